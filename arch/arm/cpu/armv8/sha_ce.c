@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-1 and SHA-256 using the ARMv8 Crypto Extensions
+ */
+
+#include <common.h>
+#include <hash.h>
+
+#define ID_AA64ISAR0_SHA1_SHIFT		8
+#define ID_AA64ISAR0_SHA2_SHIFT		12
+
+void sha1_ce_process(uint32_t *state, const uint8_t *data,
+		     unsigned int blocks);
+void sha256_ce_process(uint32_t *state, const uint8_t *data,
+		       unsigned int blocks);
+
+static unsigned int isar0_field(int shift)
+{
+	u64 isar0;
+
+	asm volatile ("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+
+	return (isar0 >> shift) & 0xf;
+}
+
+#ifdef CONFIG_SHA1
+static bool sha1_ce_probe(void)
+{
+	return isar0_field(ID_AA64ISAR0_SHA1_SHIFT) != 0;
+}
+
+U_BOOT_HASH_BACKEND(sha1_ce) = {
+	.algo		= "sha1",
+	.name		= "armv8-ce",
+	.priority	= 100,
+	.probe		= sha1_ce_probe,
+	.process	= sha1_ce_process,
+};
+#endif
+
+#ifdef CONFIG_SHA256
+static bool sha256_ce_probe(void)
+{
+	return isar0_field(ID_AA64ISAR0_SHA2_SHIFT) != 0;
+}
+
+U_BOOT_HASH_BACKEND(sha256_ce) = {
+	.algo		= "sha256",
+	.name		= "armv8-ce",
+	.priority	= 100,
+	.probe		= sha256_ce_probe,
+	.process	= sha256_ce_process,
+};
+#endif
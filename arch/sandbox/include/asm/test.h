@@ -121,4 +121,79 @@ int sandbox_pwm_get_config(struct udevice *dev, uint channel, uint *period_nsp,
  */
 void sandbox_sf_set_block_protect(struct udevice *dev, int bp_mask);
 
+/**
+ * struct sandbox_virtio_stats - ring activity seen by a sandbox virtio device
+ *
+ * @kicks:	number of notifications received
+ * @chains:	number of descriptor chains consumed
+ * @indirect:	number of chains which used an indirect descriptor table
+ * @max_batch:	most chains consumed by a single notification
+ */
+struct sandbox_virtio_stats {
+	uint kicks;
+	uint chains;
+	uint indirect;
+	uint max_batch;
+};
+
+/**
+ * sandbox_virtio_set_features() - set the features offered by the device
+ *
+ * This must be called before the child virtio device is probed.
+ *
+ * @dev: Sandbox virtio transport device
+ * @features: Device feature bits
+ */
+void sandbox_virtio_set_features(struct udevice *dev, u64 features);
+
+/**
+ * sandbox_virtio_get_stats() - get and clear the ring statistics
+ *
+ * @dev: Sandbox virtio transport device
+ * @stats: Returns the statistics since the last call
+ */
+void sandbox_virtio_get_stats(struct udevice *dev,
+			      struct sandbox_virtio_stats *stats);
+
+/**
+ * struct sandbox_sdhci_stats - ADMA2 statistics of the emulated SDHCI
+ *
+ * @transfers:	number of data transfers
+ * @descs:	number of data descriptors used by all the transfers
+ * @max_descs:	most data descriptors used by a single transfer
+ */
+struct sandbox_sdhci_stats {
+	uint transfers;
+	uint descs;
+	uint max_descs;
+};
+
+/**
+ * sandbox_sdhci_get_stats() - get and clear the ADMA2 statistics
+ *
+ * @dev: Sandbox SDHCI device
+ * @stats: Returns the statistics since the last call
+ */
+void sandbox_sdhci_get_stats(struct udevice *dev,
+			     struct sandbox_sdhci_stats *stats);
+
+/**
+ * sandbox_sdhci_get_card() - get the contents of the emulated SD card
+ *
+ * @dev: Sandbox SDHCI device
+ * @return pointer to the card contents
+ */
+u8 *sandbox_sdhci_get_card(struct udevice *dev);
+
+/**
+ * sandbox_sdhci_set_latency() - make transfers to and from the card take time
+ *
+ * Until the time is up, the emulated controller reports that it is busy and
+ * leaves the card and the memory being transferred untouched.
+ *
+ * @dev: Sandbox SDHCI device
+ * @latency_us: Time taken by each data transfer, 0 to do it at once
+ */
+void sandbox_sdhci_set_latency(struct udevice *dev, ulong latency_us);
+
 #endif
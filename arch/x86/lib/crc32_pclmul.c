@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * CRC32 using the x86 carry-less multiply instruction
+ *
+ * This is also built into sandbox on 64-bit x86 hosts, so it must not rely
+ * on anything from arch/x86/include.
+ */
+
+#include <common.h>
+#include <hash.h>
+#include <cpuid.h>
+
+#define CPUID1_ECX_PCLMULQDQ	(1 << 1)
+#define CPUID1_ECX_SSE41	(1 << 19)
+#define X86_CR4_OSFXSR		(1 << 9)
+
+void crc32_pclmul_process(uint32_t *state, const uint8_t *data,
+			  unsigned int blocks);
+
+static bool crc32_pclmul_probe(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+#ifndef CONFIG_SANDBOX
+	unsigned long cr4;
+
+	/* SSE instructions fault unless the OS has enabled them */
+	asm volatile ("mov %%cr4, %0" : "=r" (cr4));
+	if (!(cr4 & X86_CR4_OSFXSR))
+		return false;
+#endif
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+
+	return (ecx & (CPUID1_ECX_PCLMULQDQ | CPUID1_ECX_SSE41)) ==
+		(CPUID1_ECX_PCLMULQDQ | CPUID1_ECX_SSE41);
+}
+
+U_BOOT_HASH_BACKEND(crc32_pclmul) = {
+	.algo		= "crc32",
+	.name		= "pclmulqdq",
+	.priority	= 100,
+	.probe		= crc32_pclmul_probe,
+	.process	= crc32_pclmul_process,
+};
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-1 and SHA-256 using the x86 SHA extensions
+ *
+ * This is also built into sandbox on 64-bit x86 hosts, so it must not rely
+ * on anything from arch/x86/include.
+ */
+
+#include <common.h>
+#include <hash.h>
+#include <cpuid.h>
+
+#define CPUID1_ECX_SSSE3	(1 << 9)
+#define CPUID1_ECX_SSE41	(1 << 19)
+#define CPUID7_EBX_SHA		(1 << 29)
+#define X86_CR4_OSFXSR		(1 << 9)
+
+void sha1_ni_process(uint32_t *state, const uint8_t *data,
+		     unsigned int blocks);
+void sha256_ni_process(uint32_t *state, const uint8_t *data,
+		       unsigned int blocks);
+
+/* SSE instructions fault unless the OS has enabled them */
+static bool sha_ni_sse_enabled(void)
+{
+#ifdef CONFIG_SANDBOX
+	return true;
+#else
+	unsigned long cr4;
+
+	asm volatile ("mov %%cr4, %0" : "=r" (cr4));
+
+	return cr4 & X86_CR4_OSFXSR;
+#endif
+}
+
+static bool sha_ni_probe(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+	if ((ecx & (CPUID1_ECX_SSSE3 | CPUID1_ECX_SSE41)) !=
+	    (CPUID1_ECX_SSSE3 | CPUID1_ECX_SSE41))
+		return false;
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return false;
+	if (!(ebx & CPUID7_EBX_SHA))
+		return false;
+
+	return sha_ni_sse_enabled();
+}
+
+#ifdef CONFIG_SHA1
+U_BOOT_HASH_BACKEND(sha1_ni) = {
+	.algo		= "sha1",
+	.name		= "sha-ni",
+	.priority	= 100,
+	.probe		= sha_ni_probe,
+	.process	= sha1_ni_process,
+};
+#endif
+
+#ifdef CONFIG_SHA256
+U_BOOT_HASH_BACKEND(sha256_ni) = {
+	.algo		= "sha256",
+	.name		= "sha-ni",
+	.priority	= 100,
+	.probe		= sha_ni_probe,
+	.process	= sha256_ni_process,
+};
+#endif
@@ -12,37 +12,56 @@
 static int blkc_show(cmd_tbl_t *cmdtp, int flag,
 		     int argc, char * const argv[])
 {
+	struct block_cache_dev_stats dev_stats;
 	struct block_cache_stats stats;
+	unsigned total;
+	int i;
+
 	blkcache_stats(&stats);
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
 	       "entries: %u\n"
+	       "size: %u bytes\n"
 	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
-	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       "max cache entries: %u\n"
+	       "max size: %u bytes\n"
+	       "read-ahead: %u blocks\n",
+	       stats.hits, stats.misses, stats.entries, stats.size,
+	       stats.max_blocks_per_entry, stats.max_entries,
+	       stats.max_size, stats.readahead);
+
+	for (i = 0; !blkcache_dev_stats(i, &dev_stats); i++) {
+		total = dev_stats.hits + dev_stats.misses;
+		printf("%s %d: hits: %u, misses: %u, hit ratio: %u%%\n",
+		       blk_get_if_type_name(dev_stats.iftype),
+		       dev_stats.devnum, dev_stats.hits, dev_stats.misses,
+		       total ? dev_stats.hits * 100 / total : 0);
+	}
+
 	return 0;
 }
 
 static int blkc_configure(cmd_tbl_t *cmdtp, int flag,
 			  int argc, char * const argv[])
 {
-	unsigned blocks_per_entry, max_entries;
-	if (argc != 3)
+	unsigned blocks_per_entry, max_size, readahead;
+
+	if (argc < 3 || argc > 4)
 		return CMD_RET_USAGE;
 
 	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
-	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
-	printf("changed to max of %u entries of %u blocks each\n",
-	       max_entries, blocks_per_entry);
+	max_size = simple_strtoul(argv[2], 0, 0);
+	readahead = argc > 3 ? simple_strtoul(argv[3], 0, 0) : 0;
+	blkcache_configure(blocks_per_entry, max_size, readahead);
+	printf("changed to max of %u bytes, %u blocks per entry, %u blocks read-ahead\n",
+	       max_size, blocks_per_entry, readahead);
 	return 0;
 }
 
 static cmd_tbl_t cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
-	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(configure, 4, 0, blkc_configure, "", ""),
 };
 
 static __maybe_unused void blkc_reloc(void)
@@ -79,8 +98,10 @@ static int do_blkcache(cmd_tbl_t *cmdtp, int flag,
 }
 
 U_BOOT_CMD(
-	blkcache, 4, 0, do_blkcache,
+	blkcache, 5, 0, do_blkcache,
 	"block cache diagnostics and control",
 	"show - show and reset statistics\n"
-	"blkcache configure blocks entries\n"
+	"blkcache configure blocks size [readahead]\n"
+	"    - cache reads of up to 'blocks' blocks in 'size' bytes,\n"
+	"      reading 'readahead' blocks on a miss\n"
 );
@@ -43,6 +43,26 @@ U_BOOT_CMD(
 	"      If 'pos' is 0 or omitted, the file is read from the start."
 )
 
+#ifdef CONFIG_CMD_LOADZ
+static int do_loadz_wrapper(cmd_tbl_t *cmdtp, int flag, int argc,
+			    char * const argv[])
+{
+	return do_loadz(cmdtp, flag, argc, argv, FS_TYPE_ANY);
+}
+
+U_BOOT_CMD(
+	loadz,	7,	0,	do_loadz_wrapper,
+	"load a compressed file from a filesystem and decompress it",
+	"<interface> <dev[:part]> <addr> <filename> <comp> [maxsize]\n"
+	"    - Load compressed file 'filename' from partition 'part' on\n"
+	"      device type 'interface' instance 'dev', decompressing it to\n"
+	"      address 'addr' in memory one piece at a time.\n"
+	"      'comp' is the compression type (e.g. gzip, lz4, lzma).\n"
+	"      'maxsize' limits the decompressed size and defaults to\n"
+	"      CONFIG_SYS_BOOTM_LEN."
+)
+#endif
+
 static int do_save_wrapper(cmd_tbl_t *cmdtp, int flag, int argc,
 				char * const argv[])
 {
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Zstandard uncompress command, made from cmd/lzmadec.c
+ */
+
+#include <common.h>
+#include <command.h>
+#include <bootm.h>
+#include <mapmem.h>
+#include <u-boot/zstd.h>
+
+static int do_unzstd(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
+{
+	unsigned long src, dst;
+	size_t src_len = 0, dst_len = CONFIG_SYS_BOOTM_LEN;
+	void *srcp, *dstp;
+	int ret;
+
+	switch (argc) {
+	case 5:
+		src_len = simple_strtoul(argv[4], NULL, 16);
+		/* fall through */
+	case 4:
+		dst_len = simple_strtoul(argv[3], NULL, 16);
+		/* fall through */
+	case 3:
+		src = simple_strtoul(argv[1], NULL, 16);
+		dst = simple_strtoul(argv[2], NULL, 16);
+		break;
+	default:
+		return CMD_RET_USAGE;
+	}
+
+	/* Without a size, the frames are found by parsing their headers */
+	srcp = map_sysmem(src, src_len);
+	dstp = map_sysmem(dst, dst_len);
+	if (!src_len)
+		src_len = ~(uintptr_t)srcp;
+
+	ret = zstd_decompress(srcp, src_len, dstp, &dst_len);
+	unmap_sysmem(dstp);
+	unmap_sysmem(srcp);
+	if (ret) {
+		printf("Error: zstd decompression failed (%d)\n", ret);
+		return 1;
+	}
+	printf("Uncompressed size: %ld = %#lX\n", (ulong)dst_len,
+	       (ulong)dst_len);
+	env_set_hex("filesize", dst_len);
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	unzstd,    5,    1,    do_unzstd,
+	"zstd uncompress a memory region",
+	"srcaddr dstaddr [dstsize [srcsize]]"
+);
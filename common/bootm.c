@@ -14,10 +14,13 @@
 #include <malloc.h>
 #include <mapmem.h>
 #include <asm/io.h>
+#include <asm/unaligned.h>
 #include <linux/lzo.h>
 #include <lzma/LzmaTypes.h>
 #include <lzma/LzmaDec.h>
 #include <lzma/LzmaTools.h>
+#include <u-boot/zlib.h>
+#include <u-boot/zstd.h>
 #if defined(CONFIG_CMD_USB)
 #include <usb.h>
 #endif
@@ -29,11 +32,6 @@
 #include <bootm.h>
 #include <image.h>
 
-#ifndef CONFIG_SYS_BOOTM_LEN
-/* use 8MByte as default max gunzip size */
-#define CONFIG_SYS_BOOTM_LEN	0x800000
-#endif
-
 #define IH_INITRD_ARCH IH_ARCH_DEFAULT
 
 #ifndef USE_HOSTCC
@@ -66,14 +64,22 @@ static void boot_start_lmb(bootm_headers_t *images)
 	arch_lmb_reserve(&images->lmb);
 	board_lmb_reserve(&images->lmb);
 }
+
+/* Free the region storage left over from an earlier bootm */
+static void boot_release_lmb(bootm_headers_t *images)
+{
+	lmb_release(&images->lmb);
+}
 #else
 #define lmb_reserve(lmb, base, size)
 static inline void boot_start_lmb(bootm_headers_t *images) { }
+static inline void boot_release_lmb(bootm_headers_t *images) { }
 #endif
 
 static int bootm_start(cmd_tbl_t *cmdtp, int flag, int argc,
 		       char * const argv[])
 {
+	boot_release_lmb(&images);
 	memset((void *)&images, 0, sizeof(images));
 	images.verify = env_get_yesno("verify");
 
@@ -363,6 +369,9 @@ int bootm_decomp_image(int comp, ulong load, ulong image_start, int type,
 
 	*load_end = load;
 	print_decomp_msg(comp, type, load == image_start);
+#ifndef USE_HOSTCC
+	bootstage_start(BOOTSTAGE_ID_ACCUM_DECOMP, "decompress");
+#endif
 
 	/*
 	 * Load the image to the right place, decompressing if needed. After
@@ -428,10 +437,22 @@ int bootm_decomp_image(int comp, ulong load, ulong image_start, int type,
 		break;
 	}
 #endif /* CONFIG_LZ4 */
+#ifdef CONFIG_ZSTD
+	case IH_COMP_ZSTD: {
+		size_t size = unc_len;
+
+		ret = zstd_decompress(image_buf, image_len, load_buf, &size);
+		image_len = ret == -ENOSPC ? unc_len : size;
+		break;
+	}
+#endif /* CONFIG_ZSTD */
 	default:
 		printf("Unimplemented compression type %d\n", comp);
 		return BOOTM_ERR_UNIMPLEMENTED;
 	}
+#ifndef USE_HOSTCC
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_DECOMP);
+#endif
 
 	if (ret)
 		return handle_decomp_error(comp, image_len, unc_len, ret);
@@ -442,6 +463,497 @@ int bootm_decomp_image(int comp, ulong load, ulong image_start, int type,
 	return 0;
 }
 
+#ifndef USE_HOSTCC
+/* Longest gzip header we wait for (it may contain a file name) */
+#define GZIP_STREAM_HEADER_MAX	1024
+/* LZMA properties followed by the 64-bit uncompressed size */
+#define LZMA_STREAM_HEADER_SIZE	(LZMA_PROPS_SIZE + sizeof(u64))
+
+/* Decompressor state for a struct bootm_decomp_stream */
+union bootm_decomp_state {
+#ifdef CONFIG_GZIP
+	z_stream gzip;
+#endif
+#ifdef CONFIG_BZIP2
+	bz_stream bzip2;
+#endif
+#ifdef CONFIG_LZMA
+	CLzmaDec lzma;
+#endif
+#ifdef CONFIG_LZO
+	bool lzo_started;
+#endif
+#ifdef CONFIG_LZ4
+	struct ulz4fn_state lz4;
+#endif
+#ifdef CONFIG_ZSTD
+	struct zstd_stream *zstd;
+#endif
+};
+
+/*
+ * Each decoder below is passed the next @len bytes of compressed data and
+ * returns the number of bytes it used, or a -ve error. If it does not use
+ * all of the data, because a header or block is incomplete, it sets
+ * ds->need to the number of bytes it must see at once to make progress.
+ * It sets ds->done at the end of the compressed data. @last is true if no
+ * more data follows. -ENOSPC means that the output buffer is too small.
+ */
+
+#ifdef CONFIG_GZIP
+static int decomp_stream_gzip(struct bootm_decomp_stream *ds, const uchar *in,
+			      ulong len, bool last)
+{
+	z_stream *s = &ds->state->gzip;
+	int offset = 0;
+	int ret;
+
+	if (!ds->started) {
+		if (len < GZIP_STREAM_HEADER_MAX && !last) {
+			ds->need = GZIP_STREAM_HEADER_MAX;
+			return 0;
+		}
+		offset = gzip_parse_header(in, len);
+		if (offset < 0)
+			return -EINVAL;
+		s->zalloc = gzalloc;
+		s->zfree = gzfree;
+		ret = inflateInit2(s, -MAX_WBITS);
+		if (ret != Z_OK)
+			return ret;
+		s->next_out = ds->out;
+		s->avail_out = ds->out_size;
+		ds->started = true;
+	}
+
+	s->next_in = (Bytef *)in + offset;
+	s->avail_in = len - offset;
+	ret = inflate(s, last ? Z_FINISH : Z_NO_FLUSH);
+	ds->out_len = s->next_out - (Bytef *)ds->out;
+	if (ret == Z_STREAM_END) {
+		/* Ignore the trailer */
+		ds->done = true;
+		return len;
+	}
+	if (ret != Z_OK && ret != Z_BUF_ERROR)
+		return ret;
+	if (!s->avail_out && s->avail_in)
+		return -ENOSPC;
+
+	return len - s->avail_in;
+}
+#endif
+
+#ifdef CONFIG_BZIP2
+static int decomp_stream_bzip2(struct bootm_decomp_stream *ds,
+			       const uchar *in, ulong len, bool last)
+{
+	bz_stream *s = &ds->state->bzip2;
+	int ret;
+
+	if (!ds->started) {
+		/*
+		 * If we've got less than 4 MB of malloc() space,
+		 * use slower decompression algorithm which requires
+		 * at most 2300 KB of memory.
+		 */
+		ret = BZ2_bzDecompressInit(s, 0, CONFIG_SYS_MALLOC_LEN <
+					   4096 * 1024);
+		if (ret != BZ_OK)
+			return ret;
+		s->next_out = (char *)ds->out;
+		s->avail_out = ds->out_size;
+		ds->started = true;
+	}
+
+	s->next_in = (char *)in;
+	s->avail_in = len;
+	ret = BZ2_bzDecompress(s);
+	ds->out_len = (uchar *)s->next_out - ds->out;
+	if (ret == BZ_STREAM_END) {
+		ds->done = true;
+		return len;
+	}
+	if (ret != BZ_OK)
+		return ret;
+	if (!s->avail_out && s->avail_in)
+		return -ENOSPC;
+
+	return len - s->avail_in;
+}
+#endif
+
+#ifdef CONFIG_LZMA
+static void *decomp_stream_lzma_alloc(void *p, size_t size)
+{
+	return malloc(size);
+}
+
+static void decomp_stream_lzma_free(void *p, void *address)
+{
+	free(address);
+}
+
+static ISzAlloc decomp_stream_lzma_allocator = {
+	.Alloc	= decomp_stream_lzma_alloc,
+	.Free	= decomp_stream_lzma_free,
+};
+
+static int decomp_stream_lzma(struct bootm_decomp_stream *ds, const uchar *in,
+			      ulong len, bool last)
+{
+	CLzmaDec *dec = &ds->state->lzma;
+	ELzmaStatus status;
+	SizeT in_size;
+	int offset = 0;
+	u64 size;
+	SRes res;
+
+	if (!ds->started) {
+		if (len < LZMA_STREAM_HEADER_SIZE) {
+			ds->need = LZMA_STREAM_HEADER_SIZE;
+			return 0;
+		}
+		size = get_unaligned_le64(in + LZMA_PROPS_SIZE);
+		/* All ones means that the size is unknown */
+		if (size == (u64)-1)
+			size = ds->out_size;
+		else if (size > ds->out_size)
+			return -ENOSPC;
+
+		LzmaDec_Construct(dec);
+		res = LzmaDec_AllocateProbs(dec, in, LZMA_PROPS_SIZE,
+					    &decomp_stream_lzma_allocator);
+		if (res != SZ_OK)
+			return -res;
+		dec->dic = ds->out;
+		dec->dicBufSize = size;
+		LzmaDec_Init(dec);
+		offset = LZMA_STREAM_HEADER_SIZE;
+		ds->started = true;
+	}
+
+	in_size = len - offset;
+	res = LzmaDec_DecodeToDic(dec, dec->dicBufSize, in + offset, &in_size,
+				  LZMA_FINISH_END, &status);
+	ds->out_len = dec->dicPos;
+	if (res != SZ_OK)
+		return -res;
+	if (status == LZMA_STATUS_FINISHED_WITH_MARK ||
+	    (status == LZMA_STATUS_MAYBE_FINISHED_WITHOUT_MARK &&
+	     dec->dicPos == dec->dicBufSize)) {
+		ds->done = true;
+		return len;
+	}
+	if (status == LZMA_STATUS_NOT_FINISHED)
+		return -ENOSPC;
+
+	return offset + in_size;
+}
+#endif
+
+#ifdef CONFIG_LZO
+static int decomp_stream_lzo(struct bootm_decomp_stream *ds, const uchar *in,
+			     ulong len, bool last)
+{
+	size_t used, out_used;
+	int ret;
+
+	ret = lzop_decompress_stream(&ds->state->lzo_started, in, len, &used,
+				     ds->out + ds->out_len,
+				     ds->out_size - ds->out_len, &out_used,
+				     &ds->need);
+	ds->out_len += out_used;
+	if (ret == LZO_E_OK)
+		ds->done = true;
+	else if (ret == LZO_E_OUTPUT_OVERRUN)
+		return -ENOSPC;
+	else if (ret != LZO_E_INPUT_OVERRUN)
+		return ret;
+
+	return used;
+}
+#endif
+
+#ifdef CONFIG_LZ4
+static int decomp_stream_lz4(struct bootm_decomp_stream *ds, const uchar *in,
+			     ulong len, bool last)
+{
+	size_t used, out_used;
+	int ret;
+
+	ret = ulz4fn_stream(&ds->state->lz4, in, len, &used,
+			    ds->out + ds->out_len, ds->out_size - ds->out_len,
+			    &out_used, &ds->need);
+	ds->out_len += out_used;
+	if (!ret)
+		ds->done = true;
+	else if (ret == -ENOBUFS)
+		return -ENOSPC;
+	else if (ret != -EAGAIN)
+		return ret;
+
+	return used;
+}
+#endif
+
+#ifdef CONFIG_ZSTD
+static int decomp_stream_zstd(struct bootm_decomp_stream *ds, const uchar *in,
+			      ulong len, bool last)
+{
+	size_t out_used;
+	int ret;
+
+	if (!ds->started) {
+		ds->state->zstd = zstd_stream_create(ds->out, ds->out_size);
+		if (!ds->state->zstd)
+			return -ENOMEM;
+		ds->started = true;
+	}
+
+	ret = zstd_stream_decompress(ds->state->zstd, in, len, &out_used);
+	ds->out_len = out_used;
+	/* Another frame may follow the end of this one */
+	if (!ret && last)
+		ds->done = true;
+	else if (ret && ret != -EAGAIN)
+		return ret;
+
+	return len;
+}
+#endif
+
+static int decomp_stream_none(struct bootm_decomp_stream *ds, const uchar *in,
+			      ulong len, bool last)
+{
+	if (len > ds->out_size - ds->out_len)
+		return -ENOSPC;
+	memcpy(ds->out + ds->out_len, in, len);
+	ds->out_len += len;
+
+	return len;
+}
+
+static int decomp_stream_decode(struct bootm_decomp_stream *ds,
+				const uchar *in, ulong len, bool last)
+{
+	switch (ds->comp) {
+	case IH_COMP_NONE:
+		return decomp_stream_none(ds, in, len, last);
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		return decomp_stream_gzip(ds, in, len, last);
+#endif
+#ifdef CONFIG_BZIP2
+	case IH_COMP_BZIP2:
+		return decomp_stream_bzip2(ds, in, len, last);
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA:
+		return decomp_stream_lzma(ds, in, len, last);
+#endif
+#ifdef CONFIG_LZO
+	case IH_COMP_LZO:
+		return decomp_stream_lzo(ds, in, len, last);
+#endif
+#ifdef CONFIG_LZ4
+	case IH_COMP_LZ4:
+		return decomp_stream_lz4(ds, in, len, last);
+#endif
+#ifdef CONFIG_ZSTD
+	case IH_COMP_ZSTD:
+		return decomp_stream_zstd(ds, in, len, last);
+#endif
+	}
+
+	return -EPROTONOSUPPORT;
+}
+
+/* Add @len bytes to the data carried over to the next decode */
+static int decomp_stream_carry(struct bootm_decomp_stream *ds,
+			       const uchar *in, ulong len)
+{
+	ulong size = max(ds->need, ds->carry_len + len);
+	uchar *carry;
+
+	if (size > ds->carry_size) {
+		carry = realloc(ds->carry, size);
+		if (!carry)
+			return -ENOMEM;
+		ds->carry = carry;
+		ds->carry_size = size;
+	}
+	memcpy(ds->carry + ds->carry_len, in, len);
+	ds->carry_len += len;
+
+	return 0;
+}
+
+static void decomp_stream_free(struct bootm_decomp_stream *ds)
+{
+	if (ds->started) {
+		switch (ds->comp) {
+#ifdef CONFIG_GZIP
+		case IH_COMP_GZIP:
+			inflateEnd(&ds->state->gzip);
+			break;
+#endif
+#ifdef CONFIG_BZIP2
+		case IH_COMP_BZIP2:
+			BZ2_bzDecompressEnd(&ds->state->bzip2);
+			break;
+#endif
+#ifdef CONFIG_LZMA
+		case IH_COMP_LZMA:
+			LzmaDec_FreeProbs(&ds->state->lzma,
+					  &decomp_stream_lzma_allocator);
+			break;
+#endif
+#ifdef CONFIG_ZSTD
+		case IH_COMP_ZSTD:
+			zstd_stream_free(ds->state->zstd);
+			break;
+#endif
+		}
+	}
+	free(ds->state);
+	free(ds->carry);
+	ds->state = NULL;
+	ds->carry = NULL;
+	ds->started = false;
+}
+
+/* Pass @len bytes at @in to the decoder, @last if there are no more */
+static int decomp_stream_write(struct bootm_decomp_stream *ds,
+			       const uchar *in, ulong len, bool last)
+{
+	ulong take;
+	int ret;
+
+	if (!ds->state)
+		return -EINVAL;
+	bootstage_start(BOOTSTAGE_ID_ACCUM_DECOMP, "decompress");
+
+	/* Complete the header or block left over from last time first */
+	while (ds->carry_len && !ds->done) {
+		take = 0;
+		if (ds->need > ds->carry_len)
+			take = min(len, ds->need - ds->carry_len);
+		ret = decomp_stream_carry(ds, in, take);
+		if (ret)
+			goto err;
+		in += take;
+		len -= take;
+		if (ds->carry_len < ds->need && !last)
+			goto out;
+
+		ret = decomp_stream_decode(ds, ds->carry, ds->carry_len,
+					   last && !len);
+		if (ret < 0)
+			goto err;
+		if (!ret && ds->carry_len >= ds->need && !ds->done) {
+			ret = -EINVAL;
+			goto err;
+		}
+		ds->carry_len -= ret;
+		memmove(ds->carry, ds->carry + ret, ds->carry_len);
+		if (last && !len)
+			break;
+	}
+
+	/* The last call may have no data, to tell the decoder it is the end */
+	if ((len || last) && !ds->done) {
+		ret = decomp_stream_decode(ds, in, len, last);
+		if (ret < 0)
+			goto err;
+		if (ret < len && !ds->done) {
+			ret = decomp_stream_carry(ds, in + ret, len - ret);
+			if (ret)
+				goto err;
+		}
+	}
+
+	/* Uncompressed data has no end marker */
+	if (last && !ds->done && ds->comp != IH_COMP_NONE) {
+		/* The compressed data stopped early */
+		ret = -EIO;
+		goto err;
+	}
+out:
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_DECOMP);
+
+	return 0;
+
+err:
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_DECOMP);
+	decomp_stream_free(ds);
+
+	return handle_decomp_error(ds->comp, ret == -ENOSPC ? ds->out_size :
+				   ds->out_len, ds->out_size, ret);
+}
+
+int bootm_decomp_stream_start(struct bootm_decomp_stream *ds, int comp,
+			      void *out, ulong out_size)
+{
+	memset(ds, '\0', sizeof(*ds));
+	ds->comp = comp;
+	ds->out = out;
+	ds->out_size = out_size;
+	switch (comp) {
+	case IH_COMP_NONE:
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+#endif
+#ifdef CONFIG_BZIP2
+	case IH_COMP_BZIP2:
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA:
+#endif
+#ifdef CONFIG_LZO
+	case IH_COMP_LZO:
+#endif
+#ifdef CONFIG_LZ4
+	case IH_COMP_LZ4:
+#endif
+#ifdef CONFIG_ZSTD
+	case IH_COMP_ZSTD:
+#endif
+		break;
+	default:
+		printf("Unimplemented compression type %d\n", comp);
+		return BOOTM_ERR_UNIMPLEMENTED;
+	}
+	ds->state = calloc(1, sizeof(*ds->state));
+	if (!ds->state)
+		return -ENOMEM;
+
+	return 0;
+}
+
+int bootm_decomp_stream_feed(struct bootm_decomp_stream *ds, const void *buf,
+			     ulong len)
+{
+	return decomp_stream_write(ds, buf, len, false);
+}
+
+int bootm_decomp_stream_finish(struct bootm_decomp_stream *ds)
+{
+	int ret;
+
+	ret = decomp_stream_write(ds, NULL, 0, true);
+	if (!ret)
+		decomp_stream_free(ds);
+
+	return ret;
+}
+
+void bootm_decomp_stream_abort(struct bootm_decomp_stream *ds)
+{
+	decomp_stream_free(ds);
+}
+#endif /* !USE_HOSTCC */
+
 #ifndef USE_HOSTCC
 static int bootm_load_os(bootm_headers_t *images, int boot_progress)
 {
@@ -375,8 +375,16 @@ static inline void debug_printf(const char *format, ...) { }
 #define final_printf debug_printf
 
 #ifdef __U_BOOT__
+#ifdef CONFIG_HUSH_PARSE_CACHE
+/* set while parsing a string for the cache, which reports no errors */
+static int syntax_quiet;
+#else
+#define syntax_quiet 0
+#endif
+
 static void syntax_err(void) {
-	 printf("syntax error\n");
+	if (!syntax_quiet)
+		printf("syntax error\n");
 }
 #else
 static void __syntax(char *file, int line) {
@@ -1588,6 +1596,9 @@ static int run_pipe_real(struct pipe *pi)
 #endif
 		return rcode;
 	} else if (pi->num_progs == 1 && pi->progs[0].argv != NULL) {
+		/* the pipe may be run again, so leave child->sp alone */
+		int sp = child->sp;
+
 		for (i=0; is_assignment(child->argv[i]); i++) { /* nothing */ }
 		if (i!=0 && child->argv[i]==NULL) {
 			/* assignments, but no command: set the local environment */
@@ -1626,11 +1637,11 @@ static int run_pipe_real(struct pipe *pi)
 			set_local_var(p, 0);
 #endif
 			if (p != child->argv[i]) {
-				child->sp--;
+				sp--;
 				free(p);
 			}
 		}
-		if (child->sp) {
+		if (sp) {
 			char * str = NULL;
 
 			str = make_string(child->argv + i,
@@ -1764,6 +1775,7 @@ static int run_list_real(struct pipe *pi)
 	char **list = NULL;
 	char **save_list = NULL;
 	struct pipe *rpipe;
+	struct pipe *for_pipe = NULL;
 	int flag_rep = 0;
 #ifndef __U_BOOT__
 	int save_num_progs;
@@ -1802,7 +1814,8 @@ static int run_list_real(struct pipe *pi)
 				/* check Ctrl-C */
 				ctrlc();
 				if ((had_ctrlc())) {
-					return 1;
+					rcode = 1;
+					break;
 				}
 #endif
 				flag_restore = 0;
@@ -1832,6 +1845,7 @@ static int run_list_real(struct pipe *pi)
 					pi->progs->argv[0]);
 				save_list = list;
 				save_name = pi->progs->argv[0];
+				for_pipe = pi;
 				pi->progs->argv[0] = NULL;
 				flag_rep = 1;
 			}
@@ -1902,7 +1916,8 @@ static int run_list_real(struct pipe *pi)
 #else
 		if (rcode < -1) {
 			last_return_code = -rcode - 2;
-			return -2;	/* exit */
+			rcode = -2;	/* exit */
+			break;
 		}
 		last_return_code=(rcode == 0) ? 0 : 1;
 #endif
@@ -1922,6 +1937,17 @@ static int run_list_real(struct pipe *pi)
 		checkjobs(NULL);
 #endif
 	}
+	/*
+	 * If a "for" loop was left early, put back its variable name so
+	 * that the list can be run again
+	 */
+	if (list) {
+		free(for_pipe->progs->argv[0]);
+		while (*list)
+			free(*list++);
+		free(save_list);
+		for_pipe->progs->argv[0] = save_name;
+	}
 	return rcode;
 }
 
@@ -3252,6 +3278,167 @@ static int parse_stream_outer(struct in_str *inp, int flag)
 #endif /* __U_BOOT__ */
 }
 
+#ifdef CONFIG_HUSH_PARSE_CACHE
+/*
+ * Scripts run from the environment are parsed again each time they are
+ * run, which for loops adds up. So keep the parsed lists of the last few
+ * strings run. The parse only depends on the text and the flags, since
+ * variables are substituted when a list is run, so a script which is
+ * changed simply gets a new entry.
+ */
+#define PARSE_CACHE_ENTRIES	32
+
+struct parse_cache_entry {
+	char *text;		/* the string as passed in, or NULL if unused */
+	unsigned int hash;	/* hash of the text */
+	int flag;		/* parse flags */
+	struct pipe *list;	/* the parsed list */
+	int busy;		/* number of runs in progress */
+	unsigned long last_use;	/* value of parse_cache_uses when last run */
+};
+
+static struct parse_cache_entry parse_cache[PARSE_CACHE_ENTRIES];
+static unsigned long parse_cache_uses;
+
+static unsigned int parse_cache_hash(const char *s)
+{
+	unsigned int hash = 2166136261U;
+
+	while (*s) {
+		hash ^= (unsigned char)*s++;
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+/*
+ * Parse a whole string into a list without running it. This returns NULL
+ * if the string cannot be parsed in one go, e.g. on a syntax error, in
+ * which case it is left to parse_stream_outer() to deal with it, and to
+ * report the error.
+ */
+static struct pipe *parse_string_list(const char *s, int flag)
+{
+	struct in_str input;
+	struct p_context ctx;
+	o_string temp = NULL_O_STRING;
+	int rcode;
+
+	setup_string_in_str(&input, s);
+	ctx.type = flag;
+	initialize_context(&ctx);
+	update_ifs_map();
+	if (!(flag & FLAG_PARSE_SEMICOLON) || (flag & FLAG_REPARSING))
+		mapset((uchar *)";$&|", 0);
+	input.promptmode = 1;
+	syntax_quiet = 1;
+	rcode = parse_stream(&temp, &ctx, &input,
+			     flag & FLAG_CONT_ON_NEWLINE ? -1 : '\n');
+	syntax_quiet = 0;
+	if (rcode == 1 || ctx.old_flag != 0 ||
+	    (rcode != -1 && b_peek(&input))) {
+		if (ctx.old_flag != 0)
+			free(ctx.stack);
+		b_free(&temp);
+		free_pipe_list(ctx.list_head, 0);
+		return NULL;
+	}
+	done_word(&temp, &ctx);
+	done_pipe(&ctx, PIPE_SEQ);
+	b_free(&temp);
+
+	return ctx.list_head;
+}
+
+/*
+ * Find the entry holding a string, or set one up for it. Entries which are
+ * being run are left alone, since running a list changes it until the run
+ * finishes.
+ */
+static struct parse_cache_entry *parse_cache_get(const char *s, int flag)
+{
+	struct parse_cache_entry *entry, *victim = NULL;
+	unsigned int hash = parse_cache_hash(s);
+	char *p, *text;
+	int i;
+
+	for (i = 0; i < PARSE_CACHE_ENTRIES; i++) {
+		entry = &parse_cache[i];
+		if (entry->text && entry->hash == hash && entry->flag == flag &&
+		    !strcmp(entry->text, s))
+			return entry->busy ? NULL : entry;
+		/* Use an unused entry, or else the least recently used */
+		if (!entry->busy && (!victim ||
+				     (victim->text && (!entry->text ||
+				      entry->last_use < victim->last_use))))
+			victim = entry;
+	}
+	if (!victim)
+		return NULL;
+
+	/* Same as parse_string_outer(): the text must end with a newline */
+	text = xmalloc(strlen(s) + 2);
+	strcpy(text, s);
+	p = strchr(s, '\n');
+	if (!p || p[1])
+		strcat(text, "\n");
+
+	free(victim->text);
+	free_pipe_list(victim->list, 0);
+	victim->text = NULL;
+	victim->list = parse_string_list(text, flag);
+	if (!victim->list) {
+		free(text);
+		return NULL;
+	}
+
+	/* Keep the string as passed in, for comparison */
+	strcpy(text, s);
+	victim->text = text;
+	victim->hash = hash;
+	victim->flag = flag;
+
+	return victim;
+}
+
+/*
+ * Run a string from the cache. This returns -1 if the string cannot be
+ * cached, so must be run by parse_stream_outer() instead.
+ */
+static int parse_string_cached(const char *s, int flag)
+{
+	struct parse_cache_entry *entry;
+	int code;
+
+	/* A second pass over expanded text changes with the values expanded */
+	if (flag & FLAG_REPARSING)
+		return -1;
+
+	/* Without FLAG_CONT_ON_NEWLINE, each line is parsed once run */
+	if (!(flag & FLAG_CONT_ON_NEWLINE) && strchr(s, '\n') &&
+	    strchr(s, '\n')[1])
+		return -1;
+
+	entry = parse_cache_get(s, flag);
+	if (!entry)
+		return -1;
+
+	entry->last_use = ++parse_cache_uses;
+	entry->busy++;
+	code = run_list_real(entry->list);
+	entry->busy--;
+
+	/* As for parse_stream_outer() */
+	if (code == -2)		/* exit */
+		code = 0;
+	if (code == -1)
+		flag_repeat = 0;
+
+	return (code != 0) ? 1 : 0;
+}
+#endif /* CONFIG_HUSH_PARSE_CACHE */
+
 #ifndef __U_BOOT__
 static int parse_string_outer(const char *s, int flag)
 #else
@@ -3266,6 +3453,11 @@ int parse_string_outer(const char *s, int flag)
 		return 1;
 	if (!*s)
 		return 0;
+#ifdef CONFIG_HUSH_PARSE_CACHE
+	rcode = parse_string_cached(s, flag);
+	if (rcode != -1)
+		return rcode;
+#endif
 	if (!(p = strchr(s, '\n')) || *++p) {
 		p = xmalloc(strlen(s) + 2);
 		strcpy(p, s);
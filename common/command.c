@@ -11,8 +11,11 @@
 #include <common.h>
 #include <command.h>
 #include <console.h>
+#include <malloc.h>
 #include <linux/ctype.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 /*
  * Use puts() instead of printf() to avoid printf buffer overflow
  * for long help messages
@@ -116,10 +119,106 @@ cmd_tbl_t *find_cmd_tbl(const char *cmd, cmd_tbl_t *table, int table_len)
 	return NULL;	/* not found or ambiguous command */
 }
 
+#ifdef CONFIG_CMDLINE
+/*
+ * Index of the command table, sorted by name. The commands starting with a
+ * given prefix are then next to each other, so that looking up a command or
+ * the completions of a partial name is a binary search rather than a scan.
+ * It is built on first use after relocation, since it holds pointers into
+ * the table.
+ */
+static cmd_tbl_t **cmd_index;
+static int cmd_index_len;
+
+static int cmd_index_cmp(const void *a, const void *b)
+{
+	return strcmp((*(cmd_tbl_t **)a)->name, (*(cmd_tbl_t **)b)->name);
+}
+
+/*
+ * Get the sorted index of the command table, building it if needed.
+ * Returns NULL if it is not available, in which case the table must be
+ * scanned.
+ */
+static cmd_tbl_t **cmd_get_index(void)
+{
+	cmd_tbl_t *start = ll_entry_start(cmd_tbl_t, cmd);
+	const int count = ll_entry_count(cmd_tbl_t, cmd);
+	int i;
+
+	if (cmd_index || !(gd->flags & GD_FLG_RELOC))
+		return cmd_index;
+
+	cmd_index = malloc(count * sizeof(*cmd_index));
+	if (!cmd_index)
+		return NULL;
+	for (i = 0; i < count; i++)
+		cmd_index[i] = start + i;
+	qsort(cmd_index, count, sizeof(*cmd_index), cmd_index_cmp);
+	cmd_index_len = count;
+
+	return cmd_index;
+}
+
+/*
+ * Find the commands whose name starts with the first 'len' characters of
+ * 'cmd' in the sorted index. Returns the position of the first one and sets
+ * '*countp' to the number found.
+ */
+static int cmd_index_find(cmd_tbl_t **index, const char *cmd, int len,
+			  int *countp)
+{
+	int lo = 0, hi = cmd_index_len, mid, first;
+
+	/* First entry not below the prefix */
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (strncmp(index[mid]->name, cmd, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	first = lo;
+
+	/* First entry past the prefix */
+	hi = cmd_index_len;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (strncmp(index[mid]->name, cmd, len) == 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*countp = lo - first;
+
+	return first;
+}
+#endif /* CONFIG_CMDLINE */
+
 cmd_tbl_t *find_cmd(const char *cmd)
 {
 	cmd_tbl_t *start = ll_entry_start(cmd_tbl_t, cmd);
 	const int len = ll_entry_count(cmd_tbl_t, cmd);
+#ifdef CONFIG_CMDLINE
+	cmd_tbl_t **index = cmd_get_index();
+	const char *p;
+	int first, n_found, clen;
+
+	if (index && cmd) {
+		/* As find_cmd_tbl(), only compare up to the first dot */
+		p = strchr(cmd, '.');
+		clen = p ? p - cmd : strlen(cmd);
+		first = cmd_index_find(index, cmd, clen, &n_found);
+
+		/* A full match sorts before any longer name with its prefix */
+		if (n_found && strlen(index[first]->name) == clen)
+			return index[first];
+		if (n_found == 1)
+			return index[first];	/* abbreviated command */
+
+		return NULL;	/* not found or ambiguous command */
+	}
+#endif
 	return find_cmd_tbl(cmd, start, len);
 }
 
@@ -167,9 +266,11 @@ static int complete_cmdv(int argc, char * const argv[], char last_char, int maxv
 	cmd_tbl_t *cmdtp = ll_entry_start(cmd_tbl_t, cmd);
 	const int count = ll_entry_count(cmd_tbl_t, cmd);
 	const cmd_tbl_t *cmdend = cmdtp + count;
+	cmd_tbl_t **index;
 	const char *p;
 	int len, clen;
 	int n_found = 0;
+	int first, matches, i;
 	const char *cmd;
 
 	/* sanity? */
@@ -212,6 +313,24 @@ static int complete_cmdv(int argc, char * const argv[], char last_char, int maxv
 	else
 		len = p - cmd;
 
+	/* the partial matches are next to each other in the index */
+	index = cmd_get_index();
+	if (index) {
+		first = cmd_index_find(index, cmd, len, &matches);
+		for (i = first; i < first + matches; i++) {
+			/* too many! */
+			if (n_found >= maxv - 2) {
+				cmdv[n_found++] = "...";
+				break;
+			}
+
+			cmdv[n_found++] = index[i]->name;
+		}
+
+		cmdv[n_found] = NULL;
+		return n_found;
+	}
+
 	/* return the partial matches */
 	for (; cmdtp != cmdend; cmdtp++) {
 
@@ -1153,14 +1153,37 @@ int calculate_hash(const void *data, int data_len, const char *algo,
 	return 0;
 }
 
+/* Check a calculated hash against the value in hash node @noffset */
+static int fit_image_hash_compare(const void *fit, int noffset,
+				  const uint8_t *value, int value_len,
+				  char **err_msgp)
+{
+	uint8_t *fit_value;
+	int fit_value_len;
+
+	if (fit_image_hash_get_value(fit, noffset, &fit_value,
+				     &fit_value_len)) {
+		*err_msgp = "Can't get hash value property";
+		return -1;
+	}
+
+	if (value_len != fit_value_len) {
+		*err_msgp = "Bad hash value len";
+		return -1;
+	} else if (memcmp(value, fit_value, value_len) != 0) {
+		*err_msgp = "Bad hash value";
+		return -1;
+	}
+
+	return 0;
+}
+
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 				size_t size, char **err_msgp)
 {
 	uint8_t value[FIT_MAX_HASH_LEN];
-	int value_len;
+	int value_len = 0;
 	char *algo;
-	uint8_t *fit_value;
-	int fit_value_len;
 	int ignore;
 
 	*err_msgp = NULL;
@@ -1179,26 +1202,12 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		}
 	}
 
-	if (fit_image_hash_get_value(fit, noffset, &fit_value,
-				     &fit_value_len)) {
-		*err_msgp = "Can't get hash value property";
-		return -1;
-	}
-
 	if (calculate_hash(data, size, algo, value, &value_len)) {
 		*err_msgp = "Unsupported hash algorithm";
 		return -1;
 	}
 
-	if (value_len != fit_value_len) {
-		*err_msgp = "Bad hash value len";
-		return -1;
-	} else if (memcmp(value, fit_value, value_len) != 0) {
-		*err_msgp = "Bad hash value";
-		return -1;
-	}
-
-	return 0;
+	return fit_image_hash_compare(fit, noffset, value, value_len, err_msgp);
 }
 
 int fit_image_verify_with_data(const void *fit, int image_noffset,
@@ -1297,6 +1306,193 @@ int fit_image_verify(const void *fit, int image_noffset)
 	return fit_image_verify_with_data(fit, image_noffset, data, size);
 }
 
+/*
+ * @algo is looked up in the FIT, which may be overwritten by the time the
+ * hash is finished, so the hash keeps its own copy of the name
+ */
+static int fit_hash_start(struct fit_image_hash *ctx, const char *algo)
+{
+	if (IMAGE_ENABLE_CRC32 && !strcmp(algo, "crc32")) {
+		ctx->algo = "crc32";
+		ctx->u.crc = 0;
+	} else if (IMAGE_ENABLE_SHA1 && !strcmp(algo, "sha1")) {
+		ctx->algo = "sha1";
+		sha1_starts(&ctx->u.sha1);
+	} else if (IMAGE_ENABLE_SHA256 && !strcmp(algo, "sha256")) {
+		ctx->algo = "sha256";
+		sha256_starts(&ctx->u.sha256);
+	} else {
+		return -1;
+	}
+
+	return 0;
+}
+
+static void fit_hash_update(struct fit_image_hash *ctx, const void *data,
+			    size_t len)
+{
+	if (IMAGE_ENABLE_CRC32 && !strcmp(ctx->algo, "crc32"))
+		ctx->u.crc = crc32(ctx->u.crc, data, len);
+	else if (IMAGE_ENABLE_SHA1 && !strcmp(ctx->algo, "sha1"))
+		sha1_update(&ctx->u.sha1, data, len);
+	else if (IMAGE_ENABLE_SHA256 && !strcmp(ctx->algo, "sha256"))
+		sha256_update(&ctx->u.sha256, data, len);
+}
+
+static void fit_hash_finish(struct fit_image_hash *ctx, uint8_t *value,
+			    int *value_len)
+{
+	if (IMAGE_ENABLE_CRC32 && !strcmp(ctx->algo, "crc32")) {
+		*((uint32_t *)value) = cpu_to_uimage(ctx->u.crc);
+		*value_len = 4;
+	} else if (IMAGE_ENABLE_SHA1 && !strcmp(ctx->algo, "sha1")) {
+		sha1_finish(&ctx->u.sha1, value);
+		*value_len = SHA1_SUM_LEN;
+	} else if (IMAGE_ENABLE_SHA256 && !strcmp(ctx->algo, "sha256")) {
+		sha256_finish(&ctx->u.sha256, value);
+		*value_len = SHA256_SUM_LEN;
+	}
+}
+
+int fit_image_hash_start(const void *fit, int image_noffset,
+			 struct fit_image_hashes *hashes)
+{
+	struct fit_image_hash *ctx;
+	int noffset, verify_all = 1;
+	uint8_t *value;
+	char *algo;
+
+	hashes->count = 0;
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+		int ignore = 0;
+
+		if (!strncmp(name, FIT_SIG_NODENAME,
+			     strlen(FIT_SIG_NODENAME)))
+			return -EAGAIN;
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (hashes->count == FIT_STREAM_MAX_HASHES)
+			return -EAGAIN;
+		ctx = &hashes->hash[hashes->count];
+		if (fit_image_hash_get_algo(fit, noffset, &algo))
+			return -EAGAIN;
+		if (IMAGE_ENABLE_IGNORE)
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+		ctx->skip = ignore;
+		if (fit_hash_start(ctx, algo))
+			return -EAGAIN;
+		if (!ctx->skip) {
+			if (fit_image_hash_get_value(fit, noffset, &value,
+						     &ctx->value_len) ||
+			    ctx->value_len > sizeof(ctx->value))
+				return -EAGAIN;
+			memcpy(ctx->value, value, ctx->value_len);
+		}
+		hashes->count++;
+	}
+	if (noffset == -FDT_ERR_TRUNCATED || noffset == -FDT_ERR_BADSTRUCTURE)
+		return -EAGAIN;
+
+	/*
+	 * There are no signatures, so this only fails if one is required.
+	 * The data is not looked at.
+	 */
+	if (IMAGE_ENABLE_VERIFY &&
+	    fit_image_verify_required_sigs(fit, image_noffset, NULL, 0,
+					   gd_fdt_blob(), &verify_all))
+		return -EAGAIN;
+
+	return 0;
+}
+
+void fit_image_hash_update(struct fit_image_hashes *hashes, const void *data,
+			   size_t len)
+{
+	int i;
+
+	for (i = 0; i < hashes->count; i++) {
+		if (!hashes->hash[i].skip)
+			fit_hash_update(&hashes->hash[i], data, len);
+	}
+}
+
+int fit_image_hash_finish(struct fit_image_hashes *hashes)
+{
+	uint8_t value[FIT_MAX_HASH_LEN];
+	struct fit_image_hash *ctx;
+	int value_len = 0;
+	int i;
+
+	for (i = 0; i < hashes->count; i++) {
+		ctx = &hashes->hash[i];
+		printf("%s", ctx->algo);
+		if (ctx->skip) {
+			printf("-skipped ");
+			continue;
+		}
+		fit_hash_finish(ctx, value, &value_len);
+		if (value_len != ctx->value_len) {
+			printf(" error!\nBad hash value len\n");
+			return 0;
+		} else if (memcmp(value, ctx->value, value_len)) {
+			printf(" error!\nBad hash value\n");
+			return 0;
+		}
+		puts("+ ");
+	}
+
+	return 1;
+}
+
+/* Size of the pieces in which fit_image_copy_verify() copies and hashes */
+#define FIT_COPY_CHUNK_SIZE	(64 << 10)
+
+/**
+ * fit_image_copy_verify - copy image data, checking its hashes on the way
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ * @dst: where to copy the image data to
+ * @src: image data
+ * @size: size of the image data
+ *
+ * The data is copied a piece at a time and each piece is hashed straight
+ * after it is copied, while it is still in the cache, so the image is only
+ * read from memory once. @dst must not overlap the end of @src, but may
+ * overlap the rest of @fit, which is not looked at once copying starts.
+ *
+ * returns:
+ *     1, if all hashes are valid
+ *     0, otherwise
+ *     -EAGAIN, if the image must be checked with fit_image_verify(), in
+ *     which case nothing is copied
+ */
+int fit_image_copy_verify(const void *fit, int image_noffset, void *dst,
+			  const void *src, size_t size)
+{
+	struct fit_image_hashes hashes;
+	size_t chunk, ofs;
+	int ret;
+
+	ret = fit_image_hash_start(fit, image_noffset, &hashes);
+	if (ret)
+		return ret;
+
+	for (ofs = 0; ofs < size; ofs += chunk) {
+		chunk = size - ofs;
+		if (chunk > FIT_COPY_CHUNK_SIZE)
+			chunk = FIT_COPY_CHUNK_SIZE;
+		memmove((char *)dst + ofs, (const char *)src + ofs, chunk);
+		fit_image_hash_update(&hashes, (char *)dst + ofs, chunk);
+#if defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG)
+		WATCHDOG_RESET();
+#endif
+	}
+
+	return fit_image_hash_finish(&hashes);
+}
+
 /**
  * fit_all_image_verify - verify data integrity for all images
  * @fit: pointer to the FIT format image header
@@ -1706,11 +1902,16 @@ int fit_conf_get_prop_node(const void *fit, int noffset,
 
 static int fit_image_select(const void *fit, int rd_noffset, int verify)
 {
+	int ret;
+
 	fit_image_print(fit, rd_noffset, "   ");
 
 	if (verify) {
 		puts("   Verifying Hash Integrity ... ");
-		if (!fit_image_verify(fit, rd_noffset)) {
+		bootstage_start(BOOTSTAGE_ID_ACCUM_FIT_HASH, "fit_hash");
+		ret = fit_image_verify(fit, rd_noffset);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_FIT_HASH);
+		if (!ret) {
 			puts("Bad Data Hash\n");
 			return -EACCES;
 		}
@@ -1720,6 +1921,36 @@ static int fit_image_select(const void *fit, int rd_noffset, int verify)
 	return 0;
 }
 
+/*
+ * Check whether fit_image_load() will copy the image to its load address,
+ * following the same rules that it does, without overwriting the FIT or the
+ * image data. The FIT is still read after the copy.
+ */
+static bool fit_image_copied_on_load(const void *fit, ulong addr, int noffset,
+				     enum fit_load_op load_op)
+{
+#if !defined(USE_HOSTCC) && defined(CONFIG_FIT_IMAGE_POST_PROCESS)
+	/* The hashes cover the data as it was before post-processing */
+	return false;
+#else
+	const void *buf;
+	ulong load, start;
+	size_t size;
+
+	if (load_op == FIT_LOAD_IGNORED ||
+	    fit_image_get_load(fit, noffset, &load) ||
+	    (load_op == FIT_LOAD_OPTIONAL_NON_ZERO && !load) ||
+	    fit_image_get_data_and_size(fit, noffset, &buf, &size))
+		return false;
+
+	start = map_to_sysmem((void *)buf);
+	if (load < addr + fit_get_size(fit) && load + size > addr)
+		return false;
+
+	return load + size <= start || load >= start + size;
+#endif
+}
+
 int fit_get_node_from_config(bootm_headers_t *images, const char *prop_name,
 			ulong addr)
 {
@@ -1780,6 +2011,79 @@ static const char *fit_get_image_type_property(int type)
 	return "unknown";
 }
 
+/*
+ * Copy the image data at @buf, which is at *@datap, to its load address, if
+ * it has one, and update *@datap to point there. If @verify is true, the
+ * hashes are checked while copying.
+ */
+static int fit_image_load_data(const void *fit, int noffset, ulong addr,
+			       int image_type, enum fit_load_op load_op,
+			       const char *prop_name, int bootstage_id,
+			       const void *buf, ulong len, bool verify,
+			       ulong *datap)
+{
+	ulong load;
+	int ret;
+
+	if (load_op == FIT_LOAD_IGNORED) {
+		/* Don't load */
+	} else if (fit_image_get_load(fit, noffset, &load)) {
+		if (load_op == FIT_LOAD_REQUIRED) {
+			printf("Can't get %s subimage load address!\n",
+			       prop_name);
+			bootstage_error(bootstage_id + BOOTSTAGE_SUB_LOAD);
+			return -EBADF;
+		}
+	} else if (load_op != FIT_LOAD_OPTIONAL_NON_ZERO || load) {
+		ulong image_start, image_end;
+		ulong load_end;
+		void *dst;
+
+		/*
+		 * move image data to the load address,
+		 * make sure we don't overwrite initial image
+		 */
+		image_start = addr;
+		image_end = addr + fit_get_size(fit);
+
+		load_end = load + len;
+		if (image_type != IH_TYPE_KERNEL &&
+		    load < image_end && load_end > image_start) {
+			printf("Error: %s overwritten\n", prop_name);
+			return -EXDEV;
+		}
+
+		printf("   Loading %s from 0x%08lx to 0x%08lx\n",
+		       prop_name, *datap, load);
+
+		dst = map_sysmem(load, len);
+		bootstage_start(BOOTSTAGE_ID_ACCUM_FIT_LOAD, "fit_load");
+		if (verify) {
+			puts("   Verifying Hash Integrity ... ");
+			ret = fit_image_copy_verify(fit, noffset, dst, buf,
+						    len);
+			if (ret == -EAGAIN) {
+				ret = fit_image_verify(fit, noffset);
+				if (ret)
+					memmove(dst, buf, len);
+			}
+			if (!ret) {
+				puts("Bad Data Hash\n");
+				bootstage_error(bootstage_id +
+						BOOTSTAGE_SUB_HASH);
+				return -EACCES;
+			}
+			puts("OK\n");
+		} else {
+			memmove(dst, buf, len);
+		}
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_FIT_LOAD);
+		*datap = load;
+	}
+
+	return 0;
+}
+
 int fit_image_load(bootm_headers_t *images, ulong addr,
 		   const char **fit_unamep, const char **fit_uname_configp,
 		   int arch, int image_type, int bootstage_id,
@@ -1793,12 +2097,13 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 	const void *buf;
 	size_t size;
 	int type_ok, os_ok;
-	ulong load, data, len;
+	ulong data, len;
 	uint8_t os;
 #ifndef USE_HOSTCC
 	uint8_t os_arch;
 #endif
 	const char *prop_name;
+	bool verify_on_load;
 	int ret;
 
 	fit = map_sysmem(addr, 0);
@@ -1870,12 +2175,53 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 
 	printf("   Trying '%s' %s subimage\n", fit_uname, prop_name);
 
-	ret = fit_image_select(fit, noffset, images->verify);
+	/*
+	 * If the image is copied to its load address, check its hashes while
+	 * copying it rather than in a separate pass beforehand
+	 */
+	verify_on_load = images->verify &&
+			 fit_image_copied_on_load(fit, addr, noffset, load_op);
+	ret = fit_image_select(fit, noffset,
+			       images->verify && !verify_on_load);
 	if (ret) {
 		bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
 		return ret;
 	}
 
+	/* get image data address and length */
+	if (fit_image_get_data_and_size(fit, noffset, &buf, &size)) {
+		printf("Could not find %s subimage data!\n", prop_name);
+		bootstage_error(bootstage_id + BOOTSTAGE_SUB_GET_DATA);
+		return -ENOENT;
+	}
+
+#if !defined(USE_HOSTCC) && defined(CONFIG_FIT_IMAGE_POST_PROCESS)
+	/* perform any post-processing on the image data */
+	board_fit_image_post_process((void **)&buf, &size);
+#endif
+
+	len = (ulong)size;
+
+	/*
+	 * Work-around for eldk-4.2 which gives this warning if we try to
+	 * cast in the unmap_sysmem() call:
+	 * warning: initialization discards qualifiers from pointer target type
+	 */
+	{
+		void *vbuf = (void *)buf;
+
+		data = map_to_sysmem(vbuf);
+	}
+
+	/* check the hashes before anything else is checked */
+	if (verify_on_load) {
+		ret = fit_image_load_data(fit, noffset, addr, image_type,
+					  load_op, prop_name, bootstage_id,
+					  buf, len, true, &data);
+		if (ret)
+			return ret;
+	}
+
 	bootstage_mark(bootstage_id + BOOTSTAGE_SUB_CHECK_ARCH);
 #if !defined(USE_HOSTCC) && !defined(CONFIG_SANDBOX)
 	if (!fit_image_check_target_arch(fit, noffset)) {
@@ -1925,74 +2271,22 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 
 	bootstage_mark(bootstage_id + BOOTSTAGE_SUB_CHECK_ALL_OK);
 
-	/* get image data address and length */
-	if (fit_image_get_data_and_size(fit, noffset, &buf, &size)) {
-		printf("Could not find %s subimage data!\n", prop_name);
-		bootstage_error(bootstage_id + BOOTSTAGE_SUB_GET_DATA);
-		return -ENOENT;
+	if (!verify_on_load) {
+		ret = fit_image_load_data(fit, noffset, addr, image_type,
+					  load_op, prop_name, bootstage_id,
+					  buf, len, false, &data);
+		if (ret)
+			return ret;
 	}
 
-#if !defined(USE_HOSTCC) && defined(CONFIG_FIT_IMAGE_POST_PROCESS)
-	/* perform any post-processing on the image data */
-	board_fit_image_post_process((void **)&buf, &size);
-#endif
-
-	len = (ulong)size;
-
 	/* verify that image data is a proper FDT blob */
-	if (image_type == IH_TYPE_FLATDT && fdt_check_header(buf)) {
+	if (image_type == IH_TYPE_FLATDT &&
+	    fdt_check_header(map_sysmem(data, len))) {
 		puts("Subimage data is not a FDT");
 		return -ENOEXEC;
 	}
 
 	bootstage_mark(bootstage_id + BOOTSTAGE_SUB_GET_DATA_OK);
-
-	/*
-	 * Work-around for eldk-4.2 which gives this warning if we try to
-	 * cast in the unmap_sysmem() call:
-	 * warning: initialization discards qualifiers from pointer target type
-	 */
-	{
-		void *vbuf = (void *)buf;
-
-		data = map_to_sysmem(vbuf);
-	}
-
-	if (load_op == FIT_LOAD_IGNORED) {
-		/* Don't load */
-	} else if (fit_image_get_load(fit, noffset, &load)) {
-		if (load_op == FIT_LOAD_REQUIRED) {
-			printf("Can't get %s subimage load address!\n",
-			       prop_name);
-			bootstage_error(bootstage_id + BOOTSTAGE_SUB_LOAD);
-			return -EBADF;
-		}
-	} else if (load_op != FIT_LOAD_OPTIONAL_NON_ZERO || load) {
-		ulong image_start, image_end;
-		ulong load_end;
-		void *dst;
-
-		/*
-		 * move image data to the load address,
-		 * make sure we don't overwrite initial image
-		 */
-		image_start = addr;
-		image_end = addr + fit_get_size(fit);
-
-		load_end = load + len;
-		if (image_type != IH_TYPE_KERNEL &&
-		    load < image_end && load_end > image_start) {
-			printf("Error: %s overwritten\n", prop_name);
-			return -EXDEV;
-		}
-
-		printf("   Loading %s from 0x%08lx to 0x%08lx\n",
-		       prop_name, data, load);
-
-		dst = map_sysmem(load, len);
-		memmove(dst, buf, len);
-		data = load;
-	}
 	bootstage_mark(bootstage_id + BOOTSTAGE_SUB_LOAD);
 
 	*datap = data;
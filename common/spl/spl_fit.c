@@ -9,6 +9,7 @@
 #include <fpga.h>
 #include <image.h>
 #include <linux/libfdt.h>
+#include <memalign.h>
 #include <spl.h>
 
 #ifndef CONFIG_SYS_BOOTM_LEN
@@ -141,6 +142,150 @@ static int get_aligned_image_size(struct spl_load_info *info, int data_size,
 	return (data_size + info->bl_len - 1) / info->bl_len;
 }
 
+/* Largest block size that spl_fit_read_direct() handles */
+#define SPL_FIT_MAX_BLKSZ	512
+
+/* Number of bytes read from a block device before hashing them */
+#define SPL_FIT_READ_CHUNK	(64 << 10)
+
+/* Hash the part of a newly read piece which falls inside the image */
+static void spl_fit_hash_piece(struct fit_image_hashes *hashes, ulong piece,
+			       ulong piece_len, ulong load_addr, size_t length)
+{
+#ifdef CONFIG_SPL_FIT_SIGNATURE
+	ulong start = max(piece, load_addr);
+	ulong end = min(piece + piece_len, load_addr + (ulong)length);
+
+	if (hashes && start < end)
+		fit_image_hash_update(hashes, (void *)start, end - start);
+#endif
+}
+
+/**
+ * spl_fit_read_direct(): read external image data to its load address
+ * @info:	points to information about the device to load data from
+ * @sector:	the start sector of the FIT image on the device
+ * @offset:	offset of the image data from the start of the FIT
+ * @load_addr:	where the image data must end up
+ * @length:	size of the image data
+ * @hashes:	hash state to update as the data arrives, or NULL
+ *
+ * The data is read straight to the load address, rather than to a
+ * temporary buffer and then copied. A block device can only read whole
+ * blocks, so the data is read to just below the load address such that
+ * the image lands in the right place. The bytes before the image which
+ * this overwrites are saved and put back, and the last partial block goes
+ * through a bounce buffer.
+ *
+ * Return:	0 on success, -EAGAIN if the buffer would not be aligned for
+ *		DMA, or another negative error number
+ */
+static int spl_fit_read_direct(struct spl_load_info *info, ulong sector,
+			       int offset, ulong load_addr, size_t length,
+			       struct fit_image_hashes *hashes)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, bounce, SPL_FIT_MAX_BLKSZ);
+	ulong overhead, total, full, rem, blk, dst, pos, count, start;
+
+	/* A filesystem can read from any offset; do it all at once */
+	if (info->filename) {
+		if (load_addr & (ARCH_DMA_MINALIGN - 1))
+			return -EAGAIN;
+		if (info->read(info, sector + offset, length,
+			       (void *)load_addr) != length)
+			return -EIO;
+		spl_fit_hash_piece(hashes, load_addr, length, load_addr,
+				   length);
+		return 0;
+	}
+
+	overhead = offset % info->bl_len;
+	dst = load_addr - overhead;
+	if (info->bl_len > SPL_FIT_MAX_BLKSZ ||
+	    (dst & (ARCH_DMA_MINALIGN - 1)))
+		return -EAGAIN;
+
+	blk = sector + offset / info->bl_len;
+	total = overhead + length;
+	full = total / info->bl_len;
+	rem = total % info->bl_len;
+
+	/* Keep the bytes before the image, which the first block covers */
+	if (full && overhead)
+		memcpy(bounce, (void *)dst, overhead);
+	for (pos = 0; pos < full; pos += count) {
+		count = full - pos;
+		if (hashes)
+			count = min(count,
+				    (ulong)(SPL_FIT_READ_CHUNK / info->bl_len));
+		if (info->read(info, blk + pos, count,
+			       (void *)dst + pos * info->bl_len) != count)
+			return -EIO;
+		if (!pos && overhead)
+			memcpy((void *)dst, bounce, overhead);
+		spl_fit_hash_piece(hashes, dst + pos * info->bl_len,
+				   count * info->bl_len, load_addr, length);
+	}
+
+	/* Copy the rest of the image out of the last block */
+	if (rem) {
+		if (info->read(info, blk + full, 1, bounce) != 1)
+			return -EIO;
+		start = full ? 0 : overhead;
+		memcpy((void *)dst + full * info->bl_len + start,
+		       bounce + start, rem - start);
+		spl_fit_hash_piece(hashes, dst + full * info->bl_len + start,
+				   rem - start, load_addr, length);
+	}
+
+	return 0;
+}
+
+/**
+ * spl_fit_load_external(): read external image data and check its hashes
+ *
+ * This reads the data straight to @load_addr using spl_fit_read_direct(),
+ * hashing it as it arrives.
+ *
+ * Return:	0 on success, -EAGAIN if the data must be loaded through a
+ *		temporary buffer, or another negative error number
+ */
+static int spl_fit_load_external(struct spl_load_info *info, ulong sector,
+				 void *fit, int node, int offset,
+				 ulong load_addr, size_t length)
+{
+	struct fit_image_hashes *hashes = NULL;
+	int ret;
+#ifdef CONFIG_SPL_FIT_SIGNATURE
+	struct fit_image_hashes state;
+
+	if (!fit_image_hash_start(fit, node, &state))
+		hashes = &state;
+#endif
+
+	ret = spl_fit_read_direct(info, sector, offset, load_addr, length,
+				  hashes);
+	if (ret)
+		return ret;
+	debug("External data: dst=%lx, offset=%x, size=%lx\n",
+	      load_addr, offset, (unsigned long)length);
+
+#ifdef CONFIG_SPL_FIT_SIGNATURE
+	printf("## Checking hash(es) for Image %s ... ",
+	       fit_get_name(fit, node, NULL));
+	if (hashes)
+		ret = fit_image_hash_finish(hashes);
+	else
+		ret = fit_image_verify_with_data(fit, node, (void *)load_addr,
+						 length);
+	if (!ret)
+		return -EPERM;
+	puts("OK\n");
+#endif
+
+	return 0;
+}
+
 /**
  * spl_load_fit_image(): load the image described in a certain FIT node
  * @info:	points to information about the device to load data from
@@ -174,6 +319,8 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 	uint8_t image_comp = -1, type = -1;
 	const void *data;
 	bool external_data = false;
+	bool direct, copied = false;
+	int ret;
 
 	if (IS_ENABLED(CONFIG_SPL_FPGA_SUPPORT) ||
 	    (IS_ENABLED(CONFIG_SPL_OS_BOOT) && IS_ENABLED(CONFIG_SPL_GZIP))) {
@@ -200,13 +347,29 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 		external_data = true;
 	}
 
+	/*
+	 * Unless the data must be decompressed or post-processed, it goes
+	 * straight to the load address and is hashed on the way
+	 */
+	direct = !IS_ENABLED(CONFIG_SPL_FIT_IMAGE_POST_PROCESS) &&
+		 !(IS_ENABLED(CONFIG_SPL_GZIP) && image_comp == IH_COMP_GZIP);
+
 	if (external_data) {
 		/* External data */
 		if (fit_image_get_data_size(fit, node, &len))
 			return -ENOENT;
+		length = len;
+
+		if (direct) {
+			ret = spl_fit_load_external(info, sector, fit, node,
+						    offset, load_addr, len);
+			if (!ret)
+				goto done;
+			if (ret != -EAGAIN)
+				return ret;
+		}
 
 		load_ptr = (load_addr + align_len) & ~align_len;
-		length = len;
 
 		overhead = get_aligned_image_overhead(info, offset);
 		nr_sectors = get_aligned_image_size(info, length, offset);
@@ -233,8 +396,18 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 #ifdef CONFIG_SPL_FIT_SIGNATURE
 	printf("## Checking hash(es) for Image %s ... ",
 	       fit_get_name(fit, node, NULL));
-	if (!fit_image_verify_with_data(fit, node,
-					 src, length))
+	/* The copy runs forwards, so must not overrun the data */
+	ret = -EAGAIN;
+	if (direct && (load_addr <= (ulong)src ||
+		       load_addr >= (ulong)src + length))
+		ret = fit_image_copy_verify(fit, node, (void *)load_addr, src,
+					    length);
+	if (ret == -EAGAIN &&
+	    fit_image_verify_with_data(fit, node, src, length))
+		ret = 0;
+	else if (ret == 1)
+		copied = true;
+	else
 		return -EPERM;
 	puts("OK\n");
 #endif
@@ -251,10 +424,11 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 			return -EIO;
 		}
 		length = size;
-	} else {
+	} else if (!copied) {
 		memcpy((void *)load_addr, src, length);
 	}
 
+done:
 	if (image_info) {
 		image_info->load_addr = load_addr;
 		image_info->size = length;
@@ -431,7 +431,9 @@ unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
+	lbaint_t ra_start, ra_cnt;
 	ulong blks_read;
+	void *ra_buf;
 
 	if (!ops->read)
 		return -ENOSYS;
@@ -439,6 +441,17 @@ unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 	if (blkcache_read(block_dev->if_type, block_dev->devnum,
 			  start, blkcnt, block_dev->blksz, buffer))
 		return blkcnt;
+
+	ra_buf = blkcache_readahead(block_dev, start, blkcnt, &ra_start,
+				   &ra_cnt);
+	if (ra_buf && ops->read(dev, ra_start, ra_cnt, ra_buf) == ra_cnt) {
+		blkcache_fill(block_dev->if_type, block_dev->devnum,
+			      ra_start, ra_cnt, block_dev->blksz, ra_buf);
+		memcpy(buffer, ra_buf + (start - ra_start) * block_dev->blksz,
+		       blkcnt * block_dev->blksz);
+		return blkcnt;
+	}
+
 	blks_read = ops->read(dev, start, blkcnt, buffer);
 	if (blks_read == blkcnt)
 		blkcache_fill(block_dev->if_type, block_dev->devnum,
@@ -457,6 +470,7 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 		return -ENOSYS;
 
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	block_dev->write_count++;
 	return ops->write(dev, start, blkcnt, buffer);
 }
 
@@ -470,9 +484,82 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 		return -ENOSYS;
 
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	block_dev->write_count++;
 	return ops->erase(dev, start, blkcnt);
 }
 
+void blk_request_done(struct blk_request *req, unsigned long result)
+{
+	req->result = result;
+	req->done = true;
+	if (req->complete)
+		req->complete(req);
+}
+
+int blk_dsubmit(struct blk_desc *block_dev, struct blk_request *req)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
+
+	if (req->write ? !ops->write : !ops->read)
+		return -ENOSYS;
+
+	req->done = false;
+	if (ops->submit) {
+		if (req->write) {
+			blkcache_invalidate(block_dev->if_type,
+					    block_dev->devnum);
+			block_dev->write_count++;
+		} else if (blkcache_read(block_dev->if_type, block_dev->devnum,
+					 req->start, req->blkcnt,
+					 block_dev->blksz, req->buffer)) {
+			blk_request_done(req, req->blkcnt);
+			return 0;
+		}
+
+		ret = ops->submit(dev, req);
+		if (ret != -ENOSYS)
+			return ret;
+	}
+
+	/* The driver cannot queue this request, so do it now */
+	blk_request_done(req, req->write ?
+			 blk_dwrite(block_dev, req->start, req->blkcnt,
+				    req->buffer) :
+			 blk_dread(block_dev, req->start, req->blkcnt,
+				   req->buffer));
+
+	return 0;
+}
+
+int blk_dpoll(struct blk_desc *block_dev)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+
+	if (!ops->poll)
+		return 0;
+
+	return ops->poll(dev);
+}
+
+unsigned long blk_dwait(struct blk_desc *block_dev, struct blk_request *req)
+{
+	int ret;
+
+	while (!req->done) {
+		ret = blk_dpoll(block_dev);
+		if (ret < 0)
+			return ret;
+		/* Nothing is outstanding, so the request was lost */
+		if (!ret && !req->done)
+			return -EIO;
+	}
+
+	return req->result;
+}
+
 int blk_get_from_parent(struct udevice *parent, struct udevice **devp)
 {
 	struct udevice *dev;
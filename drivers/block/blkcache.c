@@ -7,166 +7,346 @@
 #include <config.h>
 #include <common.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <part.h>
 #include <linux/ctype.h>
-#include <linux/list.h>
+#include <linux/log2.h>
 
-struct block_cache_node {
-	struct list_head lh;
+/*
+ * The cache is a set-associative array of lines, each holding one block.
+ * A block is looked up by hashing (iftype, devnum, lba) into a set and
+ * comparing the tags of the BLKCACHE_WAYS lines in that set, so the cost
+ * of a lookup does not depend on the cache size. The least recently used
+ * line of a set is replaced on a fill.
+ *
+ * Consecutive blocks map to consecutive sets, so a run of blocks (a FAT
+ * sector range, an ext4 inode table block) never competes for the same
+ * set. Line buffers are allocated on first use and the total is kept
+ * within the configured byte budget.
+ */
+#define BLKCACHE_WAYS		4
+/* Smallest block size, used to size the line array from the budget */
+#define BLKCACHE_MIN_BLKSZ	512
+/* Number of devices with separate statistics */
+#define BLKCACHE_MAX_DEVS	8
+
+struct block_cache_line {
 	int iftype;
 	int devnum;
-	lbaint_t start;
-	lbaint_t blkcnt;
-	unsigned long blksz;
-	char *cache;
+	lbaint_t lba;
+	unsigned long blksz;	/* 0 if the line is empty */
+	unsigned long used;	/* LRU stamp */
+	char *data;
+	unsigned long size;	/* bytes allocated for data */
 };
 
-static LIST_HEAD(block_cache);
+static struct block_cache_line *lines;
+static unsigned num_sets;
+static unsigned long lru_stamp;
+static unsigned long cache_bytes;
+
+/* Read-ahead bounce buffer, reused for every miss */
+static void *ra_buf;
+static unsigned long ra_buf_size;
+
+static struct block_cache_dev_stats dev_stats[BLKCACHE_MAX_DEVS];
 
 static struct block_cache_stats _stats = {
-	.max_blocks_per_entry = 2,
-	.max_entries = 32
+	.max_blocks_per_entry = CONFIG_BLOCK_CACHE_MAX_BLOCKS,
+	.max_entries = CONFIG_BLOCK_CACHE_SIZE * 1024 / BLKCACHE_MIN_BLKSZ,
+	.max_size = CONFIG_BLOCK_CACHE_SIZE * 1024,
+	.readahead = CONFIG_BLOCK_CACHE_READAHEAD,
 };
 
-static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+static struct block_cache_dev_stats *dev_stats_get(int iftype, int devnum)
 {
-	struct block_cache_node *node;
-
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
-			if (block_cache.next != &node->lh) {
-				/* maintain MRU ordering */
-				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
-			}
-			return node;
+	struct block_cache_dev_stats *ds;
+	int i;
+
+	for (i = 0, ds = dev_stats; i < BLKCACHE_MAX_DEVS; i++, ds++) {
+		if (ds->active && ds->iftype == iftype && ds->devnum == devnum)
+			return ds;
+		if (!ds->active) {
+			ds->active = true;
+			ds->iftype = iftype;
+			ds->devnum = devnum;
+			return ds;
 		}
+	}
+
+	return NULL;
+}
+
+static void cache_account(int iftype, int devnum, bool hit)
+{
+	struct block_cache_dev_stats *ds = dev_stats_get(iftype, devnum);
+
+	if (hit) {
+		++_stats.hits;
+		if (ds)
+			ds->hits++;
+	} else {
+		++_stats.misses;
+		if (ds)
+			ds->misses++;
+	}
+}
+
+static struct block_cache_line *cache_set(int iftype, int devnum,
+					  lbaint_t lba)
+{
+	unsigned set;
+
+	set = ((unsigned)lba + ((unsigned)devnum << 8) +
+	       ((unsigned)iftype << 12)) & (num_sets - 1);
+
+	return &lines[set * BLKCACHE_WAYS];
+}
+
+static struct block_cache_line *cache_find(int iftype, int devnum,
+					   lbaint_t lba, unsigned long blksz)
+{
+	struct block_cache_line *line;
+	int way;
+
+	if (!lines)
+		return NULL;
+
+	line = cache_set(iftype, devnum, lba);
+	for (way = 0; way < BLKCACHE_WAYS; way++, line++)
+		if (line->blksz == blksz && line->lba == lba &&
+		    line->devnum == devnum && line->iftype == iftype)
+			return line;
+
+	return NULL;
+}
+
+static int cache_alloc(void)
+{
+	unsigned entries = _stats.max_entries;
+
+	if (entries < BLKCACHE_WAYS)
+		return -EINVAL;
+
+	num_sets = rounddown_pow_of_two(entries / BLKCACHE_WAYS);
+	lines = calloc(num_sets * BLKCACHE_WAYS, sizeof(*lines));
+	if (!lines)
+		return -ENOMEM;
+
 	return 0;
 }
 
+static void cache_free(void)
+{
+	unsigned i;
+
+	if (lines) {
+		for (i = 0; i < num_sets * BLKCACHE_WAYS; i++)
+			free(lines[i].data);
+		free(lines);
+	}
+	lines = NULL;
+	num_sets = 0;
+	cache_bytes = 0;
+	_stats.entries = 0;
+	free(ra_buf);
+	ra_buf = NULL;
+	ra_buf_size = 0;
+}
+
+static void cache_insert(int iftype, int devnum, lbaint_t lba,
+			 unsigned long blksz, const char *buffer)
+{
+	struct block_cache_line *line, *victim;
+	int way;
+
+	line = cache_find(iftype, devnum, lba, blksz);
+	if (line) {
+		memcpy(line->data, buffer, blksz);
+		line->used = ++lru_stamp;
+		return;
+	}
+
+	/* take an empty line if any, else the least recently used one */
+	victim = cache_set(iftype, devnum, lba);
+	for (way = 0, line = victim; way < BLKCACHE_WAYS; way++, line++) {
+		if (!line->blksz) {
+			victim = line;
+			break;
+		}
+		if (line->used < victim->used)
+			victim = line;
+	}
+
+	if (victim->size < blksz) {
+		if (cache_bytes - victim->size + blksz > _stats.max_size)
+			return;
+		free(victim->data);
+		cache_bytes -= victim->size;
+		victim->size = 0;
+		if (victim->blksz) {
+			victim->blksz = 0;
+			_stats.entries--;
+		}
+		victim->data = malloc(blksz);
+		if (!victim->data)
+			return;
+		victim->size = blksz;
+		cache_bytes += blksz;
+	}
+
+	if (!victim->blksz)
+		_stats.entries++;
+	debug("fill: lba " LBAF " in set %ld\n", lba,
+	      (long)(victim - lines) / BLKCACHE_WAYS);
+	victim->iftype = iftype;
+	victim->devnum = devnum;
+	victim->lba = lba;
+	victim->blksz = blksz;
+	victim->used = ++lru_stamp;
+	memcpy(victim->data, buffer, blksz);
+}
+
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
-		debug("hit: start " LBAF ", count " LBAFU "\n",
-		      start, blkcnt);
-		++_stats.hits;
-		return 1;
+	struct block_cache_line *line;
+	char *dst = buffer;
+	lbaint_t i;
+
+	if (blkcnt > max(_stats.max_blocks_per_entry, _stats.readahead))
+		goto miss;
+
+	for (i = 0; i < blkcnt; i++) {
+		line = cache_find(iftype, devnum, start + i, blksz);
+		if (!line)
+			goto miss;
+		memcpy(dst, line->data, blksz);
+		line->used = ++lru_stamp;
+		dst += blksz;
 	}
 
+	debug("hit: start " LBAF ", count " LBAFU "\n",
+	      start, blkcnt);
+	cache_account(iftype, devnum, true);
+	return 1;
+
+miss:
 	debug("miss: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
-	++_stats.misses;
+	cache_account(iftype, devnum, false);
 	return 0;
 }
 
+void *blkcache_readahead(struct blk_desc *block_dev, lbaint_t start,
+			 lbaint_t blkcnt, lbaint_t *ra_start,
+			 lbaint_t *ra_cnt)
+{
+	unsigned ra = _stats.readahead;
+	lbaint_t first, last;
+	unsigned long size;
+
+	if (ra <= 1 || blkcnt >= ra || !_stats.max_entries)
+		return NULL;
+
+	/* read the aligned window(s) containing the request */
+	first = start - (lbaint_t)((unsigned)start % ra);
+	last = start + blkcnt + ra - 1;
+	last -= (lbaint_t)((unsigned)last % ra);
+	if (block_dev->lba && last > block_dev->lba)
+		last = block_dev->lba;
+	if (last - first <= blkcnt)
+		return NULL;
+
+	size = (last - first) * block_dev->blksz;
+	if (size > ra_buf_size) {
+		free(ra_buf);
+		ra_buf = memalign(ARCH_DMA_MINALIGN, size);
+		ra_buf_size = ra_buf ? size : 0;
+		if (!ra_buf)
+			return NULL;
+	}
+
+	*ra_start = first;
+	*ra_cnt = last - first;
+
+	return ra_buf;
+}
+
 void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
-	struct block_cache_node *node;
+	const char *src = buffer;
+	lbaint_t i;
 
 	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
+	if (blkcnt > max(_stats.max_blocks_per_entry, _stats.readahead))
 		return;
 
-	if (_stats.max_entries == 0)
+	if (!lines && (!_stats.max_entries || cache_alloc()))
 		return;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
-		}
-	} else {
-		node = malloc(sizeof(*node));
-		if (!node)
-			return;
-		node->cache = 0;
-	}
-
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
-		}
-	}
-
-	debug("fill: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
-
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+	for (i = 0; i < blkcnt; i++, src += blksz)
+		cache_insert(iftype, devnum, start + i, blksz, src);
 }
 
 void blkcache_invalidate(int iftype, int devnum)
 {
-	struct list_head *entry, *n;
-	struct block_cache_node *node;
-
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
+	struct block_cache_line *line;
+	unsigned i;
+
+	if (!lines)
+		return;
+
+	for (i = 0, line = lines; i < num_sets * BLKCACHE_WAYS; i++, line++) {
+		if (line->blksz && line->iftype == iftype &&
+		    line->devnum == devnum) {
+			line->blksz = 0;
 			--_stats.entries;
 		}
 	}
 }
 
-void blkcache_configure(unsigned blocks, unsigned entries)
+void blkcache_configure(unsigned blocks, unsigned size, unsigned readahead)
 {
-	struct block_cache_node *node;
-	if ((blocks != _stats.max_blocks_per_entry) ||
-	    (entries != _stats.max_entries)) {
+	if (blocks != _stats.max_blocks_per_entry ||
+	    size != _stats.max_size || readahead != _stats.readahead)
 		/* invalidate cache */
-		while (!list_empty(&block_cache)) {
-			node = (struct block_cache_node *)block_cache.next;
-			list_del(&node->lh);
-			free(node->cache);
-			free(node);
-		}
-		_stats.entries = 0;
-	}
+		cache_free();
 
 	_stats.max_blocks_per_entry = blocks;
-	_stats.max_entries = entries;
+	_stats.max_size = size;
+	_stats.max_entries = size / BLKCACHE_MIN_BLKSZ;
+	_stats.readahead = readahead;
 
 	_stats.hits = 0;
 	_stats.misses = 0;
+	memset(dev_stats, 0, sizeof(dev_stats));
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
 {
+	_stats.size = cache_bytes;
 	memcpy(stats, &_stats, sizeof(*stats));
 	_stats.hits = 0;
 	_stats.misses = 0;
 }
+
+int blkcache_dev_stats(int index, struct block_cache_dev_stats *stats)
+{
+	struct block_cache_dev_stats *ds;
+
+	if (index < 0 || index >= BLKCACHE_MAX_DEVS)
+		return -ENOENT;
+	ds = &dev_stats[index];
+	if (!ds->active)
+		return -ENOENT;
+
+	memcpy(stats, ds, sizeof(*stats));
+	ds->hits = 0;
+	ds->misses = 0;
+
+	return 0;
+}
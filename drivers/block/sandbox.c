@@ -29,6 +29,27 @@ static struct host_block_dev *find_host_device(int dev)
 #endif
 
 #ifdef CONFIG_BLK
+/*
+ * Simulate a device which handles one request at a time, each taking
+ * latency_us. Returns the time at which a request submitted now is finished.
+ */
+static ulong host_block_schedule(struct host_block_dev *host_dev)
+{
+	ulong now = timer_get_us();
+
+	if ((long)(host_dev->busy_until - now) < 0)
+		host_dev->busy_until = now;
+	host_dev->busy_until += host_dev->latency_us;
+
+	return host_dev->busy_until;
+}
+
+static void host_block_wait(ulong until)
+{
+	while ((long)(timer_get_us() - until) < 0)
+		;
+}
+
 static unsigned long host_block_read(struct udevice *dev,
 				     unsigned long start, lbaint_t blkcnt,
 				     void *buffer)
@@ -48,6 +69,9 @@ static unsigned long host_block_read(struct blk_desc *block_dev,
 		return -1;
 #endif
 
+#ifdef CONFIG_BLK
+	host_block_wait(host_block_schedule(host_dev));
+#endif
 	if (os_lseek(host_dev->fd, start * block_dev->blksz, OS_SEEK_SET) ==
 			-1) {
 		printf("ERROR: Invalid block %lx\n", start);
@@ -75,6 +99,9 @@ static unsigned long host_block_write(struct blk_desc *block_dev,
 	struct host_block_dev *host_dev = find_host_device(dev);
 #endif
 
+#ifdef CONFIG_BLK
+	host_block_wait(host_block_schedule(host_dev));
+#endif
 	if (os_lseek(host_dev->fd, start * block_dev->blksz, OS_SEEK_SET) ==
 			-1) {
 		printf("ERROR: Invalid block %lx\n", start);
@@ -218,15 +245,108 @@ int host_get_dev_err(int devnum, struct blk_desc **blk_devp)
 }
 
 #ifdef CONFIG_BLK
+int host_dev_set_latency(int devnum, uint latency_us)
+{
+	struct host_block_dev *host_dev;
+	struct udevice *dev;
+	int ret;
+
+	ret = blk_get_device(IF_TYPE_HOST, devnum, &dev);
+	if (ret)
+		return ret;
+	host_dev = dev_get_platdata(dev);
+	host_dev->latency_us = latency_us;
+
+	return 0;
+}
+
+static int host_block_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+
+	req->drv_data = host_block_schedule(host_dev);
+	list_add_tail(&req->node, &host_dev->queue);
+
+	return 0;
+}
+
+/* Do the transfer for a request whose time is up */
+static unsigned long host_block_xfer(struct udevice *dev,
+				     struct blk_request *req)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+	struct blk_desc *block_dev = dev_get_uclass_platdata(dev);
+	ssize_t len;
+
+	if (os_lseek(host_dev->fd, req->start * block_dev->blksz,
+		     OS_SEEK_SET) == -1)
+		return -EINVAL;
+	if (req->write)
+		len = os_write(host_dev->fd, req->buffer,
+			       req->blkcnt * block_dev->blksz);
+	else
+		len = os_read(host_dev->fd, req->buffer,
+			      req->blkcnt * block_dev->blksz);
+	if (len < 0)
+		return -EIO;
+
+	return len / block_dev->blksz;
+}
+
+static int host_block_poll(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+	struct blk_request *req, *next;
+	ulong now = timer_get_us();
+	int count = 0;
+
+	list_for_each_entry_safe(req, next, &host_dev->queue, node) {
+		if ((long)(now - req->drv_data) < 0) {
+			count++;
+			continue;
+		}
+		list_del(&req->node);
+		blk_request_done(req, host_block_xfer(dev, req));
+	}
+
+	return count;
+}
+
+static int host_block_probe(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+
+	INIT_LIST_HEAD(&host_dev->queue);
+
+	return 0;
+}
+
+static int host_block_remove(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+	struct blk_request *req, *next;
+
+	list_for_each_entry_safe(req, next, &host_dev->queue, node) {
+		list_del(&req->node);
+		blk_request_done(req, -ENODEV);
+	}
+
+	return 0;
+}
+
 static const struct blk_ops sandbox_host_blk_ops = {
 	.read	= host_block_read,
 	.write	= host_block_write,
+	.submit	= host_block_submit,
+	.poll	= host_block_poll,
 };
 
 U_BOOT_DRIVER(sandbox_host_blk) = {
 	.name		= "sandbox_host_blk",
 	.id		= UCLASS_BLK,
 	.ops		= &sandbox_host_blk_ops,
+	.probe		= host_block_probe,
+	.remove		= host_block_remove,
 	.platdata_auto_alloc_size = sizeof(struct host_block_dev),
 };
 #else
@@ -368,6 +368,14 @@ static int uclass_find_device_by_phandle(enum uclass_id id,
 	find_phandle = dev_read_u32_default(parent, name, -1);
 	if (find_phandle <= 0)
 		return -ENOENT;
+
+	/* With the index, finding the node is quicker than reading phandles */
+	if (CONFIG_IS_ENABLED(OF_INDEX) && !of_live_active())
+		return uclass_find_device_by_of_offset(id,
+				fdtdec_node_offset_by_phandle(gd->fdt_blob,
+							      find_phandle),
+				devp);
+
 	ret = uclass_get(id, &uc);
 	if (ret)
 		return ret;
@@ -495,6 +503,13 @@ int uclass_get_device_by_phandle_id(enum uclass_id id, uint phandle_id,
 	int ret;
 
 	*devp = NULL;
+	if (CONFIG_IS_ENABLED(OF_INDEX) && !of_live_active()) {
+		ret = uclass_find_device_by_of_offset(id,
+				fdtdec_node_offset_by_phandle(gd->fdt_blob,
+							      phandle_id),
+				&dev);
+		return uclass_get_device_tail(dev, ret, devp);
+	}
 	ret = uclass_get(id, &uc);
 	if (ret)
 		return ret;
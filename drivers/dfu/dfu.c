@@ -13,8 +13,16 @@
 #include <fat.h>
 #include <dfu.h>
 #include <hash.h>
+#include <div64.h>
+#include <u-boot/crc.h>
+#include <u-boot/zlib.h>
+#include <asm/unaligned.h>
 #include <linux/list.h>
 #include <linux/compiler.h>
+#include <linux/sizes.h>
+
+/* Smallest half of the buffer worth writing in the background */
+#define DFU_MIN_HALF_BUF_SIZE	SZ_1M
 
 static LIST_HEAD(dfu_list);
 static int dfu_alt_num;
@@ -137,37 +145,227 @@ static char *dfu_get_hash_algo(void)
 	return NULL;
 }
 
-static int dfu_write_buffer_drain(struct dfu_entity *dfu)
+static int dfu_write_to_medium(struct dfu_entity *dfu, void *buf, long w_size)
 {
-	long w_size;
+	ulong start;
 	int ret;
 
-	/* flush size? */
-	w_size = dfu->i_buf - dfu->i_buf_start;
-	if (w_size == 0)
-		return 0;
-
 	if (dfu_hash_algo)
 		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
-					   dfu->i_buf_start, w_size, 0);
+					   buf, w_size, 0);
 
-	ret = dfu->write_medium(dfu, dfu->offset, dfu->i_buf_start, &w_size);
+	start = get_timer(0);
+	ret = dfu->write_medium(dfu, dfu->offset, buf, &w_size);
+	dfu->medium_time += get_timer(start);
 	if (ret)
 		debug("%s: Write error!\n", __func__);
 
-	/* point back */
-	dfu->i_buf = dfu->i_buf_start;
+	/* update offset */
+	dfu->offset += w_size;
+
+	puts("#");
+
+	return ret;
+}
+
+static int dfu_write_wait(struct dfu_entity *dfu)
+{
+	ulong start;
+	int ret;
+
+	if (!dfu->write_pending)
+		return 0;
+
+	start = get_timer(0);
+	ret = dfu->write_wait(dfu);
+	dfu->medium_time += get_timer(start);
+	dfu->write_pending = 0;
+	if (ret)
+		debug("%s: Write error!\n", __func__);
+
+	return ret;
+}
+
+/*
+ * Start writing the current half of the buffer, then switch to the other
+ * half so that it can be filled while the write is in progress
+ */
+static int dfu_write_start(struct dfu_entity *dfu, long w_size)
+{
+	long half = dfu->i_buf_end - dfu->i_buf_start;
+	u8 *buf = dfu->i_buf_start;
+	ulong start;
+	int ret;
+
+	/* The other half may still be being written */
+	ret = dfu_write_wait(dfu);
+	if (ret)
+		return ret;
+
+	if (dfu_hash_algo)
+		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
+					   buf, w_size, 0);
+
+	start = get_timer(0);
+	ret = dfu->write_medium_start(dfu, dfu->offset, buf, &w_size);
+	dfu->medium_time += get_timer(start);
+	if (ret) {
+		debug("%s: Write error!\n", __func__);
+		return ret;
+	}
+	dfu->write_pending = 1;
 
 	/* update offset */
 	dfu->offset += w_size;
 
+	dfu->i_buf_start = buf == dfu_buf ? dfu_buf + half : dfu_buf;
+	dfu->i_buf_end = dfu->i_buf_start + half;
+
 	puts("#");
 
+	return 0;
+}
+
+static int dfu_write_buffer_drain(struct dfu_entity *dfu)
+{
+	long w_size;
+	int ret;
+
+	/* flush size? */
+	w_size = dfu->i_buf - dfu->i_buf_start;
+	if (w_size == 0)
+		return 0;
+
+	if (dfu->double_buf)
+		ret = dfu_write_start(dfu, w_size);
+	else
+		ret = dfu_write_to_medium(dfu, dfu->i_buf_start, w_size);
+
+	/* point back */
+	dfu->i_buf = dfu->i_buf_start;
+
 	return ret;
 }
 
+#if CONFIG_IS_ENABLED(DFU_GZIP)
+static bool dfu_want_gunzip(const u8 *buf, int size)
+{
+	return size >= 10 && buf[0] == 0x1f && buf[1] == 0x8b &&
+		env_get_yesno("dfu_gunzip") == 1;
+}
+
+/*
+ * Start decompressing the image, returning the length of its gzip header,
+ * which is assumed to be in the first block
+ */
+static int dfu_gunzip_start(struct dfu_entity *dfu, u8 *buf, int size)
+{
+	z_stream *s;
+	int hdr_len;
+
+	hdr_len = gzip_parse_header(buf, size);
+	if (hdr_len < 0)
+		return -EINVAL;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return -ENOMEM;
+	s->zalloc = gzalloc;
+	s->zfree = gzfree;
+	if (inflateInit2(s, -MAX_WBITS) != Z_OK) {
+		free(s);
+		return -EIO;
+	}
+	dfu->gz = s;
+
+	return hdr_len;
+}
+
+/* Decompress data into the buffer, writing it out each time it fills */
+static int dfu_gunzip(struct dfu_entity *dfu, u8 *buf, int size)
+{
+	z_stream *s = dfu->gz;
+	int r, ret;
+	uint len;
+
+	s->next_in = buf;
+	s->avail_in = size;
+	while (s->avail_in && !dfu->gz_done) {
+		s->next_out = dfu->i_buf;
+		s->avail_out = dfu->i_buf_end - dfu->i_buf;
+		r = inflate(s, Z_SYNC_FLUSH);
+		dfu->gz_crc = crc32(dfu->gz_crc, dfu->i_buf,
+				    s->next_out - dfu->i_buf);
+		dfu->i_buf = s->next_out;
+		if (r == Z_STREAM_END) {
+			dfu->gz_done = 1;
+		} else if (r != Z_OK) {
+			printf("Error: inflate() returned %d\n", r);
+			return -EIO;
+		}
+
+		if (dfu->i_buf == dfu->i_buf_end) {
+			ret = dfu_write_buffer_drain(dfu);
+			if (ret)
+				return ret;
+		}
+	}
+
+	/* Anything after the end of the stream is the gzip trailer */
+	len = min_t(uint, s->avail_in,
+		    sizeof(dfu->gz_trailer) - dfu->gz_trailer_len);
+	memcpy(dfu->gz_trailer + dfu->gz_trailer_len, s->next_in, len);
+	dfu->gz_trailer_len += len;
+
+	return 0;
+}
+
+/* Check the decompressed data against the gzip trailer */
+static int dfu_gunzip_check(struct dfu_entity *dfu)
+{
+	if (!dfu->gz_done || dfu->gz_trailer_len < sizeof(dfu->gz_trailer)) {
+		pr_err("gzip data is truncated\n");
+		return -EIO;
+	}
+	if (get_unaligned_le32(dfu->gz_trailer) != dfu->gz_crc ||
+	    get_unaligned_le32(dfu->gz_trailer + 4) !=
+	    (u32)dfu->gz->total_out) {
+		pr_err("gzip data is corrupt\n");
+		return -EIO;
+	}
+
+	return 0;
+}
+#else
+static inline bool dfu_want_gunzip(const u8 *buf, int size)
+{
+	return false;
+}
+
+static inline int dfu_gunzip_check(struct dfu_entity *dfu)
+{
+	return 0;
+}
+#endif
+
+/* Show how fast the image was written, and how much time the medium took */
+static void dfu_show_rate(struct dfu_entity *dfu)
+{
+	ulong time = max(get_timer(dfu->start_time), 1UL);
+
+	printf("\nDFU %s: wrote %llu bytes", dfu->name, dfu->offset);
+	if (dfu->gz)
+		printf(" from %llu compressed", dfu->in_bytes);
+	printf(" in %lu ms, ", time);
+	print_size(lldiv(dfu->offset * 1000, time), "/s");
+	printf(", %lu ms writing\n", dfu->medium_time);
+}
+
 void dfu_transaction_cleanup(struct dfu_entity *dfu)
 {
+	/* the buffer must not be reused while it is being written */
+	dfu_write_wait(dfu);
+
 	/* clear everything */
 	dfu->crc = 0;
 	dfu->offset = 0;
@@ -178,12 +376,27 @@ void dfu_transaction_cleanup(struct dfu_entity *dfu)
 	dfu->r_left = 0;
 	dfu->b_left = 0;
 	dfu->bad_skip = 0;
+	dfu->medium_time = 0;
+	dfu->in_bytes = 0;
+
+#if CONFIG_IS_ENABLED(DFU_GZIP)
+	if (dfu->gz) {
+		inflateEnd(dfu->gz);
+		free(dfu->gz);
+		dfu->gz = NULL;
+	}
+#endif
+	dfu->gz_crc = 0;
+	dfu->gz_trailer_len = 0;
+	dfu->gz_done = 0;
+	dfu->double_buf = 0;
 
 	dfu->inited = 0;
 }
 
 int dfu_transaction_initiate(struct dfu_entity *dfu, bool read)
 {
+	unsigned long size;
 	int ret = 0;
 
 	if (dfu->inited)
@@ -194,7 +407,19 @@ int dfu_transaction_initiate(struct dfu_entity *dfu, bool read)
 	if (dfu->i_buf_start == NULL)
 		return -ENOMEM;
 
-	dfu->i_buf_end = dfu->i_buf_start + dfu_get_buf_size();
+	/*
+	 * If the medium can write in the background, fill one half of the
+	 * buffer while the other is being written. Each half must still hold
+	 * the largest block which the gadgets pass in (1 MiB, for thor).
+	 */
+	size = dfu_get_buf_size();
+	if (!read && dfu->write_medium_start && dfu->write_in_background &&
+	    dfu->write_in_background(dfu) &&
+	    ALIGN_DOWN(size / 2, SZ_4K) >= DFU_MIN_HALF_BUF_SIZE) {
+		size = ALIGN_DOWN(size / 2, SZ_4K);
+		dfu->double_buf = 1;
+	}
+	dfu->i_buf_end = dfu->i_buf_start + size;
 
 	if (read) {
 		ret = dfu->get_medium_size(dfu, &dfu->r_left);
@@ -203,6 +428,7 @@ int dfu_transaction_initiate(struct dfu_entity *dfu, bool read)
 		debug("%s: %s %lld [B]\n", __func__, dfu->name, dfu->r_left);
 	}
 
+	dfu->start_time = get_timer(0);
 	dfu->inited = 1;
 
 	return 0;
@@ -210,18 +436,34 @@ int dfu_transaction_initiate(struct dfu_entity *dfu, bool read)
 
 int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 {
+	ulong start;
 	int ret = 0;
 
 	ret = dfu_write_buffer_drain(dfu);
+	if (!ret)
+		ret = dfu_write_wait(dfu);
 	if (ret)
 		return ret;
 
-	if (dfu->flush_medium)
+	if (dfu->gz) {
+		ret = dfu_gunzip_check(dfu);
+		if (ret) {
+			dfu_transaction_cleanup(dfu);
+			return ret;
+		}
+	}
+
+	if (dfu->flush_medium) {
+		start = get_timer(0);
 		ret = dfu->flush_medium(dfu);
+		dfu->medium_time += get_timer(start);
+	}
 
 	if (dfu_hash_algo)
 		printf("\nDFU complete %s: 0x%08x\n", dfu_hash_algo->name,
 		       dfu->crc);
+	if (!ret)
+		dfu_show_rate(dfu);
 
 	dfu_transaction_cleanup(dfu);
 
@@ -263,6 +505,25 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	/* handle rollover */
 	dfu->i_blk_seq_num = (dfu->i_blk_seq_num + 1) & 0xffff;
 
+	dfu->in_bytes += size;
+#if CONFIG_IS_ENABLED(DFU_GZIP)
+	if (dfu->in_bytes == size && dfu_want_gunzip(buf, size)) {
+		ret = dfu_gunzip_start(dfu, buf, size);
+		if (ret < 0) {
+			dfu_transaction_cleanup(dfu);
+			return ret;
+		}
+		buf += ret;
+		size -= ret;
+	}
+	if (dfu->gz) {
+		ret = dfu_gunzip(dfu, buf, size);
+		if (ret)
+			dfu_transaction_cleanup(dfu);
+		return ret;
+	}
+#endif
+
 	/* flush buffer if overflow */
 	if ((dfu->i_buf + size) > dfu->i_buf_end) {
 		ret = dfu_write_buffer_drain(dfu);
@@ -560,6 +821,7 @@ int dfu_write_from_mem_addr(struct dfu_entity *dfu, void *buf, int size)
 	unsigned long dfu_buf_size, write, left = size;
 	int i, ret = 0;
 	void *dp = buf;
+	bool direct;
 
 	/*
 	 * Here we must call dfu_get_buf(dfu) first to be sure that dfu_buf_size
@@ -570,14 +832,33 @@ int dfu_write_from_mem_addr(struct dfu_entity *dfu, void *buf, int size)
 	dfu_buf_size = dfu_get_buf_size();
 	debug("%s: dfu buf size: %lu\n", __func__, dfu_buf_size);
 
+	/*
+	 * The data is in memory already, so write it from there unless it
+	 * must be decompressed or is not aligned well enough for DMA
+	 */
+	direct = IS_ALIGNED((ulong)buf, CONFIG_SYS_CACHELINE_SIZE) &&
+		!dfu_want_gunzip(buf, size);
+	ret = dfu_transaction_initiate(dfu, false);
+	if (ret < 0)
+		return ret;
+	if (direct)
+		dfu->in_bytes = size;
+	else
+		dfu_buf_size = dfu->i_buf_end - dfu->i_buf_start;
+
 	for (i = 0; left > 0; i++) {
 		write = min(dfu_buf_size, left);
 
 		debug("%s: dp: 0x%p left: %lu write: %lu\n", __func__,
 		      dp, left, write);
-		ret = dfu_write(dfu, dp, write, i);
+		if (direct)
+			ret = dfu_write_to_medium(dfu, dp, write);
+		else
+			ret = dfu_write(dfu, dp, write, i);
 		if (ret) {
 			pr_err("DFU write failed\n");
+			if (direct)
+				dfu_transaction_cleanup(dfu);
 			return ret;
 		}
 
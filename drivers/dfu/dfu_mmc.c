@@ -19,6 +19,33 @@ static unsigned char *dfu_file_buf;
 static u64 dfu_file_buf_len;
 static long dfu_file_buf_filled;
 
+#if CONFIG_IS_ENABLED(BLK)
+/* The raw write which is in progress, if any */
+static struct blk_request dfu_mmc_req;
+static struct blk_desc *dfu_mmc_req_desc;
+#endif
+
+static int mmc_block_range(struct dfu_entity *dfu, u64 offset, long *len,
+			   u32 *blk_start, u32 *blk_count)
+{
+	/*
+	 * We must ensure that we work in lba_blk_size chunks, so ALIGN
+	 * this value.
+	 */
+	*len = ALIGN(*len, dfu->data.mmc.lba_blk_size);
+
+	*blk_start = dfu->data.mmc.lba_start +
+			(u32)lldiv(offset, dfu->data.mmc.lba_blk_size);
+	*blk_count = *len / dfu->data.mmc.lba_blk_size;
+	if (*blk_start + *blk_count >
+			dfu->data.mmc.lba_start + dfu->data.mmc.lba_size) {
+		puts("Request would exceed designated area!\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
 static int mmc_block_op(enum dfu_op op, struct dfu_entity *dfu,
 			u64 offset, void *buf, long *len)
 {
@@ -32,20 +59,9 @@ static int mmc_block_op(enum dfu_op op, struct dfu_entity *dfu,
 		return -ENODEV;
 	}
 
-	/*
-	 * We must ensure that we work in lba_blk_size chunks, so ALIGN
-	 * this value.
-	 */
-	*len = ALIGN(*len, dfu->data.mmc.lba_blk_size);
-
-	blk_start = dfu->data.mmc.lba_start +
-			(u32)lldiv(offset, dfu->data.mmc.lba_blk_size);
-	blk_count = *len / dfu->data.mmc.lba_blk_size;
-	if (blk_start + blk_count >
-			dfu->data.mmc.lba_start + dfu->data.mmc.lba_size) {
-		puts("Request would exceed designated area!\n");
-		return -EINVAL;
-	}
+	ret = mmc_block_range(dfu, offset, len, &blk_start, &blk_count);
+	if (ret)
+		return ret;
 
 	if (dfu->data.mmc.hw_partition >= 0) {
 		part_num_bkp = mmc_get_blk_desc(mmc)->hwpart;
@@ -208,6 +224,87 @@ int dfu_flush_medium_mmc(struct dfu_entity *dfu)
 	return ret;
 }
 
+#if CONFIG_IS_ENABLED(BLK)
+/*
+ * Start a raw write without waiting for it to finish. Writes to a hardware
+ * partition, and to files, are done straight away since they need the device
+ * to be set up around them.
+ */
+static int dfu_write_medium_mmc_start(struct dfu_entity *dfu, u64 offset,
+				      void *buf, long *len)
+{
+	struct blk_request *req = &dfu_mmc_req;
+	u32 blk_start, blk_count;
+	struct mmc *mmc;
+	int ret;
+
+	if (dfu->layout != DFU_RAW_ADDR || dfu->data.mmc.hw_partition >= 0)
+		return dfu_write_medium_mmc(dfu, offset, buf, len);
+
+	mmc = find_mmc_device(dfu->data.mmc.dev_num);
+	if (!mmc) {
+		pr_err("Device MMC %d - not found!", dfu->data.mmc.dev_num);
+		return -ENODEV;
+	}
+
+	ret = mmc_block_range(dfu, offset, len, &blk_start, &blk_count);
+	if (ret)
+		return ret;
+
+	debug("%s: dev: %d start: %d cnt: %d buf: 0x%p\n", __func__,
+	      dfu->data.mmc.dev_num, blk_start, blk_count, buf);
+	memset(req, '\0', sizeof(*req));
+	req->start = blk_start;
+	req->blkcnt = blk_count;
+	req->buffer = buf;
+	req->write = true;
+	dfu_mmc_req_desc = mmc_get_blk_desc(mmc);
+
+	ret = blk_dsubmit(dfu_mmc_req_desc, req);
+	if (ret) {
+		dfu_mmc_req_desc = NULL;
+		return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Only hosts which send the data of a write by themselves, such as SDHCI
+ * with ADMA2, write in the background. On the rest blk_dsubmit() falls back
+ * to blk_dwrite(), so there is nothing to overlap.
+ */
+static bool dfu_write_in_background_mmc(struct dfu_entity *dfu)
+{
+	struct mmc *mmc;
+
+	if (dfu->layout != DFU_RAW_ADDR || dfu->data.mmc.hw_partition >= 0)
+		return false;
+
+	mmc = find_mmc_device(dfu->data.mmc.dev_num);
+
+	return mmc && mmc_can_write_in_background(mmc);
+}
+
+static int dfu_write_wait_mmc(struct dfu_entity *dfu)
+{
+	struct blk_request *req = &dfu_mmc_req;
+	struct blk_desc *desc = dfu_mmc_req_desc;
+
+	/* The last write was done straight away */
+	if (!desc)
+		return 0;
+
+	dfu_mmc_req_desc = NULL;
+	if (blk_dwait(desc, req) != req->blkcnt) {
+		pr_err("MMC operation failed");
+		return -EIO;
+	}
+
+	return 0;
+}
+#endif
+
 int dfu_get_medium_size_mmc(struct dfu_entity *dfu, u64 *size)
 {
 	int ret;
@@ -387,6 +484,11 @@ int dfu_fill_entity_mmc(struct dfu_entity *dfu, char *devstr, char *s)
 	dfu->get_medium_size = dfu_get_medium_size_mmc;
 	dfu->read_medium = dfu_read_medium_mmc;
 	dfu->write_medium = dfu_write_medium_mmc;
+#if CONFIG_IS_ENABLED(BLK)
+	dfu->write_medium_start = dfu_write_medium_mmc_start;
+	dfu->write_wait = dfu_write_wait_mmc;
+	dfu->write_in_background = dfu_write_in_background_mmc;
+#endif
 	dfu->flush_medium = dfu_flush_medium_mmc;
 	dfu->inited = 0;
 	dfu->free_entity = dfu_free_entity_mmc;
@@ -8,6 +8,7 @@
 #include <fastboot-internal.h>
 #include <fb_mmc.h>
 #include <fb_nand.h>
+#include <image-sparse.h>
 #include <part.h>
 #include <stdlib.h>
 
@@ -26,6 +27,38 @@ static u32 fastboot_bytes_received;
  */
 static u32 fastboot_bytes_expected;
 
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/**
+ * stream_part - partition which downloads are written to as they arrive, or
+ * an empty string to keep them in fastboot_buf_addr
+ */
+static char stream_part[32];
+
+/**
+ * stream_used - the last download was written to stream_part as it arrived
+ */
+static bool stream_used;
+
+/**
+ * stream_ok - the last download was written to stream_part successfully
+ */
+static bool stream_ok;
+
+static struct sparse_storage stream_storage;
+static struct sparse_stream stream;
+
+/**
+ * stream_staged - number of bytes in fastboot_buf_addr still to be written
+ */
+static u32 stream_staged;
+
+/**
+ * stream_response - response to send once the download is complete, set by
+ * the first error in writing it
+ */
+static char stream_response[FASTBOOT_RESPONSE_LEN];
+#endif
+
 static void okay(char *, char *);
 static void getvar(char *, char *);
 static void download(char *, char *);
@@ -37,6 +70,9 @@ static void reboot_bootloader(char *, char *);
 #if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_FORMAT)
 static void oem_format(char *, char *);
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+static void oem_stream(char *, char *);
+#endif
 
 static const struct {
 	const char *command;
@@ -86,6 +122,12 @@ static const struct {
 		.dispatch = oem_format,
 	},
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	[FASTBOOT_COMMAND_OEM_STREAM] = {
+		.command = "oem stream",
+		.dispatch = oem_stream,
+	},
+#endif
 };
 
 /**
@@ -147,6 +189,78 @@ static void getvar(char *cmd_parameter, char *response)
 	fastboot_getvar(cmd_parameter, response);
 }
 
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/**
+ * stream_start() - Set up stream_storage to write to a partition
+ *
+ * @part: Name of the partition
+ * @response: Pointer to fastboot response buffer
+ *
+ * Return: 0 if OK, -ve on error
+ */
+static int stream_start(const char *part, char *response)
+{
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_MMC)
+	return fastboot_mmc_stream_start(part, &stream_storage, response);
+#elif CONFIG_IS_ENABLED(FASTBOOT_FLASH_NAND)
+	return fastboot_nand_stream_start(part, &stream_storage, response);
+#endif
+}
+
+/**
+ * stream_flush() - Write the data staged in fastboot_buf_addr
+ *
+ * After an error the rest of the download is received but ignored.
+ */
+static void stream_flush(void)
+{
+	if (stream_staged && !*stream_response) {
+		if (fastboot_progress_callback)
+			fastboot_progress_callback("writing");
+		sparse_stream_write(&stream, fastboot_buf_addr, stream_staged,
+				    stream_response);
+	}
+	stream_staged = 0;
+}
+
+/**
+ * stream_data() - Stage received data, writing it out when the buffer fills
+ *
+ * @data: Pointer to received data
+ * @len: Length of received data
+ */
+static void stream_data(const u8 *data, u32 len)
+{
+	u32 count;
+
+	while (len) {
+		count = min(len, fastboot_buf_size - stream_staged);
+		memcpy(fastboot_buf_addr + stream_staged, data, count);
+		stream_staged += count;
+		data += count;
+		len -= count;
+		if (stream_staged == fastboot_buf_size)
+			stream_flush();
+	}
+}
+#endif
+
+/**
+ * fastboot_max_download_size() - Find the size of the largest download
+ *
+ * Return: Size of the download buffer, or of the partition which downloads
+ * are written to as they arrive
+ */
+u32 fastboot_max_download_size(void)
+{
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	if (*stream_part)
+		return min_t(u64, (u64)stream_storage.size *
+			     stream_storage.blksz, U32_MAX);
+#endif
+	return fastboot_buf_size;
+}
+
 /**
  * fastboot_download() - Start a download transfer from the client
  *
@@ -173,13 +287,32 @@ static void download(char *cmd_parameter, char *response)
 	 *
 	 * where cmd_parameter is an 8 digit hexadecimal number
 	 */
-	if (fastboot_bytes_expected > fastboot_buf_size) {
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	stream_used = false;
+	stream_ok = false;
+	if (*stream_part) {
+		/* Look the partition up again, in case it has moved */
+		if (stream_start(stream_part, response))
+			return;
+	}
+#endif
+	if (fastboot_bytes_expected > fastboot_max_download_size()) {
 		fastboot_fail(cmd_parameter, response);
-	} else {
-		printf("Starting download of %d bytes\n",
-		       fastboot_bytes_expected);
-		fastboot_response("DATA", response, "%s", cmd_parameter);
+		return;
 	}
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	if (*stream_part) {
+		if (sparse_stream_init(&stream, &stream_storage, response))
+			return;
+		stream_used = true;
+		stream_staged = 0;
+		*stream_response = '\0';
+		printf("Writing download to '%s' as it arrives\n",
+		       stream_part);
+	}
+#endif
+	printf("Starting download of %d bytes\n", fastboot_bytes_expected);
+	fastboot_response("DATA", response, "%s", cmd_parameter);
 }
 
 /**
@@ -220,9 +353,14 @@ void fastboot_data_download(const void *fastboot_data,
 			      response);
 		return;
 	}
-	/* Download data to fastboot_buf_addr */
-	memcpy(fastboot_buf_addr + fastboot_bytes_received,
-	       fastboot_data, fastboot_data_len);
+	/* Download data to fastboot_buf_addr, or write it to flash */
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	if (stream_used)
+		stream_data(fastboot_data, fastboot_data_len);
+	else
+#endif
+		memcpy(fastboot_buf_addr + fastboot_bytes_received,
+		       fastboot_data, fastboot_data_len);
 
 	pre_dot_num = fastboot_bytes_received / BYTES_PER_DOT;
 	fastboot_bytes_received += fastboot_data_len;
@@ -252,6 +390,17 @@ void fastboot_data_complete(char *response)
 	env_set_hex("filesize", image_size);
 	fastboot_bytes_expected = 0;
 	fastboot_bytes_received = 0;
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	if (stream_used) {
+		stream_flush();
+		if (sparse_stream_finish(&stream, stream_part,
+					 stream_response)) {
+			strcpy(response, stream_response);
+			return;
+		}
+		stream_ok = true;
+	}
+#endif
 }
 
 #if CONFIG_IS_ENABLED(FASTBOOT_FLASH)
@@ -266,6 +415,19 @@ void fastboot_data_complete(char *response)
  */
 static void flash(char *cmd_parameter, char *response)
 {
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	/* The image has already been written, or failed to be */
+	if (stream_used) {
+		if (!cmd_parameter || strcmp(cmd_parameter, stream_part))
+			fastboot_fail("image was streamed to another partition",
+				      response);
+		else if (!stream_ok)
+			fastboot_fail("writing the image failed", response);
+		else
+			fastboot_okay(NULL, response);
+		return;
+	}
+#endif
 #if CONFIG_IS_ENABLED(FASTBOOT_FLASH_MMC)
 	fastboot_mmc_flash_write(cmd_parameter, fastboot_buf_addr, image_size,
 				 response);
@@ -333,3 +495,32 @@ static void oem_format(char *cmd_parameter, char *response)
 	}
 }
 #endif
+
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/**
+ * oem_stream() - Execute the OEM stream command
+ *
+ * @cmd_parameter: Pointer to partition name, or NULL
+ * @response: Pointer to fastboot response buffer
+ *
+ * Makes the following downloads be written to the partition as they
+ * arrive, or without a partition, go back to keeping them in
+ * fastboot_buf_addr.
+ */
+static void oem_stream(char *cmd_parameter, char *response)
+{
+	if (!cmd_parameter || !*cmd_parameter) {
+		*stream_part = '\0';
+		fastboot_okay(NULL, response);
+		return;
+	}
+	if (strlen(cmd_parameter) >= sizeof(stream_part)) {
+		fastboot_fail("partition name too long", response);
+		return;
+	}
+	if (stream_start(cmd_parameter, response))
+		return;
+	strcpy(stream_part, cmd_parameter);
+	fastboot_okay(NULL, response);
+}
+#endif
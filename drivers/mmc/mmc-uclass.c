@@ -33,6 +33,43 @@ int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 	return dm_mmc_send_cmd(mmc->dev, cmd, data);
 }
 
+int dm_mmc_send_cmd_start(struct udevice *dev, struct mmc_cmd *cmd,
+			  struct mmc_data *data)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+	int ret;
+
+	if (!ops->send_cmd_start)
+		return -ENOSYS;
+
+	mmmc_trace_before_send(mmc, cmd);
+	ret = ops->send_cmd_start(dev, cmd, data);
+	mmmc_trace_after_send(mmc, cmd, ret);
+
+	return ret;
+}
+
+int mmc_send_cmd_start(struct mmc *mmc, struct mmc_cmd *cmd,
+		       struct mmc_data *data)
+{
+	return dm_mmc_send_cmd_start(mmc->dev, cmd, data);
+}
+
+int dm_mmc_send_cmd_done(struct udevice *dev)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->send_cmd_done)
+		return -ENOSYS;
+	return ops->send_cmd_done(dev);
+}
+
+int mmc_send_cmd_done(struct mmc *mmc)
+{
+	return dm_mmc_send_cmd_done(mmc->dev);
+}
+
 int dm_mmc_set_ios(struct udevice *dev)
 {
 	struct dm_mmc_ops *ops = mmc_get_ops(dev);
@@ -364,11 +401,19 @@ static int mmc_blk_probe(struct udevice *dev)
 	return 0;
 }
 
+bool mmc_can_write_in_background(struct mmc *mmc)
+{
+	return CONFIG_IS_ENABLED(MMC_WRITE) &&
+		mmc_get_ops(mmc->dev)->send_cmd_start;
+}
+
 static const struct blk_ops mmc_blk_ops = {
 	.read	= mmc_bread,
 #if CONFIG_IS_ENABLED(MMC_WRITE)
 	.write	= mmc_bwrite,
 	.erase	= mmc_berase,
+	.submit	= mmc_bsubmit,
+	.poll	= mmc_bpoll,
 #endif
 	.select_hwpart	= mmc_select_hwpart,
 };
@@ -386,9 +431,37 @@ U_BOOT_DRIVER(mmc) = {
 	.id	= UCLASS_MMC,
 };
 
+#if CONFIG_IS_ENABLED(BLK)
+static int mmc_post_probe(struct udevice *dev)
+{
+	struct mmc_uclass_priv *upriv = dev_get_uclass_priv(dev);
+
+	INIT_LIST_HEAD(&upriv->write_queue);
+
+	return 0;
+}
+
+static int mmc_pre_remove(struct udevice *dev)
+{
+	struct mmc_uclass_priv *upriv = dev_get_uclass_priv(dev);
+	struct blk_request *req, *next;
+
+	list_for_each_entry_safe(req, next, &upriv->write_queue, node) {
+		list_del(&req->node);
+		blk_request_done(req, -ENODEV);
+	}
+
+	return 0;
+}
+#endif
+
 UCLASS_DRIVER(mmc) = {
 	.id		= UCLASS_MMC,
 	.name		= "mmc",
 	.flags		= DM_UC_FLAG_SEQ_ALIAS,
+#if CONFIG_IS_ENABLED(BLK)
+	.post_probe	= mmc_post_probe,
+	.pre_remove	= mmc_pre_remove,
+#endif
 	.per_device_auto_alloc_size = sizeof(struct mmc_uclass_priv),
 };
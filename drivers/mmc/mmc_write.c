@@ -126,42 +126,44 @@ ulong mmc_berase(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt)
 	return blk;
 }
 
-static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
-		lbaint_t blkcnt, const void *src)
+/* Set up the command and data to write @blkcnt blocks from @src */
+static int mmc_write_prepare(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+			     const void *src, struct mmc_cmd *cmd,
+			     struct mmc_data *data)
 {
-	struct mmc_cmd cmd;
-	struct mmc_data data;
-	int timeout = 1000;
-
 	if ((start + blkcnt) > mmc_get_blk_desc(mmc)->lba) {
 		printf("MMC: block number 0x" LBAF " exceeds max(0x" LBAF ")\n",
 		       start + blkcnt, mmc_get_blk_desc(mmc)->lba);
-		return 0;
+		return -EINVAL;
 	}
 
 	if (blkcnt == 0)
-		return 0;
+		return -EINVAL;
 	else if (blkcnt == 1)
-		cmd.cmdidx = MMC_CMD_WRITE_SINGLE_BLOCK;
+		cmd->cmdidx = MMC_CMD_WRITE_SINGLE_BLOCK;
 	else
-		cmd.cmdidx = MMC_CMD_WRITE_MULTIPLE_BLOCK;
+		cmd->cmdidx = MMC_CMD_WRITE_MULTIPLE_BLOCK;
 
 	if (mmc->high_capacity)
-		cmd.cmdarg = start;
+		cmd->cmdarg = start;
 	else
-		cmd.cmdarg = start * mmc->write_bl_len;
+		cmd->cmdarg = start * mmc->write_bl_len;
 
-	cmd.resp_type = MMC_RSP_R1;
+	cmd->resp_type = MMC_RSP_R1;
 
-	data.src = src;
-	data.blocks = blkcnt;
-	data.blocksize = mmc->write_bl_len;
-	data.flags = MMC_DATA_WRITE;
+	data->src = src;
+	data->blocks = blkcnt;
+	data->blocksize = mmc->write_bl_len;
+	data->flags = MMC_DATA_WRITE;
 
-	if (mmc_send_cmd(mmc, &cmd, &data)) {
-		printf("mmc write failed\n");
-		return 0;
-	}
+	return 0;
+}
+
+/* End a write once its data is sent, and wait for the card to be ready */
+static int mmc_write_finish(struct mmc *mmc, lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd;
+	int timeout = 1000;
 
 	/* SPI multiblock writes terminate using a special
 	 * token, not a STOP_TRANSMISSION request.
@@ -172,12 +174,29 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 		cmd.resp_type = MMC_RSP_R1b;
 		if (mmc_send_cmd(mmc, &cmd, NULL)) {
 			printf("mmc fail to send stop cmd\n");
-			return 0;
+			return -EIO;
 		}
 	}
 
 	/* Waiting for the ready status */
-	if (mmc_send_status(mmc, timeout))
+	return mmc_send_status(mmc, timeout);
+}
+
+static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
+		lbaint_t blkcnt, const void *src)
+{
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+
+	if (mmc_write_prepare(mmc, start, blkcnt, src, &cmd, &data))
+		return 0;
+
+	if (mmc_send_cmd(mmc, &cmd, &data)) {
+		printf("mmc write failed\n");
+		return 0;
+	}
+
+	if (mmc_write_finish(mmc, blkcnt))
 		return 0;
 
 	return blkcnt;
@@ -221,3 +240,121 @@ ulong mmc_bwrite(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 
 	return blkcnt;
 }
+
+#if CONFIG_IS_ENABLED(BLK) && CONFIG_IS_ENABLED(DM_MMC)
+/*
+ * Start sending the next part of the first queued write, at most b_max
+ * blocks. Writes which are finished, or which fail to start, are completed
+ * and the next one is tried.
+ *
+ * req->drv_data holds the number of blocks of a request already written.
+ */
+static void mmc_bwrite_next(struct udevice *dev)
+{
+	struct blk_desc *block_dev = dev_get_uclass_platdata(dev);
+	struct udevice *mmc_dev = dev_get_parent(dev);
+	struct mmc_uclass_priv *upriv = dev_get_uclass_priv(mmc_dev);
+	struct mmc *mmc = upriv->mmc;
+	struct blk_request *req;
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+	lbaint_t cur;
+	void *src;
+	int ret;
+
+	/* A request completed below may have queued and started another */
+	upriv->write_cur = 0;
+	while (!upriv->write_cur && !list_empty(&upriv->write_queue)) {
+		req = list_first_entry(&upriv->write_queue, struct blk_request,
+				       node);
+		if (req->drv_data == req->blkcnt) {
+			list_del(&req->node);
+			blk_request_done(req, req->blkcnt);
+			continue;
+		}
+
+		if (!req->drv_data &&
+		    (blk_select_hwpart_devnum(IF_TYPE_MMC, block_dev->devnum,
+					      block_dev->hwpart) < 0 ||
+		     mmc_set_blocklen(mmc, mmc->write_bl_len))) {
+			list_del(&req->node);
+			blk_request_done(req, -EIO);
+			continue;
+		}
+
+		cur = min_t(lbaint_t, req->blkcnt - req->drv_data,
+			    mmc->cfg->b_max);
+		src = req->buffer + req->drv_data * mmc->write_bl_len;
+		ret = mmc_write_prepare(mmc, req->start + req->drv_data, cur,
+					src, &cmd, &data);
+		if (!ret) {
+			ret = mmc_send_cmd_start(mmc, &cmd, &data);
+			if (!ret) {
+				upriv->write_cur = cur;
+				return;
+			}
+		}
+
+		/* The host may not be able to send this part by itself */
+		if (ret == -ENOSYS &&
+		    mmc_write_blocks(mmc, req->start + req->drv_data, cur,
+				     src) == cur) {
+			req->drv_data += cur;
+			continue;
+		}
+
+		printf("mmc write failed\n");
+		list_del(&req->node);
+		blk_request_done(req, -EIO);
+	}
+}
+
+int mmc_bsubmit(struct udevice *dev, struct blk_request *req)
+{
+	struct udevice *mmc_dev = dev_get_parent(dev);
+	struct mmc_uclass_priv *upriv = dev_get_uclass_priv(mmc_dev);
+
+	/* Only writes can overlap with the caller */
+	if (!req->write || !mmc_can_write_in_background(upriv->mmc))
+		return -ENOSYS;
+
+	req->drv_data = 0;
+	list_add_tail(&req->node, &upriv->write_queue);
+	if (!upriv->write_cur)
+		mmc_bwrite_next(dev);
+
+	return 0;
+}
+
+int mmc_bpoll(struct udevice *dev)
+{
+	struct udevice *mmc_dev = dev_get_parent(dev);
+	struct mmc_uclass_priv *upriv = dev_get_uclass_priv(mmc_dev);
+	struct mmc *mmc = upriv->mmc;
+	struct blk_request *req;
+	int ret, count = 0;
+
+	if (upriv->write_cur) {
+		ret = mmc_send_cmd_done(mmc);
+		if (ret != -EBUSY) {
+			if (!ret)
+				ret = mmc_write_finish(mmc, upriv->write_cur);
+			req = list_first_entry(&upriv->write_queue,
+					       struct blk_request, node);
+			if (ret) {
+				printf("mmc write failed\n");
+				list_del(&req->node);
+				blk_request_done(req, -EIO);
+			} else {
+				req->drv_data += upriv->write_cur;
+			}
+			mmc_bwrite_next(dev);
+		}
+	}
+
+	list_for_each_entry(req, &upriv->write_queue, node)
+		count++;
+
+	return count;
+}
+#endif
@@ -0,0 +1,466 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Emulation of an SD Host Controller with an SD card attached
+ *
+ * The controller registers are emulated through the SDHCI I/O accessors, so
+ * that the generic SDHCI driver can be tested on sandbox. Data is only
+ * transferred using ADMA2: the descriptor table is walked and checked in the
+ * same way as real hardware would do it.
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <malloc.h>
+#include <mmc.h>
+#include <sdhci.h>
+#include <asm/test.h>
+#include <asm/unaligned.h>
+
+#define SANDBOX_SDHCI_REGS	0x100
+/* Card size in 512-byte blocks, see the C_SIZE field in the CSD */
+#define SANDBOX_SDHCI_C_SIZE	7
+#define SANDBOX_SDHCI_BLOCKS	((SANDBOX_SDHCI_C_SIZE + 1) * 1024)
+
+struct sandbox_sdhci_plat {
+	struct mmc_config cfg;
+	struct mmc mmc;
+};
+
+/**
+ * struct sandbox_sdhci_priv - state of the emulated controller and card
+ *
+ * @host:	SDHCI host, which must come first as it is the device priv
+ *		used by the SDHCI driver
+ * @regs:	Controller registers
+ * @card:	Contents of the card
+ * @app_cmd:	true if the last command was APP_CMD
+ * @stats:	Transfer statistics for tests
+ * @latency_us:	Time taken by each transfer to or from the card, 0 to do it
+ *		as soon as the command is sent
+ * @busy_until:	Time (from timer_get_us()) when the pending transfer is done
+ * @xfer_buf:	Part of the card for the pending transfer, NULL if none
+ * @xfer_len:	Length of the pending transfer in bytes
+ * @xfer_read:	true if the pending transfer reads from the card
+ */
+struct sandbox_sdhci_priv {
+	struct sdhci_host host;
+	u8 regs[SANDBOX_SDHCI_REGS];
+	u8 *card;
+	bool app_cmd;
+	struct sandbox_sdhci_stats stats;
+	ulong latency_us;
+	ulong busy_until;
+	u8 *xfer_buf;
+	uint xfer_len;
+	bool xfer_read;
+};
+
+static struct sandbox_sdhci_priv *to_priv(struct sdhci_host *host)
+{
+	return container_of(host, struct sandbox_sdhci_priv, host);
+}
+
+static u32 reg_get(struct sandbox_sdhci_priv *priv, int reg, int size)
+{
+	u32 val = 0;
+
+	while (size--)
+		val = val << 8 | priv->regs[reg + size];
+
+	return val;
+}
+
+static void reg_set(struct sandbox_sdhci_priv *priv, int reg, int size,
+		    u32 val)
+{
+	for (; size--; reg++, val >>= 8)
+		priv->regs[reg] = val;
+}
+
+static void sandbox_sdhci_reset(struct sandbox_sdhci_priv *priv)
+{
+	memset(priv->regs, '\0', sizeof(priv->regs));
+	reg_set(priv, SDHCI_CAPABILITIES, 4,
+		50 << SDHCI_CLOCK_BASE_SHIFT | SDHCI_CAN_DO_8BIT |
+		SDHCI_CAN_DO_ADMA2 | SDHCI_CAN_DO_HISPD | SDHCI_CAN_VDD_330 |
+		SDHCI_CAN_64BIT);
+	reg_set(priv, SDHCI_HOST_VERSION, 2, SDHCI_SPEC_300);
+}
+
+/* Set a 136-bit response, which the controller stores without the CRC */
+static void sandbox_sdhci_set_r2(struct sandbox_sdhci_priv *priv,
+				 const u32 *resp)
+{
+	int i;
+
+	for (i = 0; i < 15; i++)
+		priv->regs[SDHCI_RESPONSE + i] =
+			resp[3 - (i + 1) / 4] >> ((i + 1) % 4 * 8);
+}
+
+/*
+ * Walk the ADMA2 descriptor table, copying @len bytes between @buf and the
+ * buffers it describes. Returns 0 if the table described exactly @len bytes
+ * and was otherwise valid.
+ */
+static int sandbox_sdhci_adma(struct sandbox_sdhci_priv *priv, u8 *buf,
+			      uint len, bool read)
+{
+	u8 mode = priv->regs[SDHCI_HOST_CONTROL] & SDHCI_CTRL_DMA_MASK;
+	bool is64 = mode == SDHCI_CTRL_ADMA64;
+	ulong addr = reg_get(priv, SDHCI_ADMA_ADDRESS, 4);
+	struct sdhci_adma_desc *desc;
+	uint descs = 0, done = 0;
+	ulong data;
+	uint dlen;
+	u16 attr;
+
+	if (mode != SDHCI_CTRL_ADMA32 && !is64)
+		return -ENOTSUPP;
+	if (is64)
+		addr |= (u64)reg_get(priv, SDHCI_ADMA_ADDRESS_HI, 4) << 32;
+
+	do {
+		if (addr & 3)
+			return -EINVAL;
+		desc = (struct sdhci_adma_desc *)addr;
+		attr = le16_to_cpu(get_unaligned(&desc->attr));
+		dlen = le16_to_cpu(get_unaligned(&desc->len)) ?: 0x10000;
+		data = le32_to_cpu(get_unaligned(&desc->addr_lo));
+		if (is64)
+			data |= (u64)le32_to_cpu(get_unaligned(&desc->addr_hi))
+				<< 32;
+		if (!(attr & ADMA_DESC_ATTR_VALID))
+			return -EINVAL;
+
+		switch (attr & (ADMA_DESC_ATTR_ACT1 | ADMA_DESC_ATTR_ACT2)) {
+		case ADMA_DESC_ATTR_ACT2:
+			if ((data & 3) || done + dlen > len)
+				return -EINVAL;
+			if (read)
+				memcpy((void *)data, buf + done, dlen);
+			else
+				memcpy(buf + done, (void *)data, dlen);
+			done += dlen;
+			descs++;
+			addr += is64 ? ADMA_DESC_LEN_64 : ADMA_DESC_LEN_32;
+			break;
+		case ADMA_DESC_ATTR_ACT1 | ADMA_DESC_ATTR_ACT2:
+			/* Link to another descriptor */
+			addr = data;
+			break;
+		default:
+			addr += is64 ? ADMA_DESC_LEN_64 : ADMA_DESC_LEN_32;
+			break;
+		}
+	} while (!(attr & ADMA_DESC_ATTR_END));
+
+	priv->stats.transfers++;
+	priv->stats.descs += descs;
+	priv->stats.max_descs = max(priv->stats.max_descs, descs);
+
+	return done == len ? 0 : -EINVAL;
+}
+
+/* Do a data transfer, returning the interrupt status bits to set */
+static u32 sandbox_sdhci_xfer(struct sandbox_sdhci_priv *priv, u8 *buf,
+			      uint len, bool read)
+{
+	if (sandbox_sdhci_adma(priv, buf, len, read))
+		return SDHCI_INT_ERROR | SDHCI_INT_ADMA_ERROR;
+
+	return SDHCI_INT_DATA_END;
+}
+
+/* Finish the pending transfer once its time is up */
+static void sandbox_sdhci_update(struct sandbox_sdhci_priv *priv)
+{
+	u32 stat;
+
+	if (!priv->xfer_buf || (long)(timer_get_us() - priv->busy_until) < 0)
+		return;
+
+	stat = reg_get(priv, SDHCI_INT_STATUS, 4);
+	stat |= sandbox_sdhci_xfer(priv, priv->xfer_buf, priv->xfer_len,
+				  priv->xfer_read);
+	reg_set(priv, SDHCI_INT_STATUS, 4, stat);
+	reg_set(priv, SDHCI_PRESENT_STATE, 4,
+		reg_get(priv, SDHCI_PRESENT_STATE, 4) & ~SDHCI_DATA_INHIBIT);
+	priv->xfer_buf = NULL;
+}
+
+/* Run a command, returning the interrupt status bits to set */
+static u32 sandbox_sdhci_command(struct sandbox_sdhci_priv *priv, u16 val)
+{
+	uint cmd = val >> 8;
+	u32 arg = reg_get(priv, SDHCI_ARGUMENT, 4);
+	u16 mode = reg_get(priv, SDHCI_TRANSFER_MODE, 2);
+	uint blksz = reg_get(priv, SDHCI_BLOCK_SIZE, 2) & 0xfff;
+	uint blocks = mode & SDHCI_TRNS_MULTI ?
+		      reg_get(priv, SDHCI_BLOCK_COUNT, 2) : 1;
+	bool read = mode & SDHCI_TRNS_READ;
+	u32 resp[4] = { 0 };
+	__be32 small[16] = { 0 };
+	u8 *buf = NULL;
+	bool app_cmd = priv->app_cmd;
+
+	priv->app_cmd = false;
+	switch (cmd) {
+	case MMC_CMD_GO_IDLE_STATE:
+		break;
+	case MMC_CMD_ALL_SEND_CID:
+		resp[0] = 0x03000000;	/* Manufacturer ID */
+		sandbox_sdhci_set_r2(priv, resp);
+		return SDHCI_INT_RESPONSE;
+	case SD_CMD_SEND_RELATIVE_ADDR:
+		resp[0] = 1 << 16;
+		break;
+	case SD_CMD_SEND_IF_COND:
+		/* Echo back the voltage and check pattern */
+		resp[0] = arg & 0xfff;
+		break;
+	case MMC_CMD_SEND_CSD:
+		resp[0] = 0x400e0032;	/* CSD version 2.0, 25MHz */
+		resp[1] = 9 << 16 | SANDBOX_SDHCI_C_SIZE >> 16;
+		resp[2] = (SANDBOX_SDHCI_C_SIZE & 0xffff) << 16;
+		sandbox_sdhci_set_r2(priv, resp);
+		return SDHCI_INT_RESPONSE;
+	case MMC_CMD_SELECT_CARD:
+	case MMC_CMD_SET_BLOCKLEN:
+	case MMC_CMD_STOP_TRANSMISSION:
+		break;
+	case MMC_CMD_APP_CMD:
+		priv->app_cmd = true;
+		break;
+	case SD_CMD_APP_SEND_OP_COND:
+		resp[0] = OCR_BUSY | OCR_HCS | (arg & 0xff8000);
+		break;
+	case SD_CMD_SWITCH_FUNC:	/* also SD_CMD_APP_SET_BUS_WIDTH */
+		if (!app_cmd)
+			buf = (u8 *)small;
+		break;
+	case MMC_CMD_SEND_STATUS:	/* also SD_CMD_APP_SD_STATUS */
+		if (app_cmd)
+			buf = (u8 *)small;
+		else
+			resp[0] = MMC_STATUS_RDY_FOR_DATA;
+		break;
+	case SD_CMD_APP_SEND_SCR:
+		small[0] = cpu_to_be32(2 << 24 | SD_DATA_4BIT);
+		buf = (u8 *)small;
+		break;
+	case MMC_CMD_READ_SINGLE_BLOCK:
+	case MMC_CMD_READ_MULTIPLE_BLOCK:
+	case MMC_CMD_WRITE_SINGLE_BLOCK:
+	case MMC_CMD_WRITE_MULTIPLE_BLOCK:
+		if (blksz != MMC_MAX_BLOCK_LEN || arg >= SANDBOX_SDHCI_BLOCKS ||
+		    blocks > SANDBOX_SDHCI_BLOCKS - arg)
+			return SDHCI_INT_RESPONSE | SDHCI_INT_ERROR |
+				SDHCI_INT_DATA_END_BIT;
+		buf = priv->card + arg * MMC_MAX_BLOCK_LEN;
+		break;
+	default:
+		debug("%s: Unknown command %d\n", __func__, cmd);
+		return SDHCI_INT_ERROR | SDHCI_INT_TIMEOUT;
+	}
+	reg_set(priv, SDHCI_RESPONSE, 4, resp[0]);
+
+	if (!(val & SDHCI_CMD_DATA))
+		return SDHCI_INT_RESPONSE;
+	if (!buf || blocks * blksz > (buf == (u8 *)small ? sizeof(small) :
+				      SANDBOX_SDHCI_BLOCKS * 512) ||
+	    !(mode & SDHCI_TRNS_DMA))
+		return SDHCI_INT_RESPONSE | SDHCI_INT_ERROR |
+			SDHCI_INT_ADMA_ERROR;
+
+	/* Transfers to and from the card take a while, if so set up */
+	if (priv->latency_us && buf != (u8 *)small) {
+		priv->xfer_buf = buf;
+		priv->xfer_len = blocks * blksz;
+		priv->xfer_read = read;
+		priv->busy_until = timer_get_us() + priv->latency_us;
+		reg_set(priv, SDHCI_PRESENT_STATE, 4, SDHCI_DATA_INHIBIT);
+		return SDHCI_INT_RESPONSE;
+	}
+
+	return SDHCI_INT_RESPONSE |
+		sandbox_sdhci_xfer(priv, buf, blocks * blksz, read);
+}
+
+static void sandbox_sdhci_write(struct sdhci_host *host, u32 val, int reg,
+				int size)
+{
+	struct sandbox_sdhci_priv *priv = to_priv(host);
+	u32 stat;
+
+	if (reg + size > SANDBOX_SDHCI_REGS)
+		return;
+
+	switch (reg) {
+	case SDHCI_INT_STATUS:
+		/* Write one to clear */
+		stat = reg_get(priv, SDHCI_INT_STATUS, 4) & ~val;
+		if (!(stat & ~0xffff))
+			stat &= ~SDHCI_INT_ERROR;
+		reg_set(priv, SDHCI_INT_STATUS, 4, stat);
+		return;
+	case SDHCI_SOFTWARE_RESET:
+		if (val & SDHCI_RESET_ALL)
+			sandbox_sdhci_reset(priv);
+		else
+			reg_set(priv, SDHCI_INT_STATUS, 4, 0);
+		/* Drop the pending transfer */
+		if (val & (SDHCI_RESET_ALL | SDHCI_RESET_DATA)) {
+			priv->xfer_buf = NULL;
+			reg_set(priv, SDHCI_PRESENT_STATE, 4, 0);
+		}
+		return;
+	case SDHCI_CLOCK_CONTROL:
+		if (val & SDHCI_CLOCK_INT_EN)
+			val |= SDHCI_CLOCK_INT_STABLE;
+		break;
+	}
+	reg_set(priv, reg, size, val);
+
+	if (reg == SDHCI_COMMAND && size == 2) {
+		stat = reg_get(priv, SDHCI_INT_STATUS, 4);
+		stat |= sandbox_sdhci_command(priv, val);
+		reg_set(priv, SDHCI_INT_STATUS, 4, stat);
+	}
+}
+
+static u32 sandbox_sdhci_read(struct sdhci_host *host, int reg, int size)
+{
+	struct sandbox_sdhci_priv *priv = to_priv(host);
+
+	if (reg + size > SANDBOX_SDHCI_REGS)
+		return 0;
+	sandbox_sdhci_update(priv);
+
+	return reg_get(priv, reg, size);
+}
+
+static u32 sandbox_sdhci_read_l(struct sdhci_host *host, int reg)
+{
+	return sandbox_sdhci_read(host, reg, 4);
+}
+
+static u16 sandbox_sdhci_read_w(struct sdhci_host *host, int reg)
+{
+	return sandbox_sdhci_read(host, reg, 2);
+}
+
+static u8 sandbox_sdhci_read_b(struct sdhci_host *host, int reg)
+{
+	return sandbox_sdhci_read(host, reg, 1);
+}
+
+static void sandbox_sdhci_write_l(struct sdhci_host *host, u32 val, int reg)
+{
+	sandbox_sdhci_write(host, val, reg, 4);
+}
+
+static void sandbox_sdhci_write_w(struct sdhci_host *host, u16 val, int reg)
+{
+	sandbox_sdhci_write(host, val, reg, 2);
+}
+
+static void sandbox_sdhci_write_b(struct sdhci_host *host, u8 val, int reg)
+{
+	sandbox_sdhci_write(host, val, reg, 1);
+}
+
+static const struct sdhci_ops sandbox_sdhci_ops = {
+	.read_l		= sandbox_sdhci_read_l,
+	.read_w		= sandbox_sdhci_read_w,
+	.read_b		= sandbox_sdhci_read_b,
+	.write_l	= sandbox_sdhci_write_l,
+	.write_w	= sandbox_sdhci_write_w,
+	.write_b	= sandbox_sdhci_write_b,
+};
+
+void sandbox_sdhci_get_stats(struct udevice *dev,
+			     struct sandbox_sdhci_stats *stats)
+{
+	struct sandbox_sdhci_priv *priv = dev_get_priv(dev);
+
+	*stats = priv->stats;
+	memset(&priv->stats, '\0', sizeof(priv->stats));
+}
+
+void sandbox_sdhci_set_latency(struct udevice *dev, ulong latency_us)
+{
+	struct sandbox_sdhci_priv *priv = dev_get_priv(dev);
+
+	priv->latency_us = latency_us;
+}
+
+u8 *sandbox_sdhci_get_card(struct udevice *dev)
+{
+	struct sandbox_sdhci_priv *priv = dev_get_priv(dev);
+
+	return priv->card;
+}
+
+static int sandbox_sdhci_probe(struct udevice *dev)
+{
+	struct mmc_uclass_priv *upriv = dev_get_uclass_priv(dev);
+	struct sandbox_sdhci_plat *plat = dev_get_platdata(dev);
+	struct sandbox_sdhci_priv *priv = dev_get_priv(dev);
+	struct sdhci_host *host = &priv->host;
+	int ret;
+
+	priv->card = calloc(SANDBOX_SDHCI_BLOCKS, MMC_MAX_BLOCK_LEN);
+	if (!priv->card)
+		return -ENOMEM;
+	sandbox_sdhci_reset(priv);
+
+	host->name = dev->name;
+	host->ops = &sandbox_sdhci_ops;
+	ret = sdhci_setup_cfg(&plat->cfg, host, 0, 400000);
+	if (ret)
+		return ret;
+
+	host->mmc = &plat->mmc;
+	host->mmc->priv = host;
+	host->mmc->dev = dev;
+	upriv->mmc = host->mmc;
+
+	return sdhci_probe(dev);
+}
+
+static int sandbox_sdhci_remove(struct udevice *dev)
+{
+	struct sandbox_sdhci_priv *priv = dev_get_priv(dev);
+
+	free(priv->card);
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	free(priv->host.adma_desc_table);
+#endif
+
+	return 0;
+}
+
+static int sandbox_sdhci_bind(struct udevice *dev)
+{
+	struct sandbox_sdhci_plat *plat = dev_get_platdata(dev);
+
+	return sdhci_bind(dev, &plat->mmc, &plat->cfg);
+}
+
+static const struct udevice_id sandbox_sdhci_ids[] = {
+	{ .compatible = "sandbox,sdhci" },
+	{ }
+};
+
+U_BOOT_DRIVER(sandbox_sdhci) = {
+	.name		= "sandbox_sdhci",
+	.id		= UCLASS_MMC,
+	.of_match	= sandbox_sdhci_ids,
+	.ops		= &sdhci_ops,
+	.bind		= sandbox_sdhci_bind,
+	.probe		= sandbox_sdhci_probe,
+	.remove		= sandbox_sdhci_remove,
+	.priv_auto_alloc_size = sizeof(struct sandbox_sdhci_priv),
+	.platdata_auto_alloc_size = sizeof(struct sandbox_sdhci_plat),
+};
@@ -67,18 +67,104 @@ static void sdhci_transfer_pio(struct sdhci_host *host, struct mmc_data *data)
 	}
 }
 
-static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
-				unsigned int start_addr)
+#if defined(CONFIG_MMC_SDHCI_SDMA) || defined(CONFIG_MMC_SDHCI_ADMA)
+static void sdhci_set_dma_mode(struct sdhci_host *host, u8 mode)
 {
-	unsigned int stat, rdy, mask, timeout, block = 0;
-	bool transfer_done = false;
-#ifdef CONFIG_MMC_SDHCI_SDMA
-	unsigned char ctrl;
+	u8 ctrl;
+
 	ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL);
 	ctrl &= ~SDHCI_CTRL_DMA_MASK;
+	ctrl |= mode;
 	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
+}
 #endif
 
+#ifdef CONFIG_MMC_SDHCI_ADMA
+static void sdhci_adma_write_desc(struct sdhci_host *host, void *desc,
+				  dma_addr_t addr, uint len, bool end)
+{
+	struct sdhci_adma_desc *dma_desc = desc;
+	u16 attr = ADMA_DESC_TRANSFER_DATA;
+
+	if (end)
+		attr |= ADMA_DESC_ATTR_END;
+	dma_desc->attr = cpu_to_le16(attr);
+	/* A length of 0 would mean 64KiB */
+	dma_desc->len = cpu_to_le16(len);
+	dma_desc->addr_lo = cpu_to_le32(lower_32_bits(addr));
+	if (host->adma_desc_len == ADMA_DESC_LEN_64)
+		dma_desc->addr_hi = cpu_to_le32(upper_32_bits(addr));
+}
+
+/*
+ * Describe the whole transfer in the ADMA2 descriptor table, so that the
+ * controller can run it without the CPU having to step in
+ */
+static void sdhci_prepare_adma_table(struct sdhci_host *host,
+				     dma_addr_t start_addr, uint trans_bytes)
+{
+	void *desc = host->adma_desc_table;
+	dma_addr_t table_addr = (ulong)host->adma_desc_table;
+	uint len;
+
+	while (trans_bytes) {
+		len = min_t(uint, trans_bytes, ADMA_MAX_LEN);
+		trans_bytes -= len;
+		sdhci_adma_write_desc(host, desc, start_addr, len,
+				      !trans_bytes);
+		start_addr += len;
+		desc += host->adma_desc_len;
+	}
+	flush_cache((ulong)host->adma_desc_table,
+		    ALIGN(desc - host->adma_desc_table,
+			  CONFIG_SYS_CACHELINE_SIZE));
+
+	sdhci_writel(host, lower_32_bits(table_addr), SDHCI_ADMA_ADDRESS);
+	if (host->adma_desc_len == ADMA_DESC_LEN_64) {
+		sdhci_writel(host, upper_32_bits(table_addr),
+			     SDHCI_ADMA_ADDRESS_HI);
+		sdhci_set_dma_mode(host, SDHCI_CTRL_ADMA64);
+	} else {
+		sdhci_set_dma_mode(host, SDHCI_CTRL_ADMA32);
+	}
+}
+
+static int sdhci_adma_init(struct sdhci_host *host, u32 caps)
+{
+	if (!(caps & SDHCI_CAN_DO_ADMA2)) {
+		/* Fall back to SDMA if we can */
+		if (IS_ENABLED(CONFIG_MMC_SDHCI_SDMA))
+			return 0;
+		printf("%s: Your controller doesn't support ADMA2!!\n",
+		       __func__);
+		return -EINVAL;
+	}
+
+	host->adma_desc_len = ADMA_DESC_LEN_32;
+	if (sizeof(dma_addr_t) > sizeof(u32) && (caps & SDHCI_CAN_64BIT))
+		host->adma_desc_len = ADMA_DESC_LEN_64;
+
+	if (!host->adma_desc_table) {
+		host->adma_desc_table = memalign(ARCH_DMA_MINALIGN,
+						 ADMA_TABLE_NO_ENTRIES *
+						 host->adma_desc_len);
+		if (!host->adma_desc_table) {
+			printf("%s: ADMA descriptor table alloc failed!!\n",
+			       __func__);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+#endif
+
+static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
+			       dma_addr_t start_addr)
+{
+	unsigned int stat, rdy, mask, timeout, block = 0;
+	bool transfer_done = false;
+
 	timeout = 1000000;
 	rdy = SDHCI_INT_SPACE_AVAIL | SDHCI_INT_DATA_AVAIL;
 	mask = SDHCI_DATA_AVAILABLE | SDHCI_SPACE_AVAILABLE;
@@ -87,6 +173,11 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 		if (stat & SDHCI_INT_ERROR) {
 			pr_debug("%s: Error detected in status(0x%X)!\n",
 				 __func__, stat);
+#ifdef CONFIG_MMC_SDHCI_ADMA
+			if (stat & SDHCI_INT_ADMA_ERROR)
+				pr_debug("%s: ADMA error 0x%x\n", __func__,
+					 sdhci_readb(host, SDHCI_ADMA_ERROR));
+#endif
 			return -EIO;
 		}
 		if (!transfer_done && (stat & rdy)) {
@@ -105,6 +196,7 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 			}
 		}
 #ifdef CONFIG_MMC_SDHCI_SDMA
+		/* ADMA2 has no buffer boundaries to restart at */
 		if (!transfer_done && (stat & SDHCI_INT_DMA_END)) {
 			sdhci_writel(host, SDHCI_INT_DMA_END, SDHCI_INT_STATUS);
 			start_addr &= ~(SDHCI_DEFAULT_BOUNDARY_SIZE - 1);
@@ -132,30 +224,66 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 #define SDHCI_CMD_MAX_TIMEOUT			3200
 #define SDHCI_CMD_DEFAULT_TIMEOUT		100
 #define SDHCI_READ_STATUS_TIMEOUT		1000
+#define SDHCI_BG_WRITE_TIMEOUT			10000
 
-#ifdef CONFIG_DM_MMC
-static int sdhci_send_command(struct udevice *dev, struct mmc_cmd *cmd,
-			      struct mmc_data *data)
+#ifdef CONFIG_MMC_SDHCI_ADMA
+/*
+ * Check whether a write left to run by itself is over. Returns -EBUSY while
+ * it is not, else 0 with the result of the write in host->bg_ret.
+ */
+static int sdhci_bg_check(struct sdhci_host *host)
 {
-	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	unsigned int stat;
 
-#else
-static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
-			      struct mmc_data *data)
-{
+	if (!host->bg_busy)
+		return 0;
+
+	stat = sdhci_readl(host, SDHCI_INT_STATUS);
+	if (stat & (SDHCI_INT_ERROR | SDHCI_INT_DATA_END)) {
+		host->bg_ret = stat & SDHCI_INT_ERROR ? -EIO : 0;
+	} else {
+		if (get_timer(host->bg_start) < SDHCI_BG_WRITE_TIMEOUT)
+			return -EBUSY;
+		printf("%s: Transfer data timeout\n", __func__);
+		host->bg_ret = -ETIMEDOUT;
+	}
+
+	host->bg_busy = false;
+	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
+	if (host->bg_ret) {
+		sdhci_reset(host, SDHCI_RESET_CMD);
+		sdhci_reset(host, SDHCI_RESET_DATA);
+	}
+
+	return 0;
+}
 #endif
+
+/*
+ * Send a command. With @background the data transfer is left to the
+ * controller, see sdhci_send_cmd_start().
+ */
+static int sdhci_do_command(struct mmc *mmc, struct mmc_cmd *cmd,
+			    struct mmc_data *data, bool background)
+{
 	struct sdhci_host *host = mmc->priv;
 	unsigned int stat = 0;
 	int ret = 0;
 	int trans_bytes = 0, is_aligned = 1;
 	u32 mask, flags, mode;
-	unsigned int time = 0, start_addr = 0;
+	unsigned int time = 0;
+	dma_addr_t start_addr = 0;
 	int mmc_dev = mmc_get_blk_desc(mmc)->devnum;
 	ulong start = get_timer(0);
 
 	/* Timeout unit - ms */
 	static unsigned int cmd_timeout = SDHCI_CMD_DEFAULT_TIMEOUT;
 
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	while (sdhci_bg_check(host) == -EBUSY)
+		udelay(10);
+#endif
+
 	mask = SDHCI_CMD_INHIBIT | SDHCI_DATA_INHIBIT;
 
 	/* We shouldn't wait for data inihibit for stop commands, even
@@ -218,7 +346,7 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 		if (data->flags == MMC_DATA_READ)
 			mode |= SDHCI_TRNS_READ;
 
-#ifdef CONFIG_MMC_SDHCI_SDMA
+#if defined(CONFIG_MMC_SDHCI_SDMA) || defined(CONFIG_MMC_SDHCI_ADMA)
 		if (data->flags == MMC_DATA_READ)
 			start_addr = (unsigned long)data->dest;
 		else
@@ -242,8 +370,20 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 			memcpy(aligned_buffer, data->src, trans_bytes);
 #endif
 
-		sdhci_writel(host, start_addr, SDHCI_DMA_ADDRESS);
-		mode |= SDHCI_TRNS_DMA;
+#ifdef CONFIG_MMC_SDHCI_ADMA
+		if (host->adma_desc_table) {
+			sdhci_prepare_adma_table(host, start_addr,
+						 trans_bytes);
+			mode |= SDHCI_TRNS_DMA;
+		}
+#endif
+#ifdef CONFIG_MMC_SDHCI_SDMA
+		if (!(mode & SDHCI_TRNS_DMA)) {
+			sdhci_writel(host, start_addr, SDHCI_DMA_ADDRESS);
+			sdhci_set_dma_mode(host, SDHCI_CTRL_SDMA);
+			mode |= SDHCI_TRNS_DMA;
+		}
+#endif
 #endif
 		sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG,
 				data->blocksize),
@@ -255,7 +395,7 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	}
 
 	sdhci_writel(host, cmd->cmdarg, SDHCI_ARGUMENT);
-#ifdef CONFIG_MMC_SDHCI_SDMA
+#if defined(CONFIG_MMC_SDHCI_SDMA) || defined(CONFIG_MMC_SDHCI_ADMA)
 	if (data) {
 		trans_bytes = ALIGN(trans_bytes, CONFIG_SYS_CACHELINE_SIZE);
 		flush_cache(start_addr, trans_bytes);
@@ -285,8 +425,16 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	} else
 		ret = -1;
 
-	if (!ret && data)
+	if (!ret && data) {
+#ifdef CONFIG_MMC_SDHCI_ADMA
+		if (background) {
+			host->bg_busy = true;
+			host->bg_start = get_timer(0);
+			return 0;
+		}
+#endif
 		ret = sdhci_transfer_data(host, data, start_addr);
+	}
 
 	if (host->quirks & SDHCI_QUIRK_WAIT_SEND_CMD)
 		udelay(1000);
@@ -308,6 +456,50 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 		return -ECOMM;
 }
 
+#ifdef CONFIG_DM_MMC
+static int sdhci_send_command(struct udevice *dev, struct mmc_cmd *cmd,
+			      struct mmc_data *data)
+{
+	return sdhci_do_command(mmc_get_mmc_dev(dev), cmd, data, false);
+}
+
+#ifdef CONFIG_MMC_SDHCI_ADMA
+static int sdhci_send_cmd_start(struct udevice *dev, struct mmc_cmd *cmd,
+				struct mmc_data *data)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+
+	/* Only ADMA2 can get through a whole write without the CPU */
+	if (!data || data->flags != MMC_DATA_WRITE || !host->adma_desc_table)
+		return -ENOSYS;
+
+	return sdhci_do_command(mmc, cmd, data, true);
+}
+
+static int sdhci_send_cmd_done(struct udevice *dev)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+	int ret;
+
+	ret = sdhci_bg_check(host);
+	if (ret)
+		return ret;
+	ret = host->bg_ret;
+	host->bg_ret = 0;
+
+	return ret;
+}
+#endif
+#else
+static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
+			      struct mmc_data *data)
+{
+	return sdhci_do_command(mmc, cmd, data, false);
+}
+#endif
+
 #if defined(CONFIG_DM_MMC) && defined(MMC_SUPPORTS_TUNING)
 static int sdhci_execute_tuning(struct udevice *dev, uint opcode)
 {
@@ -544,6 +736,10 @@ int sdhci_probe(struct udevice *dev)
 
 const struct dm_mmc_ops sdhci_ops = {
 	.send_cmd	= sdhci_send_command,
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	.send_cmd_start	= sdhci_send_cmd_start,
+	.send_cmd_done	= sdhci_send_cmd_done,
+#endif
 	.set_ios	= sdhci_set_ios,
 #ifdef MMC_SUPPORTS_TUNING
 	.execute_tuning	= sdhci_execute_tuning,
@@ -561,6 +757,9 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 		u32 f_max, u32 f_min)
 {
 	u32 caps, caps_1 = 0;
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	int ret;
+#endif
 
 	caps = sdhci_readl(host, SDHCI_CAPABILITIES);
 
@@ -570,6 +769,11 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 		       __func__);
 		return -EINVAL;
 	}
+#endif
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	ret = sdhci_adma_init(host, caps);
+	if (ret)
+		return ret;
 #endif
 	if (host->quirks & SDHCI_QUIRK_REG32_RW)
 		host->version =
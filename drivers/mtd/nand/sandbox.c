@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Simulate a NAND flash at the MTD level
+ *
+ * The array is held in host memory, inverted so that the zero pages which
+ * the host hands out read as erased flash. Only the pages which are written
+ * use any memory, so large devices can be simulated cheaply. Like a real
+ * chip, reads go through a page register a whole page at a time. There is no
+ * ECC and the OOB area is not simulated.
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <errno.h>
+#include <malloc.h>
+#include <os.h>
+#include <linux/mtd/mtd.h>
+#include <linux/sizes.h>
+
+/**
+ * struct sandbox_nand_priv - private data for the NAND simulator
+ *
+ * @mem:	inverted contents of the array, so zero means erased
+ * @bad:	one byte per eraseblock, non-zero if it is marked bad
+ * @page:	page register, holding the last page read
+ */
+struct sandbox_nand_priv {
+	u8 *mem;
+	u8 *bad;
+	u8 *page;
+};
+
+static int sandbox_nand_read(struct mtd_info *mtd, loff_t from, size_t len,
+			     size_t *retlen, u_char *buf)
+{
+	struct sandbox_nand_priv *priv = dev_get_priv(mtd->dev);
+	size_t done, ofs, count;
+	const u8 *src;
+	int i;
+
+	for (done = 0; done < len; done += count) {
+		ofs = (from + done) & mtd->writesize_mask;
+		src = priv->mem + from + done - ofs;
+		for (i = 0; i < mtd->writesize; i++)
+			priv->page[i] = ~src[i];
+		count = min(len - done, (size_t)mtd->writesize - ofs);
+		memcpy(buf + done, priv->page + ofs, count);
+	}
+	*retlen = len;
+
+	return 0;
+}
+
+static int sandbox_nand_write(struct mtd_info *mtd, loff_t to, size_t len,
+			      size_t *retlen, const u_char *buf)
+{
+	struct sandbox_nand_priv *priv = dev_get_priv(mtd->dev);
+	u8 *dst = priv->mem + to;
+	size_t i;
+
+	if ((to | len) & (mtd->writesize - 1))
+		return -EINVAL;
+
+	/* Programming can only clear bits, i.e. set them in the copy */
+	for (i = 0; i < len; i++) {
+		if (buf[i] != 0xff)
+			dst[i] |= ~buf[i];
+	}
+	*retlen = len;
+
+	return 0;
+}
+
+static int sandbox_nand_erase(struct mtd_info *mtd, struct erase_info *instr)
+{
+	struct sandbox_nand_priv *priv = dev_get_priv(mtd->dev);
+	u64 ofs;
+	int i;
+
+	if ((instr->addr | instr->len) & (mtd->erasesize - 1))
+		return -EINVAL;
+
+	for (ofs = instr->addr; ofs < instr->addr + instr->len;
+	     ofs += mtd->erasesize) {
+		u8 *blk = priv->mem + ofs;
+
+		if (priv->bad[mtd_div_by_eb(ofs, mtd)]) {
+			instr->fail_addr = ofs;
+			instr->state = MTD_ERASE_FAILED;
+			return -EIO;
+		}
+
+		/* Leave erased blocks alone, to save host memory */
+		for (i = 0; i < mtd->erasesize; i++) {
+			if (blk[i]) {
+				memset(blk, '\0', mtd->erasesize);
+				break;
+			}
+		}
+	}
+	instr->state = MTD_ERASE_DONE;
+	mtd_erase_callback(instr);
+
+	return 0;
+}
+
+static int sandbox_nand_block_isbad(struct mtd_info *mtd, loff_t ofs)
+{
+	struct sandbox_nand_priv *priv = dev_get_priv(mtd->dev);
+
+	return priv->bad[mtd_div_by_eb(ofs, mtd)];
+}
+
+static int sandbox_nand_block_markbad(struct mtd_info *mtd, loff_t ofs)
+{
+	struct sandbox_nand_priv *priv = dev_get_priv(mtd->dev);
+
+	priv->bad[mtd_div_by_eb(ofs, mtd)] = 1;
+
+	return 0;
+}
+
+static int sandbox_nand_probe(struct udevice *dev)
+{
+	struct sandbox_nand_priv *priv = dev_get_priv(dev);
+	struct mtd_info *mtd = dev_get_uclass_priv(dev);
+
+	mtd->dev = dev;
+	mtd->name = (char *)dev->name;
+	mtd->type = MTD_NANDFLASH;
+	mtd->flags = MTD_CAP_NANDFLASH;
+	mtd->size = dev_read_u32_default(dev, "sandbox,size", SZ_16M);
+	mtd->erasesize = dev_read_u32_default(dev, "sandbox,erase-size",
+					      SZ_128K);
+	mtd->writesize = dev_read_u32_default(dev, "sandbox,page-size", SZ_2K);
+	mtd->writebufsize = mtd->writesize;
+	mtd->oobsize = mtd->writesize / 32;
+	mtd->erasesize_shift = ffs(mtd->erasesize) - 1;
+	mtd->writesize_shift = ffs(mtd->writesize) - 1;
+	mtd->erasesize_mask = mtd->erasesize - 1;
+	mtd->writesize_mask = mtd->writesize - 1;
+	if (!mtd->size || mtd->size & mtd->erasesize_mask ||
+	    mtd->erasesize & mtd->writesize_mask)
+		return -EINVAL;
+	mtd->_erase = sandbox_nand_erase;
+	mtd->_read = sandbox_nand_read;
+	mtd->_write = sandbox_nand_write;
+	mtd->_block_isbad = sandbox_nand_block_isbad;
+	mtd->_block_markbad = sandbox_nand_block_markbad;
+
+	/* os_malloc() maps fresh host pages, which are zeroed on first use */
+	priv->mem = os_malloc(mtd->size);
+	if (!priv->mem)
+		return -ENOMEM;
+	priv->bad = calloc(1, mtd_div_by_eb(mtd->size, mtd));
+	priv->page = malloc(mtd->writesize);
+	if (!priv->bad || !priv->page) {
+		free(priv->page);
+		free(priv->bad);
+		os_free(priv->mem);
+		return -ENOMEM;
+	}
+
+	return add_mtd_device(mtd) ? -ENOMEM : 0;
+}
+
+static int sandbox_nand_remove(struct udevice *dev)
+{
+	struct sandbox_nand_priv *priv = dev_get_priv(dev);
+
+	del_mtd_device(dev_get_uclass_priv(dev));
+	free(priv->page);
+	free(priv->bad);
+	os_free(priv->mem);
+
+	return 0;
+}
+
+static const struct udevice_id sandbox_nand_ids[] = {
+	{ .compatible = "sandbox,nand" },
+	{ }
+};
+
+U_BOOT_DRIVER(sandbox_nand) = {
+	.name		= "sandbox_nand",
+	.id		= UCLASS_MTD,
+	.of_match	= sandbox_nand_ids,
+	.probe		= sandbox_nand_probe,
+	.remove		= sandbox_nand_remove,
+	.priv_auto_alloc_size = sizeof(struct sandbox_nand_priv),
+};
@@ -828,6 +828,7 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
+	ubi_io_read_hdrs(ubi, pnum);
 	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
 	if (err < 0)
 		return err;
@@ -1402,6 +1403,10 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 	if (!ai)
 		return -ENOMEM;
 
+	/* Not having this just means that the headers are read separately */
+	ubi->hdrs_buf = kmalloc(ubi_io_hdrs_size(ubi), GFP_KERNEL);
+	ubi->hdrs_pnum = -1;
+
 #ifdef CONFIG_MTD_UBI_FASTMAP
 	/* On small flash devices we disable fastmap in any case. */
 	if ((int)mtd_div_by_eb(ubi->mtd->size, ubi->mtd) <= UBI_FM_MAX_START) {
@@ -1417,8 +1422,10 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 			if (err != UBI_NO_FASTMAP) {
 				destroy_ai(ai);
 				ai = alloc_ai();
-				if (!ai)
-					return -ENOMEM;
+				if (!ai) {
+					err = -ENOMEM;
+					goto out_ai;
+				}
 
 				err = scan_all(ubi, ai, 0);
 			} else {
@@ -1476,6 +1483,8 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 #endif
 
 	destroy_ai(ai);
+	kfree(ubi->hdrs_buf);
+	ubi->hdrs_buf = NULL;
 	return 0;
 
 out_wl:
@@ -1484,7 +1493,11 @@ out_vtbl:
 	ubi_free_internal_volumes(ubi);
 	vfree(ubi->vtbl);
 out_ai:
-	destroy_ai(ai);
+	/* scan_fast() leaves no attach info if it runs out of memory */
+	if (ai)
+		destroy_ai(ai);
+	kfree(ubi->hdrs_buf);
+	ubi->hdrs_buf = NULL;
 	return err;
 }
 
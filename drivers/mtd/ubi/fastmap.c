@@ -438,6 +438,25 @@ static void unmap_peb(struct ubi_attach_info *ai, int pnum)
 	}
 }
 
+/**
+ * bad_pnum - checks a PEB number read from the fastmap.
+ * @ubi: UBI device object
+ * @pnum: the PEB number
+ *
+ * The fastmap is only protected by a CRC, so a fastmap written by a buggy
+ * implementation may still refer to PEBs which do not exist.
+ *
+ * Returns true if @pnum is not a PEB of this device.
+ */
+static bool bad_pnum(struct ubi_device *ubi, int pnum)
+{
+	if (pnum >= 0 && pnum < ubi->peb_count)
+		return false;
+
+	ubi_err(ubi, "bad PEB number in fastmap: %i", pnum);
+	return true;
+}
+
 /**
  * scan_pool - scans a pool for changed (no longer empty PEBs).
  * @ubi: UBI device object
@@ -487,6 +506,11 @@ static int scan_pool(struct ubi_device *ubi, struct ubi_attach_info *ai,
 
 		pnum = be32_to_cpu(pebs[i]);
 
+		if (bad_pnum(ubi, pnum)) {
+			ret = UBI_BAD_FASTMAP;
+			goto out;
+		}
+
 		if (ubi_io_is_bad(ubi, pnum)) {
 			ubi_err(ubi, "bad PEB in fastmap pool!");
 			ret = UBI_BAD_FASTMAP;
@@ -695,6 +719,8 @@ static int ubi_attach_fastmap(struct ubi_device *ubi,
 		fm_pos += sizeof(*fmec);
 		if (fm_pos >= fm_size)
 			goto fail_bad;
+		if (bad_pnum(ubi, be32_to_cpu(fmec->pnum)))
+			goto fail_bad;
 
 		add_aeb(ai, &ai->free, be32_to_cpu(fmec->pnum),
 			be32_to_cpu(fmec->ec), 0);
@@ -706,6 +732,8 @@ static int ubi_attach_fastmap(struct ubi_device *ubi,
 		fm_pos += sizeof(*fmec);
 		if (fm_pos >= fm_size)
 			goto fail_bad;
+		if (bad_pnum(ubi, be32_to_cpu(fmec->pnum)))
+			goto fail_bad;
 
 		add_aeb(ai, &used, be32_to_cpu(fmec->pnum),
 			be32_to_cpu(fmec->ec), 0);
@@ -717,6 +745,8 @@ static int ubi_attach_fastmap(struct ubi_device *ubi,
 		fm_pos += sizeof(*fmec);
 		if (fm_pos >= fm_size)
 			goto fail_bad;
+		if (bad_pnum(ubi, be32_to_cpu(fmec->pnum)))
+			goto fail_bad;
 
 		add_aeb(ai, &used, be32_to_cpu(fmec->pnum),
 			be32_to_cpu(fmec->ec), 1);
@@ -728,6 +758,8 @@ static int ubi_attach_fastmap(struct ubi_device *ubi,
 		fm_pos += sizeof(*fmec);
 		if (fm_pos >= fm_size)
 			goto fail_bad;
+		if (bad_pnum(ubi, be32_to_cpu(fmec->pnum)))
+			goto fail_bad;
 
 		add_aeb(ai, &ai->erase, be32_to_cpu(fmec->pnum),
 			be32_to_cpu(fmec->ec), 1);
@@ -769,6 +801,9 @@ static int ubi_attach_fastmap(struct ubi_device *ubi,
 
 		fm_eba = (struct ubi_fm_eba *)(fm_raw + fm_pos);
 		fm_pos += sizeof(*fm_eba);
+		if (fm_pos >= fm_size ||
+		    be32_to_cpu(fm_eba->reserved_pebs) > ubi->peb_count)
+			goto fail_bad;
 		fm_pos += (sizeof(__be32) * be32_to_cpu(fm_eba->reserved_pebs));
 		if (fm_pos >= fm_size)
 			goto fail_bad;
@@ -784,6 +819,8 @@ static int ubi_attach_fastmap(struct ubi_device *ubi,
 
 			if ((int)be32_to_cpu(fm_eba->pnum[j]) < 0)
 				continue;
+			if (bad_pnum(ubi, pnum))
+				goto fail_bad;
 
 			aeb = NULL;
 			list_for_each_entry(tmp_aeb, &used, u.list) {
@@ -955,7 +992,7 @@ int ubi_scan_fastmap(struct ubi_device *ubi, struct ubi_attach_info *ai,
 
 		pnum = be32_to_cpu(fmsb->block_loc[i]);
 
-		if (ubi_io_is_bad(ubi, pnum)) {
+		if (bad_pnum(ubi, pnum) || ubi_io_is_bad(ubi, pnum)) {
 			ret = UBI_BAD_FASTMAP;
 			goto free_hdr;
 		}
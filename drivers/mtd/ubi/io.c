@@ -248,6 +248,9 @@ int ubi_io_write(struct ubi_device *ubi, const void *buf, int pnum, int offset,
 	if (err)
 		return err;
 
+	if (pnum == ubi->hdrs_pnum)
+		ubi->hdrs_pnum = -1;
+
 	/* The area we are writing to has to contain all 0xFF bytes */
 	err = ubi_self_check_all_ff(ubi, pnum, offset, len);
 	if (err)
@@ -336,6 +339,9 @@ static int do_sync_erase(struct ubi_device *ubi, int pnum)
 		return -EROFS;
 	}
 
+	if (pnum == ubi->hdrs_pnum)
+		ubi->hdrs_pnum = -1;
+
 retry:
 	init_waitqueue_head(&wq);
 	memset(&ei, 0, sizeof(struct erase_info));
@@ -700,6 +706,63 @@ bad:
 	return 1;
 }
 
+/**
+ * ubi_io_hdrs_size - size of the buffer needed by ubi_io_read_hdrs().
+ * @ubi: UBI device description object
+ */
+int ubi_io_hdrs_size(const struct ubi_device *ubi)
+{
+	return max_t(int, UBI_EC_HDR_SIZE,
+		     ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize);
+}
+
+/**
+ * ubi_io_read_hdrs - read the EC and VID headers of a PEB in one go.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock to read from
+ *
+ * When attaching by scanning, both headers of every PEB are read. On NAND
+ * they are in different pages, so reading them with a single multi-page
+ * request saves a round trip to the flash for each PEB. This function reads
+ * the start of @pnum into @ubi->hdrs_buf, from where the next calls to
+ * 'ubi_io_read_ec_hdr()' and 'ubi_io_read_vid_hdr()' take the headers.
+ *
+ * Nothing is kept if the read fails or reports bit-flips. The headers are
+ * then read separately, so that any problem is reported against the right
+ * header.
+ */
+void ubi_io_read_hdrs(struct ubi_device *ubi, int pnum)
+{
+	ubi->hdrs_pnum = -1;
+	if (!ubi->hdrs_buf)
+		return;
+
+	if (!ubi_io_read(ubi, ubi->hdrs_buf, pnum, 0, ubi_io_hdrs_size(ubi)))
+		ubi->hdrs_pnum = pnum;
+}
+
+/**
+ * read_hdr - read a header, using the headers read by ubi_io_read_hdrs().
+ * @ubi: UBI device description object
+ * @buf: buffer where to store the read data
+ * @pnum: physical eraseblock number to read from
+ * @offset: offset within the physical eraseblock from where to read
+ * @len: how many bytes to read
+ *
+ * This function returns the same as 'ubi_io_read()'.
+ */
+static int read_hdr(struct ubi_device *ubi, void *buf, int pnum, int offset,
+		    int len)
+{
+	if (!ubi->hdrs_buf || pnum != ubi->hdrs_pnum ||
+	    offset + len > ubi_io_hdrs_size(ubi))
+		return ubi_io_read(ubi, buf, pnum, offset, len);
+
+	memcpy(buf, ubi->hdrs_buf + offset, len);
+
+	return 0;
+}
+
 /**
  * ubi_io_read_ec_hdr - read and check an erase counter header.
  * @ubi: UBI device description object
@@ -731,7 +794,7 @@ int ubi_io_read_ec_hdr(struct ubi_device *ubi, int pnum,
 	dbg_io("read EC header from PEB %d", pnum);
 	ubi_assert(pnum >= 0 && pnum < ubi->peb_count);
 
-	read_err = ubi_io_read(ubi, ec_hdr, pnum, 0, UBI_EC_HDR_SIZE);
+	read_err = read_hdr(ubi, ec_hdr, pnum, 0, UBI_EC_HDR_SIZE);
 	if (read_err) {
 		if (read_err != UBI_IO_BITFLIPS && !mtd_is_eccerr(read_err))
 			return read_err;
@@ -1006,8 +1069,8 @@ int ubi_io_read_vid_hdr(struct ubi_device *ubi, int pnum,
 	ubi_assert(pnum >= 0 &&  pnum < ubi->peb_count);
 
 	p = (char *)vid_hdr - ubi->vid_hdr_shift;
-	read_err = ubi_io_read(ubi, p, pnum, ubi->vid_hdr_aloffset,
-			  ubi->vid_hdr_alsize);
+	read_err = read_hdr(ubi, p, pnum, ubi->vid_hdr_aloffset,
+			    ubi->vid_hdr_alsize);
 	if (read_err && read_err != UBI_IO_BITFLIPS && !mtd_is_eccerr(read_err))
 		return read_err;
 
@@ -523,6 +523,9 @@ struct ubi_debug_info {
  * @peb_buf: a buffer of PEB size used for different purposes
  * @buf_mutex: protects @peb_buf
  * @ckvol_mutex: serializes static volume checking when opening
+ * @hdrs_buf: EC and VID headers of PEB @hdrs_pnum, read in one go while
+ *            attaching (%NULL if not in use)
+ * @hdrs_pnum: PEB held in @hdrs_buf, or %-1 if none
  *
  * @dbg: debugging information for this UBI device
  */
@@ -622,6 +625,8 @@ struct ubi_device {
 	void *peb_buf;
 	struct mutex buf_mutex;
 	struct mutex ckvol_mutex;
+	void *hdrs_buf;
+	int hdrs_pnum;
 
 	struct ubi_debug_info dbg;
 };
@@ -886,6 +891,8 @@ int ubi_io_write(struct ubi_device *ubi, const void *buf, int pnum, int offset,
 int ubi_io_sync_erase(struct ubi_device *ubi, int pnum, int torture);
 int ubi_io_is_bad(const struct ubi_device *ubi, int pnum);
 int ubi_io_mark_bad(const struct ubi_device *ubi, int pnum);
+int ubi_io_hdrs_size(const struct ubi_device *ubi);
+void ubi_io_read_hdrs(struct ubi_device *ubi, int pnum);
 int ubi_io_read_ec_hdr(struct ubi_device *ubi, int pnum,
 		       struct ubi_ec_hdr *ec_hdr, int verbose);
 int ubi_io_write_ec_hdr(struct ubi_device *ubi, int pnum,
@@ -12,13 +12,27 @@
 #include <dm/device-internal.h>
 #include "nvme.h"
 
-#define NVME_Q_DEPTH		2
+#define NVME_Q_DEPTH		64
 #define NVME_AQ_DEPTH		2
 #define NVME_SQ_SIZE(depth)	(depth * sizeof(struct nvme_command))
 #define NVME_CQ_SIZE(depth)	(depth * sizeof(struct nvme_completion))
 #define ADMIN_TIMEOUT		60
 #define IO_TIMEOUT		30
-#define MAX_PRP_POOL		512
+
+/*
+ * An I/O command id holds the slot in its low byte and the slot's generation
+ * in its high byte. The generation changes when a command times out, so a
+ * late completion for it cannot be taken for the next command in the slot.
+ */
+#define NVME_CID(slot, gen)	((slot) | (gen) << 8)
+#define NVME_CID_SLOT(cid)	((cid) & 0xff)
+#define NVME_CID_GEN(cid)	((cid) >> 8)
+/*
+ * PRP list entries reserved for each I/O command slot. This limits a
+ * single command to NVME_PRP_LIST_ENTRIES pages (128KiB with 4KiB pages);
+ * larger requests are split into several commands kept in flight together.
+ */
+#define NVME_PRP_LIST_ENTRIES	32
 
 enum nvme_queue_id {
 	NVME_ADMIN_Q,
@@ -44,6 +58,13 @@ struct nvme_queue {
 	u16 qid;
 	u8 cq_phase;
 	u8 cqe_seen;
+	/* I/O queues only: command slots, indexed by command id */
+	u16 inflight;
+	u16 nr_free;
+	u16 *free_slots;	/* stack of unused command ids */
+	u64 *slot_lba;		/* first LBA of each command, ~0 if unused */
+	u8 *slot_gen;		/* generation of each slot's command id */
+	u64 *prp_lists;		/* NVME_PRP_LIST_ENTRIES per command id */
 	unsigned long cmdid_data[];
 };
 
@@ -65,12 +86,11 @@ static int nvme_wait_ready(struct nvme_dev *dev, bool enabled)
 	return -ETIME;
 }
 
-static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
+static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp_list, u64 *prp2,
 			   int total_len, u64 dma_addr)
 {
 	u32 page_size = dev->page_size;
 	int offset = dma_addr & (page_size - 1);
-	u64 *prp_pool;
 	int length = total_len;
 	int i, nprps;
 	length -= (page_size - offset);
@@ -89,31 +109,16 @@ static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
 	}
 
 	nprps = DIV_ROUND_UP(length, page_size);
+	if (nprps > NVME_PRP_LIST_ENTRIES)
+		return -EINVAL;
 
-	if (nprps > dev->prp_entry_num) {
-		free(dev->prp_pool);
-		dev->prp_pool = malloc(nprps << 3);
-		if (!dev->prp_pool) {
-			printf("Error: malloc prp_pool fail\n");
-			return -ENOMEM;
-		}
-		dev->prp_entry_num = nprps;
-	}
-
-	prp_pool = dev->prp_pool;
-	i = 0;
-	while (nprps) {
-		if (i == ((page_size >> 3) - 1)) {
-			*(prp_pool + i) = cpu_to_le64((ulong)prp_pool +
-					page_size);
-			i = 0;
-			prp_pool += page_size;
-		}
-		*(prp_pool + i++) = cpu_to_le64(dma_addr);
+	for (i = 0; i < nprps; i++) {
+		prp_list[i] = cpu_to_le64(dma_addr);
 		dma_addr += page_size;
-		nprps--;
 	}
-	*prp2 = (ulong)dev->prp_pool;
+	flush_dcache_range((ulong)prp_list,
+			   (ulong)(prp_list + NVME_PRP_LIST_ENTRIES));
+	*prp2 = (ulong)prp_list;
 
 	return 0;
 }
@@ -136,12 +141,12 @@ static u16 nvme_read_completion_status(struct nvme_queue *nvmeq, u16 index)
 }
 
 /**
- * nvme_submit_cmd() - copy a command into a queue and ring the doorbell
+ * nvme_queue_cmd() - copy a command into a queue without ringing the doorbell
  *
  * @nvmeq:	The queue to use
  * @cmd:	The command to send
  */
-static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+static void nvme_queue_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 {
 	u16 tail = nvmeq->sq_tail;
 
@@ -151,10 +156,107 @@ static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 
 	if (++tail == nvmeq->q_depth)
 		tail = 0;
-	writel(tail, nvmeq->q_db);
 	nvmeq->sq_tail = tail;
 }
 
+/**
+ * nvme_submit_cmd() - copy a command into a queue and ring the doorbell
+ *
+ * @nvmeq:	The queue to use
+ * @cmd:	The command to send
+ */
+static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+{
+	nvme_queue_cmd(nvmeq, cmd);
+	writel(nvmeq->sq_tail, nvmeq->q_db);
+}
+
+/**
+ * nvme_reap_completions() - consume all completions posted to an I/O queue
+ *
+ * Each completion returns its command slot to the free list. The
+ * completion queue head doorbell is written once for the whole batch.
+ *
+ * @nvmeq:	The queue to poll
+ * @err_lba:	Lowered to the first LBA of any command that failed
+ * @return number of completions consumed
+ */
+static int nvme_reap_completions(struct nvme_queue *nvmeq, u64 *err_lba)
+{
+	u16 head = nvmeq->cq_head;
+	u16 phase = nvmeq->cq_phase;
+	u16 status, cmdid, slot;
+	int count = 0;
+
+	for (;;) {
+		status = nvme_read_completion_status(nvmeq, head);
+		if ((status & 0x01) != phase)
+			break;
+
+		cmdid = readw(&nvmeq->cqes[head].command_id);
+		slot = NVME_CID_SLOT(cmdid);
+		status >>= 1;
+		if (slot < nvmeq->q_depth &&
+		    NVME_CID_GEN(cmdid) != nvmeq->slot_gen[slot]) {
+			/* the command timed out and was given up on */
+			debug("late completion, cmdid = %x\n", cmdid);
+		} else if (slot >= nvmeq->q_depth ||
+			   nvmeq->slot_lba[slot] == ~0ULL) {
+			printf("ERROR: spurious completion, cmdid = %x\n",
+			       cmdid);
+		} else {
+			if (status) {
+				printf("ERROR: status = %x, cmdid = %x\n",
+				       status, cmdid);
+				if (nvmeq->slot_lba[slot] < *err_lba)
+					*err_lba = nvmeq->slot_lba[slot];
+			}
+			nvmeq->slot_lba[slot] = ~0ULL;
+			nvmeq->free_slots[nvmeq->nr_free++] = slot;
+			nvmeq->inflight--;
+		}
+		count++;
+
+		if (++head == nvmeq->q_depth) {
+			head = 0;
+			phase = !phase;
+		}
+	}
+
+	if (count) {
+		writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
+		nvmeq->cq_head = head;
+		nvmeq->cq_phase = phase;
+	}
+
+	return count;
+}
+
+/**
+ * nvme_wait_completions() - wait until at least one I/O command completes
+ *
+ * @nvmeq:	The queue to poll
+ * @err_lba:	Lowered to the first LBA of any command that failed
+ * @timeout:	Timeout, in the same units as nvme_submit_sync_cmd()
+ * @return 0 if OK, -ETIMEDOUT on timeout
+ */
+static int nvme_wait_completions(struct nvme_queue *nvmeq, u64 *err_lba,
+				 unsigned timeout)
+{
+	ulong start_time = timer_get_us();
+	ulong timeout_us = timeout * 100000;
+
+	while (!nvme_reap_completions(nvmeq, err_lba)) {
+		if ((timer_get_us() - start_time) >= timeout_us) {
+			printf("ERROR: %d I/O commands timed out\n",
+			       nvmeq->inflight);
+			return -ETIMEDOUT;
+		}
+	}
+
+	return 0;
+}
+
 static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
 				struct nvme_command *cmd,
 				u32 *result, unsigned timeout)
@@ -216,6 +318,44 @@ static int nvme_submit_admin_cmd(struct nvme_dev *dev, struct nvme_command *cmd,
 				    result, ADMIN_TIMEOUT);
 }
 
+/**
+ * nvme_retire_inflight() - give up on the I/O commands still in flight
+ *
+ * Each command is aborted and its slot is freed with a new generation, so
+ * that a completion which still arrives for it is ignored. The commands
+ * count as failed and @err_lba is lowered accordingly.
+ *
+ * @nvmeq:	The I/O queue
+ * @err_lba:	Lowered to the first LBA of the commands retired
+ */
+static void nvme_retire_inflight(struct nvme_queue *nvmeq, u64 *err_lba)
+{
+	struct nvme_command c;
+	bool abort = true;
+	int i;
+
+	memset(&c, 0, sizeof(c));
+	c.abort.opcode = nvme_admin_abort_cmd;
+	c.abort.sqid = cpu_to_le16(nvmeq->qid);
+	for (i = 0; i < nvmeq->q_depth; i++) {
+		if (nvmeq->slot_lba[i] == ~0ULL)
+			continue;
+		if (nvmeq->slot_lba[i] < *err_lba)
+			*err_lba = nvmeq->slot_lba[i];
+
+		/* Stop asking once the controller fails to answer */
+		c.abort.cid = NVME_CID(i, nvmeq->slot_gen[i]);
+		if (abort && nvme_submit_admin_cmd(nvmeq->dev, &c, NULL) ==
+		    -ETIMEDOUT)
+			abort = false;
+
+		nvmeq->slot_gen[i]++;
+		nvmeq->slot_lba[i] = ~0ULL;
+		nvmeq->free_slots[nvmeq->nr_free++] = i;
+		nvmeq->inflight--;
+	}
+}
+
 static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev,
 					   int qid, int depth)
 {
@@ -234,6 +374,17 @@ static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev,
 		goto free_queue;
 	memset((void *)nvmeq->sq_cmds, 0, NVME_SQ_SIZE(depth));
 
+	if (qid != NVME_ADMIN_Q) {
+		nvmeq->free_slots = malloc(depth * sizeof(u16));
+		nvmeq->slot_lba = malloc(depth * sizeof(u64));
+		nvmeq->slot_gen = calloc(depth, sizeof(u8));
+		nvmeq->prp_lists = memalign(4096, depth * sizeof(u64) *
+					    NVME_PRP_LIST_ENTRIES);
+		if (!nvmeq->free_slots || !nvmeq->slot_lba ||
+		    !nvmeq->slot_gen || !nvmeq->prp_lists)
+			goto free_slots;
+	}
+
 	nvmeq->dev = dev;
 
 	nvmeq->cq_head = 0;
@@ -246,6 +397,12 @@ static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev,
 
 	return nvmeq;
 
+ free_slots:
+	free(nvmeq->free_slots);
+	free(nvmeq->slot_lba);
+	free(nvmeq->slot_gen);
+	free(nvmeq->prp_lists);
+	free(nvmeq->sq_cmds);
  free_queue:
 	free((void *)nvmeq->cqes);
  free_nvmeq:
@@ -295,6 +452,10 @@ static int nvme_disable_ctrl(struct nvme_dev *dev)
 
 static void nvme_free_queue(struct nvme_queue *nvmeq)
 {
+	free(nvmeq->free_slots);
+	free(nvmeq->slot_lba);
+	free(nvmeq->slot_gen);
+	free(nvmeq->prp_lists);
 	free((void *)nvmeq->cqes);
 	free(nvmeq->sq_cmds);
 	free(nvmeq);
@@ -315,11 +476,21 @@ static void nvme_free_queues(struct nvme_dev *dev, int lowest)
 static void nvme_init_queue(struct nvme_queue *nvmeq, u16 qid)
 {
 	struct nvme_dev *dev = nvmeq->dev;
+	int i;
 
 	nvmeq->sq_tail = 0;
 	nvmeq->cq_head = 0;
 	nvmeq->cq_phase = 1;
 	nvmeq->q_db = &dev->dbs[qid * 2 * dev->db_stride];
+	if (nvmeq->free_slots) {
+		/* one entry is always left empty to tell a full queue */
+		nvmeq->inflight = 0;
+		nvmeq->nr_free = nvmeq->q_depth - 1;
+		for (i = 0; i < nvmeq->q_depth; i++) {
+			nvmeq->free_slots[i] = nvmeq->q_depth - 1 - i;
+			nvmeq->slot_lba[i] = ~0ULL;
+		}
+	}
 	memset((void *)nvmeq->cqes, 0, NVME_CQ_SIZE(nvmeq->q_depth));
 	flush_dcache_range((ulong)nvmeq->cqes,
 			   (ulong)nvmeq->cqes + NVME_CQ_SIZE(nvmeq->q_depth));
@@ -668,65 +839,95 @@ static int nvme_blk_probe(struct udevice *udev)
 	return 0;
 }
 
+/**
+ * nvme_blk_rw() - read or write blocks
+ *
+ * The request is split into commands of at most NVME_PRP_LIST_ENTRIES
+ * pages (or the controller's MDTS, if smaller). As many commands as there
+ * are free slots are queued before the doorbell is rung, then all posted
+ * completions are reaped in one go, so that up to q_depth - 1 commands
+ * are kept in flight until the request is done.
+ *
+ * @return number of blocks transferred before the first failed command
+ */
 static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 			 lbaint_t blkcnt, void *buffer, bool read)
 {
 	struct nvme_ns *ns = dev_get_priv(udev);
 	struct nvme_dev *dev = ns->dev;
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
 	struct nvme_command c;
 	struct blk_desc *desc = dev_get_uclass_platdata(udev);
-	int status;
-	u64 prp2;
 	u64 total_len = blkcnt << desc->log2blksz;
-	u64 temp_len = total_len;
-
 	u64 slba = blknr;
-	u16 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
-	u64 total_lbas = blkcnt;
+	u64 end = blknr + blkcnt;
+	u64 err_lba = end;
+	void *buf = buffer;
+	u32 max_len, lbas;
+	int queued;
+	u16 cmdid;
+	u64 *prp_list;
+	u64 prp2;
+
+	max_len = min_t(u64, 1ULL << dev->max_transfer_shift,
+			NVME_PRP_LIST_ENTRIES * dev->page_size);
 
 	if (!read)
 		flush_dcache_range((unsigned long)buffer,
 				   (unsigned long)buffer + total_len);
 
+	memset(&c, 0, sizeof(c));
 	c.rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
-	c.rw.flags = 0;
 	c.rw.nsid = cpu_to_le32(ns->ns_id);
-	c.rw.control = 0;
-	c.rw.dsmgmt = 0;
-	c.rw.reftag = 0;
-	c.rw.apptag = 0;
-	c.rw.appmask = 0;
-	c.rw.metadata = 0;
-
-	while (total_lbas) {
-		if (total_lbas < lbas) {
-			lbas = (u16)total_lbas;
-			total_lbas = 0;
-		} else {
-			total_lbas -= lbas;
+
+	for (;;) {
+		queued = 0;
+		while (slba < end && err_lba == end && nvmeq->nr_free) {
+			lbas = min_t(u64, max_len >> ns->lba_shift, end - slba);
+			cmdid = nvmeq->free_slots[nvmeq->nr_free - 1];
+			prp_list = nvmeq->prp_lists +
+				   cmdid * NVME_PRP_LIST_ENTRIES;
+			if (nvme_setup_prps(dev, prp_list, &prp2,
+					    lbas << ns->lba_shift,
+					    (ulong)buf)) {
+				err_lba = slba;
+				break;
+			}
+
+			nvmeq->nr_free--;
+			nvmeq->inflight++;
+			nvmeq->slot_lba[cmdid] = slba;
+
+			c.rw.command_id = NVME_CID(cmdid,
+						   nvmeq->slot_gen[cmdid]);
+			c.rw.slba = cpu_to_le64(slba);
+			c.rw.length = cpu_to_le16(lbas - 1);
+			c.rw.prp1 = cpu_to_le64((ulong)buf);
+			c.rw.prp2 = cpu_to_le64(prp2);
+			nvme_queue_cmd(nvmeq, &c);
+			queued++;
+
+			slba += lbas;
+			buf += lbas << ns->lba_shift;
 		}
 
-		if (nvme_setup_prps(dev, &prp2,
-				    lbas << ns->lba_shift, (ulong)buffer))
-			return -EIO;
-		c.rw.slba = cpu_to_le64(slba);
-		slba += lbas;
-		c.rw.length = cpu_to_le16(lbas - 1);
-		c.rw.prp1 = cpu_to_le64((ulong)buffer);
-		c.rw.prp2 = cpu_to_le64(prp2);
-		status = nvme_submit_sync_cmd(dev->queues[NVME_IO_Q],
-				&c, NULL, IO_TIMEOUT);
-		if (status)
+		if (queued)
+			writel(nvmeq->sq_tail, nvmeq->q_db);
+
+		if (!nvmeq->inflight)
+			break;
+
+		if (nvme_wait_completions(nvmeq, &err_lba, IO_TIMEOUT)) {
+			nvme_retire_inflight(nvmeq, &err_lba);
 			break;
-		temp_len -= (u32)lbas << ns->lba_shift;
-		buffer += lbas << ns->lba_shift;
+		}
 	}
 
 	if (read)
 		invalidate_dcache_range((unsigned long)buffer,
 					(unsigned long)buffer + total_len);
 
-	return (total_len - temp_len) >> desc->log2blksz;
+	return err_lba - blknr;
 }
 
 static ulong nvme_blk_read(struct udevice *udev, lbaint_t blknr,
@@ -788,14 +989,6 @@ static int nvme_probe(struct udevice *udev)
 	}
 	memset(ndev->queues, 0, NVME_Q_NUM * sizeof(struct nvme_queue *));
 
-	ndev->prp_pool = malloc(MAX_PRP_POOL);
-	if (!ndev->prp_pool) {
-		ret = -ENOMEM;
-		printf("Error: %s: Out of memory!\n", udev->name);
-		goto free_nvme;
-	}
-	ndev->prp_entry_num = MAX_PRP_POOL >> 3;
-
 	ndev->cap = nvme_readq(&ndev->bar->cap);
 	ndev->q_depth = min_t(int, NVME_CAP_MQES(ndev->cap) + 1, NVME_Q_DEPTH);
 	ndev->db_stride = 1 << NVME_CAP_STRIDE(ndev->cap);
@@ -12,46 +12,141 @@
 #include <virtio_ring.h>
 #include "virtio_blk.h"
 
+/* Most requests kept in flight at once */
+#define VIRTIO_BLK_MAX_REQS	16
+/* Most data segments in a request */
+#define VIRTIO_BLK_MAX_SEGS	64
+
+struct virtio_blk_req {
+	struct virtio_blk_outhdr out_hdr;
+	u64 sector;
+	u8 status;
+	bool busy;
+};
+
 struct virtio_blk_priv {
 	struct virtqueue *vq;
+	/* maximum bytes in a data segment, 0 if unlimited */
+	u32 size_max;
+	/* maximum data segments in a request */
+	u32 seg_max;
+	/* maximum data bytes in a request, a multiple of 512, 0 if unlimited */
+	ulong req_max;
+	struct virtio_blk_req reqs[VIRTIO_BLK_MAX_REQS];
 };
 
+static const u32 feature[] = {
+	VIRTIO_BLK_F_SIZE_MAX,
+	VIRTIO_BLK_F_SEG_MAX,
+};
+
+static struct virtio_blk_req *virtio_blk_get_req(struct virtio_blk_priv *priv)
+{
+	int i;
+
+	for (i = 0; i < VIRTIO_BLK_MAX_REQS; i++)
+		if (!priv->reqs[i].busy)
+			return &priv->reqs[i];
+
+	return NULL;
+}
+
+/*
+ * The transfer is split into requests of at most seg_max segments of
+ * size_max bytes. All the requests that fit in the ring are added before
+ * the device is notified, and all the used buffers are reaped in one go,
+ * so that the device always has more work queued while we poll.
+ */
 static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
 			       lbaint_t blkcnt, void *buffer, u32 type)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
-	unsigned int num_out = 0, num_in = 0;
-	struct virtio_sg *sgs[3];
-	u8 status;
+	struct virtio_sg sg[VIRTIO_BLK_MAX_SEGS + 2];
+	struct virtio_sg *sgs[VIRTIO_BLK_MAX_SEGS + 2];
+	unsigned int num_out, num_in, n, inflight = 0, queued;
+	struct virtio_blk_req *req;
+	u64 start = sector, end = sector + blkcnt;
+	u64 err_sector = end;
+	ulong len, left, seg_len;
+	void *data;
 	int ret;
 
-	struct virtio_blk_outhdr out_hdr = {
-		.type = cpu_to_virtio32(dev, type),
-		.sector = cpu_to_virtio64(dev, sector),
-	};
-	struct virtio_sg hdr_sg = { &out_hdr, sizeof(out_hdr) };
-	struct virtio_sg data_sg = { buffer, blkcnt * 512 };
-	struct virtio_sg status_sg = { &status, sizeof(status) };
+	for (n = 0; n < ARRAY_SIZE(sgs); n++)
+		sgs[n] = &sg[n];
 
-	sgs[num_out++] = &hdr_sg;
+	for (;;) {
+		queued = 0;
+		while (sector < end && err_sector == end) {
+			req = virtio_blk_get_req(priv);
+			if (!req)
+				break;
 
-	if (type & VIRTIO_BLK_T_OUT)
-		sgs[num_out++] = &data_sg;
-	else
-		sgs[num_out + num_in++] = &data_sg;
+			req->out_hdr.type = cpu_to_virtio32(dev, type);
+			req->out_hdr.sector = cpu_to_virtio64(dev, sector);
+			sg[0].addr = &req->out_hdr;
+			sg[0].length = sizeof(req->out_hdr);
 
-	sgs[num_out + num_in++] = &status_sg;
+			len = (end - sector) * 512;
+			if (priv->req_max && len > priv->req_max)
+				len = priv->req_max;
+			data = buffer + (sector - start) * 512;
+			for (n = 1, left = len; left; n++) {
+				seg_len = left;
+				if (priv->size_max && seg_len > priv->size_max)
+					seg_len = priv->size_max;
+				sg[n].addr = data;
+				sg[n].length = seg_len;
+				data += seg_len;
+				left -= seg_len;
+			}
 
-	ret = virtqueue_add(priv->vq, sgs, num_out, num_in);
-	if (ret)
-		return ret;
+			sg[n].addr = &req->status;
+			sg[n].length = sizeof(req->status);
+
+			if (type & VIRTIO_BLK_T_OUT) {
+				num_out = n;
+				num_in = 1;
+			} else {
+				num_out = 1;
+				num_in = n;
+			}
+
+			ret = virtqueue_add(priv->vq, sgs, num_out, num_in);
+			if (ret) {
+				/* retry once the ring has drained */
+				if (inflight)
+					break;
+				err_sector = sector;
+				break;
+			}
+
+			req->sector = sector;
+			req->busy = true;
+			inflight++;
+			queued++;
+			sector += len / 512;
+		}
 
-	virtqueue_kick(priv->vq);
+		if (queued)
+			virtqueue_kick(priv->vq);
 
-	while (!virtqueue_get_buf(priv->vq, NULL))
-		;
+		if (!inflight)
+			break;
 
-	return status == VIRTIO_BLK_S_OK ? blkcnt : -EIO;
+		while (!(req = virtqueue_get_buf(priv->vq, NULL)))
+			;
+		do {
+			req = container_of((void *)req,
+					   struct virtio_blk_req, out_hdr);
+			if (req->status != VIRTIO_BLK_S_OK &&
+			    req->sector < err_sector)
+				err_sector = req->sector;
+			req->busy = false;
+			inflight--;
+		} while ((req = virtqueue_get_buf(priv->vq, NULL)));
+	}
+
+	return err_sector == end ? blkcnt : err_sector - start;
 }
 
 static ulong virtio_blk_read(struct udevice *dev, lbaint_t start,
@@ -97,7 +192,8 @@ static int virtio_blk_bind(struct udevice *dev)
 	desc->bdev = dev;
 
 	/* Indicate what driver features we support */
-	virtio_driver_features_init(uc_priv, NULL, 0, NULL, 0);
+	virtio_driver_features_init(uc_priv, feature, ARRAY_SIZE(feature),
+				    NULL, 0);
 
 	return 0;
 }
@@ -106,6 +202,7 @@ static int virtio_blk_probe(struct udevice *dev)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
 	struct blk_desc *desc = dev_get_uclass_platdata(dev);
+	unsigned int max_segs;
 	u64 cap;
 	int ret;
 
@@ -117,6 +214,38 @@ static int virtio_blk_probe(struct udevice *dev)
 	virtio_cread(dev, struct virtio_blk_config, capacity, &cap);
 	desc->lba = cap;
 
+	/*
+	 * Without indirect descriptors, the header and status buffers
+	 * take a descriptor each out of the ring too.
+	 */
+	max_segs = VIRTIO_BLK_MAX_SEGS;
+	if (!virtio_has_feature(dev, VIRTIO_RING_F_INDIRECT_DESC))
+		max_segs = min(max(virtqueue_get_vring_size(priv->vq), 3U) - 2,
+			       max_segs);
+
+	ret = virtio_cread_feature(dev, VIRTIO_BLK_F_SEG_MAX,
+				   struct virtio_blk_config, seg_max,
+				   &priv->seg_max);
+	if (ret || !priv->seg_max)
+		priv->seg_max = 1;
+	else if (priv->seg_max > max_segs)
+		priv->seg_max = max_segs;
+
+	ret = virtio_cread_feature(dev, VIRTIO_BLK_F_SIZE_MAX,
+				   struct virtio_blk_config, size_max,
+				   &priv->size_max);
+	if (ret || !priv->size_max) {
+		/* a single segment can hold the whole transfer */
+		priv->size_max = 0;
+		priv->req_max = 0;
+	} else {
+		/* segments may split a sector, but requests may not */
+		priv->req_max = rounddown((ulong)priv->seg_max *
+					  priv->size_max, 512);
+		if (!priv->req_max)
+			return -EINVAL;
+	}
+
 	return 0;
 }
 
@@ -15,6 +15,9 @@
 /* Amount of buffers to keep in the RX virtqueue */
 #define VIRTIO_NET_NUM_RX_BUFS	32
 
+/* Amount of RX buffers given back to the device before notifying it */
+#define VIRTIO_NET_RX_BATCH	8
+
 /*
  * This value comes from the VirtIO spec: 1500 for maximum packet size,
  * 14 for the Ethernet header, 12 for virtio_net_hdr. In total 1526 bytes.
@@ -32,6 +35,7 @@ struct virtio_net_priv {
 
 	char rx_buff[VIRTIO_NET_NUM_RX_BUFS][VIRTIO_NET_RX_BUF_SIZE];
 	bool rx_running;
+	int rx_refill;
 	int net_hdr_len;
 };
 
@@ -130,6 +134,17 @@ static int virtio_net_free_pkt(struct udevice *dev, uchar *packet, int length)
 	/* Put the buffer back to the rx ring */
 	virtqueue_add(priv->rx_vq, sgs, 0, 1);
 
+	/*
+	 * The device only needs to hear about returned buffers when it ran
+	 * out of them, so let a batch build up before notifying it. With
+	 * VIRTIO_RING_F_EVENT_IDX the kick itself is skipped when the device
+	 * did not ask for one.
+	 */
+	if (++priv->rx_refill >= VIRTIO_NET_RX_BATCH) {
+		virtqueue_kick(priv->rx_vq);
+		priv->rx_refill = 0;
+	}
+
 	return 0;
 }
 
@@ -10,8 +10,21 @@
 #include <virtio_types.h>
 #include <virtio.h>
 #include <virtio_ring.h>
+#include <asm/test.h>
 #include <linux/compat.h>
 #include <linux/io.h>
+#include "virtio_blk.h"
+
+/* Number of virtqueues the device model keeps track of */
+#define SANDBOX_VIRTIO_MAX_VQS		2
+
+/*
+ * The virtio-blk device model is a small RAM disk. Its segment limits are
+ * small so that a modest transfer is split into several requests.
+ */
+#define SANDBOX_VIRTIO_BLK_SECTORS	64
+#define SANDBOX_VIRTIO_BLK_SIZE_MAX	1024
+#define SANDBOX_VIRTIO_BLK_SEG_MAX	4
 
 struct virtio_sandbox_priv {
 	u8 id;
@@ -21,11 +34,25 @@ struct virtio_sandbox_priv {
 	ulong queue_desc;
 	ulong queue_available;
 	ulong queue_used;
+	u16 last_avail_idx[SANDBOX_VIRTIO_MAX_VQS];
+	struct sandbox_virtio_stats stats;
+	u8 disk[SANDBOX_VIRTIO_BLK_SECTORS * 512];
 };
 
 static int virtio_sandbox_get_config(struct udevice *udev, unsigned int offset,
 				     void *buf, unsigned int len)
 {
+	struct virtio_dev_priv *uc_priv = dev_get_uclass_priv(udev);
+	struct virtio_blk_config config = {
+		.capacity = SANDBOX_VIRTIO_BLK_SECTORS,
+		.size_max = SANDBOX_VIRTIO_BLK_SIZE_MAX,
+		.seg_max = SANDBOX_VIRTIO_BLK_SEG_MAX,
+	};
+
+	if (uc_priv->device == VIRTIO_ID_BLOCK &&
+	    offset + len <= sizeof(config))
+		memcpy(buf, (u8 *)&config + offset, len);
+
 	return 0;
 }
 
@@ -100,6 +127,9 @@ static struct virtqueue *virtio_sandbox_setup_vq(struct udevice *udev,
 		goto error_new_virtqueue;
 	}
 
+	if (index < SANDBOX_VIRTIO_MAX_VQS)
+		priv->last_avail_idx[index] = 0;
+
 	addr = virtqueue_get_desc_addr(vq);
 	priv->queue_desc = addr;
 
@@ -147,11 +177,121 @@ static int virtio_sandbox_find_vqs(struct udevice *udev, unsigned int nvqs,
 	return 0;
 }
 
+/*
+ * Handle one virtio-blk request, made of a header, data buffers and a
+ * status byte, in either the ring or an indirect descriptor table.
+ *
+ * @return number of bytes written to the request's buffers
+ */
+static u32 virtio_sandbox_blk_req(struct virtio_sandbox_priv *priv,
+				  struct virtqueue *vq, u16 head)
+{
+	struct udevice *vdev = vq->vdev;
+	struct vring_desc *desc = vq->vring.desc;
+	struct virtio_blk_outhdr *hdr = NULL;
+	u8 result = VIRTIO_BLK_S_OK;
+	u32 len, type = 0, written = 0;
+	u64 offset = 0;
+	u16 flags, i = head;
+	void *addr;
+
+	if (desc[i].flags & cpu_to_virtio16(vdev, VRING_DESC_F_INDIRECT)) {
+		priv->stats.indirect++;
+		desc = (void *)(uintptr_t)virtio64_to_cpu(vdev, desc[i].addr);
+		i = 0;
+	}
+
+	for (;;) {
+		addr = (void *)(uintptr_t)virtio64_to_cpu(vdev, desc[i].addr);
+		len = virtio32_to_cpu(vdev, desc[i].len);
+		flags = virtio16_to_cpu(vdev, desc[i].flags);
+
+		if (!hdr) {
+			hdr = addr;
+			type = virtio32_to_cpu(vdev, hdr->type);
+			offset = virtio64_to_cpu(vdev, hdr->sector) * 512;
+		} else if (!(flags & VRING_DESC_F_NEXT)) {
+			*(u8 *)addr = result;
+			written++;
+			break;
+		} else if (offset + len > sizeof(priv->disk)) {
+			result = VIRTIO_BLK_S_IOERR;
+		} else if (type == VIRTIO_BLK_T_IN) {
+			memcpy(addr, priv->disk + offset, len);
+			written += len;
+			offset += len;
+		} else if (type == VIRTIO_BLK_T_OUT) {
+			memcpy(priv->disk + offset, addr, len);
+			offset += len;
+		} else {
+			result = VIRTIO_BLK_S_UNSUPP;
+		}
+
+		if (!(flags & VRING_DESC_F_NEXT))
+			break;
+		i = virtio16_to_cpu(vdev, desc[i].next);
+	}
+
+	return written;
+}
+
 static int virtio_sandbox_notify(struct udevice *udev, struct virtqueue *vq)
 {
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
+	struct virtio_dev_priv *uc_priv = dev_get_uclass_priv(udev);
+	struct udevice *vdev = vq->vdev;
+	struct vring *vring = &vq->vring;
+	struct vring_used_elem *used;
+	u16 *last_avail_idx;
+	u16 avail, used_idx, head;
+	uint batch = 0;
+
+	priv->stats.kicks++;
+	if (uc_priv->device != VIRTIO_ID_BLOCK ||
+	    vq->index >= SANDBOX_VIRTIO_MAX_VQS)
+		return 0;
+
+	/* Consume everything made available so far, like a real device */
+	last_avail_idx = &priv->last_avail_idx[vq->index];
+	while (*last_avail_idx != virtio16_to_cpu(vdev, vring->avail->idx)) {
+		avail = *last_avail_idx & (vring->num - 1);
+		head = virtio16_to_cpu(vdev, vring->avail->ring[avail]);
+		used_idx = virtio16_to_cpu(vdev, vring->used->idx);
+		used = &vring->used->ring[used_idx & (vring->num - 1)];
+		used->len = cpu_to_virtio32(vdev,
+					    virtio_sandbox_blk_req(priv, vq,
+								   head));
+		used->id = cpu_to_virtio32(vdev, head);
+		vring->used->idx = cpu_to_virtio16(vdev, used_idx + 1);
+		(*last_avail_idx)++;
+		batch++;
+	}
+
+	/* With VIRTIO_RING_F_EVENT_IDX, ask for a kick on the next buffer */
+	vring_avail_event(vring) = cpu_to_virtio16(vdev, *last_avail_idx);
+
+	priv->stats.chains += batch;
+	priv->stats.max_batch = max(priv->stats.max_batch, batch);
+
 	return 0;
 }
 
+void sandbox_virtio_set_features(struct udevice *udev, u64 features)
+{
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
+
+	priv->device_features = features;
+}
+
+void sandbox_virtio_get_stats(struct udevice *udev,
+			      struct sandbox_virtio_stats *stats)
+{
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
+
+	*stats = priv->stats;
+	memset(&priv->stats, 0, sizeof(priv->stats));
+}
+
 static int virtio_sandbox_probe(struct udevice *udev)
 {
 	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
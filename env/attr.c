@@ -122,41 +122,47 @@ static int regex_callback(const char *name, const char *attributes, void *priv)
 	struct regex_callback_priv *cbp = (struct regex_callback_priv *)priv;
 	struct slre slre;
 	char regex[strlen(name) + 3];
+	int match;
 
 	/* Require the whole string to be described by the regex */
 	sprintf(regex, "^%s$", name);
-	if (slre_compile(&slre, regex)) {
+	if (!strpbrk(name, "\\^$.[]|()?*+{}")) {
+		/* Without special characters, a name only matches itself */
+		match = !strcmp(name, cbp->searched_for);
+	} else if (slre_compile(&slre, regex)) {
 		struct cap caps[slre.num_caps + 2];
 
-		if (slre_match(&slre, cbp->searched_for,
-			       strlen(cbp->searched_for), caps)) {
-			free(cbp->regex);
-			if (!attributes) {
-				retval = -EINVAL;
-				goto done;
-			}
-			cbp->regex = malloc(strlen(regex) + 1);
-			if (cbp->regex) {
-				strcpy(cbp->regex, regex);
-			} else {
-				retval = -ENOMEM;
-				goto done;
-			}
-
-			free(cbp->attributes);
-			cbp->attributes = malloc(strlen(attributes) + 1);
-			if (cbp->attributes) {
-				strcpy(cbp->attributes, attributes);
-			} else {
-				retval = -ENOMEM;
-				free(cbp->regex);
-				cbp->regex = NULL;
-				goto done;
-			}
-		}
+		match = slre_match(&slre, cbp->searched_for,
+				   strlen(cbp->searched_for), caps);
 	} else {
 		printf("Error compiling regex: %s\n", slre.err_str);
-		retval = -EINVAL;
+		return -EINVAL;
+	}
+
+	if (match) {
+		free(cbp->regex);
+		if (!attributes) {
+			retval = -EINVAL;
+			goto done;
+		}
+		cbp->regex = malloc(strlen(regex) + 1);
+		if (cbp->regex) {
+			strcpy(cbp->regex, regex);
+		} else {
+			retval = -ENOMEM;
+			goto done;
+		}
+
+		free(cbp->attributes);
+		cbp->attributes = malloc(strlen(attributes) + 1);
+		if (cbp->attributes) {
+			strcpy(cbp->attributes, attributes);
+		} else {
+			retval = -ENOMEM;
+			free(cbp->regex);
+			cbp->regex = NULL;
+			goto done;
+		}
 	}
 done:
 	return retval;
@@ -199,6 +199,9 @@ void put_ext4(uint64_t off, void *buf, uint32_t size)
 	int log2blksz = fs->dev_desc->log2blksz;
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, sec_buf, fs->dev_desc->blksz);
 
+	/* Extent trees read so far may be about to change */
+	ext4fs_extent_cache_invalidate();
+
 	startblock = off >> log2blksz;
 	startblock += part_offset;
 	remainder = off & (uint64_t)(fs->dev_desc->blksz - 1);
@@ -1521,43 +1524,204 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 
 #endif
 
-static struct ext4_extent_header *ext4fs_get_extent_block
-	(struct ext2_data *data, char *buf,
-		struct ext4_extent_header *ext_block,
-		uint32_t fileblock, int log2_blksz)
+/*
+ * Extent cache
+ *
+ * The extent tree of a file is walked once and kept as a sorted list of
+ * runs, each mapping contiguous file blocks to contiguous filesystem blocks,
+ * so that looking up a block needs no device reads. Trees held entirely in
+ * the inode are used directly. The lists of the files read last are kept
+ * until the filesystem is written to. An entry is only reused for the same
+ * device, partition, filesystem and inode contents, and only if nothing has
+ * been written to the device since, e.g. with "mmc write".
+ */
+struct ext4_extent_run {
+	uint32_t block;		/* First file block of the run */
+	uint32_t len;		/* Number of blocks in the run */
+	uint64_t start;		/* First filesystem block of the run */
+};
+
+struct ext4_extent_map {
+	struct blk_desc *dev;
+	unsigned long write_count;
+	lbaint_t part_start;
+	__le32 uuid[4];
+	__le32 size, mtime, ctime;
+	__le32 root[15];	/* The root of the tree, from the inode */
+	int nr_runs;
+	int last;		/* Run found by the last lookup */
+	struct ext4_extent_run *runs;
+};
+
+static struct ext4_extent_map ext4_extent_cache[CONFIG_FS_EXT4_EXTENT_CACHE];
+static int ext4_extent_victim;
+
+void ext4fs_extent_cache_invalidate(void)
 {
-	struct ext4_extent_idx *index;
-	unsigned long long block;
-	int blksz = EXT2_BLOCK_SIZE(data);
 	int i;
 
-	while (1) {
-		index = (struct ext4_extent_idx *)(ext_block + 1);
+	for (i = 0; i < ARRAY_SIZE(ext4_extent_cache); i++) {
+		free(ext4_extent_cache[i].runs);
+		memset(&ext4_extent_cache[i], 0, sizeof(ext4_extent_cache[i]));
+	}
+}
 
-		if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC)
-			return NULL;
+static int ext4fs_add_extent(struct ext4_extent_map *map, int *alloc,
+			     struct ext4_extent *extent)
+{
+	struct ext4_extent_run *run, *tmp;
+	uint64_t start;
 
-		if (ext_block->eh_depth == 0)
-			return ext_block;
-		i = -1;
-		do {
-			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
-				break;
-		} while (fileblock >= le32_to_cpu(index[i].ei_block));
+	start = le16_to_cpu(extent->ee_start_hi);
+	start = (start << 32) + le32_to_cpu(extent->ee_start_lo);
 
-		if (--i < 0)
-			return NULL;
+	/* Merge with the previous run if contiguous on both sides */
+	run = map->nr_runs ? &map->runs[map->nr_runs - 1] : NULL;
+	if (run && run->block + run->len == le32_to_cpu(extent->ee_block) &&
+	    run->start + run->len == start) {
+		run->len += le16_to_cpu(extent->ee_len);
+		return 0;
+	}
 
+	if (map->nr_runs == *alloc) {
+		*alloc = *alloc ? *alloc * 2 : 16;
+		tmp = realloc(map->runs, *alloc * sizeof(*map->runs));
+		if (!tmp)
+			return -ENOMEM;
+		map->runs = tmp;
+	}
+	run = &map->runs[map->nr_runs++];
+	run->block = le32_to_cpu(extent->ee_block);
+	run->len = le16_to_cpu(extent->ee_len);
+	run->start = start;
+
+	return 0;
+}
+
+/*
+ * Add the extents of the (sub)tree at 'hdr', which is 'size' bytes long, to
+ * 'map' in file block order
+ */
+static int ext4fs_walk_extents(struct ext4_extent_map *map, int *alloc,
+			       struct ext4_extent_header *hdr, int size)
+{
+	int blksz = EXT2_BLOCK_SIZE(ext4fs_root);
+	int log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root) -
+			 get_fs()->dev_desc->log2blksz;
+	int entries = le16_to_cpu(hdr->eh_entries);
+	struct ext4_extent_idx *index;
+	unsigned long long block;
+	char *buf;
+	int i, ret = 0;
+
+	if (le16_to_cpu(hdr->eh_magic) != EXT4_EXT_MAGIC ||
+	    (entries + 1) * sizeof(*index) > size)
+		return -EINVAL;
+
+	if (hdr->eh_depth == 0) {
+		for (i = 0; i < entries && !ret; i++)
+			ret = ext4fs_add_extent(map, alloc,
+					(struct ext4_extent *)(hdr + 1) + i);
+		return ret;
+	}
+
+	buf = malloc(blksz);
+	if (!buf)
+		return -ENOMEM;
+	index = (struct ext4_extent_idx *)(hdr + 1);
+	for (i = 0; i < entries && !ret; i++) {
 		block = le16_to_cpu(index[i].ei_leaf_hi);
 		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
-
-		if (ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
-				   buf))
-			ext_block = (struct ext4_extent_header *)buf;
+		if (!ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
+				    buf))
+			ret = -EIO;
+		else if (((struct ext4_extent_header *)buf)->eh_depth !=
+			 cpu_to_le16(le16_to_cpu(hdr->eh_depth) - 1))
+			ret = -EINVAL;
 		else
-			return NULL;
+			ret = ext4fs_walk_extents(map, alloc,
+					(struct ext4_extent_header *)buf,
+					blksz);
+	}
+	free(buf);
+
+	return ret;
+}
+
+static struct ext4_extent_map *ext4fs_get_extents(struct ext2_inode *inode)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext4_extent_map *map;
+	int i, alloc = 0;
+
+	for (i = 0; i < ARRAY_SIZE(ext4_extent_cache); i++) {
+		map = &ext4_extent_cache[i];
+		if (map->runs && map->dev == fs->dev_desc &&
+		    map->write_count == fs->dev_desc->write_count &&
+		    map->part_start == part_offset &&
+		    !memcmp(map->uuid, ext4fs_root->sblock.unique_id,
+			    sizeof(map->uuid)) &&
+		    map->size == inode->size && map->mtime == inode->mtime &&
+		    map->ctime == inode->ctime &&
+		    !memcmp(map->root, &inode->b, sizeof(map->root)))
+			return map;
+	}
+
+	map = &ext4_extent_cache[ext4_extent_victim];
+	ext4_extent_victim = (ext4_extent_victim + 1) %
+			     ARRAY_SIZE(ext4_extent_cache);
+
+	free(map->runs);
+	memset(map, 0, sizeof(*map));
+	if (ext4fs_walk_extents(map, &alloc,
+				(struct ext4_extent_header *)&inode->b,
+				sizeof(inode->b)) || !map->runs) {
+		free(map->runs);
+		memset(map, 0, sizeof(*map));
+		return NULL;
+	}
+	debug("EXT4: %d extent runs\n", map->nr_runs);
+
+	map->dev = fs->dev_desc;
+	map->write_count = fs->dev_desc->write_count;
+	map->part_start = part_offset;
+	memcpy(map->uuid, ext4fs_root->sblock.unique_id, sizeof(map->uuid));
+	map->size = inode->size;
+	map->mtime = inode->mtime;
+	map->ctime = inode->ctime;
+	memcpy(map->root, &inode->b, sizeof(map->root));
+
+	return map;
+}
+
+/* Return the filesystem block of 'fileblock', or 0 if it is not mapped */
+static long int ext4fs_map_lookup(struct ext4_extent_map *map,
+				  uint32_t fileblock)
+{
+	struct ext4_extent_run *run = &map->runs[map->last];
+	int lo = 0, hi = map->nr_runs, mid;
+
+	/* Reads are mostly sequential, so try the last run and the next */
+	if (fileblock >= run->block && map->last + 1 < map->nr_runs &&
+	    fileblock >= run[1].block)
+		run++;
+	if (fileblock < run->block || fileblock - run->block >= run->len) {
+		while (lo < hi) {
+			mid = (lo + hi) / 2;
+			if (fileblock < map->runs[mid].block)
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		if (!lo)
+			return 0;
+		run = &map->runs[lo - 1];
+		if (fileblock - run->block >= run->len)
+			return 0;
 	}
+	map->last = run - map->runs;
+
+	return run->start + fileblock - run->block;
 }
 
 static int ext4fs_blockgroup
@@ -1629,24 +1793,28 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 		- get_fs()->dev_desc->log2blksz;
 
 	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		long int startblock, endblock;
-		char *buf = zalloc(blksz);
-		if (!buf)
-			return -ENOMEM;
 		struct ext4_extent_header *ext_block;
 		struct ext4_extent *extent;
+		struct ext4_extent_map *map;
+		long int startblock, endblock;
 		int i;
-		ext_block =
-			ext4fs_get_extent_block(ext4fs_root, buf,
-						(struct ext4_extent_header *)
-						inode->b.blocks.dir_blocks,
-						fileblock, log2_blksz);
-		if (!ext_block) {
+
+		ext_block = (struct ext4_extent_header *)&inode->b;
+		if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC) {
 			printf("invalid extent block\n");
-			free(buf);
 			return -EINVAL;
 		}
 
+		if (ext_block->eh_depth) {
+			map = ext4fs_get_extents(inode);
+			if (!map) {
+				printf("invalid extent block\n");
+				return -EINVAL;
+			}
+
+			return ext4fs_map_lookup(map, fileblock);
+		}
+
 		extent = (struct ext4_extent *)(ext_block + 1);
 
 		for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
@@ -1655,19 +1823,16 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 
 			if (startblock > fileblock) {
 				/* Sparse file */
-				free(buf);
 				return 0;
 
 			} else if (fileblock < endblock) {
 				start = le16_to_cpu(extent[i].ee_start_hi);
 				start = (start << 32) +
 					le32_to_cpu(extent[i].ee_start_lo);
-				free(buf);
 				return (fileblock - startblock) + start;
 			}
 		}
 
-		free(buf);
 		return 0;
 	}
 
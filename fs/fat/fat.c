@@ -15,6 +15,7 @@
 #include <fat.h>
 #include <fs.h>
 #include <asm/byteorder.h>
+#include <asm/unaligned.h>
 #include <part.h>
 #include <malloc.h>
 #include <memalign.h>
@@ -300,6 +301,136 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/*
+ * Extent cache
+ *
+ * The cluster chain of a file is walked once and kept as a list of runs
+ * of contiguous clusters, so that seeking into the file and reading it
+ * cost O(extents) rather than O(clusters). The lists of the files read
+ * last are kept until the FAT is modified. An entry is only reused for
+ * the same device, partition, volume and directory entry, and only if
+ * nothing has been written to the device since, e.g. with "mmc write".
+ */
+struct fat_extent {
+	__u32 clust;	/* First cluster of the run */
+	__u32 count;	/* Number of clusters in the run */
+};
+
+struct fat_extent_map {
+	struct blk_desc *dev;
+	unsigned long write_count;
+	lbaint_t part_start;
+	__u32 vol_id;
+	__u32 start_clust;
+	__u32 size;
+	__u16 date, time;
+	int nr_extents;
+	struct fat_extent *extents;
+};
+
+static struct fat_extent_map fat_extent_cache[CONFIG_FS_FAT_EXTENT_CACHE];
+static int fat_extent_victim;
+
+static void fat_extent_cache_invalidate(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(fat_extent_cache); i++) {
+		free(fat_extent_cache[i].extents);
+		memset(&fat_extent_cache[i], 0, sizeof(fat_extent_cache[i]));
+	}
+}
+
+/*
+ * Walk the cluster chain starting at 'clust' for a file of 'size' bytes
+ * and fill 'map' with the extents found. The map is cut short if the
+ * chain ends early, as the file can then only be read up to that point.
+ * Return 0 on success, -1 if out of memory.
+ */
+static int fat_build_extents(fsdata *mydata, __u32 clust, __u32 size,
+			     struct fat_extent_map *map)
+{
+	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
+	__u32 nclust = DIV_ROUND_UP(size, bytesperclust);
+	struct fat_extent *ext = NULL, *tmp;
+	int n = 0, alloc = 0;
+	__u32 i;
+
+	for (i = 0; i < nclust; i++) {
+		if (CHECK_CLUST(clust, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", clust);
+			debug("Invalid FAT entry\n");
+			break;
+		}
+
+		if (n && ext[n - 1].clust + ext[n - 1].count == clust) {
+			ext[n - 1].count++;
+		} else {
+			if (n == alloc) {
+				alloc = alloc ? alloc * 2 : 16;
+				tmp = realloc(ext, alloc * sizeof(*ext));
+				if (!tmp) {
+					free(ext);
+					return -1;
+				}
+				ext = tmp;
+			}
+			ext[n].clust = clust;
+			ext[n].count = 1;
+			n++;
+		}
+
+		if (i + 1 < nclust)
+			clust = get_fatent(mydata, clust);
+	}
+
+	debug("FAT: %u clusters in %d extents\n", i, n);
+	map->nr_extents = n;
+	map->extents = ext;
+
+	return 0;
+}
+
+static struct fat_extent_map *fat_get_extents(fsdata *mydata,
+					      dir_entry *dentptr)
+{
+	struct fat_extent_map *map;
+	__u32 clust = START(dentptr);
+	__u32 size = FAT2CPU32(dentptr->size);
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(fat_extent_cache); i++) {
+		map = &fat_extent_cache[i];
+		if (map->extents && map->dev == cur_dev &&
+		    map->write_count == cur_dev->write_count &&
+		    map->part_start == cur_part_info.start &&
+		    map->vol_id == mydata->vol_id &&
+		    map->start_clust == clust && map->size == size &&
+		    map->date == dentptr->date && map->time == dentptr->time)
+			return map;
+	}
+
+	map = &fat_extent_cache[fat_extent_victim];
+	fat_extent_victim = (fat_extent_victim + 1) %
+			    ARRAY_SIZE(fat_extent_cache);
+
+	free(map->extents);
+	memset(map, 0, sizeof(*map));
+	if (fat_build_extents(mydata, clust, size, map))
+		return NULL;
+
+	map->dev = cur_dev;
+	map->write_count = cur_dev->write_count;
+	map->part_start = cur_part_info.start;
+	map->vol_id = mydata->vol_id;
+	map->start_clust = clust;
+	map->size = size;
+	map->date = dentptr->date;
+	map->time = dentptr->time;
+
+	return map;
+}
+
 /*
  * Read at most 'maxsize' bytes from 'pos' in the file associated with 'dentptr'
  * into 'buffer'.
@@ -313,9 +444,11 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 {
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
-	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
-	loff_t actsize;
+	struct fat_extent_map *map;
+	struct fat_extent *ext;
+	__u32 curclust, idx, skip;
+	loff_t start, extsize, actsize;
+	int i;
 
 	*gotsize = 0;
 	debug("Filesize: %llu bytes\n", filesize);
@@ -330,92 +463,57 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	debug("%llu bytes\n", filesize);
 
-	actsize = bytesperclust;
-
-	/* go to cluster at pos */
-	while (actsize <= pos) {
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			debug("Invalid FAT entry\n");
-			return 0;
-		}
-		actsize += bytesperclust;
+	map = fat_get_extents(mydata, dentptr);
+	if (!map) {
+		printf("Error: allocating extent map\n");
+		return -1;
 	}
 
-	/* actsize > pos */
-	actsize -= bytesperclust;
-	filesize -= actsize;
-	pos -= actsize;
-
-	/* align to beginning of next cluster if any */
-	if (pos) {
-		actsize = min(filesize, (loff_t)bytesperclust);
-		if (get_cluster(mydata, curclust, get_contents_vfatname_block,
-				(int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		filesize -= actsize;
-		actsize -= pos;
-		memcpy(buffer, get_contents_vfatname_block + pos, actsize);
-		*gotsize += actsize;
-		if (!filesize)
-			return 0;
-		buffer += actsize;
-
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			debug("Invalid FAT entry\n");
-			return 0;
-		}
-	}
+	/* 'start' is the file offset of the extent */
+	for (i = 0, start = 0; i < map->nr_extents && pos < filesize;
+	     i++, start += extsize) {
+		ext = &map->extents[i];
+		extsize = (loff_t)ext->count * bytesperclust;
+		if (pos >= start + extsize)
+			continue;
 
-	actsize = bytesperclust;
-	endclust = curclust;
-
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				debug("Invalid FAT entry\n");
-				return 0;
+		idx = (__u32)(pos - start) / bytesperclust;
+		skip = (__u32)(pos - start) - idx * bytesperclust;
+		curclust = ext->clust + idx;
+
+		/* read a partial first cluster through a bounce buffer */
+		if (skip) {
+			actsize = min(filesize - (pos - skip),
+				      (loff_t)bytesperclust);
+			if (get_cluster(mydata, curclust,
+					get_contents_vfatname_block,
+					actsize) != 0) {
+				printf("Error reading cluster\n");
+				return -1;
 			}
-			endclust = newclust;
-			actsize += bytesperclust;
+			actsize -= skip;
+			memcpy(buffer, get_contents_vfatname_block + skip,
+			       actsize);
+			*gotsize += actsize;
+			buffer += actsize;
+			pos += actsize;
+			curclust++;
+			if (pos >= filesize || ++idx == ext->count)
+				continue;
 		}
 
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+		/* then the rest of the extent in one go */
+		actsize = min(filesize, start + extsize) - pos;
+		if (get_cluster(mydata, curclust, buffer, actsize) != 0) {
 			printf("Error reading cluster\n");
 			return -1;
 		}
 		*gotsize += actsize;
-		return 0;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += (int)actsize;
-		filesize -= actsize;
 		buffer += actsize;
+		pos += actsize;
+	}
 
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return 0;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+	return 0;
 }
 
 /*
@@ -561,6 +659,7 @@ static int get_fs_info(fsdata *mydata)
 
 	mydata->fats = bs.fats;
 	mydata->fat_sect = bs.reserved;
+	mydata->vol_id = get_unaligned_le32(volinfo.volume_id);
 
 	mydata->rootdir_sect = mydata->fat_sect + mydata->fatlength * bs.fats;
 
@@ -6,6 +6,9 @@
 #include <config.h>
 #include <errno.h>
 #include <common.h>
+#include <bootm.h>
+#include <bootstage.h>
+#include <malloc.h>
 #include <mapmem.h>
 #include <part.h>
 #include <ext4fs.h>
@@ -17,6 +20,7 @@
 #include <asm/io.h>
 #include <div64.h>
 #include <linux/math64.h>
+#include <linux/sizes.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -621,7 +625,9 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		pos = 0;
 
 	time = get_timer(0);
+	bootstage_start(BOOTSTAGE_ID_ACCUM_LOAD, "load");
 	ret = fs_read(filename, addr, pos, bytes, &len_read);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_LOAD);
 	time = get_timer(time);
 	if (ret < 0)
 		return 1;
@@ -640,6 +646,98 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	return 0;
 }
 
+#ifdef CONFIG_CMD_LOADZ
+/* Amount of the file read at a time by loadz */
+#define LOADZ_CHUNK_SIZE	SZ_1M
+
+int do_loadz(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
+	     int fstype)
+{
+	struct bootm_decomp_stream ds;
+	const char *filename;
+	unsigned long addr;
+	unsigned long time;
+	loff_t len_read;
+	loff_t size;
+	loff_t pos;
+	ulong max;
+	void *buf;
+	int comp;
+	int ret;
+	char *ep;
+
+	if (argc < 6 || argc > 7)
+		return CMD_RET_USAGE;
+
+	addr = simple_strtoul(argv[3], &ep, 16);
+	if (ep == argv[3] || *ep != '\0')
+		return CMD_RET_USAGE;
+	filename = argv[4];
+	comp = genimg_get_comp_id(argv[5]);
+	if (comp < 0) {
+		printf("** Unknown compression type '%s' **\n", argv[5]);
+		return 1;
+	}
+	max = argc >= 7 ? simple_strtoul(argv[6], NULL, 16) :
+		CONFIG_SYS_BOOTM_LEN;
+
+	if (fs_set_blk_dev(argv[1], argv[2], fstype))
+		return 1;
+	if (fs_size(filename, &size) < 0)
+		return 1;
+
+	buf = memalign(ARCH_DMA_MINALIGN, LOADZ_CHUNK_SIZE);
+	if (!buf)
+		return 1;
+	ret = bootm_decomp_stream_start(&ds, comp, map_sysmem(addr, max), max);
+	if (ret)
+		goto err_buf;
+
+	/*
+	 * Each piece is decompressed as soon as it has been read, while it
+	 * is still in the cache, rather than after the whole file is loaded
+	 */
+	time = get_timer(0);
+	for (pos = 0; pos < size; pos += len_read) {
+		ret = fs_set_blk_dev(argv[1], argv[2], fstype);
+		if (ret)
+			goto err_stream;
+		bootstage_start(BOOTSTAGE_ID_ACCUM_LOAD, "load");
+		ret = fs_read(filename, map_to_sysmem(buf), pos,
+			      min_t(loff_t, size - pos, LOADZ_CHUNK_SIZE),
+			      &len_read);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_LOAD);
+		if (ret < 0 || !len_read)
+			goto err_stream;
+		ret = bootm_decomp_stream_feed(&ds, buf, len_read);
+		if (ret)
+			goto err_buf;
+	}
+	ret = bootm_decomp_stream_finish(&ds);
+	if (ret)
+		goto err_buf;
+	time = get_timer(time);
+	free(buf);
+
+	printf("%llu bytes read, %lu bytes decompressed in %lu ms\n", size,
+	       ds.out_len, time);
+	unmap_sysmem(ds.out);
+
+	env_set_hex("fileaddr", addr);
+	env_set_hex("filesize", ds.out_len);
+
+	return 0;
+
+err_stream:
+	bootm_decomp_stream_abort(&ds);
+err_buf:
+	unmap_sysmem(ds.out);
+	free(buf);
+
+	return 1;
+}
+#endif
+
 int do_ls(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	int fstype)
 {
@@ -74,6 +74,9 @@ typedef struct global_data {
 	const void *fdt_blob;		/* Our device tree, NULL if none */
 	void *new_fdt;			/* Relocated FDT */
 	unsigned long fdt_size;		/* Space reserved for relocated FDT */
+#if CONFIG_IS_ENABLED(OF_INDEX)
+	struct fdt_index *fdt_index;	/* Lookup index for fdt_blob */
+#endif
 #ifdef CONFIG_OF_LIVE
 	struct device_node *of_root;
 #endif
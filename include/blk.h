@@ -8,6 +8,7 @@
 #define BLK_H
 
 #include <efi.h>
+#include <linux/list.h>
 
 #ifdef CONFIG_SYS_64BIT_LBA
 typedef uint64_t lbaint_t;
@@ -85,6 +86,13 @@ struct blk_desc {
 		uint32_t mbr_sig;	/* MBR integer signature */
 		efi_guid_t guid_sig;	/* GPT GUID Signature */
 	};
+	/*
+	 * Incremented by each write or erase, and when the medium may have
+	 * been changed, so that anything derived from the contents of the
+	 * device (e.g. a filesystem's cached block maps) can tell whether it
+	 * is still valid
+	 */
+	unsigned long	write_count;
 #if CONFIG_IS_ENABLED(BLK)
 	/*
 	 * For now we have a few functions which take struct blk_desc as a
@@ -154,13 +162,34 @@ void blkcache_fill(int iftype, int dev,
  */
 void blkcache_invalidate(int iftype, int dev);
 
+/**
+ * blkcache_readahead() - get a read-ahead window for a block cache miss
+ *
+ * Small reads which miss the cache are widened to the aligned read-ahead
+ * window around them, so that neighbouring blocks (the rest of a FAT
+ * sector range or an ext4 inode table block) are cached by the same
+ * device access.
+ *
+ * @param block_dev - device being read
+ * @param start - starting block number of the request
+ * @param blkcnt - number of blocks requested
+ * @param ra_start - returns the first block of the window
+ * @param ra_cnt - returns the number of blocks in the window
+ *
+ * @return - buffer to read the window into, or NULL for no read-ahead
+ */
+void *blkcache_readahead(struct blk_desc *block_dev, lbaint_t start,
+			 lbaint_t blkcnt, lbaint_t *ra_start,
+			 lbaint_t *ra_cnt);
+
 /**
  * blkcache_configure() - configure block cache
  *
- * @param blocks - maximum blocks per entry
- * @param entries - maximum entries in cache
+ * @param blocks - maximum blocks per read for it to be cached
+ * @param size - maximum size of the cached data in bytes
+ * @param readahead - read-ahead window in blocks (0 or 1 to disable)
  */
-void blkcache_configure(unsigned blocks, unsigned entries);
+void blkcache_configure(unsigned blocks, unsigned size, unsigned readahead);
 
 /*
  * statistics of the block cache
@@ -171,6 +200,20 @@ struct block_cache_stats {
 	unsigned entries; /* current entry count */
 	unsigned max_blocks_per_entry;
 	unsigned max_entries;
+	unsigned size; /* bytes currently allocated for cached blocks */
+	unsigned max_size;
+	unsigned readahead;
+};
+
+/*
+ * per-device statistics of the block cache; a miss is a device read
+ */
+struct block_cache_dev_stats {
+	bool active;
+	int iftype;
+	int devnum;
+	unsigned hits;
+	unsigned misses;
 };
 
 /**
@@ -180,6 +223,16 @@ struct block_cache_stats {
  */
 void blkcache_stats(struct block_cache_stats *stats);
 
+/**
+ * blkcache_dev_stats() - return statistics of one device and reset
+ *
+ * @param index - index of the device in the statistics table
+ * @param stats - statistics are copied here
+ *
+ * @return - 0 if OK, -ENOENT if there is no device at this index
+ */
+int blkcache_dev_stats(int index, struct block_cache_dev_stats *stats);
+
 #else
 
 static inline int blkcache_read(int iftype, int dev,
@@ -195,11 +248,49 @@ static inline void blkcache_fill(int iftype, int dev,
 
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
+static inline void *blkcache_readahead(struct blk_desc *block_dev,
+				       lbaint_t start, lbaint_t blkcnt,
+				       lbaint_t *ra_start, lbaint_t *ra_cnt)
+{
+	return NULL;
+}
+
 #endif
 
 #if CONFIG_IS_ENABLED(BLK)
 struct udevice;
 
+/**
+ * struct blk_request - an asynchronous read from or write to a block device
+ *
+ * The caller fills in the first five members and passes the request to
+ * blk_dsubmit(). The request and its buffer must stay valid until it is done.
+ *
+ * @start:	Start block number (0=first)
+ * @blkcnt:	Number of blocks to transfer
+ * @buffer:	Buffer to read into, or to write from
+ * @write:	true to write, false to read
+ * @complete:	Function called when the request is done, or NULL
+ * @priv:	For use by the caller, e.g. in @complete
+ * @result:	Number of blocks transferred, or -ve error number (see the
+ *		IS_ERR_VALUE() macro). Valid once @done is set
+ * @done:	Set when the request is done, just before @complete is called
+ * @drv_data:	For use by the driver while it owns the request
+ * @node:	For use by the driver to queue the request
+ */
+struct blk_request {
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+	bool write;
+	void (*complete)(struct blk_request *req);
+	void *priv;
+	unsigned long result;
+	bool done;
+	ulong drv_data;
+	struct list_head node;
+};
+
 /* Operations on block devices */
 struct blk_ops {
 	/**
@@ -258,6 +349,31 @@ struct blk_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
+
+	/**
+	 * submit() - queue a read or write without waiting for it
+	 *
+	 * The driver must call blk_request_done() once the transfer is
+	 * finished, normally from poll(). Drivers which do not provide this
+	 * are driven synchronously through read() and write(), as are
+	 * requests for which it returns -ENOSYS.
+	 *
+	 * @dev:	Device to read from or write to
+	 * @req:	Request to queue
+	 * @return 0 if OK, -ENOSYS if the request must be done through read()
+	 * or write(), other -ve on error (the request is then not queued)
+	 */
+	int (*submit)(struct udevice *dev, struct blk_request *req);
+
+	/**
+	 * poll() - make progress on queued requests
+	 *
+	 * This completes every queued request which has finished.
+	 *
+	 * @dev:	Device to poll
+	 * @return number of requests still outstanding, or -ve on error
+	 */
+	int (*poll)(struct udevice *dev);
 };
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
@@ -275,6 +391,46 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
 
+/**
+ * blk_dsubmit() - start an asynchronous read or write
+ *
+ * The request is queued with the driver if it supports that. Otherwise, or if
+ * a read can be satisfied from the block cache, it is done before this
+ * function returns. In every case @req->complete is called once it is done.
+ * Data read by the driver is not added to the block cache.
+ *
+ * @block_dev:	Block device to use
+ * @req:	Request to start
+ * @return 0 if OK, -ve on error (the request is then not started)
+ */
+int blk_dsubmit(struct blk_desc *block_dev, struct blk_request *req);
+
+/**
+ * blk_dpoll() - make progress on the queued requests of a block device
+ *
+ * @block_dev:	Block device to poll
+ * @return number of requests still outstanding, or -ve on error
+ */
+int blk_dpoll(struct blk_desc *block_dev);
+
+/**
+ * blk_dwait() - wait for a request to be done
+ *
+ * @block_dev:	Block device which the request was submitted to
+ * @req:	Request to wait for
+ * @return number of blocks transferred, or -ve error number (see the
+ * IS_ERR_VALUE() macro)
+ */
+unsigned long blk_dwait(struct blk_desc *block_dev, struct blk_request *req);
+
+/**
+ * blk_request_done() - mark a request as done, for use by drivers
+ *
+ * @req:	Request which is done
+ * @result:	Number of blocks transferred, or -ve error number
+ */
+void blk_request_done(struct blk_request *req, unsigned long result);
+
 /**
  * blk_find_device() - Find a block device
  *
@@ -450,6 +606,7 @@ static inline ulong blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt, const void *buffer)
 {
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	block_dev->write_count++;
 	return block_dev->block_write(block_dev, start, blkcnt, buffer);
 }
 
@@ -457,6 +614,7 @@ static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt)
 {
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	block_dev->write_count++;
 	return block_dev->block_erase(block_dev, start, blkcnt);
 }
 
@@ -14,6 +14,11 @@
 #define BOOTM_ERR_OVERLAP		(-2)
 #define BOOTM_ERR_UNIMPLEMENTED	(-3)
 
+#ifndef CONFIG_SYS_BOOTM_LEN
+/* use 8MByte as default max gunzip size */
+#define CONFIG_SYS_BOOTM_LEN	0x800000
+#endif
+
 /*
  *  Continue booting an OS image; caller already has:
  *  - copied image header to global variable `header'
@@ -72,6 +77,89 @@ int bootm_decomp_image(int comp, ulong load, ulong image_start, int type,
 		       void *load_buf, void *image_buf, ulong image_len,
 		       uint unc_len, ulong *load_end);
 
+/**
+ * struct bootm_decomp_stream - an image being decompressed as it is loaded
+ *
+ * A loader which reads an image in pieces passes each piece to
+ * bootm_decomp_stream_feed() after reading it and before reading the next,
+ * so that the compressed image never has to be held in memory all at once.
+ * Reading and decompressing take turns; they do not run at the same time.
+ *
+ * @comp:	Compression algorithm that is used (IH_COMP_...)
+ * @out:	Place to decompress to
+ * @out_size:	Available space for decompression
+ * @out_len:	Number of bytes decompressed so far
+ * @started:	true once the decompressor has read the stream header
+ * @done:	true once the end of the compressed data has been seen
+ * @need:	Number of bytes the decompressor must see at once to make
+ *		progress, when a header or block spans two pieces
+ * @carry:	Data held over from the previous piece, when a header or
+ *		block spans two pieces
+ * @carry_len:	Number of bytes in @carry
+ * @carry_size:	Size of the @carry buffer
+ * @state:	Decompressor state
+ */
+struct bootm_decomp_stream {
+	int comp;
+	unsigned char *out;
+	ulong out_size;
+	ulong out_len;
+	bool started;
+	bool done;
+	ulong need;
+	unsigned char *carry;
+	ulong carry_len;
+	ulong carry_size;
+	union bootm_decomp_state *state;
+};
+
+/**
+ * bootm_decomp_stream_start() - start decompressing an image as it loads
+ *
+ * @ds:		Stream to set up
+ * @comp:	Compression algorithm that is used (IH_COMP_...)
+ * @out:	Place to decompress to
+ * @out_size:	Available space for decompression
+ * @return 0 if OK, -ve on error (BOOTM_ERR_... or -ENOMEM)
+ */
+int bootm_decomp_stream_start(struct bootm_decomp_stream *ds, int comp,
+			      void *out, ulong out_size);
+
+/**
+ * bootm_decomp_stream_feed() - decompress the next piece of an image
+ *
+ * Data which cannot be decompressed yet is copied, so @buf can be reused
+ * for the next piece once this returns.
+ *
+ * @ds:		Stream to use
+ * @buf:	Next piece of the compressed image
+ * @len:	Number of bytes at @buf
+ * @return 0 if OK, -ve on error (BOOTM_ERR_...). On error the stream is
+ * freed and must not be used again.
+ */
+int bootm_decomp_stream_feed(struct bootm_decomp_stream *ds, const void *buf,
+			     ulong len);
+
+/**
+ * bootm_decomp_stream_finish() - finish decompressing an image
+ *
+ * This checks that the whole image has been decompressed and frees the
+ * stream. The decompressed size is then in @ds->out_len.
+ *
+ * @ds:		Stream to finish
+ * @return 0 if OK, -ve on error (BOOTM_ERR_...)
+ */
+int bootm_decomp_stream_finish(struct bootm_decomp_stream *ds);
+
+/**
+ * bootm_decomp_stream_abort() - give up on decompressing an image
+ *
+ * This frees the stream, e.g. when the image could not be read.
+ *
+ * @ds:		Stream to free
+ */
+void bootm_decomp_stream_abort(struct bootm_decomp_stream *ds);
+
 /*
  * boards should define this to disable devices when EFI exits from boot
  * services.
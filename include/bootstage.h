@@ -199,6 +199,10 @@ enum bootstage_id {
 	BOOTSTATE_ID_ACCUM_DM_SPL,
 	BOOTSTATE_ID_ACCUM_DM_F,
 	BOOTSTATE_ID_ACCUM_DM_R,
+	BOOTSTAGE_ID_ACCUM_LOAD,
+	BOOTSTAGE_ID_ACCUM_FIT_HASH,
+	BOOTSTAGE_ID_ACCUM_FIT_LOAD,
+	BOOTSTAGE_ID_ACCUM_UBI_ATTACH,
 
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
@@ -425,6 +425,8 @@ ulong	usec2ticks    (unsigned long usec);
 ulong	ticks2usec    (unsigned long ticks);
 
 /* lib/gunzip.c */
+void *gzalloc(void *x, unsigned int items, unsigned int size);
+void gzfree(void *x, void *addr, unsigned int nb);
 int gzip_parse_header(const unsigned char *src, unsigned long len);
 int gunzip(void *, int, unsigned char *, unsigned long *);
 int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
@@ -472,6 +474,40 @@ int gzwrite(unsigned char *src, int len,
 /* lib/lz4_wrapper.c */
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn);
 
+/**
+ * struct ulz4fn_state - state for decompressing an LZ4 frame in pieces
+ *
+ * @started:		true once the frame header has been read
+ * @block_checksum:	true if each block is followed by a checksum
+ */
+struct ulz4fn_state {
+	bool started;
+	bool block_checksum;
+};
+
+/**
+ * ulz4fn_stream() - Decompress the complete blocks in part of an LZ4 frame
+ *
+ * This is used to decompress a frame as it is loaded. Call it with the data
+ * which has arrived so far, then again with the data it did not use
+ * followed by the data which arrived next.
+ *
+ * @state:	Decompression state, zeroed before the first call
+ * @src:	Compressed data
+ * @srcn:	Number of bytes at @src
+ * @src_used:	Returns the number of bytes used from @src
+ * @dst:	Place to put the decompressed data
+ * @dstn:	Space available at @dst
+ * @dst_used:	Returns the number of bytes written to @dst
+ * @need:	When -EAGAIN is returned, this returns the number of bytes
+ *		needed after the used data to make progress
+ * @return 0 at the end of the frame, -EAGAIN if more data is needed, or
+ * another -ve error code
+ */
+int ulz4fn_stream(struct ulz4fn_state *state, const void *src, size_t srcn,
+		  size_t *src_used, void *dst, size_t dstn, size_t *dst_used,
+		  size_t *need);
+
 /* lib/qsort.c */
 void qsort(void *base, size_t nmemb, size_t size,
 	   int(*compar)(const void *, const void *));
@@ -72,6 +72,11 @@
 #define CONFIG_BOOTP_SEND_HOSTNAME
 #define CONFIG_BOOTP_SERVERIP
 #define CONFIG_IP_DEFRAG
+/*
+ * Enough receive buffers to queue a whole TFTP window, or the fragmented
+ * replies to a window of NFS reads, in the eth tests
+ */
+#define CONFIG_SYS_RX_ETH_BUFFER	32
 
 #ifndef SANDBOX_NO_SDL
 #define CONFIG_SANDBOX_SDL
@@ -16,6 +16,8 @@
 #include <spi_flash.h>
 #include <linux/usb/composite.h>
 
+struct z_stream_s;
+
 enum dfu_device_type {
 	DFU_DEV_MMC = 1,
 	DFU_DEV_ONENAND,
@@ -117,6 +119,17 @@ struct dfu_entity {
 	int (*write_medium)(struct dfu_entity *dfu,
 			u64 offset, void *buf, long *len);
 
+	/*
+	 * Optional: start writing and return before the write is done, so
+	 * that the next part of the buffer can be filled meanwhile. The
+	 * write must not touch the buffer after write_wait() returns.
+	 */
+	int (*write_medium_start)(struct dfu_entity *dfu,
+			u64 offset, void *buf, long *len);
+	int (*write_wait)(struct dfu_entity *dfu);
+	/* Whether write_medium_start() returns before the write is done */
+	bool (*write_in_background)(struct dfu_entity *dfu);
+
 	int (*flush_medium)(struct dfu_entity *dfu);
 	unsigned int (*poll_timeout)(struct dfu_entity *dfu);
 
@@ -136,6 +149,20 @@ struct dfu_entity {
 
 	u32 bad_skip;	/* for nand use */
 
+	/* statistics for the transfer */
+	ulong start_time;	/* get_timer() value when it started */
+	ulong medium_time;	/* ms spent writing to the medium */
+	u64 in_bytes;		/* bytes received, before decompression */
+
+	struct z_stream_s *gz;	/* state for decompressing, or NULL */
+	u32 gz_crc;		/* crc32 of the data decompressed so far */
+	u8 gz_trailer[8];	/* crc32 and size at the end of the gzip data */
+	u8 gz_trailer_len;
+	unsigned int gz_done:1;
+
+	unsigned int double_buf:1;	/* buffer is used as two halves */
+	unsigned int write_pending:1;	/* write_medium_start() in progress */
+
 	unsigned int inited:1;
 };
 
@@ -33,4 +33,14 @@ extern void (*fastboot_progress_callback)(const char *msg);
  */
 void fastboot_getvar(char *cmd_parameter, char *response);
 
+/**
+ * fastboot_max_download_size() - Find the size of the largest download
+ *
+ * This is the size of the download buffer, unless downloads are being
+ * written straight to a partition, when it is the size of the partition.
+ *
+ * Return: Number of bytes which can be downloaded
+ */
+u32 fastboot_max_download_size(void);
+
 #endif
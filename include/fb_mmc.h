@@ -34,4 +34,17 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
  * @response: Pointer to fastboot response buffer
  */
 void fastboot_mmc_erase(const char *cmd, char *response);
+
+struct sparse_storage;
+
+/**
+ * fastboot_mmc_stream_start() - Set up writing an image to eMMC as it arrives
+ *
+ * @cmd: Named partition to write image to
+ * @sparse: Storage to set up for writing to the partition
+ * @response: Pointer to fastboot response buffer
+ * Return: 0 if OK, -ve on error
+ */
+int fastboot_mmc_stream_start(const char *cmd, struct sparse_storage *sparse,
+			      char *response);
 #endif
@@ -37,4 +37,17 @@ void fastboot_nand_flash_write(const char *cmd, void *download_buffer,
  * @response: Pointer to fastboot response buffer
  */
 void fastboot_nand_erase(const char *cmd, char *response);
+
+struct sparse_storage;
+
+/**
+ * fastboot_nand_stream_start() - Set up writing an image to NAND as it arrives
+ *
+ * @cmd: Named device to write image to
+ * @sparse: Storage to set up for writing to the device
+ * @response: Pointer to fastboot response buffer
+ * Return: 0 if OK, -ve on error
+ */
+int fastboot_nand_stream_start(const char *cmd, struct sparse_storage *sparse,
+			       char *response);
 #endif
@@ -664,6 +664,73 @@ const char *fdtdec_get_compatible(enum fdt_compat_id id);
  */
 int fdtdec_lookup_phandle(const void *blob, int node, const char *prop_name);
 
+#if CONFIG_IS_ENABLED(OF_INDEX)
+/**
+ * Find a node by its path
+ *
+ * This is the same as fdt_path_offset(), but with CONFIG_OF_INDEX it uses
+ * an index of the control FDT rather than walking the tree. The same goes
+ * for the other lookups below.
+ *
+ * @param blob		FDT blob
+ * @param path		path of the node, which may start with an alias
+ * @return node offset if found, -ve error code on error
+ */
+int fdtdec_path_offset(const void *blob, const char *path);
+
+/**
+ * Find the node with a given phandle
+ *
+ * @param blob		FDT blob
+ * @param phandle	phandle to look for
+ * @return node offset if found, -ve error code on error
+ */
+int fdtdec_node_offset_by_phandle(const void *blob, uint32_t phandle);
+
+/**
+ * Find the next node with a given compatible string
+ *
+ * @param blob		FDT blob
+ * @param startoffset	only nodes after this one are checked, -1 for all
+ * @param compat	compatible string to look for
+ * @return node offset if found, -ve error code on error
+ */
+int fdtdec_node_offset_by_compatible(const void *blob, int startoffset,
+				     const char *compat);
+
+/**
+ * Find the parent of a node
+ *
+ * @param blob		FDT blob
+ * @param nodeoffset	offset of the node
+ * @return offset of the parent node, -ve error code on error
+ */
+int fdtdec_parent_offset(const void *blob, int nodeoffset);
+#else
+static inline int fdtdec_path_offset(const void *blob, const char *path)
+{
+	return fdt_path_offset(blob, path);
+}
+
+static inline int fdtdec_node_offset_by_phandle(const void *blob,
+						uint32_t phandle)
+{
+	return fdt_node_offset_by_phandle(blob, phandle);
+}
+
+static inline int fdtdec_node_offset_by_compatible(const void *blob,
+						   int startoffset,
+						   const char *compat)
+{
+	return fdt_node_offset_by_compatible(blob, startoffset, compat);
+}
+
+static inline int fdtdec_parent_offset(const void *blob, int nodeoffset)
+{
+	return fdt_parent_offset(blob, nodeoffset);
+}
+#endif
+
 /**
  * Look up a property in a node and return its contents in an integer
  * array of given length. The property must have at least enough data for
@@ -73,6 +73,41 @@ struct hash_algo {
 };
 
 #ifndef USE_HOSTCC
+/**
+ * struct hash_backend - An implementation of a hash block function
+ *
+ * The software SHA-1 and SHA-256 code hands whole 64-byte blocks to a
+ * backend. Backends are declared with U_BOOT_HASH_BACKEND() and the one
+ * with the highest priority that the running CPU supports is used.
+ *
+ * @algo:	Name of the algorithm, as in struct hash_algo (e.g. "sha256")
+ * @name:	Name of this implementation (e.g. "generic")
+ * @priority:	Backends with a higher priority are preferred
+ * @probe:	Check whether the CPU can run this backend, returning true if
+ *		so. NULL if the backend can always be used
+ * @process:	Hash @blocks 64-byte blocks from @data into @state
+ */
+struct hash_backend {
+	const char *algo;
+	const char *name;
+	int priority;
+	bool (*probe)(void);
+	void (*process)(uint32_t *state, const uint8_t *data,
+			unsigned int blocks);
+};
+
+/* Declare a new hash backend */
+#define U_BOOT_HASH_BACKEND(__name) \
+	ll_entry_declare(struct hash_backend, __name, hash_backend)
+
+/**
+ * hash_backend_find() - Find the backend to use for an algorithm
+ *
+ * @algo_name:	Hash algorithm to look up (e.g. "sha256")
+ * @return the usable backend with the highest priority, or NULL if none
+ */
+const struct hash_backend *hash_backend_find(const char *algo_name);
+
 /**
  * hash_command: Process a hash command for a particular algorithm
  *
@@ -37,5 +37,116 @@ static inline int is_sparse_image(void *buf)
 	return 0;
 }
 
+/**
+ * enum sparse_stream_state - what a sparse stream expects next
+ *
+ * @SPARSE_STREAM_FILE_HDR:	the file header
+ * @SPARSE_STREAM_CHUNK_HDR:	a chunk header
+ * @SPARSE_STREAM_RAW:		the data of a raw chunk
+ * @SPARSE_STREAM_FILL:		the fill value of a fill chunk
+ * @SPARSE_STREAM_RAW_IMAGE:	more of an image which is not sparse
+ * @SPARSE_STREAM_DONE:		nothing; all the chunks have been written
+ * @SPARSE_STREAM_ERROR:	nothing; writing the image failed
+ */
+enum sparse_stream_state {
+	SPARSE_STREAM_FILE_HDR,
+	SPARSE_STREAM_CHUNK_HDR,
+	SPARSE_STREAM_RAW,
+	SPARSE_STREAM_FILL,
+	SPARSE_STREAM_RAW_IMAGE,
+	SPARSE_STREAM_DONE,
+	SPARSE_STREAM_ERROR,
+};
+
+/**
+ * struct sparse_stream - an image being written as it arrives
+ *
+ * The image is fed in pieces of any size, so headers and blocks may be split
+ * between two pieces. Whole blocks are written straight from the data passed
+ * in; only a block which is split is copied.
+ *
+ * @info:	where the image is written
+ * @state:	what is expected next
+ * @sparse:	file header of the image
+ * @chunk:	header of the current chunk
+ * @hdr:	header (or fill value) collected so far
+ * @hdr_len:	number of bytes in @hdr
+ * @hdr_want:	number of bytes needed in @hdr
+ * @skip:	number of bytes to ignore before going on
+ * @left:	number of bytes of raw chunk data still to come
+ * @chunks_left: number of chunks still to come
+ * @blksz:	block size of the storage
+ * @blk:	next block to write
+ * @blk_buf:	part of a block which has been split
+ * @blk_len:	number of bytes in @blk_buf
+ * @fill_buf:	buffer holding the fill value, allocated when first needed
+ * @fill_blks:	number of blocks in @fill_buf
+ * @total_blocks: number of image blocks handled so far
+ * @bytes_written: number of bytes written to the storage
+ */
+struct sparse_stream {
+	struct sparse_storage *info;
+	enum sparse_stream_state state;
+	sparse_header_t sparse;
+	chunk_header_t chunk;
+	u8 hdr[sizeof(sparse_header_t)];
+	uint hdr_len;
+	uint hdr_want;
+	u32 skip;
+	u32 left;
+	u32 chunks_left;
+	uint blksz;
+	lbaint_t blk;
+	u8 *blk_buf;
+	uint blk_len;
+	u32 *fill_buf;
+	uint fill_blks;
+	u32 total_blocks;
+	u64 bytes_written;
+};
+
 int write_sparse_image(struct sparse_storage *info, const char *part_name,
 		       void *data, char *response);
+
+/**
+ * sparse_stream_init() - Start writing an image as it arrives
+ *
+ * The first bytes decide whether this is a sparse image. If not, the data is
+ * written as it is, starting at info->start.
+ *
+ * @ss:		stream to set up
+ * @info:	where to write the image
+ * @response:	passed to info->mssg() on error
+ * @return 0 if OK, -1 on error
+ */
+int sparse_stream_init(struct sparse_stream *ss, struct sparse_storage *info,
+		       char *response);
+
+/**
+ * sparse_stream_write() - Write the next piece of an image
+ *
+ * Data after the last chunk of a sparse image is ignored.
+ *
+ * @ss:		stream to write
+ * @data:	next piece of the image
+ * @len:	number of bytes in the piece
+ * @response:	passed to info->mssg() on error
+ * @return 0 if OK, -1 on error, after which the rest of the image is ignored
+ */
+int sparse_stream_write(struct sparse_stream *ss, const void *data,
+			size_t len, char *response);
+
+/**
+ * sparse_stream_finish() - Finish writing an image
+ *
+ * This writes the last partial block of an image which is not sparse, padded
+ * with zeroes, and checks that a sparse image was complete. It must be called
+ * even if writing failed, to free the stream's buffers.
+ *
+ * @ss:		stream to finish
+ * @part_name:	name of the partition, for the message on success
+ * @response:	passed to info->mssg() on error
+ * @return 0 if the whole image was written, -1 otherwise
+ */
+int sparse_stream_finish(struct sparse_stream *ss, const char *part_name,
+			 char *response);
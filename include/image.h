@@ -56,6 +56,8 @@ struct fdt_region;
 #include <hash.h>
 #include <linux/libfdt.h>
 #include <fdt_support.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
 # ifdef CONFIG_SPL_BUILD
 #  ifdef CONFIG_SPL_CRC32_SUPPORT
 #   define IMAGE_ENABLE_CRC32	1
@@ -295,6 +297,7 @@ enum {
 	IH_COMP_LZMA,			/* lzma  Compression Used	*/
 	IH_COMP_LZO,			/* lzo   Compression Used	*/
 	IH_COMP_LZ4,			/* lz4   Compression Used	*/
+	IH_COMP_ZSTD,			/* zstd  Compression Used	*/
 
 	IH_COMP_COUNT,
 };
@@ -1029,6 +1032,78 @@ int fit_add_verification_data(const char *keydir, void *keydest, void *fit,
 int fit_image_verify_with_data(const void *fit, int image_noffset,
 			       const void *data, size_t size);
 int fit_image_verify(const void *fit, int noffset);
+
+/* Most hashes which fit_image_hash_start() can handle in one image */
+#define FIT_STREAM_MAX_HASHES	4
+
+/**
+ * struct fit_image_hashes - hashes of an image calculated a piece at a time
+ *
+ * @count:	number of hash nodes in the image
+ * @hash:	state of each hash. @skip is set if the hash node is marked to
+ *		be ignored. @value holds the expected hash, which is read from
+ *		the FIT before any data is loaded, in case loading overwrites
+ *		the FIT
+ */
+struct fit_image_hashes {
+	int count;
+	struct fit_image_hash {
+		const char *algo;
+		bool skip;
+		uint8_t value[FIT_MAX_HASH_LEN];
+		int value_len;
+		union {
+			uint32_t crc;
+			sha1_context sha1;
+			sha256_context sha256;
+		} u;
+	} hash[FIT_STREAM_MAX_HASHES];
+};
+
+/**
+ * fit_image_hash_start() - start checking the hashes of an image in pieces
+ *
+ * This allows the image data to be hashed while it is read or copied, so
+ * that it only passes through the CPU once. Pass each piece of the data in
+ * order to fit_image_hash_update(), then call fit_image_hash_finish().
+ *
+ * Images with signatures, with a hash which cannot be calculated in pieces
+ * or with more than FIT_STREAM_MAX_HASHES hashes must be checked with
+ * fit_image_verify_with_data() instead.
+ *
+ * @fit:	FIT to check
+ * @image_noffset: offset of the image node
+ * @hashes:	returns the hash state
+ * @return 0 if OK, -EAGAIN if fit_image_verify_with_data() must be used
+ */
+int fit_image_hash_start(const void *fit, int image_noffset,
+			 struct fit_image_hashes *hashes);
+
+/**
+ * fit_image_hash_update() - hash the next piece of an image
+ *
+ * @hashes:	hash state from fit_image_hash_start()
+ * @data:	next piece of image data
+ * @len:	length of @data in bytes
+ */
+void fit_image_hash_update(struct fit_image_hashes *hashes, const void *data,
+			   size_t len);
+
+/**
+ * fit_image_hash_finish() - check the hashes of an image
+ *
+ * This prints the result of each hash in the same way as
+ * fit_image_verify_with_data(). The FIT is not looked at, so it may have
+ * been overwritten by the image data.
+ *
+ * @hashes:	hash state from fit_image_hash_start()
+ * @return 1 if all hashes are valid, 0 if not
+ */
+int fit_image_hash_finish(struct fit_image_hashes *hashes);
+
+/* Copy image data and check its hashes in one pass, see image-fit.c */
+int fit_image_copy_verify(const void *fit, int image_noffset, void *dst,
+			  const void *src, size_t size);
 int fit_config_verify(const void *fit, int conf_noffset);
 int fit_all_image_verify(const void *fit);
 int fit_image_check_os(const void *fit, int noffset, uint8_t os);
@@ -31,6 +31,31 @@ int lzo1x_decompress_safe(const unsigned char *src, size_t src_len,
 int lzop_decompress(const unsigned char *src, size_t src_len,
 		    unsigned char *dst, size_t *dst_len);
 
+/**
+ * lzop_decompress_stream() - Decompress the complete blocks in part of an
+ * lzop file
+ *
+ * This is used to decompress a file as it is loaded. Call it with the data
+ * which has arrived so far, then again with the data it did not use
+ * followed by the data which arrived next.
+ *
+ * @started:	false before the first call, then updated by this function
+ * @src:	Compressed data
+ * @src_len:	Number of bytes at @src
+ * @src_used:	Returns the number of bytes used from @src
+ * @dst:	Place to put the decompressed data
+ * @dst_len:	Space available at @dst
+ * @dst_used:	Returns the number of bytes written to @dst
+ * @need:	When LZO_E_INPUT_OVERRUN is returned, this returns the number
+ *		of bytes needed after the used data to make progress
+ * @return LZO_E_OK at the end of the file, LZO_E_INPUT_OVERRUN if more data
+ * is needed, or another LZO_E_... error
+ */
+int lzop_decompress_stream(bool *started, const unsigned char *src,
+			   size_t src_len, size_t *src_used,
+			   unsigned char *dst, size_t dst_len,
+			   size_t *dst_used, size_t *need);
+
 /* check if the header is valid (based on magic numbers) */
 bool lzop_is_valid_header(const unsigned char *src);
 
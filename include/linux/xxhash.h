@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: (GPL-2.0 OR BSD-2-Clause) */
+/*
+ * xxHash - Extremely Fast Hash algorithm
+ * Copyright (C) 2012-2016, Yann Collet.
+ *
+ * Only the 64-bit variant is provided, since that is all that the zstd
+ * decompressor needs to check frame checksums.
+ */
+
+#ifndef __LINUX_XXHASH_H
+#define __LINUX_XXHASH_H
+
+#include <linux/types.h>
+
+/**
+ * xxh64() - calculate the 64-bit hash of the input with a given seed
+ *
+ * @input:  The data to hash
+ * @length: The length of the data to hash
+ * @seed:   The seed can be used to alter the result predictably
+ * @return the 64-bit hash of the data
+ */
+uint64_t xxh64(const void *input, size_t length, uint64_t seed);
+
+/**
+ * struct xxh64_state - private xxh64 state, do not use members directly
+ */
+struct xxh64_state {
+	uint64_t total_len;
+	uint64_t v1;
+	uint64_t v2;
+	uint64_t v3;
+	uint64_t v4;
+	uint64_t mem64[4];
+	uint32_t memsize;
+};
+
+/**
+ * xxh64_reset() - reset the xxh64 state to start a new hashing operation
+ *
+ * @state: The xxh64 state to reset
+ * @seed:  Initialize the hash state with this seed
+ */
+void xxh64_reset(struct xxh64_state *state, uint64_t seed);
+
+/**
+ * xxh64_update() - hash the data given and update the xxh64 state
+ *
+ * Call xxh64_reset() before calling this for the first time.
+ *
+ * @state:  The xxh64 state to update
+ * @input:  The data to hash
+ * @length: The length of the data to hash
+ * @return 0 on success or -EINVAL if @input is NULL
+ */
+int xxh64_update(struct xxh64_state *state, const void *input, size_t length);
+
+/**
+ * xxh64_digest() - produce the current xxh64 hash
+ *
+ * The state is not changed, so more data can be added with xxh64_update()
+ * afterwards.
+ *
+ * @state: Produce the current xxh64 hash of this state
+ * @return the xxh64 hash stored in the state
+ */
+uint64_t xxh64_digest(const struct xxh64_state *state);
+
+#endif /* __LINUX_XXHASH_H */
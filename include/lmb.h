@@ -10,17 +10,27 @@
  * Copyright (C) 2001 Peter Bergner, IBM Corp.
  */
 
-#define MAX_LMB_REGIONS 8
+/*
+ * Number of regions held in struct lmb_region itself. Once these are used
+ * up, the regions are moved to a larger array on the heap.
+ */
+#define LMB_INITIAL_REGIONS 8
 
 struct lmb_property {
 	phys_addr_t base;
 	phys_size_t size;
 };
 
+/*
+ * Regions are kept sorted by base address. Neighbouring regions which touch
+ * or overlap are merged, so the regions never overlap.
+ */
 struct lmb_region {
 	unsigned long cnt;
+	unsigned long max;
 	phys_size_t size;
-	struct lmb_property region[MAX_LMB_REGIONS+1];
+	struct lmb_property *region;
+	struct lmb_property initial[LMB_INITIAL_REGIONS];
 };
 
 struct lmb {
@@ -31,6 +41,7 @@ struct lmb {
 extern struct lmb lmb;
 
 extern void lmb_init(struct lmb *lmb);
+extern void lmb_release(struct lmb *lmb);
 extern long lmb_add(struct lmb *lmb, phys_addr_t base, phys_size_t size);
 extern long lmb_reserve(struct lmb *lmb, phys_addr_t base, phys_size_t size);
 extern phys_addr_t lmb_alloc(struct lmb *lmb, phys_size_t size, ulong align);
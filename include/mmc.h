@@ -346,9 +346,19 @@ enum mmc_voltage {
 
 /**
  * struct mmc_uclass_priv - Holds information about a device used by the uclass
+ *
+ * @mmc:	MMC struct for the device
+ * @write_queue:	Writes queued through the block device, see
+ *			mmc_bsubmit()
+ * @write_cur:	Number of blocks of the first queued write which are being
+ *		sent, or 0 if none
  */
 struct mmc_uclass_priv {
 	struct mmc *mmc;
+#if CONFIG_IS_ENABLED(BLK)
+	struct list_head write_queue;
+	lbaint_t write_cur;
+#endif
 };
 
 /**
@@ -406,6 +416,32 @@ struct dm_mmc_ops {
 	int (*send_cmd)(struct udevice *dev, struct mmc_cmd *cmd,
 			struct mmc_data *data);
 
+	/**
+	 * send_cmd_start() - Send a command and leave its data to be written
+	 *
+	 * This returns once the command has been accepted, while the
+	 * controller goes on sending the data by itself. No other command
+	 * may be sent until send_cmd_done() says that this one is done, and
+	 * the data must stay valid until then.
+	 *
+	 * @dev:	Device to receive the command
+	 * @cmd:	Command to send
+	 * @data:	Data to write
+	 * @return 0 if OK, -ENOSYS if this command must be sent with
+	 * send_cmd() instead, other -ve on error
+	 */
+	int (*send_cmd_start)(struct udevice *dev, struct mmc_cmd *cmd,
+			      struct mmc_data *data);
+
+	/**
+	 * send_cmd_done() - Check whether the data of a command is written
+	 *
+	 * @dev:	Device to check
+	 * @return 0 if the data started by send_cmd_start() has been
+	 * written, -EBUSY if it is still being written, other -ve on error
+	 */
+	int (*send_cmd_done)(struct udevice *dev);
+
 	/**
 	 * set_ios() - Set the I/O speed/width for an MMC device
 	 *
@@ -467,6 +503,9 @@ struct dm_mmc_ops {
 
 int dm_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		    struct mmc_data *data);
+int dm_mmc_send_cmd_start(struct udevice *dev, struct mmc_cmd *cmd,
+			  struct mmc_data *data);
+int dm_mmc_send_cmd_done(struct udevice *dev);
 int dm_mmc_set_ios(struct udevice *dev);
 void dm_mmc_send_init_stream(struct udevice *dev);
 int dm_mmc_get_cd(struct udevice *dev);
@@ -475,6 +514,9 @@ int dm_mmc_execute_tuning(struct udevice *dev, uint opcode);
 int dm_mmc_wait_dat0(struct udevice *dev, int state, int timeout);
 
 /* Transition functions for compatibility */
+int mmc_send_cmd_start(struct mmc *mmc, struct mmc_cmd *cmd,
+		       struct mmc_data *data);
+int mmc_send_cmd_done(struct mmc *mmc);
 int mmc_set_ios(struct mmc *mmc);
 void mmc_send_init_stream(struct mmc *mmc);
 int mmc_getcd(struct mmc *mmc);
@@ -843,4 +885,20 @@ int mmc_get_env_dev(void);
  */
 struct blk_desc *mmc_get_blk_desc(struct mmc *mmc);
 
+/**
+ * mmc_can_write_in_background() - Check for writes which do not block
+ *
+ * @mmc:	MMC device
+ * @return true if the host can write data while the caller gets on with
+ * something else, i.e. if blk_dsubmit() queues writes to the device
+ */
+#if CONFIG_IS_ENABLED(DM_MMC) && CONFIG_IS_ENABLED(BLK)
+bool mmc_can_write_in_background(struct mmc *mmc);
+#else
+static inline bool mmc_can_write_in_background(struct mmc *mmc)
+{
+	return false;
+}
+#endif
+
 #endif /* _MMC_H_ */
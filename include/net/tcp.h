@@ -0,0 +1,152 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Minimal TCP client
+ */
+
+#ifndef __TCP_H__
+#define __TCP_H__
+
+/*
+ *	Internet Protocol (IP) + TCP header.
+ */
+struct ip_tcp_hdr {
+	u8		ip_hl_v;	/* header length and version	*/
+	u8		ip_tos;		/* type of service		*/
+	u16		ip_len;		/* total length			*/
+	u16		ip_id;		/* identification		*/
+	u16		ip_off;		/* fragment offset field	*/
+	u8		ip_ttl;		/* time to live			*/
+	u8		ip_p;		/* protocol			*/
+	u16		ip_sum;		/* checksum			*/
+	struct in_addr	ip_src;		/* Source IP address		*/
+	struct in_addr	ip_dst;		/* Destination IP address	*/
+	u16		tcp_src;	/* TCP source port		*/
+	u16		tcp_dst;	/* TCP destination port		*/
+	u32		tcp_seq;	/* sequence number		*/
+	u32		tcp_ack;	/* acknowledgment number	*/
+	u8		tcp_hlen;	/* header length, in words << 4	*/
+	u8		tcp_flags;	/* flags			*/
+	u16		tcp_win;	/* receive window		*/
+	u16		tcp_xsum;	/* checksum			*/
+	u16		tcp_ugr;	/* urgent pointer		*/
+} __packed;
+
+#define IP_TCP_HDR_SIZE		(sizeof(struct ip_tcp_hdr))
+#define TCP_HDR_SIZE		(IP_TCP_HDR_SIZE - IP_HDR_SIZE)
+
+/* TCP flags */
+#define TCP_FIN		0x01
+#define TCP_SYN		0x02
+#define TCP_RST		0x04
+#define TCP_PSH		0x08
+#define TCP_ACK		0x10
+
+/* Largest segment which fits in an Ethernet frame (MTU of 1500 bytes) */
+#define TCP_MSS		(1500 - IP_TCP_HDR_SIZE)
+
+/**
+ * enum tcp_event - things which happen to a connection
+ *
+ * @TCP_EVENT_CONNECTED:	the connection is open and data can be sent
+ * @TCP_EVENT_DATA:		more of the stream has been received in order
+ * @TCP_EVENT_CLOSED:		the peer has sent all its data
+ * @TCP_EVENT_RESET:		the connection was refused or reset
+ * @TCP_EVENT_TIMEOUT:		the peer stopped responding
+ */
+enum tcp_event {
+	TCP_EVENT_CONNECTED,
+	TCP_EVENT_DATA,
+	TCP_EVENT_CLOSED,
+	TCP_EVENT_RESET,
+	TCP_EVENT_TIMEOUT,
+};
+
+/**
+ * tcp_rx_f - store data received on the connection
+ *
+ * Data which arrives ahead of a lost segment is offered too, so that it
+ * does not have to be sent again. The handler may refuse it, in which case
+ * it is offered again once everything before it has arrived.
+ *
+ * @offset:	position of the data in the received stream
+ * @data:	the data
+ * @len:	number of bytes of data
+ * @return 0 if the data was stored, -EAGAIN if it is only accepted in
+ * order, or another -ve error to reset the connection
+ */
+typedef int tcp_rx_f(uint offset, const uchar *data, uint len);
+
+/**
+ * tcp_event_f - report something which happened to the connection
+ *
+ * @event:	what happened
+ * @rx_len:	number of bytes of the stream received in order so far
+ */
+typedef void tcp_event_f(enum tcp_event event, uint rx_len);
+
+/**
+ * tcp_connect() - open a connection
+ *
+ * The connection is opened from within net_loop(), which must be running
+ * by the time this returns. Only one connection is supported at a time.
+ *
+ * @dest:	IP address to connect to
+ * @dport:	TCP port to connect to
+ * @rx:		handler for received data
+ * @event:	handler for events on the connection
+ */
+void tcp_connect(struct in_addr dest, int dport, tcp_rx_f *rx,
+		 tcp_event_f *event);
+
+/**
+ * tcp_send() - send data on the connection
+ *
+ * The data is sent once the connection is open. It is not copied, so must
+ * stay in place until the connection is closed.
+ *
+ * @data:	data to send
+ * @len:	number of bytes to send
+ * @return 0 if OK, -EBUSY if there is still data waiting to be sent
+ */
+int tcp_send(const uchar *data, uint len);
+
+/**
+ * tcp_close() - close the connection
+ *
+ * This sends a FIN and forgets the connection, so the handlers are not
+ * called again. Any data which has not been sent yet is dropped. Nothing
+ * happens if there is no connection.
+ */
+void tcp_close(void);
+
+/**
+ * tcp_receive() - handle a TCP segment
+ *
+ * This is called by net_process_received_packet().
+ *
+ * @ip:		IP packet holding the segment
+ * @len:	length of the IP packet
+ */
+void tcp_receive(struct ip_tcp_hdr *ip, int len);
+
+/**
+ * tcp_set_tcp_header() - set up the IP and TCP headers of a segment
+ *
+ * The payload must already be in place at IP_TCP_HDR_SIZE. A SYN carries
+ * options there instead, so must not have a payload.
+ *
+ * @pkt:	start of the IP header
+ * @dest:	destination IP address
+ * @dport:	destination port
+ * @sport:	source port
+ * @payload_len: number of bytes of payload
+ * @action:	TCP flags to set
+ * @tcp_seq_num: sequence number
+ * @tcp_ack_num: acknowledgment number
+ * @return size of the IP and TCP headers
+ */
+int tcp_set_tcp_header(uchar *pkt, struct in_addr dest, int dport, int sport,
+		       int payload_len, u8 action, u32 tcp_seq_num,
+		       u32 tcp_ack_num);
+
+#endif /* __TCP_H__ */
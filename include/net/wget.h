@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Download a file over HTTP
+ */
+
+#ifndef __WGET_H__
+#define __WGET_H__
+
+/* Port the HTTP server listens on */
+#define WGET_HTTP_PORT	80
+
+/**
+ * wget_start() - start downloading the boot file
+ *
+ * This is called by net_loop() to fetch net_boot_file_name, which is a path
+ * optionally preceded by the server's IP address and a colon, to load_addr.
+ */
+void wget_start(void);
+
+#endif /* __WGET_H__ */
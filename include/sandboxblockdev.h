@@ -12,8 +12,27 @@ struct host_block_dev {
 #endif
 	char *filename;
 	int fd;
+#ifdef CONFIG_BLK
+	uint latency_us;	/* Simulated time taken by each request */
+	ulong busy_until;	/* Time (us) when the last request finishes */
+	struct list_head queue;	/* Requests submitted, oldest first */
+#endif
 };
 
 int host_dev_bind(int dev, char *filename);
 
+#ifdef CONFIG_BLK
+/**
+ * host_dev_set_latency() - set the simulated latency of a host device
+ *
+ * The device handles one request at a time and each one takes this long,
+ * whether it is submitted asynchronously or not.
+ *
+ * @devnum:	Host device number
+ * @latency_us:	Time taken by each request, in microseconds
+ * @return 0 if OK, -ve on error
+ */
+int host_dev_set_latency(int devnum, uint latency_us);
+#endif
+
 #endif
@@ -186,6 +186,7 @@
 /* 55-57 reserved */
 
 #define SDHCI_ADMA_ADDRESS	0x58
+#define SDHCI_ADMA_ADDRESS_HI	0x5C
 
 /* 60-FB reserved */
 
@@ -235,6 +236,38 @@ struct sdhci_host;
  */
 #define SDHCI_DEFAULT_BOUNDARY_SIZE	(512 * 1024)
 #define SDHCI_DEFAULT_BOUNDARY_ARG	(7)
+
+/*
+ * ADMA2 descriptors. The length field is 16 bits wide, so each descriptor
+ * covers at most 64KiB. Keep the length a multiple of four, as required for
+ * the addresses of the following descriptors.
+ */
+#define ADMA_MAX_LEN			65532
+#define ADMA_TABLE_NO_ENTRIES \
+	DIV_ROUND_UP(CONFIG_SYS_MMC_MAX_BLK_COUNT * MMC_MAX_BLOCK_LEN, \
+		     ADMA_MAX_LEN)
+#define ADMA_DESC_ATTR_VALID		BIT(0)
+#define ADMA_DESC_ATTR_END		BIT(1)
+#define ADMA_DESC_ATTR_INT		BIT(2)
+#define ADMA_DESC_ATTR_ACT1		BIT(4)
+#define ADMA_DESC_ATTR_ACT2		BIT(5)
+#define ADMA_DESC_TRANSFER_DATA		(ADMA_DESC_ATTR_VALID | \
+					 ADMA_DESC_ATTR_ACT2)
+
+/*
+ * An ADMA2 descriptor. In 32-bit mode the table only holds the first eight
+ * bytes of each descriptor, in 64-bit mode it holds all twelve.
+ */
+struct sdhci_adma_desc {
+	__le16 attr;
+	__le16 len;
+	__le32 addr_lo;
+	__le32 addr_hi;
+} __packed;
+
+#define ADMA_DESC_LEN_32		8
+#define ADMA_DESC_LEN_64		12
+
 struct sdhci_ops {
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
 	u32	(*read_l)(struct sdhci_host *host, int reg);
@@ -272,6 +305,13 @@ struct sdhci_host {
 	uint	voltages;
 
 	struct mmc_config cfg;
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	void *adma_desc_table;		/* NULL if ADMA2 is not used */
+	uint adma_desc_len;		/* ADMA_DESC_LEN_32 or _64 */
+	bool bg_busy;			/* A write is running by itself */
+	int bg_ret;			/* Result of the last such write */
+	ulong bg_start;			/* Time it was started, in ms */
+#endif
 };
 
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
@@ -38,8 +38,9 @@ typedef struct entry {
 	int flags;
 } ENTRY;
 
-/* Opaque type for internal use.  */
+/* Opaque types for internal use.  */
 struct _ENTRY;
+struct _HSLOT;
 
 /*
  * Family of hash table handling functions.  The functions also
@@ -52,6 +53,16 @@ struct hsearch_data {
 	struct _ENTRY *table;
 	unsigned int size;
 	unsigned int filled;
+	/* Hash index of the table; slot_mask + 1 is the number of slots */
+	struct _HSLOT *slots;
+	unsigned int slot_mask;
+	/* Indices of the used entries in the table, sorted by key */
+	unsigned int *order;
+	/* No entry below this index in the table is free */
+	unsigned int next_free;
+	/* Imported environment, which names and values may point into */
+	char *arena;
+	size_t arena_size;
 /*
  * Callback function which will check whether the given change for variable
  * "__item" to "newval" may be applied or not, and possibly apply such change.
@@ -0,0 +1,14 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Tests for the hash algorithms and their CPU-specific backends
+ */
+
+#ifndef __TEST_HASH_H__
+#define __TEST_HASH_H__
+
+#include <test/test.h>
+
+/* Declare a new hash test */
+#define HASH_TEST(_name, _flags)	UNIT_TEST(_name, _flags, hash_test)
+
+#endif /* __TEST_HASH_H__ */
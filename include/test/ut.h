@@ -38,6 +38,24 @@ void ut_failf(struct unit_test_state *uts, const char *fname, int line,
 	      const char *func, const char *cond, const char *fmt, ...)
 			__attribute__ ((format (__printf__, 6, 7)));
 
+/**
+ * ut_pattern() - Get a byte of the test data pattern
+ *
+ * Each 512-byte block of the pattern differs from the 255 blocks around it,
+ * so that data which is read from or written to the wrong block is noticed.
+ *
+ * @offset: Offset of the byte in the pattern
+ * @return the byte at that offset
+ */
+u8 ut_pattern(ulong offset);
+
+/**
+ * ut_fill_pattern() - Fill a buffer with the test data pattern
+ *
+ * @buf: Buffer to fill
+ * @size: Number of bytes to fill, starting at offset 0 in the pattern
+ */
+void ut_fill_pattern(void *buf, ulong size);
 
 /* Assert that a condition is non-zero */
 #define ut_assert(cond)							\
@@ -28,6 +28,10 @@ void crc32_wd_buf(const unsigned char *input, uint ilen,
 		    unsigned char *output, uint chunk_sz);
 
 /* lib/crc32c.c */
+
+/* Number of entries in the table filled in by crc32c_init() */
+#define CRC32C_TABLE_SIZE	(8 * 256)
+
 void crc32c_init(uint32_t *, uint32_t);
 uint32_t crc32c_cal(uint32_t, const char *, int, uint32_t *);
 
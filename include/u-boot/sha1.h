@@ -30,8 +30,11 @@ extern const uint8_t sha1_der_prefix[];
 typedef struct
 {
     unsigned long total[2];	/*!< number of bytes processed	*/
-    unsigned long state[5];	/*!< intermediate digest state	*/
+    uint32_t state[5];		/*!< intermediate digest state	*/
     unsigned char buffer[64];	/*!< data block being processed */
+    /*! block function, chosen by sha1_starts() */
+    void (*process)(uint32_t *state, const uint8_t *data,
+		    unsigned int blocks);
 }
 sha1_context;
 
@@ -13,6 +13,9 @@ typedef struct {
 	uint32_t total[2];
 	uint32_t state[8];
 	uint8_t buffer[64];
+	/* Block function, chosen by sha256_starts() */
+	void (*process)(uint32_t *state, const uint8_t *data,
+			unsigned int blocks);
 } sha256_context;
 
 void sha256_starts(sha256_context * ctx);
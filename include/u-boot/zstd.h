@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Zstandard decompression, see lib/zstd/
+ */
+
+#ifndef __UBOOT_ZSTD_H
+#define __UBOOT_ZSTD_H
+
+#include <linux/types.h>
+
+/**
+ * zstd_decompress() - Decompress Zstandard data
+ *
+ * Data after the last frame which is not a valid frame is ignored, so @srcn
+ * may be larger than the compressed data.
+ *
+ * @src:	Compressed data, which may hold several frames one after another
+ * @srcn:	Number of bytes at @src
+ * @dst:	Place to put the decompressed data
+ * @dstn:	On entry, the space available at @dst. On exit, the number of
+ *		bytes written to @dst
+ * @return 0 if OK, -ENOSPC if @dst is too small, -ENOMEM if there is not
+ * enough memory for the decompression context, or -EPROTO if the data is
+ * corrupt
+ */
+int zstd_decompress(const void *src, size_t srcn, void *dst, size_t *dstn);
+
+struct zstd_stream;
+
+/**
+ * zstd_stream_create() - Set up to decompress Zstandard data in pieces
+ *
+ * All of the data is decompressed to @dst, so no window buffer is needed.
+ *
+ * @dst:	Place to put the decompressed data
+ * @dstn:	Space available at @dst
+ * @return the new stream, or NULL if out of memory
+ */
+struct zstd_stream *zstd_stream_create(void *dst, size_t dstn);
+
+/**
+ * zstd_stream_decompress() - Decompress the next piece of Zstandard data
+ *
+ * All of @src is used unless an error is returned.
+ *
+ * @zs:		Stream to use
+ * @src:	Next piece of compressed data, which may be empty
+ * @srcn:	Number of bytes at @src
+ * @dst_used:	Returns the total number of bytes decompressed so far
+ * @return 0 if the data so far ends at the end of a frame, -EAGAIN if more
+ * data is needed to finish the frame, or another -ve error as for
+ * zstd_decompress()
+ */
+int zstd_stream_decompress(struct zstd_stream *zs, const void *src,
+			   size_t srcn, size_t *dst_used);
+
+/**
+ * zstd_stream_free() - Free a stream set up by zstd_stream_create()
+ *
+ * @zs:		Stream to free, or NULL
+ */
+void zstd_stream_free(struct zstd_stream *zs);
+
+#endif /* __UBOOT_ZSTD_H */
@@ -102,6 +102,7 @@ struct virtqueue {
 	unsigned int index;
 	unsigned int num_free;
 	struct vring vring;
+	bool indirect;
 	bool event;
 	unsigned int free_head;
 	unsigned int num_added;
@@ -13,6 +13,7 @@
 #else
 #include <common.h>
 #include <efi_loader.h>
+#include <hash.h>
 #endif
 #include <compiler.h>
 #include <u-boot/crc.h>
@@ -29,10 +30,27 @@
 
 #define tole(x) cpu_to_le32(x)
 
+/*
+ * The slice-by-8 code reads eight bytes at a time and looks each of them up
+ * in its own table. It is only used on little-endian machines.
+ */
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#ifdef USE_HOSTCC
+#define CRC32_SLICE_BY_8
+#else
+#if CONFIG_IS_ENABLED(CRC32_SLICE_BY_8)
+#define CRC32_SLICE_BY_8
+#endif
+#endif
+#endif
+
 #ifdef CONFIG_DYNAMIC_CRC_TABLE
 
 static int __efi_runtime_data crc_table_empty = 1;
 static uint32_t __efi_runtime_data crc_table[256];
+#ifdef CRC32_SLICE_BY_8
+static uint32_t __efi_runtime_data crc_slice_table[7][256];
+#endif
 static void __efi_runtime make_crc_table OF((void));
 
 /*
@@ -79,6 +97,17 @@ static void __efi_runtime make_crc_table(void)
       c = c & 1 ? poly ^ (c >> 1) : c >> 1;
     crc_table[n] = tole(c);
   }
+#ifdef CRC32_SLICE_BY_8
+  for (n = 0; n < 256; n++)
+  {
+    c = crc_table[n];
+    for (k = 0; k < 7; k++)
+    {
+      c = crc_table[c & 0xff] ^ (c >> 8);
+      crc_slice_table[k][n] = c;
+    }
+  }
+#endif
   crc_table_empty = 0;
 }
 #else
@@ -152,6 +181,10 @@ tole(0xbad03605L), tole(0xcdd70693L), tole(0x54de5729L), tole(0x23d967bfL),
 tole(0xb3667a2eL), tole(0xc4614ab8L), tole(0x5d681b02L), tole(0x2a6f2b94L),
 tole(0xb40bbe37L), tole(0xc30c8ea1L), tole(0x5a05df1bL), tole(0x2d02ef8dL)
 };
+
+#ifdef CRC32_SLICE_BY_8
+#include "crc32table.h"
+#endif
 #endif
 
 #if 0
@@ -198,6 +231,23 @@ uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 	 b = (uint32_t *)p;
     }
 
+#ifdef CRC32_SLICE_BY_8
+    /* fold in eight bytes with one lookup in each of the eight tables */
+    for (; len >= 8; len -= 8) {
+	 uint32_t one = *b++ ^ crc;
+	 uint32_t two = *b++;
+
+	 crc = crc_slice_table[6][one & 255] ^
+	       crc_slice_table[5][(one >> 8) & 255] ^
+	       crc_slice_table[4][(one >> 16) & 255] ^
+	       crc_slice_table[3][one >> 24] ^
+	       crc_slice_table[2][two & 255] ^
+	       crc_slice_table[1][(two >> 8) & 255] ^
+	       crc_slice_table[0][(two >> 16) & 255] ^
+	       tab[two >> 24];
+    }
+#endif
+
     rem_len = len & 3;
     len = len >> 2;
     for (--b; len; --len) {
@@ -226,6 +276,43 @@ uint32_t __efi_runtime crc32(uint32_t crc, const Bytef *p, uInt len)
      return crc32_no_comp(crc ^ 0xffffffffL, p, len) ^ 0xffffffffL;
 }
 
+#if !defined(USE_HOSTCC) && defined(CONFIG_CRC32_BACKEND)
+static void crc32_process_generic(uint32_t *state, const uint8_t *data,
+				  unsigned int blocks)
+{
+	*state = crc32_no_comp(*state, data, blocks * 64);
+}
+
+U_BOOT_HASH_BACKEND(crc32_generic) = {
+	.algo		= "crc32",
+	.name		= "generic",
+	.priority	= 0,
+	.process	= crc32_process_generic,
+};
+
+/*
+ * Like crc32(), but hand whole 64-byte blocks to @backend. This is not
+ * available to EFI runtime services, which is why crc32() does not use it.
+ */
+static uint32_t crc32_backend(const struct hash_backend *backend,
+			      uint32_t crc, const unsigned char *buf, uInt len)
+{
+	uInt blocks = len / 64;
+
+	crc ^= 0xffffffffL;
+	if (blocks) {
+		backend->process(&crc, buf, blocks);
+		buf += blocks * 64;
+		len -= blocks * 64;
+	}
+
+	return crc32_no_comp(crc, buf, len) ^ 0xffffffffL;
+}
+#define CRC32_FUNC(crc, buf, len) crc32_backend(backend, crc, buf, len)
+#else
+#define CRC32_FUNC(crc, buf, len) crc32(crc, buf, len)
+#endif
+
 /*
  * Calculate the crc32 checksum triggering the watchdog every 'chunk_sz' bytes
  * of input.
@@ -233,6 +320,9 @@ uint32_t __efi_runtime crc32(uint32_t crc, const Bytef *p, uInt len)
 uint32_t crc32_wd(uint32_t crc, const unsigned char *buf, uInt len,
 		  uInt chunk_sz)
 {
+#if !defined(USE_HOSTCC) && defined(CONFIG_CRC32_BACKEND)
+	const struct hash_backend *backend = hash_backend_find("crc32");
+#endif
 #if defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG)
 	const unsigned char *end, *curr;
 	int chunk;
@@ -243,12 +333,12 @@ uint32_t crc32_wd(uint32_t crc, const unsigned char *buf, uInt len,
 		chunk = end - curr;
 		if (chunk > chunk_sz)
 			chunk = chunk_sz;
-		crc = crc32 (crc, curr, chunk);
+		crc = CRC32_FUNC(crc, curr, chunk);
 		curr += chunk;
 		WATCHDOG_RESET ();
 	}
 #else
-	crc = crc32 (crc, buf, len);
+	crc = CRC32_FUNC(crc, buf, len);
 #endif
 
 	return crc;
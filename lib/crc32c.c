@@ -12,18 +12,38 @@
 
 #include <common.h>
 #include <compiler.h>
+#include <u-boot/crc.h>
+#include <asm/unaligned.h>
 
+/*
+ * The table passed in holds eight 256-entry tables: table k gives the CRC of
+ * a byte followed by k zero bytes, so that eight bytes can be folded into
+ * the CRC at a time (slice-by-8).
+ */
 uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
 		    uint32_t *crc32c_table)
 {
-	while (length--)
-		crc = crc32c_table[(u8)(crc ^ *data++)] ^ (crc >> 8);
+	const uint32_t (*t)[256] = (const uint32_t (*)[256])crc32c_table;
+	const u8 *p = (const u8 *)data;
+	uint32_t one, two;
+
+	for (; length >= 8; length -= 8, p += 8) {
+		one = get_unaligned_le32(p) ^ crc;
+		two = get_unaligned_le32(p + 4);
+		crc = t[7][one & 0xff] ^ t[6][(one >> 8) & 0xff] ^
+		      t[5][(one >> 16) & 0xff] ^ t[4][one >> 24] ^
+		      t[3][two & 0xff] ^ t[2][(two >> 8) & 0xff] ^
+		      t[1][(two >> 16) & 0xff] ^ t[0][two >> 24];
+	}
+	while (length-- > 0)
+		crc = t[0][(u8)(crc ^ *p++)] ^ (crc >> 8);
 
 	return crc;
 }
 
 void crc32c_init(uint32_t *crc32c_table, uint32_t pol)
 {
+	uint32_t (*t)[256] = (uint32_t (*)[256])crc32c_table;
 	int i, j;
 	uint32_t v;
 	const uint32_t poly = pol; /* Bit-reflected CRC32C polynomial */
@@ -33,6 +53,14 @@ void crc32c_init(uint32_t *crc32c_table, uint32_t pol)
 		for (j = 0; j < 8; j++)
 			v = (v >> 1) ^ ((v & 1) ? poly : 0);
 
-		crc32c_table[i] = v;
+		t[0][i] = v;
+	}
+
+	for (i = 0; i < 256; i++) {
+		v = t[0][i];
+		for (j = 1; j < CRC32C_TABLE_SIZE / 256; j++) {
+			v = t[0][v & 0xff] ^ (v >> 8);
+			t[j][i] = v;
+		}
 	}
 }
@@ -10,23 +10,31 @@
 #include <malloc.h>
 #include <mapmem.h>
 #include <watchdog.h>
-#include <linux/list_sort.h>
+#include <linux/rbtree_augmented.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
 efi_uintn_t efi_memory_map_key;
 
+/*
+ * The memory map is kept in a red-black tree sorted by physical address. The
+ * regions never overlap and adjacent regions with the same type and
+ * attributes are always merged, so there is one node per map entry.
+ *
+ * Each node also records the size of the largest free (conventional memory)
+ * region in its subtree, which lets efi_find_free_memory() skip whole
+ * subtrees which cannot satisfy a request.
+ */
 struct efi_mem_list {
-	struct list_head link;
+	struct rb_node node;
 	struct efi_mem_desc desc;
+	u64 max_free_pages;
 };
 
-#define EFI_CARVE_NO_OVERLAP		-1
-#define EFI_CARVE_LOOP_AGAIN		-2
-#define EFI_CARVE_OVERLAPS_NONRAM	-3
-
-/* This list contains all memory map items */
-LIST_HEAD(efi_mem);
+/* This tree contains all memory map items */
+static struct rb_root efi_mem = RB_ROOT;
+/* Number of items in efi_mem */
+static efi_uintn_t efi_mem_entries;
 
 #ifdef CONFIG_EFI_LOADER_BOUNCE_BUFFER
 void *efi_bounce_buffer;
@@ -45,163 +53,207 @@ struct efi_pool_allocation {
 	char data[] __aligned(ARCH_DMA_MINALIGN);
 };
 
-/*
- * Sorts the memory list from highest address to lowest address
- *
- * When allocating memory we should always start from the highest
- * address chunk, so sort the memory list such that the first list
- * iterator gets the highest address and goes lower from there.
- */
-static int efi_mem_cmp(void *priv, struct list_head *a, struct list_head *b)
+static uint64_t desc_get_end(struct efi_mem_desc *desc)
+{
+	return desc->physical_start + (desc->num_pages << EFI_PAGE_SHIFT);
+}
+
+static inline struct efi_mem_list *efi_mem_entry(struct rb_node *node)
 {
-	struct efi_mem_list *mema = list_entry(a, struct efi_mem_list, link);
-	struct efi_mem_list *memb = list_entry(b, struct efi_mem_list, link);
+	return rb_entry_safe(node, struct efi_mem_list, node);
+}
 
-	if (mema->desc.physical_start == memb->desc.physical_start)
-		return 0;
-	else if (mema->desc.physical_start < memb->desc.physical_start)
-		return 1;
-	else
-		return -1;
+static u64 efi_mem_compute_max_free(struct efi_mem_list *mem)
+{
+	struct efi_mem_list *child;
+	u64 max = 0;
+
+	if (mem->desc.type == EFI_CONVENTIONAL_MEMORY)
+		max = mem->desc.num_pages;
+	child = efi_mem_entry(mem->node.rb_left);
+	if (child && child->max_free_pages > max)
+		max = child->max_free_pages;
+	child = efi_mem_entry(mem->node.rb_right);
+	if (child && child->max_free_pages > max)
+		max = child->max_free_pages;
+
+	return max;
 }
 
-static uint64_t desc_get_end(struct efi_mem_desc *desc)
+RB_DECLARE_CALLBACKS(static, efi_mem_augment, struct efi_mem_list, node,
+		     u64, max_free_pages, efi_mem_compute_max_free)
+
+/* Update the tree after the size or type of an item has changed */
+static void efi_mem_update(struct efi_mem_list *mem)
 {
-	return desc->physical_start + (desc->num_pages << EFI_PAGE_SHIFT);
+	efi_mem_augment_propagate(&mem->node, NULL);
+}
+
+static void efi_mem_insert(struct efi_mem_list *mem)
+{
+	struct rb_node **link = &efi_mem.rb_node, *parent = NULL;
+	struct efi_mem_list *cur;
+
+	while (*link) {
+		parent = *link;
+		cur = efi_mem_entry(parent);
+		/* Keep max_free_pages correct on the way down */
+		if (cur->max_free_pages < mem->max_free_pages)
+			cur->max_free_pages = mem->max_free_pages;
+		if (mem->desc.physical_start < cur->desc.physical_start)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&mem->node, parent, link);
+	rb_insert_augmented(&mem->node, &efi_mem, &efi_mem_augment);
+	efi_mem_entries++;
+}
+
+static void efi_mem_remove(struct efi_mem_list *mem)
+{
+	rb_erase_augmented(&mem->node, &efi_mem, &efi_mem_augment);
+	efi_mem_entries--;
+	free(mem);
 }
 
-static void efi_mem_sort(void)
+/*
+ * Find the lowest item which ends above @addr. As the items do not overlap
+ * this is the first one which can overlap a region starting at @addr.
+ */
+static struct efi_mem_list *efi_mem_find(uint64_t addr)
 {
-	struct list_head *lhandle;
-	struct efi_mem_list *prevmem = NULL;
-	bool merge_again = true;
-
-	list_sort(NULL, &efi_mem, efi_mem_cmp);
-
-	/* Now merge entries that can be merged */
-	while (merge_again) {
-		merge_again = false;
-		list_for_each(lhandle, &efi_mem) {
-			struct efi_mem_list *lmem;
-			struct efi_mem_desc *prev = &prevmem->desc;
-			struct efi_mem_desc *cur;
-			uint64_t pages;
-
-			lmem = list_entry(lhandle, struct efi_mem_list, link);
-			if (!prevmem) {
-				prevmem = lmem;
-				continue;
-			}
-
-			cur = &lmem->desc;
-
-			if ((desc_get_end(cur) == prev->physical_start) &&
-			    (prev->type == cur->type) &&
-			    (prev->attribute == cur->attribute)) {
-				/* There is an existing map before, reuse it */
-				pages = cur->num_pages;
-				prev->num_pages += pages;
-				prev->physical_start -= pages << EFI_PAGE_SHIFT;
-				prev->virtual_start -= pages << EFI_PAGE_SHIFT;
-				list_del(&lmem->link);
-				free(lmem);
-
-				merge_again = true;
-				break;
-			}
-
-			prevmem = lmem;
+	struct rb_node *node = efi_mem.rb_node;
+	struct efi_mem_list *found = NULL;
+
+	while (node) {
+		struct efi_mem_list *mem = efi_mem_entry(node);
+
+		if (desc_get_end(&mem->desc) > addr) {
+			found = mem;
+			node = node->rb_left;
+		} else {
+			node = node->rb_right;
 		}
 	}
+
+	return found;
+}
+
+/*
+ * Merge @mem with the items either side of it if they are adjacent and have
+ * the same type and attributes
+ */
+static void efi_mem_merge(struct efi_mem_list *mem)
+{
+	struct efi_mem_list *prev = efi_mem_entry(rb_prev(&mem->node));
+	struct efi_mem_list *next = efi_mem_entry(rb_next(&mem->node));
+	struct efi_mem_desc *desc = &mem->desc;
+
+	if (prev && desc_get_end(&prev->desc) == desc->physical_start &&
+	    prev->desc.type == desc->type &&
+	    prev->desc.attribute == desc->attribute) {
+		desc->physical_start = prev->desc.physical_start;
+		desc->virtual_start = prev->desc.virtual_start;
+		desc->num_pages += prev->desc.num_pages;
+		efi_mem_remove(prev);
+		efi_mem_update(mem);
+	}
+
+	if (next && desc_get_end(desc) == next->desc.physical_start &&
+	    next->desc.type == desc->type &&
+	    next->desc.attribute == desc->attribute) {
+		desc->num_pages += next->desc.num_pages;
+		efi_mem_remove(next);
+		efi_mem_update(mem);
+	}
 }
 
-/** efi_mem_carve_out - unmap memory region
+/**
+ * efi_mem_check_ram() - check that a region only covers free RAM
  *
- * @map:		memory map
- * @carve_desc:		memory region to unmap
- * @overlap_only_ram:	the carved out region may only overlap RAM
- * Return Value:	the number of overlapping pages which have been
- *			removed from the map,
- *			EFI_CARVE_NO_OVERLAP, if the regions don't overlap,
- *			EFI_CARVE_OVERLAPS_NONRAM, if the carve and map overlap,
- *			and the map contains anything but free ram
- *			(only when overlap_only_ram is true),
- *			EFI_CARVE_LOOP_AGAIN, if the mapping list should be
- *			traversed again, as it has been altered.
+ * @start:		start address of the region
+ * @end:		end address of the region
+ * Return Value:	true if every page in the region is conventional memory
+ */
+static bool efi_mem_check_ram(uint64_t start, uint64_t end)
+{
+	struct efi_mem_list *mem = efi_mem_find(start);
+
+	while (start < end) {
+		if (!mem || mem->desc.physical_start > start ||
+		    mem->desc.type != EFI_CONVENTIONAL_MEMORY)
+			return false;
+		start = desc_get_end(&mem->desc);
+		mem = efi_mem_entry(rb_next(&mem->node));
+	}
+
+	return true;
+}
+
+/**
+ * efi_mem_carve_out() - unmap memory region
  *
- * Unmaps all memory occupied by the carve_desc region from the list entry
- * pointed to by map.
+ * @start:	start address of the region to unmap
+ * @end:	end address of the region to unmap
  *
- * In case of EFI_CARVE_OVERLAPS_NONRAM it is the callers responsibility
- * to re-add the already carved out pages to the mapping.
+ * Removes the region from all the items which overlap it. Items which lie
+ * entirely within the region are deleted and items which straddle one of
+ * its ends are shrunk, or split in two if they cover the whole region.
  */
-static s64 efi_mem_carve_out(struct efi_mem_list *map,
-			     struct efi_mem_desc *carve_desc,
-			     bool overlap_only_ram)
+static void efi_mem_carve_out(uint64_t start, uint64_t end)
 {
-	struct efi_mem_list *newmap;
-	struct efi_mem_desc *map_desc = &map->desc;
-	uint64_t map_start = map_desc->physical_start;
-	uint64_t map_end = map_start + (map_desc->num_pages << EFI_PAGE_SHIFT);
-	uint64_t carve_start = carve_desc->physical_start;
-	uint64_t carve_end = carve_start +
-			     (carve_desc->num_pages << EFI_PAGE_SHIFT);
-
-	/* check whether we're overlapping */
-	if ((carve_end <= map_start) || (carve_start >= map_end))
-		return EFI_CARVE_NO_OVERLAP;
-
-	/* We're overlapping with non-RAM, warn the caller if desired */
-	if (overlap_only_ram && (map_desc->type != EFI_CONVENTIONAL_MEMORY))
-		return EFI_CARVE_OVERLAPS_NONRAM;
-
-	/* Sanitize carve_start and carve_end to lie within our bounds */
-	carve_start = max(carve_start, map_start);
-	carve_end = min(carve_end, map_end);
-
-	/* Carving at the beginning of our map? Just move it! */
-	if (carve_start == map_start) {
-		if (map_end == carve_end) {
-			/* Full overlap, just remove map */
-			list_del(&map->link);
-			free(map);
+	struct efi_mem_list *mem = efi_mem_find(start);
+
+	while (mem && mem->desc.physical_start < end) {
+		struct efi_mem_list *next = efi_mem_entry(rb_next(&mem->node));
+		struct efi_mem_desc *desc = &mem->desc;
+		uint64_t map_start = desc->physical_start;
+		uint64_t map_end = desc_get_end(desc);
+
+		if (map_start < start && map_end > end) {
+			/*
+			 * The region is in the middle of this item, split it
+			 *
+			 * [ mem |__start__ ... __end__| newmem ]
+			 */
+			struct efi_mem_list *newmem;
+
+			newmem = calloc(1, sizeof(*newmem));
+			newmem->desc = *desc;
+			newmem->desc.physical_start = end;
+			newmem->desc.virtual_start = end;
+			newmem->desc.num_pages = (map_end - end) >>
+						 EFI_PAGE_SHIFT;
+			newmem->max_free_pages =
+				efi_mem_compute_max_free(newmem);
+			desc->num_pages = (start - map_start) >> EFI_PAGE_SHIFT;
+			efi_mem_update(mem);
+			efi_mem_insert(newmem);
+			break;
+		} else if (map_start < start) {
+			/* Shrink the item to [ map_start ... start ] */
+			desc->num_pages = (start - map_start) >> EFI_PAGE_SHIFT;
+			efi_mem_update(mem);
+		} else if (map_end > end) {
+			/* Move the item to [ end ... map_end ] */
+			desc->physical_start = end;
+			desc->virtual_start = end;
+			desc->num_pages = (map_end - end) >> EFI_PAGE_SHIFT;
+			efi_mem_update(mem);
 		} else {
-			map->desc.physical_start = carve_end;
-			map->desc.num_pages = (map_end - carve_end)
-					      >> EFI_PAGE_SHIFT;
+			/* Full overlap, just remove the item */
+			efi_mem_remove(mem);
 		}
-
-		return (carve_end - carve_start) >> EFI_PAGE_SHIFT;
+		mem = next;
 	}
-
-	/*
-	 * Overlapping maps, just split the list map at carve_start,
-	 * it will get moved or removed in the next iteration.
-	 *
-	 * [ map_desc |__carve_start__| newmap ]
-	 */
-
-	/* Create a new map from [ carve_start ... map_end ] */
-	newmap = calloc(1, sizeof(*newmap));
-	newmap->desc = map->desc;
-	newmap->desc.physical_start = carve_start;
-	newmap->desc.num_pages = (map_end - carve_start) >> EFI_PAGE_SHIFT;
-	/* Insert before current entry (descending address order) */
-	list_add_tail(&newmap->link, &map->link);
-
-	/* Shrink the map to [ map_start ... carve_start ] */
-	map_desc->num_pages = (carve_start - map_start) >> EFI_PAGE_SHIFT;
-
-	return EFI_CARVE_LOOP_AGAIN;
 }
 
 uint64_t efi_add_memory_map(uint64_t start, uint64_t pages, int memory_type,
 			    bool overlap_only_ram)
 {
-	struct list_head *lhandle;
-	struct efi_mem_list *newlist;
-	bool carve_again;
-	uint64_t carved_pages = 0;
+	struct efi_mem_list *newmem;
+	uint64_t end = start + (pages << EFI_PAGE_SHIFT);
 
 	debug("%s: 0x%llx 0x%llx %d %s\n", __func__,
 	      start, pages, memory_type, overlap_only_ram ? "yes" : "no");
@@ -212,118 +264,81 @@ uint64_t efi_add_memory_map(uint64_t start, uint64_t pages, int memory_type,
 	if (!pages)
 		return start;
 
+	if (overlap_only_ram && !efi_mem_check_ram(start, end)) {
+		/*
+		 * The payload wanted to have RAM overlaps, but we overlapped
+		 * with a non-RAM or unallocated region. Error out.
+		 */
+		return 0;
+	}
+
 	++efi_memory_map_key;
-	newlist = calloc(1, sizeof(*newlist));
-	newlist->desc.type = memory_type;
-	newlist->desc.physical_start = start;
-	newlist->desc.virtual_start = start;
-	newlist->desc.num_pages = pages;
+	newmem = calloc(1, sizeof(*newmem));
+	newmem->desc.type = memory_type;
+	newmem->desc.physical_start = start;
+	newmem->desc.virtual_start = start;
+	newmem->desc.num_pages = pages;
 
 	switch (memory_type) {
 	case EFI_RUNTIME_SERVICES_CODE:
 	case EFI_RUNTIME_SERVICES_DATA:
-		newlist->desc.attribute = EFI_MEMORY_WB | EFI_MEMORY_RUNTIME;
+		newmem->desc.attribute = EFI_MEMORY_WB | EFI_MEMORY_RUNTIME;
 		break;
 	case EFI_MMAP_IO:
-		newlist->desc.attribute = EFI_MEMORY_RUNTIME;
+		newmem->desc.attribute = EFI_MEMORY_RUNTIME;
 		break;
 	default:
-		newlist->desc.attribute = EFI_MEMORY_WB;
+		newmem->desc.attribute = EFI_MEMORY_WB;
 		break;
 	}
+	newmem->max_free_pages = efi_mem_compute_max_free(newmem);
 
-	/* Add our new map */
-	do {
-		carve_again = false;
-		list_for_each(lhandle, &efi_mem) {
-			struct efi_mem_list *lmem;
-			s64 r;
-
-			lmem = list_entry(lhandle, struct efi_mem_list, link);
-			r = efi_mem_carve_out(lmem, &newlist->desc,
-					      overlap_only_ram);
-			switch (r) {
-			case EFI_CARVE_OVERLAPS_NONRAM:
-				/*
-				 * The user requested to only have RAM overlaps,
-				 * but we hit a non-RAM region. Error out.
-				 */
-				return 0;
-			case EFI_CARVE_NO_OVERLAP:
-				/* Just ignore this list entry */
-				break;
-			case EFI_CARVE_LOOP_AGAIN:
-				/*
-				 * We split an entry, but need to loop through
-				 * the list again to actually carve it.
-				 */
-				carve_again = true;
-				break;
-			default:
-				/* We carved a number of pages */
-				carved_pages += r;
-				carve_again = true;
-				break;
-			}
-
-			if (carve_again) {
-				/* The list changed, we need to start over */
-				break;
-			}
-		}
-	} while (carve_again);
-
-	if (overlap_only_ram && (carved_pages != pages)) {
-		/*
-		 * The payload wanted to have RAM overlaps, but we overlapped
-		 * with an unallocated region. Error out.
-		 */
-		return 0;
-	}
-
-	/* Add our new map */
-        list_add_tail(&newlist->link, &efi_mem);
-
-	/* And make sure memory is listed in descending order */
-	efi_mem_sort();
+	/* Remove whatever was mapped there before and add our new map */
+	efi_mem_carve_out(start, end);
+	efi_mem_insert(newmem);
+	efi_mem_merge(newmem);
 
 	return start;
 }
 
-static uint64_t efi_find_free_memory(uint64_t len, uint64_t max_addr)
+/*
+ * Find the highest address below max_addr at which there are len bytes of
+ * free memory in the subtree at node, or 0 if there is none
+ */
+static uint64_t efi_find_free_in(struct rb_node *node, uint64_t len,
+				 uint64_t max_addr)
 {
-	struct list_head *lhandle;
-
-	list_for_each(lhandle, &efi_mem) {
-		struct efi_mem_list *lmem = list_entry(lhandle,
-			struct efi_mem_list, link);
-		struct efi_mem_desc *desc = &lmem->desc;
-		uint64_t desc_len = desc->num_pages << EFI_PAGE_SHIFT;
-		uint64_t desc_end = desc->physical_start + desc_len;
-		uint64_t curmax = min(max_addr, desc_end);
-		uint64_t ret = curmax - len;
-
-		/* We only take memory from free RAM */
-		if (desc->type != EFI_CONVENTIONAL_MEMORY)
-			continue;
-
-		/* Out of bounds for max_addr */
-		if ((ret + len) > max_addr)
-			continue;
+	struct efi_mem_list *mem = efi_mem_entry(node);
+	struct efi_mem_desc *desc;
+	uint64_t ret, curmax;
 
-		/* Out of bounds for upper map limit */
-		if ((ret + len) > desc_end)
-			continue;
+	/* No free region in this subtree is large enough */
+	if (!mem || (mem->max_free_pages << EFI_PAGE_SHIFT) < len)
+		return 0;
 
-		/* Out of bounds for lower map limit */
-		if (ret < desc->physical_start)
-			continue;
+	desc = &mem->desc;
+	/* Try the higher addresses first, unless they are all above max_addr */
+	if (desc_get_end(desc) < max_addr) {
+		ret = efi_find_free_in(node->rb_right, len, max_addr);
+		if (ret)
+			return ret;
+	}
 
+	/* We only take memory from free RAM */
+	if (desc->type == EFI_CONVENTIONAL_MEMORY &&
+	    desc->physical_start < max_addr) {
+		curmax = min(max_addr, desc_get_end(desc));
 		/* Return the highest address in this map within bounds */
-		return ret;
+		if (curmax - desc->physical_start >= len)
+			return curmax - len;
 	}
 
-	return 0;
+	return efi_find_free_in(node->rb_left, len, max_addr);
+}
+
+static uint64_t efi_find_free_memory(uint64_t len, uint64_t max_addr)
+{
+	return efi_find_free_in(efi_mem.rb_node, len, max_addr);
 }
 
 /*
@@ -415,7 +430,6 @@ efi_status_t efi_free_pages(uint64_t memory, efi_uintn_t pages)
 	uint64_t addr = map_to_sysmem((void *)(uintptr_t)memory);
 
 	r = efi_add_memory_map(addr, pages, EFI_CONVENTIONAL_MEMORY, false);
-	/* Merging of adjacent free regions is missing */
 
 	if (r == addr)
 		return EFI_SUCCESS;
@@ -498,8 +512,7 @@ efi_status_t efi_get_memory_map(efi_uintn_t *memory_map_size,
 				uint32_t *descriptor_version)
 {
 	efi_uintn_t map_size = 0;
-	int map_entries = 0;
-	struct list_head *lhandle;
+	struct rb_node *node;
 	efi_uintn_t provided_map_size;
 
 	if (!memory_map_size)
@@ -507,10 +520,7 @@ efi_status_t efi_get_memory_map(efi_uintn_t *memory_map_size,
 
 	provided_map_size = *memory_map_size;
 
-	list_for_each(lhandle, &efi_mem)
-		map_entries++;
-
-	map_size = map_entries * sizeof(struct efi_mem_desc);
+	map_size = efi_mem_entries * sizeof(struct efi_mem_desc);
 
 	*memory_map_size = map_size;
 
@@ -526,16 +536,9 @@ efi_status_t efi_get_memory_map(efi_uintn_t *memory_map_size,
 	if (descriptor_version)
 		*descriptor_version = EFI_MEMORY_DESCRIPTOR_VERSION;
 
-	/* Copy list into array */
-	/* Return the list in ascending order */
-	memory_map = &memory_map[map_entries - 1];
-	list_for_each(lhandle, &efi_mem) {
-		struct efi_mem_list *lmem;
-
-		lmem = list_entry(lhandle, struct efi_mem_list, link);
-		*memory_map = lmem->desc;
-		memory_map--;
-	}
+	/* Copy the tree into the array in ascending order */
+	for (node = rb_first(&efi_mem); node; node = rb_next(node))
+		*memory_map++ = efi_mem_entry(node)->desc;
 
 	if (map_key)
 		*map_key = efi_memory_map_key;
@@ -0,0 +1,243 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * efi_selftest_memory
+ *
+ * This unit test stresses the memory allocation services. Many pages and
+ * pool buffers are allocated and freed again in an order which fragments the
+ * memory map. Afterwards the memory map must be the same as before. The time
+ * taken is reported.
+ */
+
+#include <efi_selftest.h>
+
+/* Number of allocations made by each pass of the test */
+#define EFI_ST_MEM_ALLOCS 10000
+
+static struct efi_boot_services *boottime;
+static struct efi_runtime_services *runtime;
+static u64 *addrs;
+static struct efi_mem_desc *map_before, *map_after;
+static efi_uintn_t map_buf_size;
+
+/*
+ * Get the current time in milliseconds since the start of the day.
+ *
+ * @ms:		time in milliseconds
+ * @return:	true if the time could be read
+ */
+static bool get_ms(unsigned int *ms)
+{
+	struct efi_time tm;
+
+	if (runtime->get_time(&tm, NULL) != EFI_SUCCESS)
+		return false;
+	*ms = ((tm.hour * 60 + tm.minute) * 60 + tm.second) * 1000 +
+	      tm.nanosecond / 1000000;
+
+	return true;
+}
+
+/*
+ * Read the memory map.
+ *
+ * @map:	buffer for the memory map
+ * @map_size:	size of the memory map read
+ * @return:	EFI_ST_SUCCESS for success
+ */
+static int get_map(struct efi_mem_desc *map, efi_uintn_t *map_size)
+{
+	efi_uintn_t map_key, desc_size;
+	u32 desc_version;
+	efi_status_t ret;
+
+	*map_size = map_buf_size;
+	ret = boottime->get_memory_map(map_size, map, &map_key, &desc_size,
+				       &desc_version);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("GetMemoryMap failed\n");
+		return EFI_ST_FAILURE;
+	}
+
+	return EFI_ST_SUCCESS;
+}
+
+/*
+ * Setup unit test.
+ *
+ * Allocate the buffers for the test before the initial memory map is read.
+ *
+ * @handle:	handle of the loaded image
+ * @systable:	system table
+ * @return:	EFI_ST_SUCCESS for success
+ */
+static int setup(const efi_handle_t handle,
+		 const struct efi_system_table *systable)
+{
+	efi_uintn_t map_key, desc_size;
+	u32 desc_version;
+	efi_status_t ret;
+
+	boottime = systable->boottime;
+	runtime = systable->runtime;
+
+	ret = boottime->allocate_pool(EFI_LOADER_DATA,
+				      EFI_ST_MEM_ALLOCS * sizeof(*addrs),
+				      (void **)&addrs);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Out of memory\n");
+		return EFI_ST_FAILURE;
+	}
+
+	map_buf_size = 0;
+	ret = boottime->get_memory_map(&map_buf_size, NULL, &map_key,
+				       &desc_size, &desc_version);
+	if (ret != EFI_BUFFER_TOO_SMALL) {
+		efi_st_error(
+			"GetMemoryMap did not return EFI_BUFFER_TOO_SMALL\n");
+		return EFI_ST_FAILURE;
+	}
+	/* Allow for the two buffers allocated here */
+	map_buf_size += 4 * sizeof(struct efi_mem_desc);
+	ret = boottime->allocate_pool(EFI_LOADER_DATA, map_buf_size,
+				      (void **)&map_before);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Out of memory\n");
+		return EFI_ST_FAILURE;
+	}
+	ret = boottime->allocate_pool(EFI_LOADER_DATA, map_buf_size,
+				      (void **)&map_after);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Out of memory\n");
+		return EFI_ST_FAILURE;
+	}
+
+	return EFI_ST_SUCCESS;
+}
+
+/*
+ * Tear down unit test.
+ *
+ * @return:	EFI_ST_SUCCESS for success
+ */
+static int teardown(void)
+{
+	int ret = EFI_ST_SUCCESS;
+
+	if (map_after && boottime->free_pool(map_after) != EFI_SUCCESS)
+		ret = EFI_ST_FAILURE;
+	map_after = NULL;
+	if (map_before && boottime->free_pool(map_before) != EFI_SUCCESS)
+		ret = EFI_ST_FAILURE;
+	map_before = NULL;
+	if (addrs && boottime->free_pool(addrs) != EFI_SUCCESS)
+		ret = EFI_ST_FAILURE;
+	addrs = NULL;
+	if (ret != EFI_ST_SUCCESS)
+		efi_st_error("FreePool failed\n");
+
+	return ret;
+}
+
+/*
+ * Free every other allocation, then the remaining ones.
+ *
+ * @count:	number of allocations in addrs
+ * @pool:	true for pool buffers, false for pages
+ * @return:	EFI_ST_SUCCESS for success
+ */
+static int free_all(int count, bool pool)
+{
+	efi_status_t ret;
+	int i, pass;
+
+	for (pass = 0; pass < 2; ++pass) {
+		for (i = pass; i < count; i += 2) {
+			if (pool)
+				ret = boottime->free_pool(
+						(void *)(uintptr_t)addrs[i]);
+			else
+				ret = boottime->free_pages(addrs[i], 1);
+			if (ret != EFI_SUCCESS) {
+				efi_st_error("Freeing memory failed\n");
+				return EFI_ST_FAILURE;
+			}
+		}
+	}
+
+	return EFI_ST_SUCCESS;
+}
+
+/*
+ * Execute unit test.
+ *
+ * Allocate single pages of alternating memory types, so that neighbouring
+ * regions cannot be merged, and free every other allocation first. Then do
+ * the same with pool buffers of different sizes. Boards with too little
+ * memory run the test with as many allocations as fit. Check that the memory
+ * map is restored and report the time taken.
+ *
+ * @return:	EFI_ST_SUCCESS for success
+ */
+static int execute(void)
+{
+	efi_uintn_t size_before, size_after;
+	unsigned int start_ms, end_ms, calls = 0;
+	bool timed;
+	int i;
+
+	if (get_map(map_before, &size_before) != EFI_ST_SUCCESS)
+		return EFI_ST_FAILURE;
+	timed = get_ms(&start_ms);
+
+	for (i = 0; i < EFI_ST_MEM_ALLOCS; ++i) {
+		if (boottime->allocate_pages(EFI_ALLOCATE_ANY_PAGES,
+					     i & 1 ? EFI_LOADER_DATA :
+					     EFI_BOOT_SERVICES_DATA,
+					     1, &addrs[i]) != EFI_SUCCESS)
+			break;
+	}
+	if (i < EFI_ST_MEM_ALLOCS)
+		efi_st_printf("Only %d pages could be allocated\n", i);
+	calls += 2 * i;
+	if (free_all(i, false) != EFI_ST_SUCCESS)
+		return EFI_ST_FAILURE;
+
+	for (i = 0; i < EFI_ST_MEM_ALLOCS; ++i) {
+		if (boottime->allocate_pool(i & 1 ? EFI_LOADER_DATA :
+					    EFI_BOOT_SERVICES_DATA,
+					    8 + (i % 7) * 500,
+					    (void **)&addrs[i]) != EFI_SUCCESS)
+			break;
+	}
+	if (i < EFI_ST_MEM_ALLOCS)
+		efi_st_printf("Only %d pool buffers could be allocated\n", i);
+	calls += 2 * i;
+	if (free_all(i, true) != EFI_ST_SUCCESS)
+		return EFI_ST_FAILURE;
+
+	if (timed && get_ms(&end_ms)) {
+		/* Allow for passing midnight */
+		if (end_ms < start_ms)
+			end_ms += 24 * 60 * 60 * 1000;
+		efi_st_printf("%u allocations and frees took %u ms\n",
+			      calls, end_ms - start_ms);
+	}
+
+	if (get_map(map_after, &size_after) != EFI_ST_SUCCESS)
+		return EFI_ST_FAILURE;
+	if (size_after != size_before ||
+	    efi_st_memcmp(map_before, map_after, size_before)) {
+		efi_st_error("Memory map not restored\n");
+		return EFI_ST_FAILURE;
+	}
+
+	return EFI_ST_SUCCESS;
+}
+
+EFI_UNIT_TEST(memory) = {
+	.name = "memory allocation",
+	.phase = EFI_EXECUTE_BEFORE_BOOTTIME_EXIT,
+	.setup = setup,
+	.execute = execute,
+	.teardown = teardown,
+};
@@ -0,0 +1,461 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Lookup index for the control FDT
+ *
+ * Finding a node in a flat tree by path, phandle or compatible string, or
+ * finding the parent of a node, means walking the tree from the start. This
+ * builds an index of the control FDT the first time it is needed, so that
+ * later lookups can go straight to the node.
+ *
+ * The index holds offsets into the tree, so it is built again if the tree
+ * moves or its structure block changes size. Like driver model, it relies on
+ * the control FDT not being otherwise changed in place: a phandle or
+ * compatible string rewritten with fdt_setprop_inplace() is not noticed.
+ */
+
+#include <common.h>
+#include <fdtdec.h>
+#include <malloc.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Deepest nesting of nodes which can be indexed */
+#define FDT_INDEX_MAX_DEPTH	32
+
+/**
+ * struct fdt_index_node - a node in the tree
+ *
+ * @offset:		offset of the node in the tree
+ * @parent:		index of its parent node, or -1 for the root node
+ * @first_child:	index of its first subnode, or -1 if none
+ * @next_sibling:	index of the next subnode of its parent, or -1 if none
+ */
+struct fdt_index_node {
+	int offset;
+	int parent;
+	int first_child;
+	int next_sibling;
+};
+
+/**
+ * struct fdt_index_entry - an entry in a sorted table
+ *
+ * @key:	phandle, or hash of a compatible string or alias name
+ * @offset:	offset of the node, or of the property for an alias
+ */
+struct fdt_index_entry {
+	u32 key;
+	int offset;
+};
+
+/**
+ * struct fdt_index - index of a device tree
+ *
+ * @blob:		tree which was indexed
+ * @struct_size:	size of its structure block, to notice changes
+ * @node_count:		number of entries in @nodes, 0 if there is no index
+ * @phandle_count:	number of entries in @phandles
+ * @compat_count:	number of entries in @compats
+ * @alias_count:	number of entries in @aliases
+ * @nodes:		nodes, in the order they appear in the tree
+ * @phandles:		phandles, sorted by phandle and then node offset
+ * @compats:		compatible strings, sorted by hash and then offset
+ * @aliases:		properties of /aliases, sorted by hash of their name
+ */
+struct fdt_index {
+	const void *blob;
+	int struct_size;
+	int node_count;
+	int phandle_count;
+	int compat_count;
+	int alias_count;
+	struct fdt_index_node *nodes;
+	struct fdt_index_entry *phandles;
+	struct fdt_index_entry *compats;
+	struct fdt_index_entry *aliases;
+};
+
+static u32 fdt_index_hash(const char *s, int len)
+{
+	u32 hash = 2166136261U;
+
+	while (len--) {
+		hash ^= (u8)*s++;
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+/* Same as _fdt_nodename_eq() in libfdt */
+static bool fdt_index_name_eq(const void *blob, int offset, const char *s,
+			      int len)
+{
+	const char *p = fdt_offset_ptr(blob, offset + FDT_TAGSIZE, len + 1);
+
+	if (!p || memcmp(p, s, len))
+		return false;
+
+	return !p[len] || (p[len] == '@' && !memchr(s, '@', len));
+}
+
+static void fdt_index_add(struct fdt_index_entry *table, int *countp, u32 key,
+			  int offset)
+{
+	if (table) {
+		table[*countp].key = key;
+		table[*countp].offset = offset;
+	}
+	(*countp)++;
+}
+
+/* Add each string in a compatible property */
+static void fdt_index_add_compats(struct fdt_index *idx, const char *list,
+				  int len, int offset)
+{
+	const char *end = list + len;
+	int slen;
+
+	for (; list < end; list += slen + 1) {
+		slen = strnlen(list, end - list);
+		if (list + slen == end)
+			break;	/* not terminated */
+		fdt_index_add(idx->compats, &idx->compat_count,
+			      fdt_index_hash(list, slen), offset);
+	}
+}
+
+/*
+ * Walk the tree, filling in the index if its tables are allocated, else just
+ * counting what they need to hold
+ */
+static int fdt_index_scan(const void *blob, struct fdt_index *idx)
+{
+	int last[FDT_INDEX_MAX_DEPTH + 1];
+	int offset, depth, node, prop, len;
+	int aliases = -1;
+	const char *name;
+	const void *val;
+	u32 phandle;
+
+	idx->node_count = 0;
+	idx->phandle_count = 0;
+	idx->compat_count = 0;
+	idx->alias_count = 0;
+	for (offset = 0, depth = 0; offset >= 0 && depth >= 0;
+	     offset = fdt_next_node(blob, offset, &depth)) {
+		if (depth >= FDT_INDEX_MAX_DEPTH)
+			return -E2BIG;
+		node = idx->node_count++;
+		if (idx->nodes) {
+			struct fdt_index_node *np = &idx->nodes[node];
+
+			np->offset = offset;
+			np->parent = depth ? last[depth - 1] : -1;
+			np->first_child = -1;
+			np->next_sibling = -1;
+			if (depth && last[depth] == -1)
+				idx->nodes[np->parent].first_child = node;
+			else if (depth)
+				idx->nodes[last[depth]].next_sibling = node;
+		}
+		last[depth] = node;
+		last[depth + 1] = -1;
+
+		/* The first match wins, as with fdt_path_offset() */
+		if (depth == 1 && aliases == -1 &&
+		    fdt_index_name_eq(blob, offset, "aliases", 7))
+			aliases = offset;
+
+		/* Look at each property once, rather than searching for each */
+		phandle = 0;
+		fdt_for_each_property_offset(prop, blob, offset) {
+			val = fdt_getprop_by_offset(blob, prop, &name, &len);
+			if (!val)
+				continue;
+			if (!strcmp(name, "compatible")) {
+				fdt_index_add_compats(idx, val, len, offset);
+			} else if (len != sizeof(fdt32_t)) {
+				continue;
+			} else if (!strcmp(name, "phandle")) {
+				phandle = fdt32_to_cpu(*(fdt32_t *)val);
+			} else if (!phandle && !strcmp(name, "linux,phandle")) {
+				/* As fdt_get_phandle(), "phandle" wins */
+				phandle = fdt32_to_cpu(*(fdt32_t *)val);
+			}
+		}
+		if (phandle && phandle != -1)
+			fdt_index_add(idx->phandles, &idx->phandle_count,
+				      phandle, offset);
+	}
+	if (offset < 0)
+		return offset;
+
+	fdt_for_each_property_offset(offset, blob, aliases) {
+		if (!fdt_getprop_by_offset(blob, offset, &name, NULL))
+			continue;
+		fdt_index_add(idx->aliases, &idx->alias_count,
+			      fdt_index_hash(name, strlen(name)), offset);
+	}
+
+	return 0;
+}
+
+static int fdt_index_cmp(const void *a, const void *b)
+{
+	const struct fdt_index_entry *ea = a, *eb = b;
+
+	if (ea->key != eb->key)
+		return ea->key < eb->key ? -1 : 1;
+
+	return ea->offset - eb->offset;
+}
+
+/* Find the first entry which is not before (key, offset) */
+static struct fdt_index_entry *fdt_index_find(struct fdt_index_entry *table,
+					      int count, u32 key, int offset)
+{
+	int lo = 0, hi = count, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (table[mid].key < key ||
+		    (table[mid].key == key && table[mid].offset < offset))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return table + lo;
+}
+
+/* Find the index of the node at an offset, or -1 if none */
+static int fdt_index_node(struct fdt_index *idx, int offset)
+{
+	int lo = 0, hi = idx->node_count, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (idx->nodes[mid].offset == offset)
+			return mid;
+		if (idx->nodes[mid].offset < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return -1;
+}
+
+static struct fdt_index *fdt_index_build(const void *blob)
+{
+	struct fdt_index count, *idx;
+	int size = 0;
+
+	memset(&count, '\0', sizeof(count));
+	if (!fdt_index_scan(blob, &count)) {
+		size = count.node_count * sizeof(struct fdt_index_node) +
+			(count.phandle_count + count.compat_count +
+			 count.alias_count) * sizeof(struct fdt_index_entry);
+	}
+
+	/* Without tables, this records that there is no index for the tree */
+	idx = malloc(sizeof(*idx) + size);
+	if (!idx)
+		return NULL;
+	memset(idx, '\0', sizeof(*idx));
+	idx->blob = blob;
+	idx->struct_size = fdt_size_dt_struct(blob);
+	if (!size)
+		return idx;
+
+	idx->nodes = (struct fdt_index_node *)(idx + 1);
+	idx->phandles = (struct fdt_index_entry *)
+		(idx->nodes + count.node_count);
+	idx->compats = idx->phandles + count.phandle_count;
+	idx->aliases = idx->compats + count.compat_count;
+	fdt_index_scan(blob, idx);
+	qsort(idx->phandles, idx->phandle_count, sizeof(*idx->phandles),
+	      fdt_index_cmp);
+	qsort(idx->compats, idx->compat_count, sizeof(*idx->compats),
+	      fdt_index_cmp);
+	qsort(idx->aliases, idx->alias_count, sizeof(*idx->aliases),
+	      fdt_index_cmp);
+
+	return idx;
+}
+
+/* Get the index for a tree, building it if needed, or NULL if none */
+static struct fdt_index *fdt_index_get(const void *blob)
+{
+	struct fdt_index *idx = gd->fdt_index;
+
+	if (!blob || blob != gd->fdt_blob)
+		return NULL;
+	if (!idx || idx->blob != blob ||
+	    idx->struct_size != fdt_size_dt_struct(blob)) {
+		/*
+		 * Before relocation there are few lookups, too few to pay
+		 * for building the index, and the memory cannot be freed
+		 */
+		if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+			return NULL;
+		free(idx);
+		idx = fdt_index_build(blob);
+		gd->fdt_index = idx;
+		if (!idx)
+			return NULL;
+	}
+
+	return idx->node_count ? idx : NULL;
+}
+
+/* Same as fdt_subnode_offset_namelen() but returns the index of the node */
+static int fdt_index_subnode(struct fdt_index *idx, int node, const char *name,
+			     int namelen)
+{
+	for (node = idx->nodes[node].first_child; node != -1;
+	     node = idx->nodes[node].next_sibling) {
+		if (fdt_index_name_eq(idx->blob, idx->nodes[node].offset, name,
+				      namelen))
+			return node;
+	}
+
+	return -1;
+}
+
+/* Same as fdt_get_alias_namelen() */
+static const char *fdt_index_alias(struct fdt_index *idx, const char *name,
+				   int namelen)
+{
+	struct fdt_index_entry *entry, *end;
+	const char *prop, *pname;
+	u32 hash = fdt_index_hash(name, namelen);
+
+	end = idx->aliases + idx->alias_count;
+	for (entry = fdt_index_find(idx->aliases, idx->alias_count, hash, 0);
+	     entry < end && entry->key == hash; entry++) {
+		prop = fdt_getprop_by_offset(idx->blob, entry->offset, &pname,
+					     NULL);
+		if (prop && !strncmp(pname, name, namelen) && !pname[namelen])
+			return prop;
+	}
+
+	return NULL;
+}
+
+/* Same as fdt_path_next_separator() in libfdt */
+static const char *fdt_index_next_separator(const char *path, int len)
+{
+	const char *sep1 = memchr(path, '/', len);
+	const char *sep2 = memchr(path, ':', len);
+
+	if (sep1 && sep2)
+		return (sep1 < sep2) ? sep1 : sep2;
+
+	return sep1 ? sep1 : sep2;
+}
+
+/* Same as fdt_path_offset_namelen() */
+static int fdt_index_path(struct fdt_index *idx, const char *path, int len)
+{
+	const char *end = path + len;
+	const char *p = path, *q;
+	int node = 0, offset;
+
+	if (*path != '/') {
+		q = fdt_index_next_separator(path, len);
+		if (!q)
+			q = end;
+		p = fdt_index_alias(idx, path, q - path);
+		if (!p)
+			return -FDT_ERR_BADPATH;
+		offset = fdt_index_path(idx, p, strlen(p));
+		if (offset < 0)
+			return offset;
+		node = fdt_index_node(idx, offset);
+		p = q;
+	}
+
+	while (*p && p < end) {
+		while (*p == '/')
+			p++;
+		if (*p == '\0' || *p == ':')
+			break;
+		q = fdt_index_next_separator(p, end - p);
+		if (!q)
+			q = end;
+		node = fdt_index_subnode(idx, node, p, q - p);
+		if (node < 0)
+			return -FDT_ERR_NOTFOUND;
+		p = q;
+	}
+
+	return idx->nodes[node].offset;
+}
+
+int fdtdec_path_offset(const void *blob, const char *path)
+{
+	struct fdt_index *idx = fdt_index_get(blob);
+
+	if (!idx)
+		return fdt_path_offset(blob, path);
+
+	return fdt_index_path(idx, path, strlen(path));
+}
+
+int fdtdec_node_offset_by_phandle(const void *blob, uint32_t phandle)
+{
+	struct fdt_index *idx = fdt_index_get(blob);
+	struct fdt_index_entry *entry;
+
+	if (!idx)
+		return fdt_node_offset_by_phandle(blob, phandle);
+	if (!phandle || phandle == -1)
+		return -FDT_ERR_BADPHANDLE;
+
+	entry = fdt_index_find(idx->phandles, idx->phandle_count, phandle, 0);
+	if (entry == idx->phandles + idx->phandle_count ||
+	    entry->key != phandle)
+		return -FDT_ERR_NOTFOUND;
+
+	return entry->offset;
+}
+
+int fdtdec_node_offset_by_compatible(const void *blob, int startoffset,
+				     const char *compat)
+{
+	struct fdt_index *idx = fdt_index_get(blob);
+	struct fdt_index_entry *entry, *end;
+	const char *list;
+	int len = strlen(compat);
+	u32 hash;
+
+	if (!idx)
+		return fdt_node_offset_by_compatible(blob, startoffset, compat);
+
+	hash = fdt_index_hash(compat, len);
+	end = idx->compats + idx->compat_count;
+	for (entry = fdt_index_find(idx->compats, idx->compat_count, hash,
+				    startoffset + 1);
+	     entry < end && entry->key == hash; entry++) {
+		list = fdt_getprop(blob, entry->offset, "compatible", &len);
+		if (list && fdt_stringlist_contains(list, len, compat))
+			return entry->offset;
+	}
+
+	return -FDT_ERR_NOTFOUND;
+}
+
+int fdtdec_parent_offset(const void *blob, int nodeoffset)
+{
+	struct fdt_index *idx = fdt_index_get(blob);
+	int node;
+
+	node = idx ? fdt_index_node(idx, nodeoffset) : -1;
+	if (node == -1)
+		return fdt_parent_offset(blob, nodeoffset);
+	node = idx->nodes[node].parent;
+
+	return node == -1 ? -FDT_ERR_NOTFOUND : idx->nodes[node].offset;
+}
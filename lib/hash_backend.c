@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Selection of the hash block function for the running CPU
+ */
+
+#include <common.h>
+#include <hash.h>
+
+const struct hash_backend *hash_backend_find(const char *algo_name)
+{
+	struct hash_backend *start =
+		ll_entry_start(struct hash_backend, hash_backend);
+	const int n_ents = ll_entry_count(struct hash_backend, hash_backend);
+	const struct hash_backend *best = NULL;
+	struct hash_backend *entry;
+
+	for (entry = start; entry != start + n_ents; entry++) {
+		if (strcmp(entry->algo, algo_name))
+			continue;
+		if (best && entry->priority <= best->priority)
+			continue;
+		if (entry->probe && !entry->probe())
+			continue;
+		best = entry;
+	}
+
+	return best;
+}
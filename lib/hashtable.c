@@ -61,43 +61,54 @@ typedef struct _ENTRY {
 	ENTRY entry;
 } _ENTRY;
 
+/*
+ * A slot in the hash index: @idx is the index of the entry in the table,
+ * or 0 if the slot is empty, and @hval is the hash value of its key.
+ */
+typedef struct _HSLOT {
+	unsigned int hval;
+	unsigned int idx;
+} _HSLOT;
+
 
 static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
 	int idx);
 
 /*
- * hcreate()
+ * Names and values either point into the arena, which holds the imported
+ * environment, or have been allocated separately.
  */
-
-/*
- * For the used double hash method the table size has to be a prime. To
- * correct the user given table size we need a prime test.  This trivial
- * algorithm is adequate because
- * a)  the code is (most probably) called a few times per program run and
- * b)  the number is small because the table must fit in the core
- * */
-static int isprime(unsigned int number)
+static int in_arena(struct hsearch_data *htab, const char *str)
 {
-	/* no even number will be passed */
-	unsigned int div = 3;
-
-	while (div * div < number && number % div != 0)
-		div += 2;
+	return htab->arena && str >= htab->arena &&
+		str < htab->arena + htab->arena_size;
+}
 
-	return number % div != 0;
+static void hfree_str(struct hsearch_data *htab, const char *str)
+{
+	if (!in_arena(htab, str))
+		free((void *)str);
 }
 
+/*
+ * hcreate()
+ */
+
 /*
  * Before using the hash table we must allocate memory for it.
- * Test for an existing table are done. We allocate one element
- * more as the found prime number says. This is done for more effective
- * indexing as explained in the comment for the hsearch function.
- * The contents of the table is zeroed, especially the field used
- * becomes zero.
+ * Test for an existing table are done. The entries are kept in a table
+ * which is indexed from one, so that zero can mark an empty slot in the
+ * hash index. The table, the index and the sorted list of entries share
+ * a single zeroed allocation.
+ *
+ * The index has at least a third more slots than the table has entries,
+ * so that the probe sequences stay short.
  */
 
 int hcreate_r(size_t nel, struct hsearch_data *htab)
 {
+	unsigned int nslots;
+
 	/* Test for correct arguments.  */
 	if (htab == NULL) {
 		__set_errno(EINVAL);
@@ -108,18 +119,24 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 	if (htab->table != NULL)
 		return 0;
 
-	/* Change nel to the first prime number not smaller as nel. */
-	nel |= 1;		/* make odd */
-	while (!isprime(nel))
-		nel += 2;
+	if (nel < 1)
+		nel = 1;
+	for (nslots = 4; nslots < nel + nel / 3 + 1; nslots <<= 1)
+		;
 
 	htab->size = nel;
 	htab->filled = 0;
+	htab->slot_mask = nslots - 1;
+	htab->next_free = 1;
 
 	/* allocate memory and zero out */
-	htab->table = (_ENTRY *) calloc(htab->size + 1, sizeof(_ENTRY));
+	htab->table = calloc(1, (nel + 1) * sizeof(_ENTRY) +
+			     nslots * sizeof(_HSLOT) +
+			     nel * sizeof(unsigned int));
 	if (htab->table == NULL)
 		return 0;
+	htab->slots = (_HSLOT *)(htab->table + nel + 1);
+	htab->order = (unsigned int *)(htab->slots + nslots);
 
 	/* everything went alright */
 	return 1;
@@ -150,14 +167,19 @@ void hdestroy_r(struct hsearch_data *htab)
 		if (htab->table[i].used > 0) {
 			ENTRY *ep = &htab->table[i].entry;
 
-			free((void *)ep->key);
-			free(ep->data);
+			hfree_str(htab, ep->key);
+			hfree_str(htab, ep->data);
 		}
 	}
 	free(htab->table);
+	free(htab->arena);
 
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
+	htab->size = 0;
+	htab->filled = 0;
+	htab->arena = NULL;
+	htab->arena_size = 0;
 }
 
 /*
@@ -165,19 +187,14 @@ void hdestroy_r(struct hsearch_data *htab)
  */
 
 /*
- * This is the search function. It uses double hashing with open addressing.
- * The argument item.key has to be a pointer to an zero terminated, most
- * probably strings of chars. The function for generating a number of the
- * strings is simple but fast. It can be replaced by a more complex function
- * like ajw (see [Aho,Sethi,Ullman]) if the needs are shown.
- *
- * We use an trick to speed up the lookup. The table is created by hcreate
- * with one more element available. This enables us to use the index zero
- * special. This index will never be used because we store the first hash
- * index in the field used where zero means not used. Every other value
- * means used. The used field can be used as a first fast comparison for
- * equality of the stored and the parameter value. This helps to prevent
- * unnecessary expensive calls of strcmp.
+ * This is the search function. It uses Robin Hood hashing: the hash index
+ * is probed linearly, and an entry being inserted takes the slot of any
+ * entry which is closer to its home slot, which is then moved along
+ * instead. This keeps all probe sequences about equally short, and lets a
+ * search stop as soon as it reaches an entry closer to home than the key
+ * would be. Each slot holds the full hash value of its key, which is
+ * compared first to avoid most of the expensive calls of strcmp. Slots
+ * only hold the index of the entry, so entries never move once created.
  *
  * This implementation differs from the standard library version of
  * this function in a number of ways:
@@ -217,134 +234,209 @@ int hmatch_r(const char *match, int last_idx, ENTRY ** retval,
 	return 0;
 }
 
-/*
- * Compare an existing entry with the desired key, and overwrite if the action
- * is ENTER.  This is simply a helper function for hsearch_r().
- */
-static inline int _compare_and_overwrite_entry(ENTRY item, ACTION action,
-	ENTRY **retval, struct hsearch_data *htab, int flag,
-	unsigned int hval, unsigned int idx)
+/* FNV-1a hash of a key */
+static unsigned int hhash(const char *key)
 {
-	if (htab->table[idx].used == hval
-	    && strcmp(item.key, htab->table[idx].entry.key) == 0) {
-		/* Overwrite existing value? */
-		if ((action == ENTER) && (item.data != NULL)) {
-			/* check for permission */
-			if (htab->change_ok != NULL && htab->change_ok(
-			    &htab->table[idx].entry, item.data,
-			    env_op_overwrite, flag)) {
-				debug("change_ok() rejected setting variable "
-					"%s, skipping it!\n", item.key);
-				__set_errno(EPERM);
-				*retval = NULL;
-				return 0;
-			}
+	unsigned int hval = 2166136261U;
 
-			/* If there is a callback, call it */
-			if (htab->table[idx].entry.callback &&
-			    htab->table[idx].entry.callback(item.key,
-			    item.data, env_op_overwrite, flag)) {
-				debug("callback() rejected setting variable "
-					"%s, skipping it!\n", item.key);
-				__set_errno(EINVAL);
-				*retval = NULL;
-				return 0;
-			}
+	while (*key) {
+		hval ^= (unsigned char)*key++;
+		hval *= 16777619;
+	}
 
-			free(htab->table[idx].entry.data);
-			htab->table[idx].entry.data = strdup(item.data);
-			if (!htab->table[idx].entry.data) {
-				__set_errno(ENOMEM);
-				*retval = NULL;
-				return 0;
-			}
+	return hval;
+}
+
+/* Distance of the entry in a slot from the slot its hash value points to */
+static inline unsigned int hslot_dist(struct hsearch_data *htab,
+				      unsigned int pos)
+{
+	return (pos - htab->slots[pos].hval) & htab->slot_mask;
+}
+
+/* Find the slot holding a key, returning -1 if there is none */
+static int hslot_find(struct hsearch_data *htab, const char *key,
+		      unsigned int hval)
+{
+	unsigned int pos = hval & htab->slot_mask;
+	unsigned int dist;
+
+	for (dist = 0; ; dist++, pos = (pos + 1) & htab->slot_mask) {
+		_HSLOT *slot = &htab->slots[pos];
+
+		if (!slot->idx || hslot_dist(htab, pos) < dist)
+			return -1;
+		if (slot->hval == hval &&
+		    !strcmp(key, htab->table[slot->idx].entry.key))
+			return pos;
+	}
+}
+
+static void hslot_insert(struct hsearch_data *htab, unsigned int hval,
+			 unsigned int idx)
+{
+	_HSLOT cur = { .hval = hval, .idx = idx }, tmp;
+	unsigned int pos = hval & htab->slot_mask;
+	unsigned int dist = 0, d;
+
+	/* There is always an empty slot, since the index is never full */
+	while (htab->slots[pos].idx) {
+		d = hslot_dist(htab, pos);
+		if (d < dist) {
+			tmp = htab->slots[pos];
+			htab->slots[pos] = cur;
+			cur = tmp;
+			dist = d;
 		}
-		/* return found entry */
-		*retval = &htab->table[idx].entry;
-		return idx;
+		pos = (pos + 1) & htab->slot_mask;
+		dist++;
 	}
-	/* keep searching */
-	return -1;
+	htab->slots[pos] = cur;
 }
 
-int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
-	      struct hsearch_data *htab, int flag)
+/* Empty a slot, moving back the entries which follow it */
+static void hslot_remove(struct hsearch_data *htab, unsigned int pos)
 {
-	unsigned int hval;
-	unsigned int count;
-	unsigned int len = strlen(item.key);
-	unsigned int idx;
-	unsigned int first_deleted = 0;
-	int ret;
+	unsigned int next = (pos + 1) & htab->slot_mask;
 
-	/* Compute an value for the given string. Perhaps use a better method. */
-	hval = len;
-	count = len;
-	while (count-- > 0) {
-		hval <<= 4;
-		hval += item.key[count];
+	while (htab->slots[next].idx && hslot_dist(htab, next)) {
+		htab->slots[pos] = htab->slots[next];
+		pos = next;
+		next = (next + 1) & htab->slot_mask;
 	}
+	htab->slots[pos].idx = 0;
+}
 
-	/*
-	 * First hash function:
-	 * simply take the modul but prevent zero.
-	 */
-	hval %= htab->size;
-	if (hval == 0)
-		++hval;
+/* Find where a key is, or would go, in the sorted list of entries */
+static unsigned int horder_find(struct hsearch_data *htab, const char *key)
+{
+	unsigned int lo = 0, hi = htab->filled, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (strcmp(htab->table[htab->order[mid]].entry.key, key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
 
-	/* The first index tried. */
-	idx = hval;
+	return lo;
+}
 
-	if (htab->table[idx].used) {
-		/*
-		 * Further action might be required according to the
-		 * action value.
-		 */
-		unsigned hval2;
+/*
+ * Add an entry to the sorted list. Environments are stored in order, so
+ * on import this is nearly always an append.
+ */
+static void horder_insert(struct hsearch_data *htab, unsigned int idx)
+{
+	unsigned int pos = horder_find(htab, htab->table[idx].entry.key);
 
-		if (htab->table[idx].used == -1
-		    && !first_deleted)
-			first_deleted = idx;
+	memmove(&htab->order[pos + 1], &htab->order[pos],
+		(htab->filled - pos) * sizeof(htab->order[0]));
+	htab->order[pos] = idx;
+}
 
-		ret = _compare_and_overwrite_entry(item, action, retval, htab,
-			flag, hval, idx);
-		if (ret != -1)
-			return ret;
+static void horder_remove(struct hsearch_data *htab, unsigned int idx)
+{
+	unsigned int pos = horder_find(htab, htab->table[idx].entry.key);
 
-		/*
-		 * Second hash function:
-		 * as suggested in [Knuth]
-		 */
-		hval2 = 1 + hval % (htab->size - 2);
-
-		do {
-			/*
-			 * Because SIZE is prime this guarantees to
-			 * step through all available indices.
-			 */
-			if (idx <= hval2)
-				idx = htab->size + idx - hval2;
-			else
-				idx -= hval2;
-
-			/*
-			 * If we visited all entries leave the loop
-			 * unsuccessfully.
-			 */
-			if (idx == hval)
-				break;
-
-			/* If entry is found use it. */
-			ret = _compare_and_overwrite_entry(item, action, retval,
-				htab, flag, hval, idx);
-			if (ret != -1)
-				return ret;
+	memmove(&htab->order[pos], &htab->order[pos + 1],
+		(htab->filled - pos - 1) * sizeof(htab->order[0]));
+}
+
+/*
+ * Set the value of an entry. A value from the arena is used where it is.
+ * Otherwise the old value is overwritten if the new one fits, and copied
+ * if not.
+ */
+static int hset_data(struct hsearch_data *htab, ENTRY *ep, char *data,
+		     bool arena)
+{
+	size_t len;
+	char *copy;
+
+	if (arena) {
+		hfree_str(htab, ep->data);
+		ep->data = data;
+		return 0;
+	}
+
+	len = strlen(data);
+	if (len <= strlen(ep->data)) {
+		memmove(ep->data, data, len + 1);
+		return 0;
+	}
+
+	copy = strdup(data);
+	if (!copy)
+		return -ENOMEM;
+	hfree_str(htab, ep->data);
+	ep->data = copy;
+
+	return 0;
+}
+
+/*
+ * Overwrite an existing entry if the action is ENTER.  This is simply a
+ * helper function for hsearch_r().
+ */
+static inline int _overwrite_entry(ENTRY item, ACTION action,
+	ENTRY **retval, struct hsearch_data *htab, int flag,
+	unsigned int idx, bool arena)
+{
+	/* Overwrite existing value? */
+	if ((action == ENTER) && (item.data != NULL)) {
+		/* check for permission */
+		if (htab->change_ok != NULL && htab->change_ok(
+		    &htab->table[idx].entry, item.data,
+		    env_op_overwrite, flag)) {
+			debug("change_ok() rejected setting variable "
+				"%s, skipping it!\n", item.key);
+			__set_errno(EPERM);
+			*retval = NULL;
+			return 0;
+		}
+
+		/* If there is a callback, call it */
+		if (htab->table[idx].entry.callback &&
+		    htab->table[idx].entry.callback(item.key,
+		    item.data, env_op_overwrite, flag)) {
+			debug("callback() rejected setting variable "
+				"%s, skipping it!\n", item.key);
+			__set_errno(EINVAL);
+			*retval = NULL;
+			return 0;
+		}
+
+		if (hset_data(htab, &htab->table[idx].entry, item.data,
+			      arena)) {
+			__set_errno(ENOMEM);
+			*retval = NULL;
+			return 0;
 		}
-		while (htab->table[idx].used);
 	}
+	/* return found entry */
+	*retval = &htab->table[idx].entry;
+	return idx;
+}
+
+/*
+ * Search for or enter an item. If @arena is true, the item's key and data
+ * are in the arena and are used where they are instead of being copied.
+ */
+static int _hsearch(ENTRY item, ACTION action, ENTRY **retval,
+		    struct hsearch_data *htab, int flag, bool arena)
+{
+	unsigned int hval = hhash(item.key);
+	unsigned int idx;
+	ENTRY *ep;
+	int pos;
+
+	pos = hslot_find(htab, item.key, hval);
+	if (pos >= 0)
+		return _overwrite_entry(item, action, retval, htab, flag,
+					htab->slots[pos].idx, arena);
 
-	/* An empty bucket has been found. */
 	if (action == ENTER) {
 		/*
 		 * If table is full and another entry should be
@@ -356,55 +448,66 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 			return 0;
 		}
 
+		/* Take the first free entry */
+		for (idx = htab->next_free; htab->table[idx].used; idx++)
+			;
+		htab->next_free = idx + 1;
+		ep = &htab->table[idx].entry;
+
 		/*
 		 * Create new entry;
 		 * create copies of item.key and item.data
 		 */
-		if (first_deleted)
-			idx = first_deleted;
-
-		htab->table[idx].used = hval;
-		htab->table[idx].entry.key = strdup(item.key);
-		htab->table[idx].entry.data = strdup(item.data);
-		if (!htab->table[idx].entry.key ||
-		    !htab->table[idx].entry.data) {
-			__set_errno(ENOMEM);
-			*retval = NULL;
-			return 0;
+		if (arena) {
+			ep->key = item.key;
+			ep->data = item.data;
+		} else {
+			ep->key = strdup(item.key);
+			ep->data = strdup(item.data);
+			if (!ep->key || !ep->data) {
+				free((void *)ep->key);
+				free(ep->data);
+				htab->next_free = idx;
+				__set_errno(ENOMEM);
+				*retval = NULL;
+				return 0;
+			}
 		}
 
+		htab->table[idx].used = 1;
+		hslot_insert(htab, hval, idx);
+		horder_insert(htab, idx);
 		++htab->filled;
 
 		/* This is a new entry, so look up a possible callback */
-		env_callback_init(&htab->table[idx].entry);
+		env_callback_init(ep);
 		/* Also look for flags */
-		env_flags_init(&htab->table[idx].entry);
+		env_flags_init(ep);
 
 		/* check for permission */
 		if (htab->change_ok != NULL && htab->change_ok(
-		    &htab->table[idx].entry, item.data, env_op_create, flag)) {
+		    ep, item.data, env_op_create, flag)) {
 			debug("change_ok() rejected setting variable "
 				"%s, skipping it!\n", item.key);
-			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
+			_hdelete(item.key, htab, ep, idx);
 			__set_errno(EPERM);
 			*retval = NULL;
 			return 0;
 		}
 
 		/* If there is a callback, call it */
-		if (htab->table[idx].entry.callback &&
-		    htab->table[idx].entry.callback(item.key, item.data,
-		    env_op_create, flag)) {
+		if (ep->callback && ep->callback(item.key, item.data,
+						 env_op_create, flag)) {
 			debug("callback() rejected setting variable "
 				"%s, skipping it!\n", item.key);
-			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
+			_hdelete(item.key, htab, ep, idx);
 			__set_errno(EINVAL);
 			*retval = NULL;
 			return 0;
 		}
 
 		/* return new entry */
-		*retval = &htab->table[idx].entry;
+		*retval = ep;
 		return 1;
 	}
 
@@ -413,6 +516,12 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 	return 0;
 }
 
+int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
+	      struct hsearch_data *htab, int flag)
+{
+	return _hsearch(item, action, retval, htab, flag, false);
+}
+
 
 /*
  * hdelete()
@@ -427,13 +536,24 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
 	int idx)
 {
+	int pos;
+
 	/* free used ENTRY */
 	debug("hdelete: DELETING key \"%s\"\n", key);
-	free((void *)ep->key);
-	free(ep->data);
+	pos = hslot_find(htab, ep->key, hhash(ep->key));
+	if (pos >= 0)
+		hslot_remove(htab, pos);
+	horder_remove(htab, idx);
+
+	hfree_str(htab, ep->key);
+	hfree_str(htab, ep->data);
+	ep->key = NULL;
+	ep->data = NULL;
 	ep->callback = NULL;
 	ep->flags = 0;
-	htab->table[idx].used = -1;
+	htab->table[idx].used = 0;
+	if (idx < htab->next_free)
+		htab->next_free = idx;
 
 	--htab->filled;
 }
@@ -494,7 +614,8 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
  * for later re-import.
  *
  * The entries in the result list will be sorted by ascending key
- * values.
+ * values. The table keeps a sorted list of its entries, so this needs
+ * no sorting.
  *
  * If the separator character is different from NUL, then any
  * separator characters and backslash characters in the values will
@@ -519,14 +640,6 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
  *		bytes in the string will be '\0'-padded.
  */
 
-static int cmpkey(const void *p1, const void *p2)
-{
-	ENTRY *e1 = *(ENTRY **) p1;
-	ENTRY *e2 = *(ENTRY **) p2;
-
-	return (strcmp(e1->key, e2->key));
-}
-
 static int match_string(int flag, const char *str, const char *pat, void *priv)
 {
 	switch (flag & H_MATCH_METHOD) {
@@ -605,54 +718,48 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 	      htab, htab->size, htab->filled, (ulong)size);
 	/*
 	 * Pass 1:
-	 * search used entries,
+	 * search used entries in order,
 	 * save addresses and compute total length
 	 */
-	for (i = 1, n = 0, totlen = 0; i <= htab->size; ++i) {
+	for (i = 0, n = 0, totlen = 0; i < htab->filled; ++i) {
+		ENTRY *ep = &htab->table[htab->order[i]].entry;
+		int found = match_entry(ep, flag, argc, argv);
 
-		if (htab->table[i].used > 0) {
-			ENTRY *ep = &htab->table[i].entry;
-			int found = match_entry(ep, flag, argc, argv);
-
-			if ((argc > 0) && (found == 0))
-				continue;
+		if ((argc > 0) && (found == 0))
+			continue;
 
-			if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
-				continue;
+		if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
+			continue;
 
-			list[n++] = ep;
+		list[n++] = ep;
 
-			totlen += strlen(ep->key);
+		totlen += strlen(ep->key);
 
-			if (sep == '\0') {
-				totlen += strlen(ep->data);
-			} else {	/* check if escapes are needed */
-				char *s = ep->data;
+		if (sep == '\0') {
+			totlen += strlen(ep->data);
+		} else {	/* check if escapes are needed */
+			char *s = ep->data;
 
-				while (*s) {
+			while (*s) {
+				++totlen;
+				/* add room for needed escape chars */
+				if ((*s == sep) || (*s == '\\'))
 					++totlen;
-					/* add room for needed escape chars */
-					if ((*s == sep) || (*s == '\\'))
-						++totlen;
-					++s;
-				}
+				++s;
 			}
-			totlen += 2;	/* for '=' and 'sep' char */
 		}
+		totlen += 2;	/* for '=' and 'sep' char */
 	}
 
 #ifdef DEBUG
-	/* Pass 1a: print unsorted list */
-	printf("Unsorted: n=%d\n", n);
+	/* Pass 1a: print list */
+	printf("Sorted: n=%d\n", n);
 	for (i = 0; i < n; ++i) {
 		printf("\t%3d: %p ==> %-10s => %s\n",
 		       i, list[i], list[i]->key, list[i]->data);
 	}
 #endif
 
-	/* Sort list by keys */
-	qsort(list, n, sizeof(ENTRY *), cmpkey);
-
 	/* Check if the user supplied buffer size is sufficient */
 	if (size) {
 		if (size < totlen + 1) {	/* provided buffer too small */
@@ -738,6 +845,26 @@ static int drop_var_from_set(const char *name, int nvars, char * vars[])
 	return res;
 }
 
+/*
+ * Find how much of the data himport_r() will parse. With NUL separators,
+ * that ends at the first empty entry, usually well before the end of the
+ * storage area.
+ */
+static size_t himport_len(const char *env, size_t size, const char sep)
+{
+	size_t i;
+
+	if (sep != '\0')
+		return size;
+
+	for (i = 1; i < size; i++) {
+		if (!env[i] && !env[i - 1])
+			return i + 1;
+	}
+
+	return size;
+}
+
 /*
  * Import linearized data into hash table.
  *
@@ -774,6 +901,10 @@ static int drop_var_from_set(const char *name, int nvars, char * vars[])
  *
  * In theory, arbitrary separator characters can be used, but only
  * '\0' and '\n' have really been tested.
+ *
+ * If the hash table has no arena, the parsed copy of the data becomes its
+ * arena, and the names and values are used from there without being
+ * copied again.
  */
 
 int himport_r(struct hsearch_data *htab,
@@ -782,6 +913,8 @@ int himport_r(struct hsearch_data *htab,
 {
 	char *data, *sp, *dp, *name, *value;
 	char *localvars[nvars];
+	size_t len;
+	bool arena;
 	int i;
 
 	/* Test for correct arguments.  */
@@ -791,13 +924,14 @@ int himport_r(struct hsearch_data *htab,
 	}
 
 	/* we allocate new space to make sure we can write to the array */
-	if ((data = malloc(size + 1)) == NULL) {
-		debug("himport_r: can't malloc %lu bytes\n", (ulong)size + 1);
+	len = himport_len(env, size, sep);
+	if ((data = malloc(len + 1)) == NULL) {
+		debug("himport_r: can't malloc %lu bytes\n", (ulong)len + 1);
 		__set_errno(ENOMEM);
 		return 0;
 	}
-	memcpy(data, env, size);
-	data[size] = '\0';
+	memcpy(data, env, len);
+	data[len] = '\0';
 	dp = data;
 
 	/* make a local copy of the list of variables */
@@ -844,21 +978,28 @@ int himport_r(struct hsearch_data *htab,
 		}
 	}
 
-	if (!size) {
+	if (!len) {
 		free(data);
 		return 1;		/* everything OK */
 	}
+
+	arena = !htab->arena;
+	if (arena) {
+		htab->arena = data;
+		htab->arena_size = len + 1;
+	}
+
 	if(crlf_is_lf) {
 		/* Remove Carriage Returns in front of Line Feeds */
 		unsigned ignored_crs = 0;
-		for(;dp < data + size && *dp; ++dp) {
+		for(;dp < data + len && *dp; ++dp) {
 			if(*dp == '\r' &&
-			   dp < data + size - 1 && *(dp+1) == '\n')
+			   dp < data + len - 1 && *(dp+1) == '\n')
 				++ignored_crs;
 			else
 				*(dp-ignored_crs) = *dp;
 		}
-		size -= ignored_crs;
+		len -= ignored_crs;
 		dp = data;
 	}
 	/* Parse environment; allow for '\0' and 'sep' as separators */
@@ -911,7 +1052,8 @@ int himport_r(struct hsearch_data *htab,
 		if (*name == 0) {
 			debug("INSERT: unable to use an empty key\n");
 			__set_errno(EINVAL);
-			free(data);
+			if (!arena)
+				free(data);
 			return 0;
 		}
 
@@ -923,7 +1065,7 @@ int himport_r(struct hsearch_data *htab,
 		e.key = name;
 		e.data = value;
 
-		hsearch_r(e, ENTER, &rv, htab, flag);
+		_hsearch(e, ENTER, &rv, htab, flag, arena);
 		if (rv == NULL)
 			printf("himport_r: can't insert \"%s=%s\" into hash table\n",
 				name, value);
@@ -931,10 +1073,12 @@ int himport_r(struct hsearch_data *htab,
 		debug("INSERT: table %p, filled %d/%d rv %p ==> name=\"%s\" value=\"%s\"\n",
 			htab, htab->filled, htab->size,
 			rv, name, value);
-	} while ((dp < data + size) && *dp);	/* size check needed for text */
+	} while ((dp < data + len) && *dp);	/* size check needed for text */
 						/* without '\0' termination */
-	debug("INSERT: free(data = %p)\n", data);
-	free(data);
+	if (!arena) {
+		debug("INSERT: free(data = %p)\n", data);
+		free(data);
+	}
 
 	if (flag & H_NOCLEAR)
 		goto end;
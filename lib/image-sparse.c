@@ -40,47 +40,140 @@
 #include <div64.h>
 #include <malloc.h>
 #include <part.h>
+#include <asm/unaligned.h>
 #include <sparse_format.h>
 
 #include <linux/math64.h>
 
 static void default_log(const char *ignored, char *response) {}
 
-int write_sparse_image(struct sparse_storage *info,
-		       const char *part_name, void *data, char *response)
+static int sparse_fail(struct sparse_stream *ss, const char *msg,
+		       char *response)
 {
-	lbaint_t blk;
-	lbaint_t blkcnt;
+	ss->info->mssg(msg, response);
+	ss->state = SPARSE_STREAM_ERROR;
+
+	return -1;
+}
+
+static int sparse_write_blocks(struct sparse_stream *ss, const void *buf,
+			       lbaint_t blkcnt, char *response)
+{
+	struct sparse_storage *info = ss->info;
 	lbaint_t blks;
-	uint32_t bytes_written = 0;
-	unsigned int chunk;
-	unsigned int offset;
-	unsigned int chunk_data_sz;
-	uint32_t *fill_buf = NULL;
-	uint32_t fill_val;
-	sparse_header_t *sparse_header;
-	chunk_header_t *chunk_header;
-	uint32_t total_blocks = 0;
-	int fill_buf_num_blks;
-	int i;
-	int j;
-
-	fill_buf_num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
-
-	/* Read and skip over sparse image header */
-	sparse_header = (sparse_header_t *)data;
-
-	data += sparse_header->file_hdr_sz;
-	if (sparse_header->file_hdr_sz > sizeof(sparse_header_t)) {
-		/*
-		 * Skip the remaining bytes in a header that is longer than
-		 * we expected.
-		 */
-		data += (sparse_header->file_hdr_sz - sizeof(sparse_header_t));
+
+	if (ss->blk + blkcnt > info->start + info->size) {
+		printf("%s: Request would exceed partition size!\n", __func__);
+		return sparse_fail(ss, "Request would exceed partition size!",
+				   response);
 	}
 
-	if (!info->mssg)
-		info->mssg = default_log;
+	blks = info->write(info, ss->blk, blkcnt, buf);
+	/* blks might be > blkcnt (eg. NAND bad-blocks) */
+	if (blks < blkcnt) {
+		printf("%s: %s" LBAFU " [" LBAFU "]\n", __func__,
+		       "Write failed, block #", ss->blk, blks);
+		return sparse_fail(ss, "flash write failure", response);
+	}
+	ss->blk += blks;
+	ss->bytes_written += (u64)blkcnt * ss->blksz;
+
+	return 0;
+}
+
+/* Write raw data, holding back the start of a block which is split */
+static int sparse_write_raw(struct sparse_stream *ss, const u8 *data,
+			    uint len, char *response)
+{
+	uint count;
+
+	if (ss->blk_len) {
+		count = min(len, ss->blksz - ss->blk_len);
+		memcpy(ss->blk_buf + ss->blk_len, data, count);
+		ss->blk_len += count;
+		data += count;
+		len -= count;
+		if (ss->blk_len < ss->blksz)
+			return 0;
+		ss->blk_len = 0;
+		if (sparse_write_blocks(ss, ss->blk_buf, 1, response))
+			return -1;
+	}
+
+	count = len / ss->blksz;
+	if (count && sparse_write_blocks(ss, data, count, response))
+		return -1;
+	data += count * ss->blksz;
+	len -= count * ss->blksz;
+
+	memcpy(ss->blk_buf, data, len);
+	ss->blk_len = len;
+
+	return 0;
+}
+
+static int sparse_write_fill(struct sparse_stream *ss, u32 fill_val,
+			     char *response)
+{
+	struct sparse_storage *info = ss->info;
+	lbaint_t blkcnt, i, j;
+	int k;
+
+	if (!ss->fill_buf) {
+		ss->fill_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / ss->blksz;
+		ss->fill_buf = memalign(ARCH_DMA_MINALIGN,
+					ROUNDUP(ss->blksz * ss->fill_blks,
+						ARCH_DMA_MINALIGN));
+		if (!ss->fill_buf) {
+			info->mssg("Malloc failed for: CHUNK_TYPE_FILL",
+				   response);
+			ss->state = SPARSE_STREAM_ERROR;
+			return -1;
+		}
+	}
+	for (k = 0; k < ss->blksz * ss->fill_blks / sizeof(fill_val); k++)
+		ss->fill_buf[k] = fill_val;
+
+	blkcnt = (lbaint_t)ss->chunk.chunk_sz * (ss->sparse.blk_sz / ss->blksz);
+	if (ss->blk + blkcnt > info->start + info->size) {
+		printf("%s: Request would exceed partition size!\n", __func__);
+		return sparse_fail(ss, "Request would exceed partition size!",
+				   response);
+	}
+	for (i = 0; i < blkcnt; i += j) {
+		j = min_t(lbaint_t, blkcnt - i, ss->fill_blks);
+		if (sparse_write_blocks(ss, ss->fill_buf, j, response))
+			return -1;
+	}
+
+	return 0;
+}
+
+static void sparse_next_chunk(struct sparse_stream *ss)
+{
+	if (!ss->chunks_left--) {
+		ss->state = SPARSE_STREAM_DONE;
+	} else {
+		ss->state = SPARSE_STREAM_CHUNK_HDR;
+		ss->hdr_want = sizeof(chunk_header_t);
+	}
+	ss->hdr_len = 0;
+}
+
+static int sparse_file_header(struct sparse_stream *ss, char *response)
+{
+	sparse_header_t *sparse_header = &ss->sparse;
+	int ret;
+
+	if (!is_sparse_image(ss->hdr)) {
+		/* Write it as it is */
+		ss->state = SPARSE_STREAM_RAW_IMAGE;
+		ret = sparse_write_raw(ss, ss->hdr, ss->hdr_len, response);
+		ss->hdr_len = 0;
+		return ret;
+	}
+
+	memcpy(sparse_header, ss->hdr, sizeof(*sparse_header));
 
 	debug("=== Sparse Image Header ===\n");
 	debug("magic: 0x%x\n", sparse_header->magic);
@@ -92,170 +185,238 @@ int write_sparse_image(struct sparse_storage *info,
 	debug("total_blks: %d\n", sparse_header->total_blks);
 	debug("total_chunks: %d\n", sparse_header->total_chunks);
 
+	if (sparse_header->file_hdr_sz < sizeof(sparse_header_t) ||
+	    sparse_header->chunk_hdr_sz < sizeof(chunk_header_t))
+		return sparse_fail(ss, "sparse image header issue", response);
+
 	/*
 	 * Verify that the sparse block size is a multiple of our
 	 * storage backend block size
 	 */
-	div_u64_rem(sparse_header->blk_sz, info->blksz, &offset);
-	if (offset) {
+	if (!sparse_header->blk_sz || sparse_header->blk_sz % ss->blksz) {
 		printf("%s: Sparse image block size issue [%u]\n",
 		       __func__, sparse_header->blk_sz);
-		info->mssg("sparse image block size issue", response);
-		return -1;
+		return sparse_fail(ss, "sparse image block size issue",
+				   response);
 	}
 
 	puts("Flashing Sparse Image\n");
 
-	/* Start processing chunks */
-	blk = info->start;
-	for (chunk = 0; chunk < sparse_header->total_chunks; chunk++) {
-		/* Read and skip over chunk header */
-		chunk_header = (chunk_header_t *)data;
-		data += sizeof(chunk_header_t);
-
-		if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
-			debug("=== Chunk Header ===\n");
-			debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
-			debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
-			debug("total_size: 0x%x\n", chunk_header->total_sz);
-		}
+	/* Skip the remaining bytes in a header that is longer than expected */
+	ss->skip = sparse_header->file_hdr_sz - sizeof(sparse_header_t);
+	ss->chunks_left = sparse_header->total_chunks;
+	sparse_next_chunk(ss);
 
-		if (sparse_header->chunk_hdr_sz > sizeof(chunk_header_t)) {
-			/*
-			 * Skip the remaining bytes in a header that is longer
-			 * than we expected.
-			 */
-			data += (sparse_header->chunk_hdr_sz -
-				 sizeof(chunk_header_t));
-		}
+	return 0;
+}
+
+static int sparse_chunk_header(struct sparse_stream *ss, char *response)
+{
+	sparse_header_t *sparse_header = &ss->sparse;
+	chunk_header_t *chunk_header = &ss->chunk;
+	struct sparse_storage *info = ss->info;
+	u64 chunk_data_sz;
+	lbaint_t blkcnt;
 
-		chunk_data_sz = sparse_header->blk_sz * chunk_header->chunk_sz;
-		blkcnt = chunk_data_sz / info->blksz;
-		switch (chunk_header->chunk_type) {
-		case CHUNK_TYPE_RAW:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + chunk_data_sz)) {
-				info->mssg("Bogus chunk size for chunk type Raw",
+	memcpy(chunk_header, ss->hdr, sizeof(*chunk_header));
+	ss->hdr_len = 0;
+
+	if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
+		debug("=== Chunk Header ===\n");
+		debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
+		debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
+		debug("total_size: 0x%x\n", chunk_header->total_sz);
+	}
+
+	if (chunk_header->total_sz < sparse_header->chunk_hdr_sz)
+		return sparse_fail(ss, "Bogus chunk size", response);
+
+	/*
+	 * Skip the remaining bytes in a header that is longer than expected
+	 */
+	ss->skip = sparse_header->chunk_hdr_sz - sizeof(chunk_header_t);
+
+	chunk_data_sz = (u64)sparse_header->blk_sz * chunk_header->chunk_sz;
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + chunk_data_sz))
+			return sparse_fail(ss,
+					   "Bogus chunk size for chunk type Raw",
 					   response);
-				return -1;
-			}
+		ss->total_blocks += chunk_header->chunk_sz;
+		ss->left = chunk_data_sz;
+		ss->state = SPARSE_STREAM_RAW;
+		if (!ss->left)
+			sparse_next_chunk(ss);
+		break;
 
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				info->mssg("Request would exceed partition size!",
+	case CHUNK_TYPE_FILL:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + sizeof(uint32_t)))
+			return sparse_fail(ss,
+					   "Bogus chunk size for chunk type FILL",
 					   response);
-				return -1;
-			}
+		ss->total_blocks += chunk_header->chunk_sz;
+		ss->hdr_want = sizeof(uint32_t);
+		ss->state = SPARSE_STREAM_FILL;
+		break;
 
-			blks = info->write(info, blk, blkcnt, data);
-			/* blks might be > blkcnt (eg. NAND bad-blocks) */
-			if (blks < blkcnt) {
-				printf("%s: %s" LBAFU " [" LBAFU "]\n",
-				       __func__, "Write failed, block #",
-				       blk, blks);
-				info->mssg("flash write failure", response);
-				return -1;
-			}
-			blk += blks;
-			bytes_written += blkcnt * info->blksz;
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
-			break;
+	case CHUNK_TYPE_DONT_CARE:
+		blkcnt = (lbaint_t)chunk_header->chunk_sz *
+			(sparse_header->blk_sz / ss->blksz);
+		ss->blk += info->reserve(info, ss->blk, blkcnt);
+		/* fall through */
+	case CHUNK_TYPE_CRC32:
+		ss->total_blocks += chunk_header->chunk_sz;
+		ss->skip += chunk_header->total_sz -
+			sparse_header->chunk_hdr_sz;
+		sparse_next_chunk(ss);
+		break;
 
-		case CHUNK_TYPE_FILL:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + sizeof(uint32_t))) {
-				info->mssg("Bogus chunk size for chunk type FILL", response);
-				return -1;
-			}
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk_header->chunk_type);
+		return sparse_fail(ss, "Unknown chunk type", response);
+	}
 
-			fill_buf = (uint32_t *)
-				   memalign(ARCH_DMA_MINALIGN,
-					    ROUNDUP(
-						info->blksz * fill_buf_num_blks,
-						ARCH_DMA_MINALIGN));
-			if (!fill_buf) {
-				info->mssg("Malloc failed for: CHUNK_TYPE_FILL",
-					   response);
-				return -1;
-			}
+	return 0;
+}
 
-			fill_val = *(uint32_t *)data;
-			data = (char *)data + sizeof(uint32_t);
+int sparse_stream_init(struct sparse_stream *ss, struct sparse_storage *info,
+		       char *response)
+{
+	memset(ss, '\0', sizeof(*ss));
+	ss->info = info;
+	if (!info->mssg)
+		info->mssg = default_log;
 
-			for (i = 0;
-			     i < (info->blksz * fill_buf_num_blks /
-				  sizeof(fill_val));
-			     i++)
-				fill_buf[i] = fill_val;
+	ss->blksz = info->blksz;
+	ss->blk = info->start;
+	ss->state = SPARSE_STREAM_FILE_HDR;
+	ss->hdr_want = sizeof(sparse_header_t);
+	ss->blk_buf = memalign(ARCH_DMA_MINALIGN, ss->blksz);
+	if (!ss->blk_buf)
+		return sparse_fail(ss, "Malloc failed for block buffer",
+				   response);
 
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				info->mssg("Request would exceed partition size!",
-					   response);
-				return -1;
-			}
+	return 0;
+}
 
-			for (i = 0; i < blkcnt;) {
-				j = blkcnt - i;
-				if (j > fill_buf_num_blks)
-					j = fill_buf_num_blks;
-				blks = info->write(info, blk, j, fill_buf);
-				/* blks might be > j (eg. NAND bad-blocks) */
-				if (blks < j) {
-					printf("%s: %s " LBAFU " [%d]\n",
-					       __func__,
-					       "Write failed, block #",
-					       blk, j);
-					info->mssg("flash write failure",
-						   response);
-					free(fill_buf);
-					return -1;
-				}
-				blk += blks;
-				i += j;
-			}
-			bytes_written += blkcnt * info->blksz;
-			total_blocks += chunk_data_sz / sparse_header->blk_sz;
-			free(fill_buf);
-			break;
+int sparse_stream_write(struct sparse_stream *ss, const void *data,
+			size_t len, char *response)
+{
+	const u8 *ptr = data;
+	u32 fill_val;
+	uint count;
+	int ret = 0;
 
-		case CHUNK_TYPE_DONT_CARE:
-			blk += info->reserve(info, blk, blkcnt);
-			total_blocks += chunk_header->chunk_sz;
-			break;
+	while (len && !ret && ss->state < SPARSE_STREAM_DONE) {
+		if (ss->skip) {
+			count = min_t(size_t, len, ss->skip);
+			ss->skip -= count;
+			ptr += count;
+			len -= count;
+			continue;
+		}
 
-		case CHUNK_TYPE_CRC32:
-			if (chunk_header->total_sz !=
-			    sparse_header->chunk_hdr_sz) {
-				info->mssg("Bogus chunk size for chunk type Dont Care",
-					   response);
-				return -1;
+		switch (ss->state) {
+		case SPARSE_STREAM_RAW:
+			count = min_t(size_t, len, ss->left);
+			ret = sparse_write_raw(ss, ptr, count, response);
+			ss->left -= count;
+			if (!ret && !ss->left)
+				sparse_next_chunk(ss);
+			break;
+		case SPARSE_STREAM_RAW_IMAGE:
+			count = min_t(size_t, len, UINT_MAX & ~(ss->blksz - 1));
+			ret = sparse_write_raw(ss, ptr, count, response);
+			break;
+		default:
+			/* Collect a header, which may be split */
+			count = min_t(size_t, len, ss->hdr_want - ss->hdr_len);
+			memcpy(ss->hdr + ss->hdr_len, ptr, count);
+			ss->hdr_len += count;
+			if (ss->hdr_len < ss->hdr_want)
+				break;
+			if (ss->state == SPARSE_STREAM_FILE_HDR) {
+				ret = sparse_file_header(ss, response);
+			} else if (ss->state == SPARSE_STREAM_CHUNK_HDR) {
+				ret = sparse_chunk_header(ss, response);
+			} else {
+				fill_val = get_unaligned((u32 *)ss->hdr);
+				ret = sparse_write_fill(ss, fill_val, response);
+				if (!ret)
+					sparse_next_chunk(ss);
 			}
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
 			break;
+		}
+		ptr += count;
+		len -= count;
+	}
 
-		default:
-			printf("%s: Unknown chunk type: %x\n", __func__,
-			       chunk_header->chunk_type);
-			info->mssg("Unknown chunk type", response);
-			return -1;
+	return ss->state == SPARSE_STREAM_ERROR ? -1 : 0;
+}
+
+int sparse_stream_finish(struct sparse_stream *ss, const char *part_name,
+			 char *response)
+{
+	int ret = 0;
+
+	/* An image shorter than a sparse header cannot be sparse */
+	if (ss->state == SPARSE_STREAM_FILE_HDR) {
+		ss->state = SPARSE_STREAM_RAW_IMAGE;
+		ret = sparse_write_raw(ss, ss->hdr, ss->hdr_len, response);
+	}
+
+	if (!ret && ss->state == SPARSE_STREAM_RAW_IMAGE && ss->blk_len) {
+		memset(ss->blk_buf + ss->blk_len, '\0',
+		       ss->blksz - ss->blk_len);
+		ret = sparse_write_blocks(ss, ss->blk_buf, 1, response);
+	}
+
+	if (ss->state == SPARSE_STREAM_ERROR) {
+		ret = -1;
+	} else {
+		if (ss->state != SPARSE_STREAM_RAW_IMAGE)
+			debug("Wrote %d blocks, expected to write %d blocks\n",
+			      ss->total_blocks, ss->sparse.total_blks);
+		printf("........ wrote %llu bytes to '%s'\n",
+		       ss->bytes_written, part_name);
+		if (ss->state != SPARSE_STREAM_RAW_IMAGE &&
+		    (ss->state != SPARSE_STREAM_DONE ||
+		     ss->total_blocks != ss->sparse.total_blks)) {
+			ss->info->mssg("sparse image write failure", response);
+			ret = -1;
 		}
 	}
 
-	debug("Wrote %d blocks, expected to write %d blocks\n",
-	      total_blocks, sparse_header->total_blks);
-	printf("........ wrote %u bytes to '%s'\n", bytes_written, part_name);
+	free(ss->fill_buf);
+	free(ss->blk_buf);
+	ss->fill_buf = NULL;
+	ss->blk_buf = NULL;
+
+	return ret;
+}
+
+int write_sparse_image(struct sparse_storage *info,
+		       const char *part_name, void *data, char *response)
+{
+	struct sparse_stream ss;
 
-	if (total_blocks != sparse_header->total_blks) {
-		info->mssg("sparse image write failure", response);
+	if (!is_sparse_image(data)) {
+		if (info->mssg)
+			info->mssg("not a sparse image", response);
 		return -1;
 	}
+	if (sparse_stream_init(&ss, info, response))
+		return -1;
 
-	return 0;
+	/*
+	 * The whole image is in memory and the stream stops after the last
+	 * chunk, so its length does not matter
+	 */
+	sparse_stream_write(&ss, data, SIZE_MAX, response);
+
+	return sparse_stream_finish(&ss, part_name, response);
 }
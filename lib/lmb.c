@@ -8,6 +8,7 @@
 
 #include <common.h>
 #include <lmb.h>
+#include <malloc.h>
 
 #define LMB_ALLOC_ANYWHERE	0
 
@@ -40,135 +41,171 @@ void lmb_dump_all(struct lmb *lmb)
 #endif /* DEBUG */
 }
 
-static long lmb_addrs_overlap(phys_addr_t base1,
-		phys_size_t size1, phys_addr_t base2, phys_size_t size2)
+/*
+ * Check whether the regions [base1, last1] and [base2, last2] overlap or
+ * touch. The last address is used rather than the end so that a region may
+ * reach the top of the address space.
+ */
+static bool lmb_addrs_touch(phys_addr_t base1, phys_addr_t last1,
+			    phys_addr_t base2, phys_addr_t last2)
 {
-	return ((base1 < (base2+size2)) && (base2 < (base1+size1)));
+	return (base1 <= last2 || base1 - last2 == 1) &&
+	       (base2 <= last1 || base2 - last1 == 1);
 }
 
-static long lmb_addrs_adjacent(phys_addr_t base1, phys_size_t size1,
-		phys_addr_t base2, phys_size_t size2)
+static phys_addr_t lmb_region_last(struct lmb_region *rgn, unsigned long r)
 {
-	if (base2 == base1 + size1)
-		return 1;
-	else if (base1 == base2 + size2)
-		return -1;
-
-	return 0;
+	return rgn->region[r].base + rgn->region[r].size - 1;
 }
 
-static long lmb_regions_adjacent(struct lmb_region *rgn,
-		unsigned long r1, unsigned long r2)
+/*
+ * Find the last region starting at or below @addr using a binary search.
+ * Returns -1 if all regions start above @addr.
+ */
+static long lmb_find_region(struct lmb_region *rgn, phys_addr_t addr)
 {
-	phys_addr_t base1 = rgn->region[r1].base;
-	phys_size_t size1 = rgn->region[r1].size;
-	phys_addr_t base2 = rgn->region[r2].base;
-	phys_size_t size2 = rgn->region[r2].size;
+	unsigned long lo = 0, hi = rgn->cnt;
+
+	while (lo < hi) {
+		unsigned long mid = lo + (hi - lo) / 2;
+
+		if (rgn->region[mid].base <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
 
-	return lmb_addrs_adjacent(base1, size1, base2, size2);
+	return (long)lo - 1;
 }
 
-static void lmb_remove_region(struct lmb_region *rgn, unsigned long r)
+static void lmb_remove_regions(struct lmb_region *rgn, unsigned long r,
+			       unsigned long count)
 {
-	unsigned long i;
+	memmove(&rgn->region[r], &rgn->region[r + count],
+		(rgn->cnt - r - count) * sizeof(*rgn->region));
+	rgn->cnt -= count;
+}
+
+/* Make room for at least one more region, moving to the heap if needed */
+static int lmb_grow_regions(struct lmb_region *rgn)
+{
+	struct lmb_property *region;
+	unsigned long max = rgn->max * 2;
 
-	for (i = r; i < rgn->cnt - 1; i++) {
-		rgn->region[i].base = rgn->region[i + 1].base;
-		rgn->region[i].size = rgn->region[i + 1].size;
+	if (rgn->cnt < rgn->max)
+		return 0;
+
+	if (rgn->region == rgn->initial) {
+		region = malloc(max * sizeof(*region));
+		if (region)
+			memcpy(region, rgn->region,
+			       rgn->cnt * sizeof(*region));
+	} else {
+		region = realloc(rgn->region, max * sizeof(*region));
 	}
-	rgn->cnt--;
+	if (!region)
+		return -ENOMEM;
+	rgn->region = region;
+	rgn->max = max;
+
+	return 0;
 }
 
-/* Assumption: base addr of region 1 < base addr of region 2 */
-static void lmb_coalesce_regions(struct lmb_region *rgn,
-		unsigned long r1, unsigned long r2)
+static int lmb_insert_region(struct lmb_region *rgn, unsigned long r,
+			     phys_addr_t base, phys_size_t size)
 {
-	rgn->region[r1].size += rgn->region[r2].size;
-	lmb_remove_region(rgn, r2);
+	if (lmb_grow_regions(rgn))
+		return -1;
+
+	memmove(&rgn->region[r + 1], &rgn->region[r],
+		(rgn->cnt - r) * sizeof(*rgn->region));
+	rgn->region[r].base = base;
+	rgn->region[r].size = size;
+	rgn->cnt++;
+
+	return 0;
+}
+
+static void lmb_init_region(struct lmb_region *rgn)
+{
+	rgn->region = rgn->initial;
+	rgn->max = LMB_INITIAL_REGIONS;
+	rgn->cnt = 0;
+	rgn->size = 0;
 }
 
 void lmb_init(struct lmb *lmb)
 {
-	/* Create a dummy zero size LMB which will get coalesced away later.
-	 * This simplifies the lmb_add() code below...
-	 */
-	lmb->memory.region[0].base = 0;
-	lmb->memory.region[0].size = 0;
-	lmb->memory.cnt = 1;
-	lmb->memory.size = 0;
-
-	/* Ditto. */
-	lmb->reserved.region[0].base = 0;
-	lmb->reserved.region[0].size = 0;
-	lmb->reserved.cnt = 1;
-	lmb->reserved.size = 0;
+	lmb_init_region(&lmb->memory);
+	lmb_init_region(&lmb->reserved);
 }
 
-/* This routine called with relocation disabled. */
-static long lmb_add_region(struct lmb_region *rgn, phys_addr_t base, phys_size_t size)
+static void lmb_release_region(struct lmb_region *rgn)
 {
-	unsigned long coalesced = 0;
-	long adjacent, i;
+	if (rgn->region != rgn->initial)
+		free(rgn->region);
+	lmb_init_region(rgn);
+}
 
-	if ((rgn->cnt == 1) && (rgn->region[0].size == 0)) {
-		rgn->region[0].base = base;
-		rgn->region[0].size = size;
-		return 0;
-	}
+/*
+ * Free any region storage which was allocated on the heap. This must only
+ * be called on an lmb which has been set up with lmb_init() or which is
+ * zeroed.
+ */
+void lmb_release(struct lmb *lmb)
+{
+	lmb_release_region(&lmb->memory);
+	lmb_release_region(&lmb->reserved);
+}
 
-	/* First try and coalesce this LMB with another. */
-	for (i=0; i < rgn->cnt; i++) {
-		phys_addr_t rgnbase = rgn->region[i].base;
-		phys_size_t rgnsize = rgn->region[i].size;
+/*
+ * Add a region, merging it with any regions that it overlaps or touches.
+ * Returns 0 if the region was added or was already covered, the number of
+ * regions it was merged with, or -1 if there is no memory to add it.
+ */
+static long lmb_add_region(struct lmb_region *rgn, phys_addr_t base, phys_size_t size)
+{
+	phys_addr_t last = base + size - 1;
+	phys_addr_t rgnbase, rgnlast;
+	unsigned long first, i;
+	long r;
 
-		if ((rgnbase == base) && (rgnsize == size))
-			/* Already have this region, so we're done */
-			return 0;
+	if (!size)
+		return 0;
 
-		adjacent = lmb_addrs_adjacent(base,size,rgnbase,rgnsize);
-		if ( adjacent > 0 ) {
-			rgn->region[i].base -= size;
-			rgn->region[i].size += size;
-			coalesced++;
+	/* Only the last region starting at or below base can reach it */
+	r = lmb_find_region(rgn, base);
+	if (r < 0)
+		first = 0;
+	else if (lmb_addrs_touch(base, last, rgn->region[r].base,
+				 lmb_region_last(rgn, r)))
+		first = r;
+	else
+		first = r + 1;
+
+	for (i = first; i < rgn->cnt; i++) {
+		if (!lmb_addrs_touch(base, last, rgn->region[i].base,
+				     lmb_region_last(rgn, i)))
 			break;
-		}
-		else if ( adjacent < 0 ) {
-			rgn->region[i].size += size;
-			coalesced++;
-			break;
-		}
-	}
-
-	if ((i < rgn->cnt-1) && lmb_regions_adjacent(rgn, i, i+1) ) {
-		lmb_coalesce_regions(rgn, i, i+1);
-		coalesced++;
 	}
 
-	if (coalesced)
-		return coalesced;
-	if (rgn->cnt >= MAX_LMB_REGIONS)
-		return -1;
-
-	/* Couldn't coalesce the LMB, so add it to the sorted table. */
-	for (i = rgn->cnt-1; i >= 0; i--) {
-		if (base < rgn->region[i].base) {
-			rgn->region[i+1].base = rgn->region[i].base;
-			rgn->region[i+1].size = rgn->region[i].size;
-		} else {
-			rgn->region[i+1].base = base;
-			rgn->region[i+1].size = size;
-			break;
-		}
-	}
+	/* Nothing to merge with, so add it to the sorted table */
+	if (i == first)
+		return lmb_insert_region(rgn, first, base, size);
 
-	if (base < rgn->region[0].base) {
-		rgn->region[0].base = base;
-		rgn->region[0].size = size;
-	}
+	rgnbase = rgn->region[first].base;
+	rgnlast = lmb_region_last(rgn, i - 1);
+	if (i - first == 1 && rgnbase <= base && last <= rgnlast)
+		/* Already have this region, so we're done */
+		return 0;
 
-	rgn->cnt++;
+	rgnbase = min(rgnbase, base);
+	rgnlast = max(rgnlast, last);
+	rgn->region[first].base = rgnbase;
+	rgn->region[first].size = rgnlast - rgnbase + 1;
+	lmb_remove_regions(rgn, first + 1, i - first - 1);
 
-	return 0;
+	return i - first;
 }
 
 /* This routine may be called with relocation disabled. */
@@ -182,50 +219,49 @@ long lmb_add(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 long lmb_free(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 {
 	struct lmb_region *rgn = &(lmb->reserved);
-	phys_addr_t rgnbegin, rgnend;
-	phys_addr_t end = base + size;
-	int i;
-
-	rgnbegin = rgnend = 0; /* supress gcc warnings */
+	phys_addr_t rgnbegin, rgnlast;
+	phys_addr_t last = base + size - 1;
+	long i;
 
 	/* Find the region where (base, size) belongs to */
-	for (i=0; i < rgn->cnt; i++) {
-		rgnbegin = rgn->region[i].base;
-		rgnend = rgnbegin + rgn->region[i].size;
-
-		if ((rgnbegin <= base) && (end <= rgnend))
-			break;
-	}
+	i = lmb_find_region(rgn, base);
+	if (i < 0 || !size)
+		return -1;
+	rgnbegin = rgn->region[i].base;
+	rgnlast = lmb_region_last(rgn, i);
 
 	/* Didn't find the region */
-	if (i == rgn->cnt)
+	if (last < base || last > rgnlast)
 		return -1;
 
 	/* Check to see if we are removing entire region */
-	if ((rgnbegin == base) && (rgnend == end)) {
-		lmb_remove_region(rgn, i);
+	if ((rgnbegin == base) && (rgnlast == last)) {
+		lmb_remove_regions(rgn, i, 1);
 		return 0;
 	}
 
 	/* Check to see if region is matching at the front */
 	if (rgnbegin == base) {
-		rgn->region[i].base = end;
+		rgn->region[i].base = last + 1;
 		rgn->region[i].size -= size;
 		return 0;
 	}
 
 	/* Check to see if the region is matching at the end */
-	if (rgnend == end) {
+	if (rgnlast == last) {
 		rgn->region[i].size -= size;
 		return 0;
 	}
 
 	/*
-	 * We need to split the entry -  adjust the current one to the
-	 * beginging of the hole and add the region after hole.
+	 * We need to split the entry -  add the region after the hole and
+	 * adjust the current one to the beginning of the hole.
 	 */
-	rgn->region[i].size = base - rgn->region[i].base;
-	return lmb_add_region(rgn, end, rgnend - end);
+	if (lmb_insert_region(rgn, i + 1, last + 1, rgnlast - last) < 0)
+		return -1;
+	rgn->region[i].size = base - rgnbegin;
+
+	return 0;
 }
 
 long lmb_reserve(struct lmb *lmb, phys_addr_t base, phys_size_t size)
@@ -235,20 +271,23 @@ long lmb_reserve(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 	return lmb_add_region(_rgn, base, size);
 }
 
+/*
+ * Return the index of the highest region overlapping (base, size), or -1 if
+ * there is none. Since regions never overlap each other, only the last
+ * region starting below the end of (base, size) needs to be checked.
+ */
 static long lmb_overlaps_region(struct lmb_region *rgn, phys_addr_t base,
 				phys_size_t size)
 {
-	unsigned long i;
+	long i;
 
-	for (i=0; i < rgn->cnt; i++) {
-		phys_addr_t rgnbase = rgn->region[i].base;
-		phys_size_t rgnsize = rgn->region[i].size;
-		if ( lmb_addrs_overlap(base,size,rgnbase,rgnsize) ) {
-			break;
-		}
-	}
+	if (!size)
+		return -1;
+	i = lmb_find_region(rgn, base + size - 1);
+	if (i >= 0 && lmb_region_last(rgn, i) >= base)
+		return i;
 
-	return (i < rgn->cnt) ? i : -1;
+	return -1;
 }
 
 phys_addr_t lmb_alloc(struct lmb *lmb, phys_size_t size, ulong align)
@@ -323,15 +362,7 @@ phys_addr_t __lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align, phy
 
 int lmb_is_reserved(struct lmb *lmb, phys_addr_t addr)
 {
-	int i;
-
-	for (i = 0; i < lmb->reserved.cnt; i++) {
-		phys_addr_t upper = lmb->reserved.region[i].base +
-			lmb->reserved.region[i].size - 1;
-		if ((addr >= lmb->reserved.region[i].base) && (addr <= upper))
-			return 1;
-	}
-	return 0;
+	return lmb_overlaps_region(&lmb->reserved, addr, 1) >= 0;
 }
 
 __weak void board_lmb_reserve(struct lmb *lmb)
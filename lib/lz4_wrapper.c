@@ -136,3 +136,92 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 	*dstn = out - dst;
 	return ret;
 }
+
+int ulz4fn_stream(struct ulz4fn_state *state, const void *src, size_t srcn,
+		  size_t *src_used, void *dst, size_t dstn, size_t *dst_used,
+		  size_t *need)
+{
+	const void *send = src + srcn;
+	const void *end = dst + dstn;
+	const void *in = src;
+	void *out = dst;
+	int ret;
+
+	if (!state->started) {
+		const struct lz4_frame_header *h = in;
+		size_t size = sizeof(*h) + sizeof(u8);
+
+		if (srcn < sizeof(*h)) {
+			*need = sizeof(*h);
+			ret = -EAGAIN;
+			goto out;
+		}
+		if (le32_to_cpu(h->magic) != LZ4F_MAGIC || h->version != 1)
+			return -EPROTONOSUPPORT;	/* unknown format */
+		if (h->reserved0 || h->reserved1 || h->reserved2)
+			return -EINVAL;	/* reserved must be zero */
+		if (!h->independent_blocks)
+			return -EPROTONOSUPPORT; /* we can't support this yet */
+		if (h->has_content_size)
+			size += sizeof(u64);
+		if (srcn < size) {
+			*need = size;
+			ret = -EAGAIN;
+			goto out;
+		}
+		state->block_checksum = h->has_block_checksum;
+		state->started = true;
+		in += size;
+	}
+
+	while (1) {
+		struct lz4_block_header b;
+		size_t size = sizeof(b);
+
+		if (send - in < size) {
+			*need = size;
+			ret = -EAGAIN;
+			break;
+		}
+		b.raw = le32_to_cpu(*(u32 *)in);
+		if (!b.size) {
+			in += size;
+			ret = 0;	/* decompression successful */
+			break;
+		}
+
+		size += b.size;
+		if (state->block_checksum)
+			size += sizeof(u32);
+		if (send - in < size) {
+			*need = size;
+			ret = -EAGAIN;
+			break;
+		}
+
+		if (b.not_compressed) {
+			if (b.size > end - out) {
+				ret = -ENOBUFS;	/* output overrun */
+				break;
+			}
+			memcpy(out, in + sizeof(b), b.size);
+			out += b.size;
+		} else {
+			/* constant folding essential, do not touch params! */
+			ret = LZ4_decompress_generic(in + sizeof(b), out, b.size,
+					end - out, endOnInputSize,
+					full, 0, noDict, out, NULL, 0);
+			if (ret < 0) {
+				ret = -EPROTO;	/* decompression error */
+				break;
+			}
+			out += ret;
+		}
+		in += size;
+	}
+
+out:
+	*src_used = in - src;
+	*dst_used = out - dst;
+	return ret;
+}
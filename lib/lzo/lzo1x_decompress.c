@@ -357,3 +357,99 @@ lookbehind_overrun:
 	*out_len = op - out;
 	return LZO_E_LOOKBEHIND_OVERRUN;
 }
+
+/* Enough of the header to find its length, including the optional fields */
+#define LZOP_HEADER_FIXED	38
+
+int lzop_decompress_stream(bool *started, const unsigned char *src,
+			   size_t src_len, size_t *src_used,
+			   unsigned char *dst, size_t dst_len,
+			   size_t *dst_used, size_t *need)
+{
+	const unsigned char *start = src;
+	const unsigned char *send = src + src_len;
+	unsigned char *out = dst;
+	u32 slen, dlen;
+	size_t tmp;
+	int r;
+
+	if (!*started) {
+		const unsigned char *hend;
+
+		if (src_len < LZOP_HEADER_FIXED) {
+			*need = LZOP_HEADER_FIXED;
+			r = LZO_E_INPUT_OVERRUN;
+			goto out;
+		}
+		hend = parse_header(src);
+		if (!hend)
+			return LZO_E_ERROR;
+		if (hend > send) {
+			*need = hend - src;
+			r = LZO_E_INPUT_OVERRUN;
+			goto out;
+		}
+		*started = true;
+		src = hend;
+	}
+
+	while (1) {
+		if (send - src < 4) {
+			*need = 4;
+			r = LZO_E_INPUT_OVERRUN;
+			break;
+		}
+
+		/* read uncompressed block size, exit if last block */
+		dlen = get_unaligned_be32(src);
+		if (dlen == 0) {
+			src += 4;
+			r = LZO_E_OK;
+			break;
+		}
+
+		/* wait for the whole block, including its checksum */
+		if (send - src < 12) {
+			*need = 12;
+			r = LZO_E_INPUT_OVERRUN;
+			break;
+		}
+		slen = get_unaligned_be32(src + 4);
+		if (slen <= 0 || slen > dlen) {
+			r = LZO_E_ERROR;
+			break;
+		}
+		if (send - src < 12 + slen) {
+			*need = 12 + slen;
+			r = LZO_E_INPUT_OVERRUN;
+			break;
+		}
+
+		/* abort if buffer ran out of room */
+		if (dlen > dst + dst_len - out) {
+			r = LZO_E_OUTPUT_OVERRUN;
+			break;
+		}
+
+		if (dlen == slen) {
+			memcpy(out, src + 12, slen);
+		} else {
+			tmp = dlen;
+			r = lzo1x_decompress_safe(src + 12, slen, out, &tmp);
+			if (r != LZO_E_OK)
+				break;
+			if (dlen != tmp) {
+				r = LZO_E_ERROR;
+				break;
+			}
+		}
+
+		src += 12 + slen;
+		out += dlen;
+	}
+
+out:
+	*src_used = src - start;
+	*dst_used = out - dst;
+	return r;
+}
@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: (GPL-2.0 OR BSD-3-Clause) */
+/*
+ * The zstd sources use the XXH64 API from the reference xxHash library.
+ * Map it onto the xxh64 implementation in lib/xxhash.c instead.
+ */
+
+#ifndef ZSTD_XXHASH_H
+#define ZSTD_XXHASH_H
+
+#include <linux/xxhash.h>
+
+typedef struct xxh64_state XXH64_state_t;
+
+#define XXH64(input, length, seed)	xxh64(input, length, seed)
+#define XXH64_reset(state, seed)	xxh64_reset(state, seed)
+#define XXH64_update(state, input, length) \
+	xxh64_update(state, input, length)
+#define XXH64_digest(state)		xxh64_digest(state)
+
+#endif /* ZSTD_XXHASH_H */
@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * U-Boot interface to the Zstandard decompressor
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <u-boot/zstd.h>
+
+#define ZSTD_STATIC_LINKING_ONLY
+#include "zstd.h"
+
+struct zstd_stream {
+	ZSTD_DStream *dstream;
+	ZSTD_outBuffer out;
+	bool frame_end;
+};
+
+static int zstd_errno(size_t ret)
+{
+	switch (ZSTD_getErrorCode(ret)) {
+	case ZSTD_error_dstSize_tooSmall:
+		return -ENOSPC;
+	case ZSTD_error_memory_allocation:
+		return -ENOMEM;
+	default:
+		return -EPROTO;
+	}
+}
+
+int zstd_decompress(const void *src, size_t srcn, void *dst, size_t *dstn)
+{
+	size_t frame_size, ret;
+	size_t out = 0;
+	ZSTD_DCtx *dctx;
+	int err = 0;
+
+	dctx = ZSTD_createDCtx();
+	if (!dctx)
+		return -ENOMEM;
+	do {
+		frame_size = ZSTD_findFrameCompressedSize(src, srcn);
+		if (ZSTD_isError(frame_size)) {
+			/* Ignore anything after the last frame */
+			if (!out)
+				err = zstd_errno(frame_size);
+			break;
+		}
+		ret = ZSTD_decompressDCtx(dctx, dst + out, *dstn - out, src,
+					  frame_size);
+		if (ZSTD_isError(ret)) {
+			err = zstd_errno(ret);
+			break;
+		}
+		out += ret;
+		src += frame_size;
+		srcn -= frame_size;
+	} while (srcn);
+	ZSTD_freeDCtx(dctx);
+	*dstn = out;
+
+	return err;
+}
+
+struct zstd_stream *zstd_stream_create(void *dst, size_t dstn)
+{
+	struct zstd_stream *zs;
+
+	zs = calloc(1, sizeof(*zs));
+	if (!zs)
+		return NULL;
+	zs->dstream = ZSTD_createDStream();
+	if (!zs->dstream) {
+		free(zs);
+		return NULL;
+	}
+	/* Decode straight into @dst rather than through a window buffer */
+	ZSTD_DCtx_setParameter(zs->dstream, ZSTD_d_stableOutBuffer, 1);
+	zs->out.dst = dst;
+	zs->out.size = dstn;
+	zs->frame_end = true;
+
+	return zs;
+}
+
+int zstd_stream_decompress(struct zstd_stream *zs, const void *src,
+			   size_t srcn, size_t *dst_used)
+{
+	ZSTD_inBuffer in = { src, srcn, 0 };
+	int err = 0;
+	size_t ret;
+
+	while (in.pos < in.size && !err) {
+		ret = ZSTD_decompressStream(zs->dstream, &zs->out, &in);
+		if (ZSTD_isError(ret)) {
+			err = zstd_errno(ret);
+		} else {
+			zs->frame_end = !ret;
+			/* The output is full but the frame has not ended */
+			if (ret && zs->out.pos == zs->out.size &&
+			    in.pos < in.size)
+				err = -ENOSPC;
+		}
+	}
+	*dst_used = zs->out.pos;
+	if (err)
+		return err;
+
+	return zs->frame_end ? 0 : -EAGAIN;
+}
+
+void zstd_stream_free(struct zstd_stream *zs)
+{
+	if (!zs)
+		return;
+	ZSTD_freeDStream(zs->dstream);
+	free(zs);
+}
@@ -42,15 +42,63 @@
 # define NFS_TIMEOUT CONFIG_NFS_TIMEOUT
 #endif
 
+/* Bounds of the retransmit timeout for READ requests, in ms */
+#define NFS_RTO_MIN	100
+#define NFS_RTO_MAX	(NFS_TIMEOUT * 8)
+
+/* Bytes of the file received for each hash mark printed */
+#define NFS_HASH_BYTES	(NFS_READ_MAX / 2 * 10)
+
+/* Ethernet frames taken by the reply to a READ of NFS_READ_MAX bytes */
+#define NFS_READ_FRAMES	DIV_ROUND_UP(UDP_HDR_SIZE + sizeof(struct rpc_t) - \
+				     NFS_READ_SIZE + NFS_READ_MAX, \
+				     1500 - IP_HDR_SIZE)
+
 #define NFS_RPC_ERR	1
 #define NFS_RPC_DROP	124
 
 static int fs_mounted;
 static unsigned long rpc_id;
-static int nfs_offset = -1;
-static int nfs_len;
 static ulong nfs_timeout = NFS_TIMEOUT;
 
+/**
+ * struct nfs_read_slot - a READ request which has not been answered in full
+ *
+ * @id:		RPC id of the request, 0 if the slot is free
+ * @offset:	offset in the file of the data still wanted
+ * @len:	number of bytes still wanted
+ * @sent:	time the request was last sent
+ * @tries:	number of times the request has been sent again
+ */
+struct nfs_read_slot {
+	ulong id;
+	uint offset;
+	uint len;
+	ulong sent;
+	int tries;
+};
+
+/*
+ * READ requests in flight. Everything before nfs_read_next has been stored
+ * once no slot is in use, since a slot is only freed when all its data has
+ * arrived.
+ */
+static struct nfs_read_slot nfs_reads[CONFIG_NFS_READ_WINDOW];
+static int nfs_read_window;	/* number of nfs_reads[] which may be used */
+static int nfs_reads_active;
+static uint nfs_read_next;	/* offset of the next block to ask for */
+static ulong nfs_received;	/* bytes of the file received so far */
+static ulong nfs_file_size;
+static bool nfs_size_known;
+static uint nfs_hashes;
+
+/* Round-trip time estimate (RFC 6298), scaled by 8 and 4, and timeout */
+static ulong nfs_srtt;
+static ulong nfs_rttvar;
+static ulong nfs_rto;
+
+static void nfs_timeout_handler(void);
+
 static char dirfh[NFS_FHSIZE];	/* NFSv2 / NFSv3 file handle of directory */
 static char filefh[NFS3_FHSIZE]; /* NFSv2 / NFSv3 file handle */
 static int filefh3_length;	/* (variable) length of filefh when NFSv3 */
@@ -168,17 +216,16 @@ static uint32_t *rpc_add_credentials(uint32_t *p)
 }
 
 /**************************************************************************
-RPC_LOOKUP - Lookup RPC Port numbers
+RPC_SEND - Send an RPC request with a given id
 **************************************************************************/
-static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
+static void rpc_send(unsigned long id, int rpc_prog, int rpc_proc,
+		     uint32_t *data, int datalen)
 {
 	struct rpc_t rpc_pkt;
-	unsigned long id;
 	uint32_t *p;
 	int pktlen;
 	int sport;
 
-	id = ++rpc_id;
 	rpc_pkt.u.call.id = htonl(id);
 	rpc_pkt.u.call.type = htonl(MSG_CALL);
 	rpc_pkt.u.call.rpcvers = htonl(2);	/* use RPC version 2 */
@@ -217,6 +264,14 @@ static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 			    nfs_our_port, pktlen);
 }
 
+/**************************************************************************
+RPC_REQ - Send a new RPC request
+**************************************************************************/
+static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
+{
+	rpc_send(++rpc_id, rpc_prog, rpc_proc, data, datalen);
+}
+
 /**************************************************************************
 RPC_LOOKUP - Lookup RPC Port numbers
 **************************************************************************/
@@ -355,8 +410,9 @@ static void nfs_lookup_req(char *fname)
 
 /**************************************************************************
 NFS_READ - Read File on NFS Server
+A request which is sent again keeps its id, so that the server can spot it
 **************************************************************************/
-static void nfs_read_req(int offset, int readlen)
+static void nfs_read_req(struct nfs_read_slot *rd)
 {
 	uint32_t data[1024];
 	uint32_t *p;
@@ -368,22 +424,71 @@ static void nfs_read_req(int offset, int readlen)
 	if (supported_nfs_versions & NFSV2_FLAG) {
 		memcpy(p, filefh, NFS_FHSIZE);
 		p += (NFS_FHSIZE / 4);
-		*p++ = htonl(offset);
-		*p++ = htonl(readlen);
+		*p++ = htonl(rd->offset);
+		*p++ = htonl(rd->len);
 		*p++ = 0;
 	} else { /* NFSV3_FLAG */
 		*p++ = htonl(filefh3_length);
 		memcpy(p, filefh, filefh3_length);
 		p += (filefh3_length / 4);
 		*p++ = htonl(0); /* offset is 64-bit long, so fill with 0 */
-		*p++ = htonl(offset);
-		*p++ = htonl(readlen);
+		*p++ = htonl(rd->offset);
+		*p++ = htonl(rd->len);
 		*p++ = 0;
 	}
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_READ, data, len);
+	rd->sent = get_timer(0);
+	rpc_send(rd->id, PROG_NFS, NFS_READ, data, len);
+}
+
+/**************************************************************************
+NFS_READ_FILL - Keep the window of READ requests full
+Returns the number of requests in flight, so 0 once the file is complete
+**************************************************************************/
+static int nfs_read_fill(void)
+{
+	struct nfs_read_slot *rd;
+	int i;
+
+	for (i = 0; i < nfs_read_window; i++) {
+		rd = &nfs_reads[i];
+		if (rd->id && nfs_size_known && rd->offset >= nfs_file_size) {
+			/* Asked for more than the file holds */
+			rd->id = 0;
+			nfs_reads_active--;
+		}
+		if (rd->id && get_timer(rd->sent) >= nfs_rto) {
+			rd->tries++;
+			nfs_read_req(rd);
+		}
+	}
+
+	/* Only ask for one block until the first one has arrived */
+	for (i = 0; i < nfs_read_window; i++) {
+		rd = &nfs_reads[i];
+		if (rd->id)
+			continue;
+		if (nfs_size_known ? nfs_read_next >= nfs_file_size :
+		    nfs_read_next && !nfs_received)
+			break;
+		rd->id = ++rpc_id;
+		rd->offset = nfs_read_next;
+		rd->len = NFS_READ_MAX;
+		if (nfs_size_known)
+			rd->len = min_t(ulong, rd->len,
+					nfs_file_size - nfs_read_next);
+		rd->tries = 0;
+		nfs_read_next += rd->len;
+		nfs_reads_active++;
+		nfs_read_req(rd);
+	}
+
+	if (nfs_reads_active)
+		net_set_timeout_handler(nfs_rto, nfs_timeout_handler);
+
+	return nfs_reads_active;
 }
 
 /**************************************************************************
@@ -416,7 +521,7 @@ static void nfs_send(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_fill();
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
@@ -652,19 +757,52 @@ static int nfs_readlink_reply(uchar *pkt, unsigned len)
 	return 0;
 }
 
+static void nfs_rtt_sample(ulong rtt)
+{
+	long err;
+
+	if (!nfs_srtt) {
+		nfs_srtt = rtt << 3;
+		nfs_rttvar = rtt << 1;
+	} else {
+		err = rtt - (nfs_srtt >> 3);
+		nfs_srtt += err;
+		if (err < 0)
+			err = -err;
+		nfs_rttvar += err - (nfs_rttvar >> 2);
+	}
+	nfs_rto = clamp((nfs_srtt >> 3) + nfs_rttvar, (ulong)NFS_RTO_MIN,
+			nfs_timeout);
+}
+
+static struct nfs_read_slot *nfs_read_find(ulong id)
+{
+	int i;
+
+	for (i = 0; i < nfs_read_window; i++) {
+		if (id && nfs_reads[i].id == id)
+			return &nfs_reads[i];
+	}
+
+	return NULL;
+}
+
 static int nfs_read_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
-	int rlen;
+	struct nfs_read_slot *rd;
+	uint rlen, hdr_len;
 	uchar *data_ptr;
+	bool eof = false;
 
 	debug("%s\n", __func__);
 
-	memcpy(&rpc_pkt.u.data[0], pkt, sizeof(rpc_pkt.u.reply));
+	/* Only the header is copied; the data is stored straight from pkt */
+	memcpy(&rpc_pkt.u.data[0], pkt, min_t(uint, len,
+					      sizeof(rpc_pkt.u.reply)));
 
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
+	rd = nfs_read_find(ntohl(rpc_pkt.u.reply.id));
+	if (!rd)
 		return -NFS_RPC_DROP;
 
 	if (rpc_pkt.u.reply.rstatus  ||
@@ -678,31 +816,67 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
-		putc('#');
-
 	if (supported_nfs_versions & NFSV2_FLAG) {
+		nfs_file_size = ntohl(rpc_pkt.u.reply.data[6]);
+		nfs_size_known = true;
 		rlen = ntohl(rpc_pkt.u.reply.data[18]);
-		data_ptr = (uchar *)&(rpc_pkt.u.reply.data[19]);
+		hdr_len = 19 * sizeof(uint32_t) +
+			offsetof(struct rpc_t, u.reply.data);
 	} else {  /* NFSV3_FLAG */
 		int nfsv3_data_offset =
 			nfs3_get_attributes_offset(rpc_pkt.u.reply.data);
 
+		/* Files larger than 4GiB are not supported, as for NFSv2 */
+		if (nfsv3_data_offset > 1) {
+			nfs_file_size = ntohl(rpc_pkt.u.reply.data[8]);
+			nfs_size_known = true;
+		}
 		/* count value */
 		rlen = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
+		eof = rpc_pkt.u.reply.data[2 + nfsv3_data_offset];
 		/* Skip unused values :
-			EOF:		32 bits value,
 			data_size:	32 bits value,
 		*/
-		data_ptr = (uchar *)
-			&(rpc_pkt.u.reply.data[4 + nfsv3_data_offset]);
+		hdr_len = (4 + nfsv3_data_offset) * sizeof(uint32_t) +
+			offsetof(struct rpc_t, u.reply.data);
 	}
 
-	if (store_block(data_ptr, nfs_offset, rlen))
-			return -9999;
+	/* A truncated reply is treated as lost */
+	if (hdr_len > len || rlen > len - hdr_len || rlen > rd->len)
+		return -NFS_RPC_DROP;
+	data_ptr = pkt + hdr_len;
+
+	if (store_block(data_ptr, rd->offset, rlen))
+		return -9999;
+
+	nfs_received += rlen;
+	while (nfs_hashes < nfs_received / NFS_HASH_BYTES) {
+		putc('#');
+		if (!(++nfs_hashes % HASHES_PER_LINE))
+			puts("\n\t ");
+	}
+
+	if (!rd->tries)
+		nfs_rtt_sample(get_timer(rd->sent));
+	nfs_timeout_count = 0;
+
+	/* An empty read also marks the end of the file */
+	if (eof || !rlen) {
+		nfs_file_size = rd->offset + rlen;
+		nfs_size_known = true;
+	}
+
+	/* The server may return less than was asked for */
+	rd->offset += rlen;
+	rd->len -= rlen;
+	if (rd->len && (!nfs_size_known || rd->offset < nfs_file_size)) {
+		rd->id = ++rpc_id;
+		rd->tries = 0;
+		nfs_read_req(rd);
+	} else {
+		rd->id = 0;
+		nfs_reads_active--;
+	}
 
 	return rlen;
 }
@@ -712,9 +886,22 @@ Interfaces of U-BOOT
 **************************************************************************/
 static void nfs_timeout_handler(void)
 {
+	int i;
+
 	if (++nfs_timeout_count > NFS_RETRY_COUNT) {
 		puts("\nRetry count exceeded; starting again\n");
 		net_start_again();
+	} else if (nfs_state == STATE_READ_REQ) {
+		/* Nothing arrived for a while, so send everything again */
+		puts("T ");
+		nfs_rto = min_t(ulong, nfs_rto * 2, NFS_RTO_MAX);
+		for (i = 0; i < nfs_read_window; i++) {
+			if (nfs_reads[i].id) {
+				nfs_reads[i].tries++;
+				nfs_read_req(&nfs_reads[i]);
+			}
+		}
+		net_set_timeout_handler(nfs_rto, nfs_timeout_handler);
 	} else {
 		puts("T ");
 		net_set_timeout_handler(nfs_timeout +
@@ -796,8 +983,15 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			nfs_send();
 		} else {
 			nfs_state = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
+			memset(nfs_reads, '\0', sizeof(nfs_reads));
+			nfs_reads_active = 0;
+			nfs_read_next = 0;
+			nfs_received = 0;
+			nfs_size_known = false;
+			nfs_hashes = 0;
+			nfs_srtt = 0;
+			nfs_rttvar = 0;
+			nfs_rto = nfs_timeout;
 			nfs_send();
 		}
 		break;
@@ -825,15 +1019,14 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		if (rlen == -NFS_RPC_DROP)
 			break;
 		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
-		if (rlen > 0) {
-			nfs_offset += rlen;
-			nfs_send();
+		if (rlen >= 0 && nfs_read_fill()) {
+			break;	/* more of the file to come */
 		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
 			nfs_state = STATE_READLINK_REQ;
 			nfs_send();
 		} else {
-			if (!rlen)
+			if (rlen >= 0)
 				nfs_download_state = NETLOOP_SUCCESS;
 			if (rlen < 0)
 				debug("NFS READ error (%d)\n", rlen);
@@ -905,6 +1098,10 @@ void nfs_start(void)
 	nfs_timeout_count = 0;
 	nfs_state = STATE_PRCLOOKUP_PROG_MOUNT_REQ;
 
+	/* Don't ask for more replies than there are buffers to receive */
+	nfs_read_window = clamp(PKTBUFSRX / (int)NFS_READ_FRAMES, 1,
+				CONFIG_NFS_READ_WINDOW);
+
 	/*nfs_our_port = 4096 + (get_ticks() % 3072);*/
 	/*FIX ME !!!*/
 	nfs_our_port = 1000;
@@ -44,6 +44,18 @@
 #define NFS_READ_SIZE	1024	/* biggest power of two that fits Ether frame */
 #define NFS_MAX_ATTRS	26
 
+/*
+ * Amount of the file asked for by each READ request. The reply to a larger
+ * read is fragmented, so this needs CONFIG_IP_DEFRAG and a reassembly buffer
+ * which can hold the largest read allowed by NFSv2.
+ */
+#if defined(CONFIG_IP_DEFRAG) && \
+	(!defined(CONFIG_NET_MAXDEFRAG) || CONFIG_NET_MAXDEFRAG >= 16384)
+#define NFS_READ_MAX	8192
+#else
+#define NFS_READ_MAX	NFS_READ_SIZE
+#endif
+
 /* Values for Accept State flag on RPC answers (See: rfc1831) */
 enum rpc_accept_stat {
 	NFS_RPC_SUCCESS = 0,	/* RPC executed successfully */
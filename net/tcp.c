@@ -0,0 +1,577 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Minimal TCP client
+ *
+ * This supports one connection at a time, opened from within net_loop(). It
+ * is meant for downloading large files: received data is handed straight to
+ * the caller, who stores it in place, so there is no receive buffer.
+ * Segments which arrive after a lost one are stored too and the ranges they
+ * cover are remembered, so that only the lost segment has to be sent again.
+ * Each segment is acknowledged at once, so the duplicate acknowledgments set
+ * off a fast retransmit in the sender without waiting for its timeout.
+ * Selective acknowledgments are not supported.
+ *
+ * Sending is simple: data is sent as the peer's window allows, resent after
+ * a timeout which backs off, and resent at once after three duplicate
+ * acknowledgments. There is no congestion control, since only small requests
+ * are expected to be sent.
+ *
+ * Closing just sends a FIN and forgets the connection, so there is no
+ * TIME-WAIT state.
+ */
+
+#include <common.h>
+#include <net.h>
+#include <net/tcp.h>
+#include <asm/unaligned.h>
+
+/* Initial retransmission timeout, doubled on each retry up to the maximum */
+#define TCP_RTO_MS	500
+#define TCP_RTO_MAX_MS	8000
+#define TCP_RETRIES	8
+
+/* Receive window, scaled so that it may be larger than 64KiB */
+#define TCP_RCV_WSCALE	4
+#define TCP_RCV_WND	((uint)CONFIG_TCP_RECEIVE_WINDOW)
+
+/* Sending MSS assumed if the peer does not say, from RFC 1122 */
+#define TCP_DEFAULT_MSS	536
+
+/* Number of ranges of out-of-order data which can be remembered */
+#define TCP_OOO_MAX	8
+
+/* TCP options */
+#define TCP_OPT_END	0
+#define TCP_OPT_NOP	1
+#define TCP_OPT_MSS	2
+#define TCP_OPT_WS	3
+
+/* Size of the options in a SYN: MSS, then NOP and window scale */
+#define TCP_SYN_OPT_SIZE	8
+
+#define SEQ_LT(a, b)	((s32)((a) - (b)) < 0)
+#define SEQ_LE(a, b)	((s32)((a) - (b)) <= 0)
+#define SEQ_GT(a, b)	SEQ_LT(b, a)
+#define SEQ_GE(a, b)	SEQ_LE(b, a)
+
+enum tcp_state {
+	TCP_CLOSED,
+	TCP_SYN_SENT,
+	TCP_ESTABLISHED,
+};
+
+/* Range of sequence numbers, not including @end */
+struct tcp_range {
+	u32 start;
+	u32 end;
+};
+
+/**
+ * struct tcp_conn - the connection
+ *
+ * @state:	connection state
+ * @ip:		peer's IP address
+ * @ethaddr:	peer's Ethernet address, filled in by ARP
+ * @dport:	peer's port
+ * @sport:	our port
+ * @rx:		handler for received data
+ * @event:	handler for events
+ * @iss:	our initial sequence number
+ * @snd_una:	oldest sequence number not acknowledged by the peer
+ * @snd_nxt:	next sequence number to send
+ * @snd_wnd:	peer's receive window
+ * @snd_wscale:	shift to apply to the window advertised by the peer
+ * @wscale_ok:	true if the peer offered window scaling, so both sides use it
+ * @snd_mss:	largest segment the peer accepts
+ * @tx_data:	data to send, or NULL if none
+ * @tx_seq:	sequence number of the first byte of @tx_data
+ * @tx_len:	number of bytes of data to send
+ * @dupacks:	number of duplicate acknowledgments received in a row
+ * @rto:	current retransmission timeout in milliseconds
+ * @retries:	number of timeouts since the peer last made progress
+ * @irs:	peer's initial sequence number
+ * @rcv_nxt:	next sequence number expected from the peer
+ * @fin_rcvd:	true if the peer has sent all its data
+ * @ack_pending: true if an acknowledgment should be sent
+ * @ooo:	ranges of data received out of order, beyond @rcv_nxt
+ * @ooo_cnt:	number of entries in @ooo
+ */
+static struct tcp_conn {
+	enum tcp_state state;
+	struct in_addr ip;
+	uchar ethaddr[ARP_HLEN];
+	int dport;
+	int sport;
+	tcp_rx_f *rx;
+	tcp_event_f *event;
+
+	u32 iss;
+	u32 snd_una;
+	u32 snd_nxt;
+	u32 snd_wnd;
+	uint snd_wscale;
+	bool wscale_ok;
+	uint snd_mss;
+	const uchar *tx_data;
+	u32 tx_seq;
+	uint tx_len;
+	uint dupacks;
+	uint rto;
+	uint retries;
+
+	u32 irs;
+	u32 rcv_nxt;
+	bool fin_rcvd;
+	bool ack_pending;
+	struct tcp_range ooo[TCP_OOO_MAX];
+	int ooo_cnt;
+} tcp;
+
+static void tcp_timeout_handler(void);
+
+/* Receive window, which cannot be scaled unless the peer agreed to that */
+static uint tcp_rcv_wnd(void)
+{
+	return tcp.wscale_ok ? TCP_RCV_WND : min(TCP_RCV_WND, 0xffffU);
+}
+
+static u16 tcp_checksum(struct ip_tcp_hdr *ip, uint tcp_len)
+{
+	struct {
+		struct in_addr src;
+		struct in_addr dst;
+		u8 zero;
+		u8 proto;
+		u16 len;
+	} __packed ph;
+
+	net_copy_ip(&ph.src, &ip->ip_src);
+	net_copy_ip(&ph.dst, &ip->ip_dst);
+	ph.zero = 0;
+	ph.proto = IPPROTO_TCP;
+	ph.len = htons(tcp_len);
+
+	return add_ip_checksums(0, compute_ip_checksum(&ph, sizeof(ph)),
+				compute_ip_checksum(&ip->tcp_src, tcp_len));
+}
+
+int tcp_set_tcp_header(uchar *pkt, struct in_addr dest, int dport, int sport,
+		       int payload_len, u8 action, u32 tcp_seq_num,
+		       u32 tcp_ack_num)
+{
+	struct ip_tcp_hdr *ip = (struct ip_tcp_hdr *)pkt;
+	uchar *opt = pkt + IP_TCP_HDR_SIZE;
+	uint hdr_len = TCP_HDR_SIZE;
+
+	if (action & TCP_SYN) {
+		opt[0] = TCP_OPT_MSS;
+		opt[1] = 4;
+		put_unaligned_be16(TCP_MSS, opt + 2);
+		opt[4] = TCP_OPT_NOP;
+		opt[5] = TCP_OPT_WS;
+		opt[6] = 3;
+		opt[7] = TCP_RCV_WSCALE;
+		hdr_len += TCP_SYN_OPT_SIZE;
+		/* The window in a SYN is never scaled */
+		ip->tcp_win = htons(min(TCP_RCV_WND, 0xffffU));
+	} else if (tcp.wscale_ok) {
+		ip->tcp_win = htons(TCP_RCV_WND >> TCP_RCV_WSCALE);
+	} else {
+		ip->tcp_win = htons(tcp_rcv_wnd());
+	}
+
+	net_set_ip_header(pkt, dest, net_ip,
+			  IP_HDR_SIZE + hdr_len + payload_len, IPPROTO_TCP);
+	ip->tcp_src = htons(sport);
+	ip->tcp_dst = htons(dport);
+	ip->tcp_seq = htonl(tcp_seq_num);
+	ip->tcp_ack = htonl(action & TCP_ACK ? tcp_ack_num : 0);
+	ip->tcp_hlen = (hdr_len / 4) << 4;
+	ip->tcp_flags = action;
+	ip->tcp_ugr = 0;
+	ip->tcp_xsum = 0;
+	ip->tcp_xsum = tcp_checksum(ip, hdr_len + payload_len);
+
+	return IP_HDR_SIZE + hdr_len;
+}
+
+/* Send a segment, taking any payload from the data to be sent */
+static void tcp_send_segment(u32 seq, uint len, u8 flags)
+{
+	uchar *pkt = net_tx_packet + net_eth_hdr_size() + IP_TCP_HDR_SIZE;
+
+	if (len)
+		memcpy(pkt, tcp.tx_data + seq - tcp.tx_seq, len);
+	if (tcp.state != TCP_SYN_SENT)
+		flags |= TCP_ACK;
+	net_send_ip_packet(tcp.ethaddr, tcp.ip, tcp.dport, tcp.sport, len,
+			   IPPROTO_TCP, flags, seq, tcp.rcv_nxt);
+	tcp.ack_pending = false;
+}
+
+/* Sequence number just after the data to send */
+static u32 tcp_tx_end(void)
+{
+	return tcp.tx_seq + tcp.tx_len;
+}
+
+/* Send whatever the peer's window allows, or else just an acknowledgment */
+static void tcp_output(void)
+{
+	u32 wnd_end = tcp.snd_una + tcp.snd_wnd;
+	u32 end = tcp_tx_end();
+	uint len;
+
+	while (SEQ_LT(tcp.snd_nxt, end) && SEQ_LT(tcp.snd_nxt, wnd_end)) {
+		len = min3(tcp.snd_mss, end - tcp.snd_nxt,
+			   wnd_end - tcp.snd_nxt);
+		tcp_send_segment(tcp.snd_nxt, len,
+				 tcp.snd_nxt + len == end ? TCP_PSH : 0);
+		tcp.snd_nxt += len;
+	}
+	if (tcp.ack_pending)
+		tcp_send_segment(tcp.snd_nxt, 0, 0);
+}
+
+/* Send the oldest unacknowledged segment again */
+static void tcp_retransmit(void)
+{
+	if (tcp.state == TCP_SYN_SENT)
+		tcp_send_segment(tcp.iss, 0, TCP_SYN);
+	else if (tcp.snd_una != tcp.snd_nxt)
+		tcp_send_segment(tcp.snd_una,
+				 min(tcp.snd_mss, tcp.snd_nxt - tcp.snd_una),
+				 TCP_PSH);
+	else
+		tcp_send_segment(tcp.snd_nxt, 0, 0);
+}
+
+static void tcp_set_timer(void)
+{
+	net_set_timeout_handler(tcp.rto, tcp_timeout_handler);
+}
+
+/* Note that the peer made progress, so the timeout starts again */
+static void tcp_progress(void)
+{
+	tcp.rto = TCP_RTO_MS;
+	tcp.retries = 0;
+	tcp_set_timer();
+}
+
+/* Number of bytes of the stream received in order */
+static uint tcp_rx_len(void)
+{
+	return tcp.rcv_nxt - tcp.irs - 1 - tcp.fin_rcvd;
+}
+
+static void tcp_end(enum tcp_event event)
+{
+	tcp_event_f *handler = tcp.event;
+
+	tcp.state = TCP_CLOSED;
+	tcp.rx = NULL;
+	tcp.event = NULL;
+	net_set_timeout_handler(0, NULL);
+	if (handler)
+		handler(event, tcp_rx_len());
+}
+
+/*
+ * Nothing has been heard from the peer for a while. Either something we sent
+ * was lost, or something it sent was, so send the oldest unacknowledged
+ * segment again, or an acknowledgment if there is none.
+ */
+static void tcp_timeout_handler(void)
+{
+	if (++tcp.retries > TCP_RETRIES) {
+		tcp_end(TCP_EVENT_TIMEOUT);
+		return;
+	}
+	tcp.rto = min_t(uint, tcp.rto * 2, TCP_RTO_MAX_MS);
+	tcp.dupacks = 0;
+	tcp_retransmit();
+	tcp_set_timer();
+}
+
+void tcp_connect(struct in_addr dest, int dport, tcp_rx_f *rx,
+		 tcp_event_f *event)
+{
+	ulong ticks = get_ticks();
+
+	memset(&tcp, '\0', sizeof(tcp));
+	tcp.ip = dest;
+	tcp.dport = dport;
+	/* Use a clock-driven ISS and an ephemeral port, so each run differs */
+	tcp.sport = 0xc000 | (ticks & 0x3fff);
+	tcp.iss = ticks * 256;
+	tcp.snd_una = tcp.iss;
+	tcp.snd_nxt = tcp.iss + 1;
+	tcp.tx_seq = tcp.snd_nxt;
+	tcp.snd_mss = TCP_DEFAULT_MSS;
+	tcp.rx = rx;
+	tcp.event = event;
+	tcp.state = TCP_SYN_SENT;
+
+	tcp_send_segment(tcp.iss, 0, TCP_SYN);
+	tcp_progress();
+}
+
+int tcp_send(const uchar *data, uint len)
+{
+	if (tcp.state == TCP_CLOSED)
+		return -ENOTCONN;
+	if (tcp.tx_len && SEQ_LT(tcp.snd_una, tcp_tx_end()))
+		return -EBUSY;
+
+	tcp.tx_data = data;
+	tcp.tx_seq = tcp.snd_nxt;
+	tcp.tx_len = len;
+	if (tcp.state == TCP_ESTABLISHED)
+		tcp_output();
+
+	return 0;
+}
+
+void tcp_close(void)
+{
+	if (tcp.state == TCP_CLOSED)
+		return;
+	if (tcp.state == TCP_ESTABLISHED)
+		tcp_send_segment(tcp.snd_nxt, 0, TCP_FIN);
+	net_set_timeout_handler(0, NULL);
+	tcp.state = TCP_CLOSED;
+	tcp.rx = NULL;
+	tcp.event = NULL;
+}
+
+/* Read the options from a SYN */
+static void tcp_parse_options(const uchar *opt, int len)
+{
+	while (len > 0) {
+		if (opt[0] == TCP_OPT_END)
+			break;
+		if (opt[0] == TCP_OPT_NOP) {
+			opt++;
+			len--;
+			continue;
+		}
+		if (len < 2 || opt[1] < 2 || opt[1] > len)
+			break;
+		if (opt[0] == TCP_OPT_MSS && opt[1] == 4)
+			tcp.snd_mss = min_t(uint, get_unaligned_be16(opt + 2),
+					    TCP_MSS);
+		else if (opt[0] == TCP_OPT_WS && opt[1] == 3) {
+			tcp.snd_wscale = min_t(uint, opt[2], 14);
+			tcp.wscale_ok = true;
+		}
+		len -= opt[1];
+		opt += opt[1];
+	}
+}
+
+/*
+ * Remember that a range of data has been received out of order, merging it
+ * with any ranges it touches. Returns false if there is no room.
+ */
+static bool tcp_ooo_add(u32 start, u32 end)
+{
+	struct tcp_range *r;
+	int i, n = tcp.ooo_cnt;
+
+	for (i = 0; i < n;) {
+		r = &tcp.ooo[i];
+		if (SEQ_GT(r->start, end) || SEQ_LT(r->end, start)) {
+			i++;
+			continue;
+		}
+		if (SEQ_LT(r->start, start))
+			start = r->start;
+		if (SEQ_GT(r->end, end))
+			end = r->end;
+		*r = tcp.ooo[--n];
+	}
+	if (n == TCP_OOO_MAX)
+		return false;
+	tcp.ooo[n].start = start;
+	tcp.ooo[n].end = end;
+	tcp.ooo_cnt = n + 1;
+
+	return true;
+}
+
+static bool tcp_ooo_covered(u32 start, u32 end)
+{
+	int i;
+
+	for (i = 0; i < tcp.ooo_cnt; i++) {
+		if (SEQ_LE(tcp.ooo[i].start, start) &&
+		    SEQ_GE(tcp.ooo[i].end, end))
+			return true;
+	}
+
+	return false;
+}
+
+/* Move past any out-of-order data which is now in order */
+static void tcp_ooo_advance(void)
+{
+	struct tcp_range *r;
+	int i;
+
+	for (i = 0; i < tcp.ooo_cnt;) {
+		r = &tcp.ooo[i];
+		if (SEQ_GT(r->start, tcp.rcv_nxt)) {
+			i++;
+			continue;
+		}
+		if (SEQ_GT(r->end, tcp.rcv_nxt))
+			tcp.rcv_nxt = r->end;
+		*r = tcp.ooo[--tcp.ooo_cnt];
+		i = 0;
+	}
+}
+
+/* Handle data from the peer, returning 0 if OK or -ve to reset */
+static int tcp_receive_data(u32 seq, const uchar *data, uint len)
+{
+	u32 end;
+	int ret;
+
+	/* Every segment is acknowledged at once */
+	tcp.ack_pending = true;
+	if (SEQ_LT(seq, tcp.rcv_nxt)) {
+		if (SEQ_LE(seq + len, tcp.rcv_nxt))
+			return 0;
+		data += tcp.rcv_nxt - seq;
+		len -= tcp.rcv_nxt - seq;
+		seq = tcp.rcv_nxt;
+	}
+	end = seq + len;
+	if (SEQ_GT(end, tcp.rcv_nxt + tcp_rcv_wnd()))
+		return 0;
+
+	if (seq != tcp.rcv_nxt) {
+		if (tcp_ooo_covered(seq, end))
+			return 0;
+		ret = tcp.rx(seq - tcp.irs - 1, data, len);
+		if (ret == -EAGAIN)
+			return 0;
+		if (ret)
+			return ret;
+		tcp_ooo_add(seq, end);
+		return 0;
+	}
+
+	ret = tcp.rx(seq - tcp.irs - 1, data, len);
+	if (ret)
+		return ret;
+	tcp.rcv_nxt = end;
+	if (tcp.ooo_cnt)
+		tcp_ooo_advance();
+
+	return 0;
+}
+
+void tcp_receive(struct ip_tcp_hdr *ip, int len)
+{
+	uint hdr_len, payload_len;
+	u32 seq, ack, old_nxt;
+	u8 flags;
+
+	if (len < IP_TCP_HDR_SIZE)
+		return;
+	hdr_len = (ip->tcp_hlen >> 4) * 4;
+	if (hdr_len < TCP_HDR_SIZE || IP_HDR_SIZE + hdr_len > len)
+		return;
+	if (tcp.state == TCP_CLOSED ||
+	    net_read_ip(&ip->ip_src).s_addr != tcp.ip.s_addr ||
+	    ntohs(ip->tcp_src) != tcp.dport || ntohs(ip->tcp_dst) != tcp.sport)
+		return;
+	if (tcp_checksum(ip, len - IP_HDR_SIZE)) {
+		debug("TCP: bad checksum\n");
+		return;
+	}
+
+	payload_len = len - IP_HDR_SIZE - hdr_len;
+	seq = ntohl(ip->tcp_seq);
+	ack = ntohl(ip->tcp_ack);
+	flags = ip->tcp_flags;
+
+	if (tcp.state == TCP_SYN_SENT) {
+		if (!(flags & TCP_ACK) || ack != tcp.iss + 1)
+			return;
+		if (flags & TCP_RST) {
+			tcp_end(TCP_EVENT_RESET);
+			return;
+		}
+		if (!(flags & TCP_SYN))
+			return;
+		tcp_parse_options((uchar *)ip + IP_TCP_HDR_SIZE,
+				  hdr_len - TCP_HDR_SIZE);
+		tcp.irs = seq;
+		tcp.rcv_nxt = seq + 1;
+		tcp.snd_una = ack;
+		/* The window in a SYN is never scaled */
+		tcp.snd_wnd = ntohs(ip->tcp_win);
+		tcp.state = TCP_ESTABLISHED;
+		tcp.ack_pending = true;
+		tcp_progress();
+		tcp.event(TCP_EVENT_CONNECTED, 0);
+		if (tcp.state == TCP_ESTABLISHED)
+			tcp_output();
+		return;
+	}
+
+	if (flags & TCP_RST) {
+		if (SEQ_GE(seq, tcp.rcv_nxt) &&
+		    SEQ_LT(seq, tcp.rcv_nxt + tcp_rcv_wnd()))
+			tcp_end(TCP_EVENT_RESET);
+		return;
+	}
+	if (flags & TCP_SYN) {
+		/* Our acknowledgment of the SYN was lost, so send it again */
+		tcp_send_segment(tcp.snd_nxt, 0, 0);
+		return;
+	}
+	if (!(flags & TCP_ACK))
+		return;
+
+	if (SEQ_GT(ack, tcp.snd_una) && SEQ_LE(ack, tcp.snd_nxt)) {
+		tcp.snd_una = ack;
+		tcp.dupacks = 0;
+		tcp_progress();
+	} else if (ack == tcp.snd_una && tcp.snd_una != tcp.snd_nxt &&
+		   !payload_len && ++tcp.dupacks == 3) {
+		tcp_retransmit();
+	}
+	tcp.snd_wnd = ntohs(ip->tcp_win) << tcp.snd_wscale;
+
+	old_nxt = tcp.rcv_nxt;
+	if (payload_len && !tcp.fin_rcvd) {
+		if (tcp_receive_data(seq, (uchar *)ip + IP_HDR_SIZE + hdr_len,
+				     payload_len)) {
+			tcp_send_segment(tcp.snd_nxt, 0, TCP_RST);
+			tcp_end(TCP_EVENT_RESET);
+			return;
+		}
+	}
+	if (tcp.rcv_nxt != old_nxt) {
+		tcp_progress();
+		tcp.event(TCP_EVENT_DATA, tcp_rx_len());
+		if (tcp.state != TCP_ESTABLISHED)
+			return;
+	}
+
+	if ((flags & TCP_FIN) && !tcp.fin_rcvd) {
+		tcp.ack_pending = true;
+		if (seq + payload_len == tcp.rcv_nxt) {
+			tcp.rcv_nxt++;
+			tcp.fin_rcvd = true;
+			tcp_output();
+			tcp.event(TCP_EVENT_CLOSED, tcp_rx_len());
+			return;
+		}
+	}
+	tcp_output();
+}
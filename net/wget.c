@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Download a file over HTTP
+ *
+ * This sends a plain HTTP/1.1 GET request and stores the body of the reply
+ * at load_addr as it arrives, including any data which the TCP stack hands
+ * over out of order. Only replies with a status of 200 are accepted, and
+ * chunked transfer encoding is not supported.
+ */
+
+#include <common.h>
+#include <mapmem.h>
+#include <net.h>
+#include <net/tcp.h>
+#include <net/wget.h>
+#include <linux/sizes.h>
+
+/* Largest HTTP reply header which can be handled */
+#define WGET_HDR_MAX		2048
+
+/* Bytes of the file received for each hash mark printed */
+#define WGET_HASH_BYTES		SZ_64K
+#define HASHES_PER_LINE		50
+
+static struct in_addr wget_server_ip;
+static char wget_path[sizeof(net_boot_file_name)];
+static char wget_request[sizeof(net_boot_file_name) + 128];
+
+/*
+ * The reply header is collected here until it is complete. Then
+ * wget_body_start is set to where the body starts in the stream.
+ */
+static char wget_hdr[WGET_HDR_MAX];
+static uint wget_hdr_len;
+static uint wget_body_start;
+
+static ulong wget_content_len;
+static bool wget_len_known;
+static bool wget_failed;
+static uint wget_hashes;
+static ulong time_start;
+
+static void wget_store(uint pos, const uchar *data, uint len)
+{
+	void *ptr;
+
+	if (wget_len_known) {
+		if (pos >= wget_content_len)
+			return;
+		len = min_t(ulong, len, wget_content_len - pos);
+	}
+	ptr = map_sysmem(load_addr + pos, len);
+	memcpy(ptr, data, len);
+	unmap_sysmem(ptr);
+}
+
+/* Check the status line and find the length of the body */
+static int wget_parse_header(void)
+{
+	char *line, *next, *val;
+	ulong status;
+
+	if (strncmp(wget_hdr, "HTTP/1.", 7) || wget_hdr[8] != ' ') {
+		puts("\nBad HTTP reply\n");
+		return -EPROTO;
+	}
+	status = simple_strtoul(wget_hdr + 9, NULL, 10);
+	if (status != 200) {
+		printf("\nHTTP error: %.*s\n",
+		       (int)(strchr(wget_hdr, '\r') - wget_hdr), wget_hdr);
+		return -ENOENT;
+	}
+
+	for (line = strstr(wget_hdr, "\r\n") + 2; *line; line = next + 2) {
+		next = strstr(line, "\r\n");
+		if (!next)
+			break;
+		if (!strncasecmp(line, "Content-Length:", 15)) {
+			val = line + 15 + strspn(line + 15, " \t");
+			wget_content_len = simple_strtoul(val, NULL, 10);
+			wget_len_known = true;
+		} else if (!strncasecmp(line, "Transfer-Encoding:", 18) &&
+			   strstr(line, "chunked") &&
+			   strstr(line, "chunked") < next) {
+			puts("\nChunked transfer encoding is not supported\n");
+			return -EPROTONOSUPPORT;
+		}
+	}
+	return 0;
+}
+
+static int wget_rx(uint offset, const uchar *data, uint len)
+{
+	uint count;
+	char *end;
+	int ret;
+
+	if (wget_body_start) {
+		if (offset < wget_body_start) {
+			count = min(len, wget_body_start - offset);
+			offset += count;
+			data += count;
+			len -= count;
+		}
+		wget_store(offset - wget_body_start, data, len);
+		return 0;
+	}
+
+	/* The header is only collected in order */
+	if (offset != wget_hdr_len)
+		return -EAGAIN;
+	count = min(len, WGET_HDR_MAX - 1 - wget_hdr_len);
+	memcpy(wget_hdr + wget_hdr_len, data, count);
+	wget_hdr_len += count;
+	wget_hdr[wget_hdr_len] = '\0';
+
+	end = strstr(wget_hdr, "\r\n\r\n");
+	if (!end) {
+		if (wget_hdr_len == WGET_HDR_MAX - 1) {
+			puts("\nHTTP header too long\n");
+			wget_failed = true;
+			return -E2BIG;
+		}
+		return 0;
+	}
+	wget_body_start = end + 4 - wget_hdr;
+	end[2] = '\0';
+	ret = wget_parse_header();
+	if (ret) {
+		wget_failed = true;
+		return ret;
+	}
+
+	count = wget_body_start - offset;
+	if (count < len)
+		wget_store(0, data + count, len - count);
+
+	return 0;
+}
+
+static void wget_done(uint size)
+{
+	net_boot_file_size = size;
+	tcp_close();
+
+	time_start = get_timer(time_start);
+	if (time_start > 0) {
+		puts("\n\t ");	/* Line up with "Loading: " */
+		print_size(net_boot_file_size / time_start * 1000, "/s");
+	}
+	puts("\ndone\n");
+	net_set_state(NETLOOP_SUCCESS);
+}
+
+static void wget_fail(const char *msg)
+{
+	if (!wget_failed)
+		printf("\n%s\n", msg);
+	wget_failed = true;
+	tcp_close();
+	net_set_state(NETLOOP_FAIL);
+}
+
+static void wget_event(enum tcp_event event, uint rx_len)
+{
+	int ret;
+	uint size = wget_body_start ? rx_len - wget_body_start : 0;
+
+	switch (event) {
+	case TCP_EVENT_CONNECTED:
+		ret = tcp_send((uchar *)wget_request, strlen(wget_request));
+		if (ret)
+			wget_fail("Cannot send HTTP request");
+		break;
+	case TCP_EVENT_DATA:
+		while (wget_hashes < size / WGET_HASH_BYTES) {
+			putc('#');
+			if (!(++wget_hashes % HASHES_PER_LINE))
+				puts("\n\t ");
+		}
+		if (wget_len_known && size >= wget_content_len)
+			wget_done(wget_content_len);
+		break;
+	case TCP_EVENT_CLOSED:
+		if (!wget_body_start)
+			wget_fail("Connection closed before the HTTP header");
+		else if (wget_len_known && size < wget_content_len)
+			wget_fail("Connection closed before end of file");
+		else
+			wget_done(size);
+		break;
+	case TCP_EVENT_RESET:
+		wget_fail("Connection reset");
+		break;
+	case TCP_EVENT_TIMEOUT:
+		wget_fail("Connection timed out");
+		break;
+	}
+}
+
+void wget_start(void)
+{
+	wget_server_ip = net_server_ip;
+	if (!net_parse_bootfile(&wget_server_ip, wget_path,
+				sizeof(wget_path)) || !*wget_path) {
+		puts("*** ERROR: no file name given\n");
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+	snprintf(wget_request, sizeof(wget_request),
+		 "GET %s%s HTTP/1.1\r\n"
+		 "Host: %pI4\r\n"
+		 "User-Agent: U-Boot\r\n"
+		 "Connection: close\r\n\r\n",
+		 *wget_path == '/' ? "" : "/", wget_path, &wget_server_ip);
+
+	printf("Using %s device\n", eth_get_name());
+	printf("HTTP from server %pI4; our IP address is %pI4\n",
+	       &wget_server_ip, &net_ip);
+	printf("Filename '%s'.\n", wget_path);
+	printf("Load address: 0x%lx\nLoading: *\b", load_addr);
+
+	wget_hdr_len = 0;
+	wget_body_start = 0;
+	wget_content_len = 0;
+	wget_len_known = false;
+	wget_failed = false;
+	wget_hashes = 0;
+	time_start = get_timer(0);
+
+	tcp_connect(wget_server_ip, WGET_HTTP_PORT, wget_rx, wget_event);
+}
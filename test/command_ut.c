@@ -13,6 +13,11 @@ static const char test_cmd[] = "setenv list 1\n setenv list ${list}2; "
 
 static int do_ut_cmd(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
+	cmd_tbl_t *start = ll_entry_start(cmd_tbl_t, cmd);
+	const int count = ll_entry_count(cmd_tbl_t, cmd);
+	char name[32];
+	int i, len;
+
 	printf("%s: Testing commands\n", __func__);
 	run_command("env default -f -a", 0);
 
@@ -49,6 +54,20 @@ static int do_ut_cmd(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	assert(!strcmp("1", env_get("black")));
 	assert(env_get("adder") != NULL);
 	assert(!strcmp("2", env_get("adder")));
+
+	/* a script run again must see changes to it and to variables */
+	run_command("setenv foo 'setenv black ${adder}x'", 0);
+	run_command("run foo; setenv adder 3; run foo", 0);
+	assert(!strcmp("3x", env_get("black")));
+	run_command("setenv foo 'setenv black y${adder}'", 0);
+	run_command("run foo", 0);
+	assert(!strcmp("y3", env_get("black")));
+
+	/* a loop left with exit can be run again */
+	run_command("setenv foo 'for i in 1 2 3; do setenv black $i; "
+		    "if test $i = 2; then exit; fi; done'", 0);
+	assert(run_command("run foo; run foo", 0) == 0);
+	assert(!strcmp("2", env_get("black")));
 #endif
 
 	assert(run_command("", 0) == 0);
@@ -56,6 +75,22 @@ static int do_ut_cmd(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 
 	assert(run_command("'", 0) == 1);
 
+	/* find_cmd() must agree with a scan of the table for every prefix */
+	for (cmdtp = start; cmdtp != start + count; cmdtp++) {
+		len = strlen(cmdtp->name);
+		assert(find_cmd(cmdtp->name) == cmdtp);
+		for (i = 1; i <= len && i < sizeof(name) - 2; i++) {
+			strlcpy(name, cmdtp->name, i + 1);
+			assert(find_cmd(name) ==
+			       find_cmd_tbl(name, start, count));
+			strcat(name, ".b");
+			assert(find_cmd(name) ==
+			       find_cmd_tbl(name, start, count));
+		}
+	}
+	assert(!find_cmd(""));
+	assert(!find_cmd("no_such_command"));
+
 	printf("%s: Everything went swimmingly\n", __func__);
 	return 0;
 }
@@ -18,6 +18,7 @@
 #include <lzma/LzmaTools.h>
 
 #include <linux/lzo.h>
+#include <u-boot/zstd.h>
 #include <test/compression.h>
 #include <test/suites.h>
 #include <test/ut.h>
@@ -117,6 +118,25 @@ static const char lz4_compressed[] =
 	"\x9d\x12\x8c\x9d";
 static const unsigned long lz4_compressed_size = 276;
 
+#if CONFIG_IS_ENABLED(ZSTD)
+/* zstd -19 /tmp/plain.txt -o /tmp/plain.zst */
+static const char zstd_compressed[] =
+	"\x28\xb5\x2f\xfd\x64\x5e\x00\xad\x05\x00\x42\x4e\x26\x17\x90\x3b"
+	"\x07\x04\x5a\x13\x8b\xa7\x65\x34\x12\x21\x6d\xb0\x39\xbb\xae\xe8"
+	"\xba\xc9\xcd\x5e\x02\x49\xd0\x2b\xa9\xfa\x96\x92\xe7\x1f\x19\x19"
+	"\x7c\x8f\xf1\x9d\x54\x37\xfc\xd6\x0a\xf3\x0c\x93\x56\xc7\x52\x4f"
+	"\x0a\x62\x3e\xd1\xa5\x83\x17\x31\xab\x5d\x8f\x57\xf3\xcc\x3b\x58"
+	"\xf8\x91\x8c\xf1\x2a\x5c\x89\xdd\xf2\x9b\x15\xb7\x92\x5b\xbe\xba"
+	"\xab\xd5\xd1\x34\xdf\xf0\x02\x0e\x61\xcd\x7b\xd6\x01\xfc\xc2\xa7"
+	"\xd4\xd1\x3d\x26\x9c\x10\x49\xb8\x5b\xcd\xba\x7c\xf7\xac\x4b\xad"
+	"\xb7\x31\x1c\xbc\xf9\xcb\x62\x8e\x2e\x9b\x0f\xd3\x87\x57\x45\x12"
+	"\x16\xfa\x3a\x79\xde\x65\xf8\xcc\x48\xd5\x43\xa6\xbd\xc3\x91\x29"
+	"\x65\x29\xa7\x5b\x9a\x08\x08\x00\x60\x13\x00\x63\xa3\x8e\x28\x94"
+	"\x79\x41\x2a\x78\xc2\x91\x70\x9f\xaa\x6a\x21\x7a\xa1\xaa\x0c\xe4"
+	"\xf4\x6e\xfa";
+static const unsigned long zstd_compressed_size = 195;
+#endif
+
 
 #define TEST_BUFFER_SIZE	512
 
@@ -292,6 +312,43 @@ static int uncompress_using_lz4(struct unit_test_state *uts,
 	return (ret != 0);
 }
 
+#if CONFIG_IS_ENABLED(ZSTD)
+static int compress_using_zstd(struct unit_test_state *uts,
+			       void *in, unsigned long in_size,
+			       void *out, unsigned long out_max,
+			       unsigned long *out_size)
+{
+	/* There is no zstd compression in u-boot, so fake it. */
+	ut_asserteq(in_size,  strlen(plain));
+	ut_asserteq(0, memcmp(plain, in, in_size));
+
+	if (zstd_compressed_size > out_max)
+		return -1;
+
+	memcpy(out, zstd_compressed, zstd_compressed_size);
+	if (out_size)
+		*out_size = zstd_compressed_size;
+
+	return 0;
+}
+
+static int uncompress_using_zstd(struct unit_test_state *uts,
+				 void *in, unsigned long in_size,
+				 void *out, unsigned long out_max,
+				 unsigned long *out_size)
+{
+	int ret;
+	size_t input_size = in_size;
+	size_t output_size = out_max;
+
+	ret = zstd_decompress(in, input_size, out, &output_size);
+	if (out_size)
+		*out_size = output_size;
+
+	return (ret != 0);
+}
+#endif
+
 #define errcheck(statement) if (!(statement)) { \
 	fprintf(stderr, "\tFailed: %s\n", #statement); \
 	ret = 1; \
@@ -436,6 +493,15 @@ static int compression_test_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_lz4, 0);
 
+#if CONFIG_IS_ENABLED(ZSTD)
+static int compression_test_zstd(struct unit_test_state *uts)
+{
+	return run_test(uts, "zstd", compress_using_zstd,
+			uncompress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_zstd, 0);
+#endif
+
 static int compress_using_none(struct unit_test_state *uts,
 			       void *in, unsigned long in_size,
 			       void *out, unsigned long out_max,
@@ -526,12 +592,183 @@ static int compression_test_bootm_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_bootm_lz4, 0);
 
+#if CONFIG_IS_ENABLED(ZSTD)
+static int compression_test_bootm_zstd(struct unit_test_state *uts)
+{
+	return run_bootm_test(uts, IH_COMP_ZSTD, compress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_bootm_zstd, 0);
+#endif
+
 static int compression_test_bootm_none(struct unit_test_state *uts)
 {
 	return run_bootm_test(uts, IH_COMP_NONE, compress_using_none);
 }
 COMPRESSION_TEST(compression_test_bootm_none, 0);
 
+/**
+ * run_stream_test() - Run tests on decompressing while an image is loaded
+ *
+ * The compressed data is fed to the decompressor in pieces of various sizes,
+ * so that headers and blocks are split across pieces.
+ *
+ * @comp_type:	Compression type to test
+ * @compress:	Our function to compress data
+ * @return 0 if OK, non-zero on failure
+ */
+static int run_stream_test(struct unit_test_state *uts, int comp_type,
+			   mutate_func compress)
+{
+	static const ulong pieces[] = { 1, 7, 100, 1024 };
+	struct bootm_decomp_stream ds;
+	ulong compress_size = 1024;
+	uchar compress_buff[1024];
+	uchar out[1024];
+	ulong unc_len;
+	ulong pos, len;
+	int i;
+
+	printf("Testing: %s\n", genimg_get_comp_name(comp_type));
+	unc_len = strlen(plain);
+	ut_assertok(compress(uts, (void *)plain, unc_len, compress_buff,
+			     compress_size, &compress_size));
+
+	for (i = 0; i < ARRAY_SIZE(pieces); i++) {
+		memset(out, '\0', sizeof(out));
+		ut_assertok(bootm_decomp_stream_start(&ds, comp_type, out,
+						      unc_len));
+		for (pos = 0; pos < compress_size; pos += len) {
+			len = min(pieces[i], compress_size - pos);
+			ut_assertok(bootm_decomp_stream_feed(&ds, compress_buff +
+							     pos, len));
+		}
+		ut_assertok(bootm_decomp_stream_finish(&ds));
+		ut_asserteq(unc_len, ds.out_len);
+		ut_assertok(memcmp(plain, out, unc_len));
+	}
+
+	/* Too little space for the output */
+	ut_assertok(bootm_decomp_stream_start(&ds, comp_type, out,
+					      unc_len - 1));
+	if (!bootm_decomp_stream_feed(&ds, compress_buff, compress_size))
+		ut_assert(bootm_decomp_stream_finish(&ds));
+
+	/* We can't detect corruption or truncation when not decompressing */
+	if (comp_type == IH_COMP_NONE)
+		return 0;
+
+	/* Truncated image */
+	ut_assertok(bootm_decomp_stream_start(&ds, comp_type, out,
+					      sizeof(out)));
+	if (!bootm_decomp_stream_feed(&ds, compress_buff, compress_size / 2))
+		ut_assert(bootm_decomp_stream_finish(&ds));
+
+	/* Corrupted image */
+	memset(compress_buff + compress_size / 2, '\x49', compress_size / 2);
+	ut_assertok(bootm_decomp_stream_start(&ds, comp_type, out,
+					      sizeof(out)));
+	if (!bootm_decomp_stream_feed(&ds, compress_buff, compress_size))
+		ut_assert(bootm_decomp_stream_finish(&ds));
+
+	return 0;
+}
+
+static int compression_test_stream_gzip(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_GZIP, compress_using_gzip);
+}
+COMPRESSION_TEST(compression_test_stream_gzip, 0);
+
+static int compression_test_stream_bzip2(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_BZIP2, compress_using_bzip2);
+}
+COMPRESSION_TEST(compression_test_stream_bzip2, 0);
+
+static int compression_test_stream_lzma(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_LZMA, compress_using_lzma);
+}
+COMPRESSION_TEST(compression_test_stream_lzma, 0);
+
+static int compression_test_stream_lzo(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_LZO, compress_using_lzo);
+}
+COMPRESSION_TEST(compression_test_stream_lzo, 0);
+
+static int compression_test_stream_lz4(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_LZ4, compress_using_lz4);
+}
+COMPRESSION_TEST(compression_test_stream_lz4, 0);
+
+#if CONFIG_IS_ENABLED(ZSTD)
+static int compression_test_stream_zstd(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_ZSTD, compress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_stream_zstd, 0);
+#endif
+
+static int compression_test_stream_none(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_NONE, compress_using_none);
+}
+COMPRESSION_TEST(compression_test_stream_none, 0);
+
+/* Number of times each image is decompressed by compression_test_speed() */
+#define SPEED_TEST_LOOPS	1000
+
+/*
+ * Report how long each algorithm takes to decompress the test text. The
+ * images are small, so the time includes setting up the decompressor,
+ * which is significant for the small images in a FIT.
+ */
+static int compression_test_speed(struct unit_test_state *uts)
+{
+	static const struct {
+		const char *name;
+		mutate_func compress;
+		mutate_func uncompress;
+	} algos[] = {
+		{ "gzip", compress_using_gzip, uncompress_using_gzip },
+		{ "bzip2", compress_using_bzip2, uncompress_using_bzip2 },
+		{ "lzma", compress_using_lzma, uncompress_using_lzma },
+		{ "lzo", compress_using_lzo, uncompress_using_lzo },
+		{ "lz4", compress_using_lz4, uncompress_using_lz4 },
+#if CONFIG_IS_ENABLED(ZSTD)
+		{ "zstd", compress_using_zstd, uncompress_using_zstd },
+#endif
+	};
+	ulong unc_len = strlen(plain);
+	ulong start_us, delta_us;
+	uchar in[TEST_BUFFER_SIZE];
+	uchar out[TEST_BUFFER_SIZE];
+	ulong in_size, out_size;
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(algos); i++) {
+		ut_assertok(algos[i].compress(uts, (void *)plain, unc_len, in,
+					      sizeof(in), &in_size));
+		start_us = timer_get_us();
+		for (j = 0; j < SPEED_TEST_LOOPS; j++) {
+			ut_assertok(algos[i].uncompress(uts, in, in_size, out,
+							sizeof(out),
+							&out_size));
+		}
+		delta_us = max(timer_get_us() - start_us, 1UL);
+		ut_asserteq(unc_len, out_size);
+		printf("%-6s %4lu -> %lu bytes: %7lu ns per image, %4lu MB/s\n",
+		       algos[i].name, in_size, out_size,
+		       delta_us * 1000 / SPEED_TEST_LOOPS,
+		       unc_len * SPEED_TEST_LOOPS / delta_us);
+	}
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_speed, 0);
+
 int do_ut_compression(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	struct unit_test *tests = ll_entry_start(struct unit_test,
@@ -5,8 +5,12 @@
 
 #include <common.h>
 #include <dm.h>
+#include <malloc.h>
+#include <os.h>
+#include <sandboxblockdev.h>
 #include <usb.h>
 #include <asm/state.h>
+#include <u-boot/sha256.h>
 #include <dm/test.h>
 #include <test/ut.h>
 
@@ -65,6 +69,8 @@ static int dm_test_blk_usb(struct unit_test_state *uts)
 {
 	struct udevice *usb_dev, *dev;
 	struct blk_desc *dev_desc;
+	/* The sandbox SDHCI controller has a card, so a block device too */
+	int count = 6 + IS_ENABLED(CONFIG_MMC_SDHCI_SANDBOX);
 
 	/* Get a flash device */
 	state_set_skip_delays(true);
@@ -77,12 +83,12 @@ static int dm_test_blk_usb(struct unit_test_state *uts)
 	ut_asserteq_ptr(usb_dev, dev_get_parent(dev));
 
 	/* Check we have one block device for each mass storage device */
-	ut_asserteq(6, count_blk_devices());
+	ut_asserteq(count, count_blk_devices());
 
 	/* Now go around again, making sure the old devices were unbound */
 	ut_assertok(usb_stop());
 	ut_assertok(usb_init());
-	ut_asserteq(6, count_blk_devices());
+	ut_asserteq(count, count_blk_devices());
 	ut_assertok(usb_stop());
 
 	return 0;
@@ -162,3 +168,145 @@ static int dm_test_blk_get_from_parent(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_get_from_parent, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Size of the chunks read by the asynchronous test, and how many there are */
+#define BLK_ASYNC_CHUNK_BLKS	128
+#define BLK_ASYNC_CHUNK_SIZE	(BLK_ASYNC_CHUNK_BLKS * 512)
+#define BLK_ASYNC_CHUNKS	16
+/* Simulated time taken by the device for each request */
+#define BLK_ASYNC_LATENCY_US	500
+
+/*
+ * Record the order in which requests complete, using the last entry of the
+ * array as the counter
+ */
+static void blk_async_complete(struct blk_request *req)
+{
+	int *order = req->priv;
+
+	order[req->start / BLK_ASYNC_CHUNK_BLKS] = ++order[BLK_ASYNC_CHUNKS];
+}
+
+static void blk_async_req(struct blk_request *req, int chunk, void *buf,
+			  bool write, int *order)
+{
+	memset(req, '\0', sizeof(*req));
+	req->start = chunk * BLK_ASYNC_CHUNK_BLKS;
+	req->blkcnt = BLK_ASYNC_CHUNK_BLKS;
+	req->buffer = buf;
+	req->write = write;
+	req->complete = blk_async_complete;
+	req->priv = order;
+}
+
+/*
+ * Test asynchronous requests, and that double-buffering overlaps the work
+ * done on one chunk with reading the next
+ */
+static int dm_test_blk_async(struct unit_test_state *uts)
+{
+	const int size = BLK_ASYNC_CHUNK_SIZE * BLK_ASYNC_CHUNKS;
+	const char *fname = "blk_async_test.img";
+	u8 digest[SHA256_SUM_LEN], expect[SHA256_SUM_LEN];
+	int order[BLK_ASYNC_CHUNKS + 1] = { 0 };
+	struct blk_request req[4], *cur, *next;
+	ulong start, sync_us, async_us;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	u8 *data, *buf;
+	int fd, i;
+
+	data = malloc(size);
+	ut_assertnonnull(data);
+	buf = malloc(BLK_ASYNC_CHUNK_SIZE * 4);
+	ut_assertnonnull(buf);
+	ut_fill_pattern(data, size);
+	fd = os_open(fname, OS_O_RDWR | OS_O_CREAT | OS_O_TRUNC);
+	ut_assert(fd >= 0);
+	ut_asserteq(size, os_write(fd, data, size));
+	os_close(fd);
+
+	ut_assertok(host_dev_bind(0, (char *)fname));
+	ut_assertok(host_get_dev_err(0, &desc));
+	ut_assertok(host_dev_set_latency(0, BLK_ASYNC_LATENCY_US));
+
+	/* Several requests can be queued and they complete in order */
+	for (i = 0; i < 4; i++) {
+		blk_async_req(&req[i], i, buf + i * BLK_ASYNC_CHUNK_SIZE,
+			      false, order);
+		ut_assertok(blk_dsubmit(desc, &req[i]));
+	}
+	ut_asserteq(BLK_ASYNC_CHUNK_BLKS, blk_dwait(desc, &req[3]));
+	for (i = 0; i < 4; i++) {
+		ut_assert(req[i].done);
+		ut_asserteq(BLK_ASYNC_CHUNK_BLKS, req[i].result);
+		ut_asserteq(i + 1, order[i]);
+	}
+	ut_assertok(memcmp(data, buf, BLK_ASYNC_CHUNK_SIZE * 4));
+	ut_asserteq(0, blk_dpoll(desc));
+
+	/* Write a chunk and read it back */
+	memset(buf, '\xa5', BLK_ASYNC_CHUNK_SIZE);
+	blk_async_req(&req[0], 5, buf, true, order);
+	ut_assertok(blk_dsubmit(desc, &req[0]));
+	ut_asserteq(BLK_ASYNC_CHUNK_BLKS, blk_dwait(desc, &req[0]));
+	memcpy(data + 5 * BLK_ASYNC_CHUNK_SIZE, buf, BLK_ASYNC_CHUNK_SIZE);
+	next = &req[1];
+	blk_async_req(next, 5, buf + BLK_ASYNC_CHUNK_SIZE, false, order);
+	ut_assertok(blk_dsubmit(desc, next));
+	ut_asserteq(BLK_ASYNC_CHUNK_BLKS, blk_dwait(desc, next));
+	ut_assertok(memcmp(buf, next->buffer, BLK_ASYNC_CHUNK_SIZE));
+
+	/* Hash each chunk while the next one is read */
+	start = timer_get_us();
+	blk_async_req(&req[0], 0, buf, false, order);
+	ut_assertok(blk_dsubmit(desc, &req[0]));
+	for (i = 0; i < BLK_ASYNC_CHUNKS; i++) {
+		cur = &req[i & 1];
+		next = &req[!(i & 1)];
+		ut_asserteq(BLK_ASYNC_CHUNK_BLKS, blk_dwait(desc, cur));
+		if (i + 1 < BLK_ASYNC_CHUNKS) {
+			blk_async_req(next, i + 1,
+				      buf + !(i & 1) * BLK_ASYNC_CHUNK_SIZE,
+				      false, order);
+			ut_assertok(blk_dsubmit(desc, next));
+		}
+		sha256_csum_wd(cur->buffer, BLK_ASYNC_CHUNK_SIZE, digest,
+			       CHUNKSZ_SHA256);
+		sha256_csum_wd(data + i * BLK_ASYNC_CHUNK_SIZE,
+			       BLK_ASYNC_CHUNK_SIZE, expect, CHUNKSZ_SHA256);
+		ut_assertok(memcmp(expect, digest, SHA256_SUM_LEN));
+	}
+	async_us = timer_get_us() - start;
+
+	/* The same, reading synchronously */
+	start = timer_get_us();
+	for (i = 0; i < BLK_ASYNC_CHUNKS; i++) {
+		ut_asserteq(BLK_ASYNC_CHUNK_BLKS,
+			    blk_dread(desc, i * BLK_ASYNC_CHUNK_BLKS,
+				      BLK_ASYNC_CHUNK_BLKS, buf));
+		sha256_csum_wd(buf, BLK_ASYNC_CHUNK_SIZE, digest,
+			       CHUNKSZ_SHA256);
+		sha256_csum_wd(data + i * BLK_ASYNC_CHUNK_SIZE,
+			       BLK_ASYNC_CHUNK_SIZE, expect, CHUNKSZ_SHA256);
+		ut_assertok(memcmp(expect, digest, SHA256_SUM_LEN));
+	}
+	sync_us = timer_get_us() - start;
+	printf("%d chunks: synchronous %lu us, double-buffered %lu us\n",
+	       BLK_ASYNC_CHUNKS, sync_us, async_us);
+
+	/* Drivers without submit() complete the request straight away */
+	ut_assertok(blk_get_device(IF_TYPE_MMC, 0, &dev));
+	blk_async_req(&req[0], 0, buf, false, order);
+	ut_assertok(blk_dsubmit(dev_get_uclass_platdata(dev), &req[0]));
+	ut_assert(req[0].done);
+	ut_asserteq(BLK_ASYNC_CHUNK_BLKS, req[0].result);
+
+	ut_assertok(host_dev_bind(0, NULL));
+	ut_assertok(os_unlink(fname));
+	free(buf);
+	free(data);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_async, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for writing DFU images to MMC, through the emulated SD Host Controller
+ */
+
+#include <common.h>
+#include <dfu.h>
+#include <dm.h>
+#include <malloc.h>
+#include <mmc.h>
+#include <asm/test.h>
+#include <dm/device-internal.h>
+#include <dm/test.h>
+#include <test/ut.h>
+
+/* The image fills the two halves of a 2 MiB DFU buffer, then one more */
+#define DFU_TEST_BUF_SIZE	"0x200000"
+#define DFU_TEST_SIZE		(3 * SZ_1M)
+#define DFU_TEST_HALVES		3
+
+/*
+ * Set up an entity covering the whole SD card. Each transfer to the card
+ * takes a while, so that writes really do overlap with filling the buffer.
+ */
+static int dfu_test_setup(struct unit_test_state *uts, struct udevice **devp,
+			  struct dfu_entity **dfup)
+{
+	struct udevice *dev;
+	struct mmc *mmc;
+	char devstr[12];
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "sdhci", &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_assertok(mmc_init(mmc));
+	ut_assert(mmc_can_write_in_background(mmc));
+	/* Probing the block device reads the partition table */
+	ut_assertok(device_probe(mmc_get_blk_desc(mmc)->bdev));
+	sandbox_sdhci_set_latency(dev, 1000);
+
+	snprintf(devstr, sizeof(devstr), "%d", mmc_get_blk_desc(mmc)->devnum);
+	ut_assertok(env_set("dfu_alt_info", "img raw 0 0x2000"));
+	ut_assertok(env_set("dfu_bufsiz", DFU_TEST_BUF_SIZE));
+	ut_assertok(env_set("dfu_gunzip", "yes"));
+	/* Drop any buffer allocated with a different size */
+	dfu_free_buf();
+	ut_assertok(dfu_init_env_entities("mmc", devstr));
+	*dfup = dfu_get_entity(0);
+	ut_assertnonnull(*dfup);
+	*devp = dev;
+
+	return 0;
+}
+
+static void dfu_test_teardown(void)
+{
+	dfu_free_entities();
+	dfu_free_buf();
+	env_set("dfu_alt_info", NULL);
+	env_set("dfu_bufsiz", NULL);
+	env_set("dfu_gunzip", NULL);
+}
+
+/* Write an image which is not aligned for DMA, so goes through the buffer */
+static int dfu_test_unaligned(struct unit_test_state *uts, u8 *data)
+{
+	struct sandbox_sdhci_stats stats;
+	struct dfu_entity *dfu;
+	struct udevice *dev;
+	u8 *card;
+
+	ut_assertnonnull(data);
+	ut_assertok(dfu_test_setup(uts, &dev, &dfu));
+	card = sandbox_sdhci_get_card(dev);
+	ut_fill_pattern(data + 1, DFU_TEST_SIZE);
+
+	sandbox_sdhci_get_stats(dev, &stats);
+	ut_assertok(dfu_write_from_mem_addr(dfu, data + 1, DFU_TEST_SIZE));
+	ut_assertok(memcmp(card, data + 1, DFU_TEST_SIZE));
+	sandbox_sdhci_get_stats(dev, &stats);
+	ut_asserteq(DFU_TEST_HALVES, stats.transfers);
+
+	return 0;
+}
+
+static int dm_test_dfu_mmc_unaligned(struct unit_test_state *uts)
+{
+	u8 *data;
+	int ret;
+
+	data = malloc(DFU_TEST_SIZE + 1);
+	ret = dfu_test_unaligned(uts, data);
+	free(data);
+	dfu_test_teardown();
+
+	return ret;
+}
+DM_TEST(dm_test_dfu_mmc_unaligned, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(DFU_GZIP)
+/* Write gzip images, intact and with the trailer damaged in various ways */
+static int dfu_test_gzip(struct unit_test_state *uts, u8 *data, u8 *img)
+{
+	struct sandbox_sdhci_stats stats;
+	struct dfu_entity *dfu;
+	struct udevice *dev;
+	unsigned long len;
+	u8 *card;
+
+	ut_assertnonnull(data);
+	ut_assertnonnull(img);
+	ut_assertok(dfu_test_setup(uts, &dev, &dfu));
+	card = sandbox_sdhci_get_card(dev);
+	ut_fill_pattern(data, DFU_TEST_SIZE);
+	len = DFU_TEST_SIZE + SZ_64K;
+	ut_assertok(gzip(img, &len, data, DFU_TEST_SIZE));
+
+	/* The image is inflated into one half while the other is written */
+	sandbox_sdhci_get_stats(dev, &stats);
+	ut_assertok(dfu_write_from_mem_addr(dfu, img, len));
+	ut_assertok(memcmp(card, data, DFU_TEST_SIZE));
+	sandbox_sdhci_get_stats(dev, &stats);
+	ut_asserteq(DFU_TEST_HALVES, stats.transfers);
+
+	/* The crc32 is at the start of the trailer, then the size */
+	img[len - 8] ^= 1;
+	ut_asserteq(-EIO, dfu_write_from_mem_addr(dfu, img, len));
+	img[len - 8] ^= 1;
+	img[len - 4] ^= 1;
+	ut_asserteq(-EIO, dfu_write_from_mem_addr(dfu, img, len));
+	img[len - 4] ^= 1;
+	ut_asserteq(-EIO, dfu_write_from_mem_addr(dfu, img, len - 4));
+
+	/* None of that gets in the way of the next image */
+	memset(card, '\0', DFU_TEST_SIZE);
+	ut_assertok(dfu_write_from_mem_addr(dfu, img, len));
+	ut_assertok(memcmp(card, data, DFU_TEST_SIZE));
+
+	return 0;
+}
+
+static int dm_test_dfu_mmc_gzip(struct unit_test_state *uts)
+{
+	u8 *data, *img;
+	int ret;
+
+	data = malloc(DFU_TEST_SIZE);
+	img = malloc(DFU_TEST_SIZE + SZ_64K);
+	ret = dfu_test_gzip(uts, data, img);
+	free(img);
+	free(data);
+	dfu_test_teardown();
+
+	return ret;
+}
+DM_TEST(dm_test_dfu_mmc_gzip, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
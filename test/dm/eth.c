@@ -10,12 +10,17 @@
 #include <dm.h>
 #include <fdtdec.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <net.h>
+#include <net/tcp.h>
+#include <net/wget.h>
 #include <dm/test.h>
 #include <dm/device-internal.h>
 #include <dm/uclass-internal.h>
 #include <asm/eth.h>
+#include <asm/unaligned.h>
 #include <test/ut.h>
+#include "../../net/nfs.h"
 
 #define DM_TEST_ETH_NUM		4
 
@@ -428,3 +433,731 @@ static int dm_test_eth_async_ping_reply(struct unit_test_state *uts)
 }
 
 DM_TEST(dm_test_eth_async_ping_reply, DM_TESTF_SCAN_FDT);
+
+/*
+ * Helpers for the fake servers below, which send files filled with
+ * ut_pattern() for U-Boot to load
+ */
+#define SB_ETH_LOAD_ADDR	0x1000000
+/* The fake host fragments datagrams which do not fit in its MTU */
+#define SB_ETH_MTU		1500
+#define SB_ETH_MAX_UDP		(10 * 1024)
+
+/**
+ * sb_eth_queue_ip() - queue an IP datagram from the fake host for U-Boot
+ *
+ * Nothing more is queued once the receive buffer is full, as if the rest of
+ * the datagram was lost.
+ *
+ * @dev: Ethernet device which receives the datagram
+ * @proto: IP protocol of the datagram, e.g. IPPROTO_UDP
+ * @dgram: Contents of the datagram, starting with the UDP or TCP header
+ * @len: Length of @dgram in bytes
+ */
+static void sb_eth_queue_ip(struct udevice *dev, u8 proto, const void *dgram,
+			    uint len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	uint max = (SB_ETH_MTU - IP_HDR_SIZE) & ~7;
+	struct ethernet_hdr *eth_recv;
+	struct ip_hdr *ipr;
+	static u16 id;
+	uint pos, frag;
+
+	for (pos = 0, id++; pos < len; pos += frag) {
+		/* Don't allow the buffer to overrun */
+		if (priv->recv_packets >= PKTBUFSRX)
+			return;
+		frag = min(len - pos, max);
+
+		eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
+		memcpy(eth_recv->et_dest, net_ethaddr, ARP_HLEN);
+		memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+		eth_recv->et_protlen = htons(PROT_IP);
+
+		ipr = (void *)eth_recv + ETHER_HDR_SIZE;
+		net_set_ip_header((uchar *)ipr, net_ip, priv->fake_host_ipaddr,
+				  IP_HDR_SIZE + frag, proto);
+		if (frag < len) {
+			ipr->ip_id = htons(id);
+			ipr->ip_off = htons(pos / 8 | (pos + frag < len ?
+						       IP_FLAGS_MFRAG : 0));
+			ipr->ip_sum = 0;
+			ipr->ip_sum = compute_ip_checksum(ipr, IP_HDR_SIZE);
+		}
+		memcpy((void *)ipr + IP_HDR_SIZE, dgram + pos, frag);
+
+		priv->recv_packet_length[priv->recv_packets] =
+			ETHER_HDR_SIZE + IP_HDR_SIZE + frag;
+		++priv->recv_packets;
+	}
+}
+
+/* Queue a UDP datagram from the fake host for U-Boot */
+static void sb_eth_queue_udp(struct udevice *dev, int sport, int dport,
+			     const void *payload, uint len)
+{
+	uchar dgram[UDP_HDR_SIZE + SB_ETH_MAX_UDP];
+
+	if (len > SB_ETH_MAX_UDP)
+		return;
+	put_unaligned_be16(sport, dgram);
+	put_unaligned_be16(dport, dgram + 2);
+	put_unaligned_be16(UDP_HDR_SIZE + len, dgram + 4);
+	put_unaligned_be16(0, dgram + 6);
+	memcpy(dgram + UDP_HDR_SIZE, payload, len);
+	sb_eth_queue_ip(dev, IPPROTO_UDP, dgram, UDP_HDR_SIZE + len);
+}
+
+/* Load a file using @proto and check that it is @size bytes of the pattern */
+static int sb_eth_load_check(struct unit_test_state *uts, enum proto_t proto,
+			     uint size)
+{
+	u8 *buf;
+	uint i;
+
+	load_addr = SB_ETH_LOAD_ADDR;
+	buf = map_sysmem(load_addr, size);
+	memset(buf, '\0', size);
+
+	ut_asserteq(size, net_loop(proto));
+	for (i = 0; i < size; i++)
+		ut_asserteq(ut_pattern(i), buf[i]);
+	unmap_sysmem(buf);
+
+	return 0;
+}
+
+/* Fake TFTP server used to exercise the RFC 7440 windowsize option */
+#define SB_TFTP_SERVER_PORT	1069
+#define SB_TFTP_BLKSIZE		512
+#define SB_TFTP_BLOCKS		100
+/* The last block is a short one, which ends the transfer */
+#define SB_TFTP_FILE_SIZE	(SB_TFTP_BLOCKS * SB_TFTP_BLKSIZE - 100)
+
+/**
+ * struct sb_tftp_server - state of the fake TFTP server
+ *
+ * @windowsize: window the server accepts (1 = ignore the option)
+ * @drop_block: block to drop once to simulate packet loss (0 = none)
+ * @client_port: UDP port used by U-Boot for the transfer
+ * @acks: number of ACK packets received from U-Boot
+ */
+struct sb_tftp_server {
+	int windowsize;
+	int drop_block;
+	int client_port;
+	int acks;
+};
+
+static void sb_tftp_send_block(struct udevice *dev, struct sb_tftp_server *srv,
+			       int block)
+{
+	uchar pkt[4 + SB_TFTP_BLKSIZE];
+	uint offset = (block - 1) * SB_TFTP_BLKSIZE;
+	int len = min(SB_TFTP_FILE_SIZE - offset, (uint)SB_TFTP_BLKSIZE);
+	int i;
+
+	put_unaligned_be16(3, pkt);	/* DATA */
+	put_unaligned_be16(block, pkt + 2);
+	for (i = 0; i < len; i++)
+		pkt[4 + i] = ut_pattern(offset + i);
+	sb_eth_queue_udp(dev, SB_TFTP_SERVER_PORT, srv->client_port, pkt,
+			 4 + len);
+}
+
+static int sb_tftp_handler(struct udevice *dev, void *packet,
+			   unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_tftp_server *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	uchar *data = (uchar *)ip + IP_UDP_HDR_SIZE;
+	uchar *end = packet + len;
+	char oack[64];
+	int block, last, olen;
+	bool window = false;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	switch (get_unaligned_be16(data)) {
+	case 1:	/* RRQ: filename, mode, then option/value pairs */
+		srv->client_port = ntohs(ip->udp_src);
+		for (data += 2; data < end; data += strlen((char *)data) + 1)
+			if (!strcmp((char *)data, "windowsize"))
+				window = true;
+		olen = 2 + sprintf(oack + 2, "blksize%c%d%c", 0,
+				   SB_TFTP_BLKSIZE, 0);
+		if (window && srv->windowsize > 1)
+			olen += sprintf(oack + olen, "windowsize%c%d%c", 0,
+					srv->windowsize, 0);
+		put_unaligned_be16(6, oack);	/* OACK */
+		sb_eth_queue_udp(dev, SB_TFTP_SERVER_PORT, srv->client_port,
+				 oack, olen);
+		break;
+	case 4:	/* ACK: send the next window */
+		srv->acks++;
+		block = get_unaligned_be16(data + 2);
+		last = min(block + srv->windowsize, SB_TFTP_BLOCKS);
+		for (block++; block <= last; block++) {
+			if (block == srv->drop_block) {
+				srv->drop_block = 0;
+				continue;
+			}
+			sb_tftp_send_block(dev, srv, block);
+		}
+		break;
+	}
+
+	return 0;
+}
+
+static int sb_tftp_get(struct unit_test_state *uts, int windowsize,
+		       int drop_block)
+{
+	struct sb_tftp_server srv = {
+		.windowsize = windowsize,
+		.drop_block = drop_block,
+	};
+
+	env_set_ulong("tftpwindowsize", windowsize);
+	sandbox_eth_set_priv(0, &srv);
+	ut_assertok(sb_eth_load_check(uts, TFTPGET, SB_TFTP_FILE_SIZE));
+
+	/* ACK of the OACK plus one per window (and one NAK per loss) */
+	ut_asserteq(1 + DIV_ROUND_UP(SB_TFTP_BLOCKS, windowsize) +
+		    (drop_block ? 1 : 0), srv.acks);
+
+	return 0;
+}
+
+static int dm_test_eth_tftp_windowsize(struct unit_test_state *uts)
+{
+	static const int windows[] = { 1, 2, 4, 8 };
+	int i, ret = 0;
+
+	sandbox_eth_set_tx_handler(0, sb_tftp_handler);
+	env_set("ethact", "eth@10002000");
+	env_set("tftpblocksize", "512");
+	net_server_ip = string_to_ip("1.1.2.2");
+	copy_filename(net_boot_file_name, "window.bin",
+		      sizeof(net_boot_file_name));
+
+	for (i = 0; i < ARRAY_SIZE(windows) && !ret; i++)
+		ret = sb_tftp_get(uts, windows[i], 0);
+
+	/* Lose a block in the middle of a window; it must be re-requested */
+	if (!ret)
+		ret = sb_tftp_get(uts, 4, 22);
+
+	sandbox_eth_set_tx_handler(0, NULL);
+	env_set("tftpwindowsize", NULL);
+	env_set("tftpblocksize", NULL);
+	net_server_ip.s_addr = 0;
+
+	return ret;
+}
+DM_TEST(dm_test_eth_tftp_windowsize, DM_TESTF_SCAN_FDT);
+
+/* Fake NFSv2 server used to exercise pipelined READ requests */
+#define SB_NFS_MOUNT_PORT	635
+#define SB_NFS_PORT		2049
+#define SB_NFS_FILE_SIZE	(300 * 1024 + 123)
+
+/**
+ * struct sb_nfs_server - state of the fake NFS server
+ *
+ * @drop_offset: offset of a READ whose reply is dropped once (-1 = none)
+ * @short_offset: offset of a READ which only gets half the data (-1 = none)
+ * @reads: number of READ requests received
+ * @pipelined: number of READ requests received while replies to earlier
+ *	ones were still waiting to be picked up by U-Boot
+ */
+struct sb_nfs_server {
+	int drop_offset;
+	int short_offset;
+	int reads;
+	int pipelined;
+};
+
+/* Add the attributes of the file, of which only the size is used */
+static uchar *sb_nfs_fattr(uchar *p)
+{
+	memset(p, '\0', 17 * 4);
+	put_unaligned_be32(1, p);			/* NFREG */
+	put_unaligned_be32(SB_NFS_FILE_SIZE, p + 5 * 4);
+
+	return p + 17 * 4;
+}
+
+static int sb_nfs_handler(struct udevice *dev, void *packet,
+			  unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_nfs_server *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	uchar *req = (uchar *)ip + IP_UDP_HDR_SIZE;
+	uchar reply[SB_ETH_MAX_UDP];
+	uchar *args, *p = reply;
+	uint prog, proc, offset, count, i;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return 0;
+
+	/* Skip the call header, credential and verifier */
+	prog = get_unaligned_be32(req + 3 * 4);
+	proc = get_unaligned_be32(req + 5 * 4);
+	args = req + 8 * 4 + get_unaligned_be32(req + 7 * 4);
+	args += 2 * 4 + get_unaligned_be32(args + 4);
+
+	/* Accepted reply with a null verifier, then the results */
+	memcpy(p, req, 4);
+	put_unaligned_be32(1, p + 4);
+	memset(p + 8, '\0', 4 * 4);
+	p += 6 * 4;
+
+	switch (prog) {
+	case PROG_PORTMAP:
+		put_unaligned_be32(get_unaligned_be32(args) == PROG_MOUNT ?
+				   SB_NFS_MOUNT_PORT : SB_NFS_PORT, p);
+		p += 4;
+		break;
+	case PROG_MOUNT:
+		if (proc == MOUNT_ADDENTRY) {
+			put_unaligned_be32(0, p);
+			memset(p + 4, 0x11, NFS_FHSIZE);
+			p += 4 + NFS_FHSIZE;
+		}
+		break;
+	case PROG_NFS:
+		put_unaligned_be32(0, p);
+		p += 4;
+		if (proc == NFS_LOOKUP) {
+			memset(p, 0x22, NFS_FHSIZE);
+			p = sb_nfs_fattr(p + NFS_FHSIZE);
+			break;
+		}
+		if (proc != NFS_READ)
+			return 0;
+
+		srv->reads++;
+		/* The reply being handled is still in the queue */
+		if (priv->recv_packets > 1)
+			srv->pipelined++;
+		offset = get_unaligned_be32(args + NFS_FHSIZE);
+		count = get_unaligned_be32(args + NFS_FHSIZE + 4);
+		if (offset == srv->drop_offset) {
+			srv->drop_offset = -1;
+			return 0;
+		}
+		if (offset == srv->short_offset) {
+			srv->short_offset = -1;
+			count /= 2;
+		}
+		offset = min(offset, (uint)SB_NFS_FILE_SIZE);
+		count = min(count, (uint)SB_ETH_MAX_UDP - 128);
+		count = min(count, SB_NFS_FILE_SIZE - offset);
+		p = sb_nfs_fattr(p);
+		put_unaligned_be32(count, p);
+		p += 4;
+		for (i = 0; i < count; i++)
+			*p++ = ut_pattern(offset + i);
+		while ((p - reply) & 3)
+			*p++ = 0;
+		break;
+	default:
+		return 0;
+	}
+	sb_eth_queue_udp(dev, ntohs(ip->udp_dst), ntohs(ip->udp_src), reply,
+			 p - reply);
+
+	return 0;
+}
+
+static int sb_nfs_get(struct unit_test_state *uts, struct sb_nfs_server *srv)
+{
+	sandbox_eth_set_priv(0, srv);
+	ut_assertok(sb_eth_load_check(uts, NFS, SB_NFS_FILE_SIZE));
+
+	/* Later requests must be sent before earlier replies are handled */
+	if (CONFIG_NFS_READ_WINDOW > 1)
+		ut_assert(srv->pipelined > 0);
+
+	/* The lost and short replies were sent */
+	ut_asserteq(-1, srv->drop_offset);
+	ut_asserteq(-1, srv->short_offset);
+
+	return 0;
+}
+
+static int dm_test_eth_nfs_pipeline(struct unit_test_state *uts)
+{
+	struct sb_nfs_server srv = {
+		.drop_offset = -1,
+		.short_offset = -1,
+	};
+	int ret;
+
+	sandbox_eth_set_tx_handler(0, sb_nfs_handler);
+	env_set("ethact", "eth@10002000");
+	net_server_ip = string_to_ip("1.1.2.2");
+	copy_filename(net_boot_file_name, "/export/nfs.bin",
+		      sizeof(net_boot_file_name));
+
+	ret = sb_nfs_get(uts, &srv);
+
+	/* Lose one reply and send another one short */
+	if (!ret) {
+		memset(&srv, '\0', sizeof(srv));
+		srv.drop_offset = 5 * NFS_READ_MAX;
+		srv.short_offset = 9 * NFS_READ_MAX;
+		ret = sb_nfs_get(uts, &srv);
+	}
+
+	sandbox_eth_set_tx_handler(0, NULL);
+	net_server_ip.s_addr = 0;
+
+	return ret;
+}
+DM_TEST(dm_test_eth_nfs_pipeline, DM_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_CMD_WGET
+/* Fake HTTP server used to exercise the TCP stack */
+#define SB_TCP_FILE_SIZE	(200 * 1024 + 77)
+#define SB_TCP_MSS		1460
+/* The server's sequence numbers wrap around during the transfer */
+#define SB_TCP_ISS		0xfffff000
+#define SB_TCP_WSCALE		2
+#define SB_TCP_HDR_MAX		128
+
+/**
+ * struct sb_tcp_server - state of the fake HTTP server
+ *
+ * Sequence numbers sent by the server are kept as offsets into the stream,
+ * which is the HTTP reply header followed by the file.
+ *
+ * @wscale: offer window scaling in the SYN-ACK
+ * @send_len: send a Content-Length header, rather than closing the
+ *	connection to mark the end of the file
+ * @drop_ofs: offset of a segment to drop once (-1 = none)
+ * @swap_ofs: offset of a segment to send after the next one, once (-1 = none)
+ * @client_port: TCP port used by U-Boot
+ * @client_wscale: window scale offered by U-Boot (-1 = none)
+ * @rcv_nxt: next sequence number expected from U-Boot
+ * @snd_una: oldest offset not acknowledged by U-Boot
+ * @snd_nxt: next offset to send
+ * @hdr: HTTP reply header
+ * @hdr_len: length of @hdr
+ * @request_ok: true once the expected HTTP request has been received
+ * @fin_sent: true once the server has sent its FIN
+ * @fin_acked: true once U-Boot has acknowledged that FIN
+ * @fin_rcvd: true once U-Boot has sent its FIN
+ * @dupacks: number of duplicate acknowledgments received in a row
+ * @win: window field of the last segment from U-Boot, other than its SYN
+ * @retransmits: number of data segments sent again
+ */
+struct sb_tcp_server {
+	bool wscale;
+	bool send_len;
+	int drop_ofs;
+	int swap_ofs;
+	int client_port;
+	int client_wscale;
+	u32 rcv_nxt;
+	uint snd_una;
+	uint snd_nxt;
+	char hdr[SB_TCP_HDR_MAX];
+	uint hdr_len;
+	bool request_ok;
+	bool fin_sent;
+	bool fin_acked;
+	bool fin_rcvd;
+	int dupacks;
+	uint win;
+	int retransmits;
+};
+
+static uint sb_tcp_stream_len(struct sb_tcp_server *srv)
+{
+	return srv->hdr_len + SB_TCP_FILE_SIZE;
+}
+
+static u16 sb_tcp_checksum(struct ip_tcp_hdr *ip, uint tcp_len)
+{
+	uchar ph[12];
+
+	net_copy_ip(ph, &ip->ip_src);
+	net_copy_ip(ph + 4, &ip->ip_dst);
+	ph[8] = 0;
+	ph[9] = IPPROTO_TCP;
+	put_unaligned_be16(tcp_len, ph + 10);
+
+	return add_ip_checksums(0, compute_ip_checksum(ph, sizeof(ph)),
+				compute_ip_checksum(&ip->tcp_src, tcp_len));
+}
+
+/* Send a segment holding the stream from @ofs, or options if it is a SYN */
+static void sb_tcp_reply(struct udevice *dev, struct sb_tcp_server *srv,
+			 u8 flags, uint ofs, uint len, const uchar *opt,
+			 uint opt_len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	uchar pkt[IP_TCP_HDR_SIZE + 8 + SB_TCP_MSS];
+	struct ip_tcp_hdr *ipr = (void *)pkt;
+	uint tcp_len = TCP_HDR_SIZE + opt_len + len;
+	uchar *p;
+	uint i;
+
+	/* Only the addresses in the IP header are needed, for the checksum */
+	net_copy_ip(&ipr->ip_src, &priv->fake_host_ipaddr);
+	net_copy_ip(&ipr->ip_dst, &net_ip);
+	ipr->tcp_src = htons(WGET_HTTP_PORT);
+	ipr->tcp_dst = htons(srv->client_port);
+	ipr->tcp_seq = htonl(SB_TCP_ISS + (flags & TCP_SYN ? 0 : 1 + ofs));
+	ipr->tcp_ack = htonl(srv->rcv_nxt);
+	ipr->tcp_hlen = ((TCP_HDR_SIZE + opt_len) / 4) << 4;
+	ipr->tcp_flags = flags;
+	ipr->tcp_win = htons(0x8000 >> (srv->wscale ? SB_TCP_WSCALE : 0));
+	ipr->tcp_ugr = 0;
+	ipr->tcp_xsum = 0;
+
+	p = (uchar *)ipr + IP_TCP_HDR_SIZE;
+	memcpy(p, opt, opt_len);
+	for (p += opt_len, i = ofs; i < ofs + len; i++) {
+		if (i < srv->hdr_len)
+			*p++ = srv->hdr[i];
+		else
+			*p++ = ut_pattern(i - srv->hdr_len);
+	}
+	ipr->tcp_xsum = sb_tcp_checksum(ipr, tcp_len);
+
+	sb_eth_queue_ip(dev, IPPROTO_TCP, &ipr->tcp_src, tcp_len);
+}
+
+/* Send the segment at @ofs, returning its length */
+static uint sb_tcp_send_seg(struct udevice *dev, struct sb_tcp_server *srv,
+			    uint ofs)
+{
+	uint len = min(sb_tcp_stream_len(srv) - ofs, (uint)SB_TCP_MSS);
+
+	if (ofs == srv->drop_ofs)
+		srv->drop_ofs = -1;
+	else
+		sb_tcp_reply(dev, srv, TCP_ACK | TCP_PSH, ofs, len, NULL, 0);
+
+	return len;
+}
+
+/* Send as much as U-Boot's window allows, then the FIN */
+static void sb_tcp_output(struct udevice *dev, struct sb_tcp_server *srv)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	uint end = sb_tcp_stream_len(srv);
+	uint wnd = srv->win;
+	uint len;
+
+	if (srv->wscale && srv->client_wscale >= 0)
+		wnd <<= srv->client_wscale;
+
+	while (srv->snd_nxt < end && priv->recv_packets < PKTBUFSRX - 1 &&
+	       srv->snd_nxt + SB_TCP_MSS <= srv->snd_una + wnd) {
+		if (srv->snd_nxt == srv->swap_ofs &&
+		    srv->snd_nxt + SB_TCP_MSS < end) {
+			srv->swap_ofs = -1;
+			len = sb_tcp_send_seg(dev, srv,
+					      srv->snd_nxt + SB_TCP_MSS);
+			sb_tcp_send_seg(dev, srv, srv->snd_nxt);
+			srv->snd_nxt += SB_TCP_MSS + len;
+			continue;
+		}
+		srv->snd_nxt += sb_tcp_send_seg(dev, srv, srv->snd_nxt);
+	}
+
+	if (srv->snd_una == end && !srv->fin_sent && !srv->fin_rcvd) {
+		sb_tcp_reply(dev, srv, TCP_ACK | TCP_FIN, end, 0, NULL, 0);
+		srv->fin_sent = true;
+	}
+}
+
+static int sb_tcp_handler(struct udevice *dev, void *packet,
+			  unsigned int len)
+{
+	static const char request[] = "GET /tcp.bin HTTP/1.1\r\n";
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_tcp_server *srv = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_tcp_hdr *ip = packet + ETHER_HDR_SIZE;
+	uchar syn_opt[8], *opt, *data;
+	uint hdr_len, data_len, ack;
+	int opt_len;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_TCP)
+		return 0;
+	hdr_len = (ip->tcp_hlen >> 4) * 4;
+	data = (uchar *)ip + IP_HDR_SIZE + hdr_len;
+	data_len = ntohs(ip->ip_len) - IP_HDR_SIZE - hdr_len;
+
+	if (ip->tcp_flags & TCP_SYN) {
+		srv->client_port = ntohs(ip->tcp_src);
+		srv->rcv_nxt = ntohl(ip->tcp_seq) + 1;
+		srv->client_wscale = -1;
+		opt = (uchar *)ip + IP_TCP_HDR_SIZE;
+		for (opt_len = hdr_len - TCP_HDR_SIZE; opt_len > 1;) {
+			if (opt[0] == 0)
+				break;
+			if (opt[0] == 1) {
+				opt++;
+				opt_len--;
+				continue;
+			}
+			if (opt[0] == 3 && opt[1] == 3)
+				srv->client_wscale = opt[2];
+			opt_len -= opt[1];
+			opt += opt[1];
+		}
+
+		/* MSS, then NOP and window scale */
+		syn_opt[0] = 2;
+		syn_opt[1] = 4;
+		put_unaligned_be16(SB_TCP_MSS, syn_opt + 2);
+		syn_opt[4] = 1;
+		syn_opt[5] = 3;
+		syn_opt[6] = 3;
+		syn_opt[7] = SB_TCP_WSCALE;
+		sb_tcp_reply(dev, srv, TCP_SYN | TCP_ACK, 0, 0, syn_opt,
+			     srv->wscale ? 8 : 4);
+		return 0;
+	}
+	if (!(ip->tcp_flags & TCP_ACK))
+		return 0;
+
+	srv->win = ntohs(ip->tcp_win);
+	if (data_len && ntohl(ip->tcp_seq) == srv->rcv_nxt) {
+		srv->rcv_nxt += data_len;
+		if (data_len > strlen(request) &&
+		    !memcmp(data, request, strlen(request)))
+			srv->request_ok = true;
+	}
+	if (ip->tcp_flags & TCP_FIN) {
+		srv->fin_rcvd = true;
+		srv->rcv_nxt++;
+	}
+
+	ack = ntohl(ip->tcp_ack) - SB_TCP_ISS - 1;
+	if (srv->fin_sent && ack == sb_tcp_stream_len(srv) + 1) {
+		srv->fin_acked = true;
+		ack--;
+	}
+	if (ack > srv->snd_una && ack <= srv->snd_nxt) {
+		srv->snd_una = ack;
+		srv->dupacks = 0;
+	} else if (ack == srv->snd_una && srv->snd_una != srv->snd_nxt &&
+		   !data_len && ++srv->dupacks == 3) {
+		/* Fast retransmit */
+		sb_tcp_send_seg(dev, srv, srv->snd_una);
+		srv->retransmits++;
+	}
+	if (srv->request_ok)
+		sb_tcp_output(dev, srv);
+
+	return 0;
+}
+
+static int sb_tcp_get(struct unit_test_state *uts, struct sb_tcp_server *srv)
+{
+	bool lose = srv->drop_ofs != -1;
+	uint win;
+
+	srv->hdr_len = sprintf(srv->hdr, "HTTP/1.1 200 OK\r\n");
+	if (srv->send_len)
+		srv->hdr_len += sprintf(srv->hdr + srv->hdr_len,
+					"Content-Length: %d\r\n",
+					SB_TCP_FILE_SIZE);
+	srv->hdr_len += sprintf(srv->hdr + srv->hdr_len, "\r\n");
+
+	sandbox_eth_set_priv(0, srv);
+	ut_assertok(sb_eth_load_check(uts, WGET, SB_TCP_FILE_SIZE));
+
+	ut_assert(srv->request_ok);
+	ut_assert(srv->client_wscale >= 0);
+	/* The window is only scaled if the server agreed to that */
+	if (srv->wscale)
+		win = CONFIG_TCP_RECEIVE_WINDOW >> srv->client_wscale;
+	else
+		win = min(CONFIG_TCP_RECEIVE_WINDOW, 0xffff);
+	ut_asserteq(win, srv->win);
+
+	/* U-Boot closes its side too */
+	ut_assert(srv->fin_rcvd);
+	if (!srv->send_len)
+		ut_assert(srv->fin_acked);
+
+	/* The lost segment was sent again once, and the swapped ones sent */
+	ut_asserteq(-1, srv->drop_ofs);
+	ut_asserteq(-1, srv->swap_ofs);
+	ut_asserteq(lose ? 1 : 0, srv->retransmits);
+
+	return 0;
+}
+
+static int dm_test_eth_tcp(struct unit_test_state *uts)
+{
+	struct sb_tcp_server srv;
+	int ret;
+
+	sandbox_eth_set_tx_handler(0, sb_tcp_handler);
+	env_set("ethact", "eth@10002000");
+	net_server_ip = string_to_ip("1.1.2.2");
+	copy_filename(net_boot_file_name, "tcp.bin",
+		      sizeof(net_boot_file_name));
+
+	/* With and without window scaling */
+	memset(&srv, '\0', sizeof(srv));
+	srv.wscale = true;
+	srv.send_len = true;
+	srv.drop_ofs = -1;
+	srv.swap_ofs = -1;
+	ret = sb_tcp_get(uts, &srv);
+	if (!ret) {
+		memset(&srv, '\0', sizeof(srv));
+		srv.send_len = true;
+		srv.drop_ofs = -1;
+		srv.swap_ofs = -1;
+		ret = sb_tcp_get(uts, &srv);
+	}
+
+	/* Lose one segment, and send two out of order */
+	if (!ret) {
+		memset(&srv, '\0', sizeof(srv));
+		srv.wscale = true;
+		srv.send_len = true;
+		srv.drop_ofs = 20 * SB_TCP_MSS;
+		srv.swap_ofs = 60 * SB_TCP_MSS;
+		ret = sb_tcp_get(uts, &srv);
+	}
+
+	/* Without a length, the server's FIN marks the end of the file */
+	if (!ret) {
+		memset(&srv, '\0', sizeof(srv));
+		srv.wscale = true;
+		srv.drop_ofs = -1;
+		srv.swap_ofs = -1;
+		ret = sb_tcp_get(uts, &srv);
+	}
+
+	sandbox_eth_set_tx_handler(0, NULL);
+	net_server_ip.s_addr = 0;
+
+	return ret;
+}
+DM_TEST(dm_test_eth_tcp, DM_TESTF_SCAN_FDT);
+#endif
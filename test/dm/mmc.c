@@ -5,7 +5,11 @@
 
 #include <common.h>
 #include <dm.h>
+#include <malloc.h>
 #include <mmc.h>
+#include <sdhci.h>
+#include <asm/test.h>
+#include <dm/device-internal.h>
 #include <dm/test.h>
 #include <test/ut.h>
 
@@ -41,3 +45,155 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(MMC_SDHCI_SANDBOX) && CONFIG_IS_ENABLED(MMC_SDHCI_ADMA)
+/*
+ * Test ADMA2 transfers through the generic SDHCI driver, with transfers
+ * either side of the descriptor boundaries
+ */
+static int dm_test_mmc_sdhci_adma(struct unit_test_state *uts)
+{
+	static const struct {
+		lbaint_t start;
+		lbaint_t count;
+	} reads[] = {
+		{ 0, 127 }, { 1, 128 }, { 100, 129 }, { 4000, 255 },
+		{ 5000, 256 }, { 33, 1000 }, { 6144, 2048 },
+	};
+	const lbaint_t card_blocks = 8192;
+	struct sandbox_sdhci_stats stats;
+	struct blk_desc *dev_desc;
+	struct udevice *dev;
+	struct mmc *mmc;
+	u8 *card, *buf, *rbuf;
+	uint i, len;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "sdhci", &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_assertok(mmc_init(mmc));
+	dev_desc = mmc_get_blk_desc(mmc);
+	ut_asserteq(512, dev_desc->blksz);
+	ut_asserteq(card_blocks, dev_desc->lba);
+	card = sandbox_sdhci_get_card(dev);
+	/* Probing the block device reads the partition table */
+	ut_assertok(device_probe(dev_desc->bdev));
+
+	buf = malloc(card_blocks * 512);
+	ut_assertnonnull(buf);
+	rbuf = malloc(card_blocks * 512);
+	ut_assertnonnull(rbuf);
+	ut_fill_pattern(buf, card_blocks * 512);
+
+	/* Fill the card with a single command */
+	sandbox_sdhci_get_stats(dev, &stats);
+	ut_asserteq(card_blocks, blk_dwrite(dev_desc, 0, card_blocks, buf));
+	ut_assertok(memcmp(card, buf, card_blocks * 512));
+	sandbox_sdhci_get_stats(dev, &stats);
+	ut_asserteq(1, stats.transfers);
+	ut_asserteq(DIV_ROUND_UP(card_blocks * 512, ADMA_MAX_LEN),
+		    stats.max_descs);
+
+	for (i = 0; i < ARRAY_SIZE(reads); i++) {
+		len = reads[i].count * 512;
+		memset(rbuf, '\0', len + 512);
+		ut_asserteq(reads[i].count, blk_dread(dev_desc, reads[i].start,
+						      reads[i].count, rbuf));
+		ut_assertok(memcmp(rbuf, buf + reads[i].start * 512, len));
+		/* Nothing is written past the end of the buffer */
+		ut_asserteq(0, rbuf[len]);
+		sandbox_sdhci_get_stats(dev, &stats);
+		ut_asserteq(1, stats.transfers);
+		ut_asserteq(DIV_ROUND_UP(len, ADMA_MAX_LEN), stats.descs);
+	}
+
+	/* Write across a descriptor boundary and check the card */
+	memset(rbuf, 0x5a, 129 * 512);
+	ut_asserteq(129, blk_dwrite(dev_desc, 300, 129, rbuf));
+	ut_assertok(memcmp(card + 300 * 512, rbuf, 129 * 512));
+	ut_assertok(memcmp(card + 299 * 512, buf + 299 * 512, 512));
+	ut_assertok(memcmp(card + 429 * 512, buf + 429 * 512, 512));
+
+	/* Reading past the end of the card fails */
+	ut_asserteq(0, blk_dread(dev_desc, card_blocks - 100, 200, rbuf));
+
+	free(rbuf);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_sdhci_adma, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test writes which go on while the caller gets on with something else */
+static int dm_test_mmc_sdhci_submit(struct unit_test_state *uts)
+{
+	const lbaint_t card_blocks = 8192;
+	struct sandbox_sdhci_stats stats;
+	struct blk_request req[3];
+	struct blk_desc *dev_desc;
+	struct udevice *dev;
+	struct mmc *mmc;
+	u8 *card, *buf;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "sdhci", &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_assertok(mmc_init(mmc));
+	ut_assert(mmc_can_write_in_background(mmc));
+	dev_desc = mmc_get_blk_desc(mmc);
+	card = sandbox_sdhci_get_card(dev);
+	ut_assertok(device_probe(dev_desc->bdev));
+
+	buf = malloc(301 * 512);
+	ut_assertnonnull(buf);
+	ut_fill_pattern(buf, 301 * 512);
+	sandbox_sdhci_set_latency(dev, 20000);
+	sandbox_sdhci_get_stats(dev, &stats);
+
+	memset(req, '\0', sizeof(req));
+	req[0].start = 10;
+	req[0].blkcnt = 300;
+	req[0].buffer = buf;
+	req[0].write = true;
+	req[1].start = 2000;
+	req[1].blkcnt = 1;
+	req[1].buffer = buf + 300 * 512;
+	req[1].write = true;
+	ut_assertok(blk_dsubmit(dev_desc, &req[0]));
+	ut_assertok(blk_dsubmit(dev_desc, &req[1]));
+
+	/* Nothing has reached the card yet */
+	ut_asserteq(2, blk_dpoll(dev_desc));
+	ut_assert(!req[0].done);
+	ut_assert(memcmp(card + 10 * 512, buf, 300 * 512));
+
+	ut_asserteq(300, blk_dwait(dev_desc, &req[0]));
+	ut_assertok(memcmp(card + 10 * 512, buf, 300 * 512));
+	ut_asserteq(1, blk_dwait(dev_desc, &req[1]));
+	ut_assertok(memcmp(card + 2000 * 512, buf + 300 * 512, 512));
+	ut_asserteq(0, blk_dpoll(dev_desc));
+	sandbox_sdhci_get_stats(dev, &stats);
+	ut_asserteq(2, stats.transfers);
+
+	/* A write past the end of the card fails without reaching it */
+	req[2].start = card_blocks - 1;
+	req[2].blkcnt = 2;
+	req[2].buffer = buf;
+	req[2].write = true;
+	ut_assertok(blk_dsubmit(dev_desc, &req[2]));
+	ut_asserteq(-EIO, (long)blk_dwait(dev_desc, &req[2]));
+
+	/* Reads are done straight away */
+	memset(buf, '\0', 300 * 512);
+	req[0].write = false;
+	ut_assertok(blk_dsubmit(dev_desc, &req[0]));
+	ut_assert(req[0].done);
+	ut_asserteq(300, req[0].result);
+	ut_assertok(memcmp(card + 10 * 512, buf, 300 * 512));
+	sandbox_sdhci_get_stats(dev, &stats);
+	ut_asserteq(1, stats.transfers);
+
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_sdhci_submit, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
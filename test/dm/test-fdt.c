@@ -611,3 +611,74 @@ static int dm_test_fdt_disable_enable_by_path(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_fdt_disable_enable_by_path, DM_TESTF_SCAN_PDATA |
 					    DM_TESTF_SCAN_FDT);
+
+/* Check that looking up a compatible string agrees with walking the tree */
+static int check_fdt_index_compat(struct unit_test_state *uts,
+				  const void *blob, const char *compat)
+{
+	int offset = -1, expect = -1;
+
+	do {
+		expect = fdt_node_offset_by_compatible(blob, expect, compat);
+		offset = fdtdec_node_offset_by_compatible(blob, offset,
+							  compat);
+		ut_asserteq(expect, offset);
+	} while (offset >= 0);
+
+	return 0;
+}
+
+/* Test that lookups using the FDT index agree with walking the tree */
+static int dm_test_fdt_index(struct unit_test_state *uts)
+{
+	static const char *const paths[] = {
+		"/", "//", "/some-bus", "/some-bus/", "/some-bus//c-test@1",
+		"/some-bus/c-test", "/some-bus/c-test@9", "/some-bus/c-tes",
+		"/aliases", "/chosen:opts", "/missing", "testbus3",
+		"testbus3/c-test@5", "testbus3:opts/x", "testfdt1/", "fdt",
+		"missing/c-test@0", "",
+	};
+	const void *blob = gd->fdt_blob;
+	const char *list, *name;
+	char path[256];
+	int node, offset, len, i;
+	u32 phandle;
+
+	for (node = 0; node >= 0; node = fdt_next_node(blob, node, NULL)) {
+		ut_assertok(fdt_get_path(blob, node, path, sizeof(path)));
+		ut_asserteq(node, fdtdec_path_offset(blob, path));
+		ut_asserteq(fdt_parent_offset(blob, node),
+			    fdtdec_parent_offset(blob, node));
+
+		phandle = fdt_get_phandle(blob, node);
+		if (phandle) {
+			ut_asserteq(fdt_node_offset_by_phandle(blob, phandle),
+				    fdtdec_node_offset_by_phandle(blob,
+								  phandle));
+		}
+
+		list = fdt_getprop(blob, node, "compatible", &len);
+		for (i = 0; list && i < len; i += strlen(list + i) + 1)
+			ut_assertok(check_fdt_index_compat(uts, blob,
+							   list + i));
+	}
+	ut_assertok(check_fdt_index_compat(uts, blob, "no-such,device"));
+	ut_asserteq(-FDT_ERR_BADPHANDLE,
+		    fdtdec_node_offset_by_phandle(blob, 0));
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdtdec_node_offset_by_phandle(blob, 0x7fffffff));
+
+	/* Aliases, and paths with unit addresses left out or mistakes */
+	offset = fdt_path_offset(blob, "/aliases");
+	fdt_for_each_property_offset(node, blob, offset) {
+		fdt_getprop_by_offset(blob, node, &name, NULL);
+		ut_asserteq(fdt_path_offset(blob, name),
+			    fdtdec_path_offset(blob, name));
+	}
+	for (i = 0; i < ARRAY_SIZE(paths); i++)
+		ut_asserteq(fdt_path_offset(blob, paths[i]),
+			    fdtdec_path_offset(blob, paths[i]));
+
+	return 0;
+}
+DM_TEST(dm_test_fdt_index, 0);
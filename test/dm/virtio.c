@@ -4,15 +4,18 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <dm.h>
 #include <virtio_types.h>
 #include <virtio.h>
 #include <virtio_ring.h>
+#include <asm/test.h>
 #include <dm/device-internal.h>
 #include <dm/uclass-internal.h>
 #include <dm/root.h>
 #include <dm/test.h>
 #include <test/ut.h>
+#include "../../drivers/virtio/virtio_blk.h"
 
 /* Basic test of the virtio uclass */
 static int dm_test_virtio_base(struct unit_test_state *uts)
@@ -120,3 +123,94 @@ static int dm_test_virtio_remove(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_virtio_remove, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/*
+ * Write then read back 32 sectors through the sandbox virtio-blk device,
+ * which splits transfers into requests of 4 segments of 1KiB each. Then
+ * read across the end of the disk, which succeeds for the requests that
+ * complete before the first failing one: @short_read sectors.
+ */
+static int virtio_blk_rw(struct unit_test_state *uts, u64 features,
+			 lbaint_t short_read,
+			 struct sandbox_virtio_stats *stats)
+{
+	struct udevice *bus, *dev;
+	struct blk_desc *desc;
+	u8 wbuf[32 * 512], rbuf[32 * 512];
+	int i;
+
+	ut_assertok(uclass_first_device(UCLASS_VIRTIO, &bus));
+	sandbox_virtio_set_features(bus, features);
+	ut_assertok(device_find_first_child(bus, &dev));
+	ut_assertok(device_probe(dev));
+	desc = dev_get_uclass_platdata(dev);
+	ut_asserteq(64, desc->lba);
+
+	for (i = 0; i < sizeof(wbuf); i++)
+		wbuf[i] = i ^ (i >> 9);
+	ut_asserteq(32, blk_dwrite(desc, 8, 32, wbuf));
+
+	sandbox_virtio_get_stats(bus, stats);
+	memset(rbuf, '\0', sizeof(rbuf));
+	ut_asserteq(32, blk_dread(desc, 8, 32, rbuf));
+	ut_assertok(memcmp(wbuf, rbuf, sizeof(rbuf)));
+	sandbox_virtio_get_stats(bus, stats);
+
+	/* reads beyond the end of the disk fail */
+	ut_asserteq(short_read, blk_dread(desc, 60, 8, rbuf));
+
+	return 0;
+}
+
+/* Test virtio-blk using direct descriptors only */
+static int dm_test_virtio_blk_direct(struct unit_test_state *uts)
+{
+	struct sandbox_virtio_stats stats;
+
+	ut_assertok(virtio_blk_rw(uts, BIT_ULL(VIRTIO_BLK_F_SIZE_MAX) |
+				  BIT_ULL(VIRTIO_BLK_F_SEG_MAX), 4, &stats));
+
+	/* the 4-entry ring holds one request with 2 data segments */
+	ut_asserteq(8, stats.chains);
+	ut_asserteq(0, stats.indirect);
+	ut_asserteq(1, stats.max_batch);
+
+	return 0;
+}
+DM_TEST(dm_test_virtio_blk_direct, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test virtio-blk with indirect descriptors and event index */
+static int dm_test_virtio_blk_indirect(struct unit_test_state *uts)
+{
+	struct sandbox_virtio_stats stats;
+
+	ut_assertok(virtio_blk_rw(uts, BIT_ULL(VIRTIO_BLK_F_SIZE_MAX) |
+				  BIT_ULL(VIRTIO_BLK_F_SEG_MAX) |
+				  BIT_ULL(VIRTIO_RING_F_INDIRECT_DESC) |
+				  BIT_ULL(VIRTIO_RING_F_EVENT_IDX), 0, &stats));
+
+	/* all four requests are in the ring together, with one kick */
+	ut_asserteq(4, stats.chains);
+	ut_asserteq(4, stats.indirect);
+	ut_asserteq(4, stats.max_batch);
+	ut_asserteq(1, stats.kicks);
+
+	return 0;
+}
+DM_TEST(dm_test_virtio_blk_indirect, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test virtio-blk with a device which does not give its segment limit */
+static int dm_test_virtio_blk_one_seg(struct unit_test_state *uts)
+{
+	struct sandbox_virtio_stats stats;
+
+	ut_assertok(virtio_blk_rw(uts, BIT_ULL(VIRTIO_BLK_F_SIZE_MAX) |
+				  BIT_ULL(VIRTIO_RING_F_INDIRECT_DESC), 4,
+				  &stats));
+
+	/* each request has a single 1KiB segment */
+	ut_asserteq(16, stats.chains);
+
+	return 0;
+}
+DM_TEST(dm_test_virtio_blk_one_seg, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
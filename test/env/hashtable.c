@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the environment hash table
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <search.h>
+#include <test/env.h>
+#include <test/ut.h>
+
+/* Number of variables in the test environment */
+#define HTAB_VARS	300
+
+/* Number of times each operation is repeated by env_test_htab_speed() */
+#define SPEED_TEST_LOOPS	100
+
+/*
+ * Build an environment holding HTAB_VARS variables in '\0'-separated form,
+ * followed by the empty entry which ends it. The names are not in order, so
+ * that the table has to sort them.
+ */
+static int build_env(char *buf, int size)
+{
+	char *p = buf;
+	int i, n;
+
+	for (i = 0; i < HTAB_VARS; i++) {
+		n = (i * 7) % HTAB_VARS;
+		p += snprintf(p, size - (p - buf), "htab_var%03d=value %d%c",
+			      n, n * 11, '\0');
+	}
+	*p++ = '\0';
+
+	return p - buf;
+}
+
+static int check_var(struct unit_test_state *uts, struct hsearch_data *htab,
+		     int n)
+{
+	char name[20], value[20];
+	ENTRY e, *ep;
+
+	snprintf(name, sizeof(name), "htab_var%03d", n);
+	snprintf(value, sizeof(value), "value %d", n * 11);
+	e.key = name;
+	e.data = NULL;
+	ut_assert(hsearch_r(e, FIND, &ep, htab, 0));
+	ut_assertnonnull(ep);
+	ut_asserteq_str(value, ep->data);
+
+	return 0;
+}
+
+/* Check that an exported environment lists every variable in order */
+static int check_export(struct unit_test_state *uts, const char *buf,
+			int nvars)
+{
+	const char *p, *prev = NULL;
+	int count = 0;
+
+	for (p = buf; *p; p += strlen(p) + 1) {
+		if (prev)
+			ut_assert(strcmp(prev, p) < 0);
+		prev = p;
+		count++;
+	}
+	ut_asserteq(nvars, count);
+
+	return 0;
+}
+
+/* Test importing, looking up, changing, deleting and exporting variables */
+static int env_test_htab(struct unit_test_state *uts)
+{
+	struct hsearch_data htab = { };
+	char *buf, *res = NULL;
+	ENTRY e, *ep;
+	int i, size;
+
+	buf = malloc(HTAB_VARS * 32);
+	ut_assertnonnull(buf);
+	size = build_env(buf, HTAB_VARS * 32);
+
+	/* Anything after the end of the environment is ignored */
+	memset(buf + size, 'x', 10);
+	ut_asserteq(1, himport_r(&htab, buf, size + 10, '\0', 0, 0, 0, NULL));
+	ut_asserteq(HTAB_VARS, htab.filled);
+	for (i = 0; i < HTAB_VARS; i++)
+		ut_assertok(check_var(uts, &htab, i));
+
+	e.key = "htab_missing";
+	e.data = NULL;
+	ut_asserteq(0, hsearch_r(e, FIND, &ep, &htab, 0));
+	ut_assertnull(ep);
+
+	/* Change values from the arena, to shorter and to longer ones */
+	e.key = "htab_var001";
+	e.data = "v";
+	ut_assert(hsearch_r(e, ENTER, &ep, &htab, 0));
+	ut_asserteq_str("v", ep->data);
+	e.data = "a much longer value than before";
+	ut_assert(hsearch_r(e, ENTER, &ep, &htab, 0));
+	ut_asserteq_str("a much longer value than before", ep->data);
+
+	/* Delete some variables, which moves others in the hash index */
+	for (i = 0; i < HTAB_VARS; i += 3) {
+		char name[20];
+
+		snprintf(name, sizeof(name), "htab_var%03d", i);
+		ut_asserteq(1, hdelete_r(name, &htab, 0));
+	}
+	ut_asserteq(HTAB_VARS - HTAB_VARS / 3, htab.filled);
+	for (i = 2; i < HTAB_VARS; i += 3)
+		ut_assertok(check_var(uts, &htab, i));
+
+	ut_assert(hexport_r(&htab, '\0', 0, &res, 0, 0, NULL) > 0);
+	ut_assertok(check_export(uts, res, htab.filled));
+	free(res);
+	res = NULL;
+
+	/* Put them back, with the table copying the strings this time */
+	ut_asserteq(1, himport_r(&htab, buf, size, '\0', H_NOCLEAR, 0, 0,
+				 NULL));
+	ut_asserteq(HTAB_VARS, htab.filled);
+	for (i = 0; i < HTAB_VARS; i++)
+		ut_assertok(check_var(uts, &htab, i));
+
+	/* An export can be imported again */
+	ut_assert(hexport_r(&htab, '\n', 0, &res, 0, 0, NULL) > 0);
+	hdestroy_r(&htab);
+	ut_asserteq(1, himport_r(&htab, res, strlen(res), '\n', 0, 0, 0,
+				 NULL));
+	ut_asserteq(HTAB_VARS, htab.filled);
+	for (i = 0; i < HTAB_VARS; i++)
+		ut_assertok(check_var(uts, &htab, i));
+
+	hdestroy_r(&htab);
+	free(res);
+	free(buf);
+
+	return 0;
+}
+ENV_TEST(env_test_htab, 0);
+
+/* Report how long it takes to import, export and look up an environment */
+static int env_test_htab_speed(struct unit_test_state *uts)
+{
+	struct hsearch_data htab = { };
+	char names[HTAB_VARS][16];
+	ulong start_us, delta_us;
+	char *buf, *res;
+	int i, j, size;
+	ENTRY e, *ep;
+
+	buf = malloc(HTAB_VARS * 32);
+	res = malloc(HTAB_VARS * 32);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(res);
+	size = build_env(buf, HTAB_VARS * 32);
+	for (i = 0; i < HTAB_VARS; i++)
+		snprintf(names[i], sizeof(names[i]), "htab_var%03d", i);
+
+	start_us = timer_get_us();
+	for (i = 0; i < SPEED_TEST_LOOPS; i++)
+		ut_asserteq(1, himport_r(&htab, buf, size, '\0', 0, 0, 0,
+					 NULL));
+	delta_us = max(timer_get_us() - start_us, 1UL);
+	printf("import: %d vars, %lu bytes: %6lu ns per var\n", HTAB_VARS,
+	       (ulong)size, delta_us * 1000 / SPEED_TEST_LOOPS / HTAB_VARS);
+
+	start_us = timer_get_us();
+	for (i = 0; i < SPEED_TEST_LOOPS; i++)
+		ut_assert(hexport_r(&htab, '\0', 0, &res, HTAB_VARS * 32, 0,
+				    NULL) > 0);
+	delta_us = max(timer_get_us() - start_us, 1UL);
+	printf("export: %d vars: %6lu ns per var\n", HTAB_VARS,
+	       delta_us * 1000 / SPEED_TEST_LOOPS / HTAB_VARS);
+	ut_assertok(check_export(uts, res, HTAB_VARS));
+
+	e.data = NULL;
+	start_us = timer_get_us();
+	for (i = 0; i < SPEED_TEST_LOOPS; i++) {
+		for (j = 0; j < HTAB_VARS; j++) {
+			e.key = names[j];
+			ut_assert(hsearch_r(e, FIND, &ep, &htab, 0));
+		}
+	}
+	delta_us = max(timer_get_us() - start_us, 1UL);
+	printf("lookup: %d vars: %6lu ns per lookup\n", HTAB_VARS,
+	       delta_us * 1000 / SPEED_TEST_LOOPS / HTAB_VARS);
+
+	hdestroy_r(&htab);
+	free(res);
+	free(buf);
+
+	return 0;
+}
+ENV_TEST(env_test_htab_speed, 0);
@@ -0,0 +1,308 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the SHA-1, SHA-256 and CRC32 backends
+ *
+ * Every backend that the CPU supports is checked against known test vectors
+ * and against the generic code, then timed.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <hash.h>
+#include <malloc.h>
+#include <asm/unaligned.h>
+#include <u-boot/crc.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+#include <test/hash.h>
+#include <test/suites.h>
+#include <test/ut.h>
+
+/* Size of the buffer used for comparing and timing backends */
+#define HASH_TEST_BUF_SIZE	(1 << 20)
+/* Number of passes over the buffer when timing a backend */
+#define HASH_TEST_BENCH_LOOPS	16
+
+struct hash_test_vector {
+	const char *algo;
+	const char *input;
+	const char *digest;
+};
+
+static const struct hash_test_vector hash_test_vectors[] = {
+	{
+		"sha1", "abc",
+		"\xa9\x99\x3e\x36\x47\x06\x81\x6a\xba\x3e"
+		"\x25\x71\x78\x50\xc2\x6c\x9c\xd0\xd8\x9d",
+	},
+	{
+		"sha1",
+		"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+		"\x84\x98\x3e\x44\x1c\x3b\xd2\x6e\xba\xae"
+		"\x4a\xa1\xf9\x51\x29\xe5\xe5\x46\x70\xf1",
+	},
+	{
+		"sha256", "abc",
+		"\xba\x78\x16\xbf\x8f\x01\xcf\xea\x41\x41\x40\xde\x5d\xae\x22\x23"
+		"\xb0\x03\x61\xa3\x96\x17\x7a\x9c\xb4\x10\xff\x61\xf2\x00\x15\xad",
+	},
+	{
+		"sha256",
+		"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+		"\x24\x8d\x6a\x61\xd2\x06\x38\xb8\xe5\xc0\x26\x93\x0c\x3e\x60\x39"
+		"\xa3\x3c\xe4\x59\x64\xff\x21\x67\xf6\xec\xed\xd4\x19\xdb\x06\xc1",
+	},
+	{
+		"crc32", "123456789", "\xcb\xf4\x39\x26",
+	},
+	{
+		"crc32",
+		"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"
+		"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+		"\x65\x6e\x49\xed",
+	},
+};
+
+/*
+ * Hash @len bytes at @data with @backend, passing the data to the update
+ * function in pieces of @split bytes. Returns the digest size.
+ */
+static int hash_test_run(const struct hash_backend *backend,
+			 const uint8_t *data, uint len, uint split,
+			 uint8_t *digest)
+{
+	union {
+		sha1_context sha1;
+		sha256_context sha256;
+		uint32_t crc;
+	} ctx;
+	uint chunk, blocks;
+
+	/* This splits the data up in the same way as crc32_wd() */
+	if (!strcmp(backend->algo, "crc32")) {
+		ctx.crc = 0xffffffff;
+		for (; len; len -= chunk, data += chunk) {
+			chunk = min(len, split);
+			blocks = chunk / 64;
+			backend->process(&ctx.crc, data, blocks);
+			ctx.crc = crc32_no_comp(ctx.crc, data + blocks * 64,
+						chunk % 64);
+		}
+		put_unaligned_be32(ctx.crc ^ 0xffffffff, digest);
+
+		return sizeof(ctx.crc);
+	}
+
+	if (!strcmp(backend->algo, "sha1")) {
+		sha1_starts(&ctx.sha1);
+		ctx.sha1.process = backend->process;
+		for (; len; len -= chunk, data += chunk) {
+			chunk = min(len, split);
+			sha1_update(&ctx.sha1, data, chunk);
+		}
+		sha1_finish(&ctx.sha1, digest);
+
+		return SHA1_SUM_LEN;
+	}
+
+	sha256_starts(&ctx.sha256);
+	ctx.sha256.process = backend->process;
+	for (; len; len -= chunk, data += chunk) {
+		chunk = min(len, split);
+		sha256_update(&ctx.sha256, data, chunk);
+	}
+	sha256_finish(&ctx.sha256, digest);
+
+	return SHA256_SUM_LEN;
+}
+
+static const struct hash_backend *hash_test_generic(const char *algo)
+{
+	struct hash_backend *start =
+		ll_entry_start(struct hash_backend, hash_backend);
+	const int n_ents = ll_entry_count(struct hash_backend, hash_backend);
+	struct hash_backend *entry;
+
+	for (entry = start; entry != start + n_ents; entry++) {
+		if (!strcmp(entry->algo, algo) &&
+		    !strcmp(entry->name, "generic"))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/* Check each usable backend against the FIPS 180 test vectors */
+static int hash_test_vectors_check(struct unit_test_state *uts)
+{
+	struct hash_backend *start =
+		ll_entry_start(struct hash_backend, hash_backend);
+	const int n_ents = ll_entry_count(struct hash_backend, hash_backend);
+	uint8_t digest[HASH_MAX_DIGEST_SIZE];
+	const struct hash_test_vector *vec;
+	struct hash_backend *entry;
+	int size;
+
+	for (entry = start; entry != start + n_ents; entry++) {
+		if (entry->probe && !entry->probe())
+			continue;
+		for (vec = hash_test_vectors;
+		     vec != hash_test_vectors + ARRAY_SIZE(hash_test_vectors);
+		     vec++) {
+			if (strcmp(vec->algo, entry->algo))
+				continue;
+			size = hash_test_run(entry, (const uint8_t *)vec->input,
+					     strlen(vec->input), 64, digest);
+			ut_assertok(memcmp(vec->digest, digest, size));
+		}
+	}
+
+	return 0;
+}
+HASH_TEST(hash_test_vectors_check, 0);
+
+/*
+ * Check each usable backend against the generic code on a larger buffer,
+ * with unaligned data and updates which do not fall on block boundaries
+ */
+static int hash_test_backends(struct unit_test_state *uts)
+{
+	struct hash_backend *start =
+		ll_entry_start(struct hash_backend, hash_backend);
+	const int n_ents = ll_entry_count(struct hash_backend, hash_backend);
+	uint8_t expect[HASH_MAX_DIGEST_SIZE], digest[HASH_MAX_DIGEST_SIZE];
+	static const uint splits[] = { 1, 63, 65, 4096, HASH_TEST_BUF_SIZE };
+	const struct hash_backend *generic;
+	struct hash_backend *entry;
+	uint8_t *buf;
+	int i, size;
+
+	buf = malloc(HASH_TEST_BUF_SIZE + 1);
+	ut_assertnonnull(buf);
+	ut_fill_pattern(buf, HASH_TEST_BUF_SIZE + 1);
+
+	for (entry = start; entry != start + n_ents; entry++) {
+		if (entry->probe && !entry->probe())
+			continue;
+		generic = hash_test_generic(entry->algo);
+		ut_assertnonnull(generic);
+		for (i = 0; i < ARRAY_SIZE(splits); i++) {
+			uint len = HASH_TEST_BUF_SIZE - 1 - i;
+
+			size = hash_test_run(generic, buf + 1, len, splits[i],
+					     expect);
+			ut_asserteq(size, hash_test_run(entry, buf + 1, len,
+							splits[i], digest));
+			ut_assertok(memcmp(expect, digest, size));
+		}
+	}
+	free(buf);
+
+	return 0;
+}
+HASH_TEST(hash_test_backends, 0);
+
+/* Report the speed of the block function of each backend */
+static int hash_test_speed(struct unit_test_state *uts)
+{
+	struct hash_backend *start =
+		ll_entry_start(struct hash_backend, hash_backend);
+	const int n_ents = ll_entry_count(struct hash_backend, hash_backend);
+	const ulong bytes = (ulong)HASH_TEST_BUF_SIZE * HASH_TEST_BENCH_LOOPS;
+	struct hash_backend *entry;
+	uint32_t state[8];
+	ulong start_us, delta_us;
+	uint8_t *buf;
+	int i;
+
+	buf = malloc(HASH_TEST_BUF_SIZE);
+	ut_assertnonnull(buf);
+	memset(buf, 0xa5, HASH_TEST_BUF_SIZE);
+
+	for (entry = start; entry != start + n_ents; entry++) {
+		printf("%-8s %-10s ", entry->algo, entry->name);
+		if (entry->probe && !entry->probe()) {
+			printf("not supported by this CPU\n");
+			continue;
+		}
+		memset(state, '\0', sizeof(state));
+		start_us = timer_get_us();
+		for (i = 0; i < HASH_TEST_BENCH_LOOPS; i++)
+			entry->process(state, buf, HASH_TEST_BUF_SIZE / 64);
+		delta_us = max(timer_get_us() - start_us, 1UL);
+		printf("%5lu MB/s%s\n", bytes / delta_us,
+		       hash_backend_find(entry->algo) == entry ?
+		       " (selected)" : "");
+	}
+	free(buf);
+
+	return 0;
+}
+HASH_TEST(hash_test_speed, 0);
+
+/* Bit-at-a-time CRC, to check the table-driven code against */
+static uint32_t hash_test_crc_bitwise(uint32_t crc, uint32_t poly,
+				      const uint8_t *data, uint len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *data++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (crc & 1 ? poly : 0);
+	}
+
+	return crc;
+}
+
+/*
+ * Check the slice-by-8 CRC32 and CRC32C code at every alignment and with
+ * lengths either side of a multiple of eight bytes
+ */
+static int hash_test_crc_slices(struct unit_test_state *uts)
+{
+#ifdef CONFIG_CRC32C
+	uint32_t *crc32c_table;
+#endif
+	uint8_t buf[256 + 8];
+	uint ofs, len;
+
+	for (ofs = 0; ofs < sizeof(buf); ofs++)
+		buf[ofs] = ofs * 13 + 5;
+
+#ifdef CONFIG_CRC32C
+	crc32c_table = malloc(CRC32C_TABLE_SIZE * sizeof(*crc32c_table));
+	ut_assertnonnull(crc32c_table);
+	crc32c_init(crc32c_table, 0x82f63b78);
+	ut_asserteq(0xe3069283,
+		    ~crc32c_cal(~0, "123456789", 9, crc32c_table));
+#endif
+
+	for (ofs = 0; ofs < 8; ofs++) {
+		for (len = 0; len <= 256; len++) {
+			ut_asserteq(~hash_test_crc_bitwise(~0, 0xedb88320,
+							   buf + ofs, len),
+				    crc32(0, buf + ofs, len));
+#ifdef CONFIG_CRC32C
+			ut_asserteq(hash_test_crc_bitwise(~0, 0x82f63b78,
+							  buf + ofs, len),
+				    crc32c_cal(~0, (char *)buf + ofs, len,
+					       crc32c_table));
+#endif
+		}
+	}
+#ifdef CONFIG_CRC32C
+	free(crc32c_table);
+#endif
+
+	return 0;
+}
+HASH_TEST(hash_test_crc_slices, 0);
+
+int do_ut_hash(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	struct unit_test *tests = ll_entry_start(struct unit_test, hash_test);
+	const int n_ents = ll_entry_count(struct unit_test, hash_test);
+
+	return cmd_ut_category("hash", tests, n_ents, argc, argv);
+}
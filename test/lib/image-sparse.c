@@ -0,0 +1,230 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for writing sparse images as they arrive
+ */
+
+#include <common.h>
+#include <image-sparse.h>
+#include <malloc.h>
+#include <dm/test.h>
+#include <test/ut.h>
+
+/* Storage block size, and size of the image's blocks in storage blocks */
+#define BLKSZ		512
+#define IMG_BLKS	2
+#define IMG_BLKSZ	(BLKSZ * IMG_BLKS)
+
+/* Storage, with the partition being written starting at PART_START */
+#define DISK_BLKS	64
+#define PART_START	4
+#define PART_BLKS	48
+
+/* Headers are longer than usual, to check that the extra bytes are skipped */
+#define FILE_HDR_SZ	(sizeof(sparse_header_t) + 4)
+#define CHUNK_HDR_SZ	(sizeof(chunk_header_t) + 4)
+
+#define FILL_VAL	0xdeadbeef
+#define UNTOUCHED	0x55
+
+static u8 disk[DISK_BLKS * BLKSZ];
+
+static lbaint_t test_write(struct sparse_storage *info, lbaint_t blk,
+			   lbaint_t blkcnt, const void *buffer)
+{
+	memcpy(disk + blk * BLKSZ, buffer, blkcnt * BLKSZ);
+
+	return blkcnt;
+}
+
+static lbaint_t test_reserve(struct sparse_storage *info, lbaint_t blk,
+			     lbaint_t blkcnt)
+{
+	return blkcnt;
+}
+
+static void test_mssg(const char *str, char *response)
+{
+	strcpy(response, str);
+}
+
+static void setup_storage(struct sparse_storage *info)
+{
+	memset(disk, UNTOUCHED, sizeof(disk));
+	info->blksz = BLKSZ;
+	info->start = PART_START;
+	info->size = PART_BLKS;
+	info->priv = NULL;
+	info->write = test_write;
+	info->reserve = test_reserve;
+	info->mssg = test_mssg;
+}
+
+static u8 *add_chunk(u8 *ptr, u16 type, u32 chunk_sz, u32 data_sz)
+{
+	chunk_header_t *chunk = (chunk_header_t *)ptr;
+
+	memset(ptr, '\0', CHUNK_HDR_SZ);
+	chunk->chunk_type = type;
+	chunk->chunk_sz = chunk_sz;
+	chunk->total_sz = CHUNK_HDR_SZ + data_sz;
+
+	return ptr + CHUNK_HDR_SZ;
+}
+
+/*
+ * Build a sparse image holding a raw chunk of three blocks, a fill chunk of
+ * two blocks, a don't-care block, a CRC and a final raw block
+ */
+static int build_image(u8 *img)
+{
+	sparse_header_t *hdr = (sparse_header_t *)img;
+	u8 *ptr = img + FILE_HDR_SZ;
+	u32 val = FILL_VAL;
+	int i;
+
+	memset(img, '\0', FILE_HDR_SZ);
+	hdr->magic = SPARSE_HEADER_MAGIC;
+	hdr->major_version = 1;
+	hdr->file_hdr_sz = FILE_HDR_SZ;
+	hdr->chunk_hdr_sz = CHUNK_HDR_SZ;
+	hdr->blk_sz = IMG_BLKSZ;
+	hdr->total_blks = 7;
+	hdr->total_chunks = 5;
+
+	ptr = add_chunk(ptr, CHUNK_TYPE_RAW, 3, 3 * IMG_BLKSZ);
+	for (i = 0; i < 3 * IMG_BLKSZ; i++)
+		*ptr++ = i * 7 + 1;
+	ptr = add_chunk(ptr, CHUNK_TYPE_FILL, 2, sizeof(val));
+	memcpy(ptr, &val, sizeof(val));
+	ptr += sizeof(val);
+	ptr = add_chunk(ptr, CHUNK_TYPE_DONT_CARE, 1, 0);
+	ptr = add_chunk(ptr, CHUNK_TYPE_CRC32, 0, sizeof(u32));
+	memset(ptr, 0xcc, sizeof(u32));
+	ptr += sizeof(u32);
+	ptr = add_chunk(ptr, CHUNK_TYPE_RAW, 1, IMG_BLKSZ);
+	for (i = 0; i < IMG_BLKSZ; i++)
+		*ptr++ = i * 3 + 2;
+
+	return ptr - img;
+}
+
+/* Check that the storage holds what build_image() describes */
+static int check_disk(struct unit_test_state *uts)
+{
+	u8 *part = disk + PART_START * BLKSZ;
+	u32 val;
+	int i;
+
+	for (i = 0; i < PART_START * BLKSZ; i++)
+		ut_asserteq(UNTOUCHED, disk[i]);
+	for (i = 0; i < 3 * IMG_BLKSZ; i++)
+		ut_asserteq((u8)(i * 7 + 1), *part++);
+	for (i = 0; i < 2 * IMG_BLKSZ; i += sizeof(val)) {
+		memcpy(&val, part, sizeof(val));
+		ut_asserteq(FILL_VAL, val);
+		part += sizeof(val);
+	}
+	for (i = 0; i < IMG_BLKSZ; i++)
+		ut_asserteq(UNTOUCHED, *part++);
+	for (i = 0; i < IMG_BLKSZ; i++)
+		ut_asserteq((u8)(i * 3 + 2), *part++);
+	while (part < disk + sizeof(disk))
+		ut_asserteq(UNTOUCHED, *part++);
+
+	return 0;
+}
+
+/* Feed an image in pieces of the given size */
+static int stream_image(struct sparse_storage *info, const u8 *img, int size,
+			int piece, char *response)
+{
+	struct sparse_stream ss;
+	int count, pos, ret;
+
+	ret = sparse_stream_init(&ss, info, response);
+	for (pos = 0; !ret && pos < size; pos += count) {
+		count = min(piece, size - pos);
+		ret = sparse_stream_write(&ss, img + pos, count, response);
+	}
+	if (sparse_stream_finish(&ss, "test", response))
+		ret = -1;
+
+	return ret;
+}
+
+/* Test writing a sparse image split at every kind of boundary */
+static int lib_test_sparse_stream(struct unit_test_state *uts)
+{
+	static const int pieces[] = { 1, 3, 7, 13, 17, 511, 512, 1000, 4096 };
+	struct sparse_storage info;
+	char response[64];
+	int i, size;
+	u8 *img;
+
+	img = malloc(FILE_HDR_SZ + 5 * CHUNK_HDR_SZ + 8 * IMG_BLKSZ);
+	ut_assertnonnull(img);
+	size = build_image(img);
+
+	for (i = 0; i < ARRAY_SIZE(pieces); i++) {
+		setup_storage(&info);
+		*response = '\0';
+		ut_assertok(stream_image(&info, img, size, pieces[i],
+					 response));
+		ut_asserteq_str("", response);
+		ut_assertok(check_disk(uts));
+	}
+
+	/* The whole image at once, as flashed from memory */
+	setup_storage(&info);
+	ut_assertok(write_sparse_image(&info, "test", img, response));
+	ut_assertok(check_disk(uts));
+
+	/* A truncated image must be reported */
+	setup_storage(&info);
+	ut_asserteq(-1, stream_image(&info, img, size - 1, 100, response));
+	ut_asserteq_str("sparse image write failure", response);
+
+	/* So must an image which does not fit */
+	setup_storage(&info);
+	info.size = 8;
+	ut_asserteq(-1, stream_image(&info, img, size, 100, response));
+	ut_asserteq_str("Request would exceed partition size!", response);
+
+	free(img);
+
+	return 0;
+}
+DM_TEST(lib_test_sparse_stream, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test writing an image which is not sparse */
+static int lib_test_sparse_stream_raw(struct unit_test_state *uts)
+{
+	struct sparse_storage info;
+	char response[64];
+	u8 img[1500];
+	u8 *part = disk + PART_START * BLKSZ;
+	int i;
+
+	for (i = 0; i < sizeof(img); i++)
+		img[i] = i * 5 + 3;
+
+	/* Pieces shorter than both a sparse header and a block */
+	setup_storage(&info);
+	ut_assertok(stream_image(&info, img, sizeof(img), 5, response));
+	ut_assertok(memcmp(img, part, sizeof(img)));
+
+	/* The last block is padded with zeroes */
+	for (i = sizeof(img); i < 3 * BLKSZ; i++)
+		ut_asserteq(0, part[i]);
+	ut_asserteq(UNTOUCHED, part[3 * BLKSZ]);
+
+	/* An image shorter than a sparse header */
+	setup_storage(&info);
+	ut_assertok(stream_image(&info, img, 10, 3, response));
+	ut_assertok(memcmp(img, part, 10));
+	ut_asserteq(0, part[10]);
+	ut_asserteq(UNTOUCHED, part[BLKSZ]);
+
+	return 0;
+}
+DM_TEST(lib_test_sparse_stream_raw, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the logical memory block allocator
+ */
+
+#include <common.h>
+#include <lmb.h>
+#include <dm/test.h>
+#include <test/ut.h>
+
+#define RAM_BASE	0x40000000
+#define RAM_SIZE	0x10000000
+#define PAGE		0x1000
+
+/* Number of regions used by the tests with many reservations */
+#define MANY		500
+
+/* Check that the regions are sorted and neither overlap nor touch */
+static int check_regions(struct unit_test_state *uts, struct lmb_region *rgn)
+{
+	unsigned long i;
+
+	ut_assert(rgn->cnt <= rgn->max);
+	for (i = 0; i < rgn->cnt; i++) {
+		ut_assert(rgn->region[i].size);
+		if (i)
+			ut_assert(rgn->region[i - 1].base +
+				  rgn->region[i - 1].size <
+				  rgn->region[i].base);
+	}
+
+	return 0;
+}
+
+static int lib_test_lmb_simple(struct unit_test_state *uts)
+{
+	struct lmb lmb;
+	phys_addr_t a, b;
+
+	lmb_init(&lmb);
+	ut_asserteq(0, lmb_add(&lmb, RAM_BASE, RAM_SIZE));
+	ut_asserteq(1, lmb.memory.cnt);
+	ut_asserteq(0, lmb.reserved.cnt);
+
+	/* Allocations come from the top of memory */
+	a = lmb_alloc(&lmb, 4 * PAGE, PAGE);
+	ut_asserteq(RAM_BASE + RAM_SIZE - 4 * PAGE, a);
+	ut_assert(lmb_is_reserved(&lmb, a));
+	ut_assert(!lmb_is_reserved(&lmb, a - 1));
+
+	/* The next one is merged with the first */
+	b = lmb_alloc(&lmb, PAGE, PAGE);
+	ut_asserteq(a - PAGE, b);
+	ut_asserteq(1, lmb.reserved.cnt);
+
+	/* An allocation below a limit goes just under it */
+	b = lmb_alloc_base(&lmb, PAGE, PAGE, RAM_BASE + PAGE * 3);
+	ut_asserteq(RAM_BASE + 2 * PAGE, b);
+	ut_asserteq(2, lmb.reserved.cnt);
+	ut_asserteq(0, lmb_free(&lmb, b, PAGE));
+	ut_asserteq(1, lmb.reserved.cnt);
+
+	/* Punch a hole in the middle of the reserved region, then fill it */
+	ut_asserteq(0, lmb_free(&lmb, a + PAGE, PAGE));
+	ut_asserteq(2, lmb.reserved.cnt);
+	ut_assert(!lmb_is_reserved(&lmb, a + PAGE));
+	ut_assert(lmb_is_reserved(&lmb, a + 2 * PAGE));
+	ut_asserteq(-1, lmb_free(&lmb, a + PAGE, PAGE));
+	ut_asserteq(a + PAGE, lmb_alloc(&lmb, PAGE, PAGE));
+	ut_asserteq(1, lmb.reserved.cnt);
+	ut_assertok(check_regions(uts, &lmb.reserved));
+
+	/* Nothing left which is big enough */
+	ut_asserteq(0, __lmb_alloc_base(&lmb, RAM_SIZE, PAGE, 0));
+	lmb_release(&lmb);
+
+	return 0;
+}
+DM_TEST(lib_test_lmb_simple, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Reservations which overlap existing ones are merged with them */
+static int lib_test_lmb_overlap(struct unit_test_state *uts)
+{
+	struct lmb lmb;
+
+	lmb_init(&lmb);
+	ut_asserteq(0, lmb_reserve(&lmb, RAM_BASE + 0x1000, 0x1000));
+	ut_asserteq(0, lmb_reserve(&lmb, RAM_BASE + 0x3000, 0x1000));
+	ut_asserteq(0, lmb_reserve(&lmb, RAM_BASE + 0x5000, 0x1000));
+	ut_asserteq(3, lmb.reserved.cnt);
+
+	/* Already covered */
+	ut_asserteq(0, lmb_reserve(&lmb, RAM_BASE + 0x1800, 0x100));
+	ut_asserteq(3, lmb.reserved.cnt);
+
+	/* Overlaps the first two */
+	ut_asserteq(2, lmb_reserve(&lmb, RAM_BASE + 0x1800, 0x2000));
+	ut_asserteq(2, lmb.reserved.cnt);
+	ut_asserteq(RAM_BASE + 0x1000, lmb.reserved.region[0].base);
+	ut_asserteq(0x3000, lmb.reserved.region[0].size);
+
+	/* Covers everything */
+	ut_asserteq(2, lmb_reserve(&lmb, RAM_BASE, 0x10000));
+	ut_asserteq(1, lmb.reserved.cnt);
+	ut_asserteq(RAM_BASE, lmb.reserved.region[0].base);
+	ut_asserteq(0x10000, lmb.reserved.region[0].size);
+
+	/* A region may end at the top of the address space */
+	ut_asserteq(0, lmb_reserve(&lmb, (phys_addr_t)-PAGE, PAGE));
+	ut_asserteq(2, lmb.reserved.cnt);
+	ut_assert(lmb_is_reserved(&lmb, (phys_addr_t)-1));
+	ut_assert(!lmb_is_reserved(&lmb, (phys_addr_t)-PAGE - 1));
+	ut_asserteq(0, lmb_free(&lmb, (phys_addr_t)-PAGE, PAGE / 2));
+	ut_assert(lmb_is_reserved(&lmb, (phys_addr_t)-1));
+	ut_assertok(check_regions(uts, &lmb.reserved));
+	lmb_release(&lmb);
+
+	return 0;
+}
+DM_TEST(lib_test_lmb_overlap, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Reserve every other page in a scrambled order, more than fit inline */
+static int lib_test_lmb_many(struct unit_test_state *uts)
+{
+	struct lmb lmb;
+	phys_addr_t base;
+	int i, n;
+
+	lmb_init(&lmb);
+	ut_asserteq(0, lmb_add(&lmb, RAM_BASE, RAM_SIZE));
+	for (i = 0; i < MANY; i++) {
+		/* 7 is coprime to MANY so this visits every page once */
+		n = (i * 7) % MANY;
+		ut_asserteq(0, lmb_reserve(&lmb, RAM_BASE + n * 2 * PAGE,
+					   PAGE));
+	}
+	ut_asserteq(MANY, lmb.reserved.cnt);
+	ut_assert(lmb.reserved.region != lmb.reserved.initial);
+	ut_assertok(check_regions(uts, &lmb.reserved));
+
+	for (i = 0; i < MANY; i++) {
+		base = RAM_BASE + i * 2 * PAGE;
+		ut_asserteq(base, lmb.reserved.region[i].base);
+		ut_assert(lmb_is_reserved(&lmb, base));
+		ut_assert(lmb_is_reserved(&lmb, base + PAGE - 1));
+		ut_assert(!lmb_is_reserved(&lmb, base + PAGE));
+		ut_assert(!lmb_is_reserved(&lmb, base + 2 * PAGE - 1));
+	}
+	ut_assert(!lmb_is_reserved(&lmb, RAM_BASE - 1));
+
+	/* Only the gaps are free below the last reservation */
+	base = RAM_BASE + (MANY - 1) * 2 * PAGE;
+	for (i = MANY - 1; i > 0; i--) {
+		ut_asserteq(RAM_BASE + (i * 2 - 1) * PAGE,
+			    lmb_alloc_base(&lmb, PAGE, PAGE, base));
+		base -= 2 * PAGE;
+		ut_asserteq(i, lmb.reserved.cnt);
+	}
+	ut_asserteq(1, lmb.reserved.cnt);
+	ut_asserteq(RAM_BASE, lmb.reserved.region[0].base);
+	ut_asserteq((MANY * 2 - 1) * PAGE, lmb.reserved.region[0].size);
+
+	/* Free every other page again, working from the top */
+	for (i = MANY - 1; i > 0; i--) {
+		ut_asserteq(0, lmb_free(&lmb, RAM_BASE + (i * 2 - 1) * PAGE,
+					PAGE));
+	}
+	ut_asserteq(MANY, lmb.reserved.cnt);
+	ut_assertok(check_regions(uts, &lmb.reserved));
+
+	/* Something bigger than a gap must go above the reservations */
+	base = lmb_alloc_base(&lmb, 2 * PAGE, PAGE,
+			      RAM_BASE + MANY * 2 * PAGE + PAGE);
+	ut_asserteq(RAM_BASE + (MANY * 2 - 1) * PAGE, base);
+	ut_asserteq(0, __lmb_alloc_base(&lmb, 2 * PAGE, PAGE,
+					RAM_BASE + MANY * 2 * PAGE));
+	lmb_release(&lmb);
+	ut_asserteq(0, lmb.reserved.cnt);
+	ut_asserteq_ptr(lmb.reserved.initial, lmb.reserved.region);
+
+	return 0;
+}
+DM_TEST(lib_test_lmb_many, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -0,0 +1,45 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Command dispatch benchmark
+
+"""
+This test runs 10000 commands from a script and reports how long they took.
+Every command is parsed by hush and looked up in the command table, so this
+mostly measures the parser and find_cmd().
+"""
+
+import pytest
+import re
+
+# The script runs LOOPS iterations of a body of CMDS_PER_LOOP commands
+LOOPS = 100
+CMDS_PER_LOOP = 100
+
+# Commands used in the body, some of them abbreviated
+BODY_CMDS = ['true', 'itest 1 == 1', 'test 1 = 1', 'setexpr.b x 1', 'tr']
+
+@pytest.mark.buildconfigspec('cmd_time')
+@pytest.mark.buildconfigspec('hush_parser')
+@pytest.mark.buildconfigspec('cmd_itest')
+@pytest.mark.buildconfigspec('cmd_setexpr')
+def test_cmd_dispatch(u_boot_console):
+    """Time 10000 command dispatches."""
+    cons = u_boot_console
+    body = [BODY_CMDS[i % len(BODY_CMDS)] for i in range(CMDS_PER_LOOP)]
+    loop = ' '.join([str(i) for i in range(LOOPS)])
+    cons.run_command('setenv bench_body "%s"' % '; '.join(body))
+    cons.run_command('setenv bench "for i in %s; do run bench_body; done"'
+                     % loop)
+
+    output = cons.run_command('time run bench')
+    m = re.search('time: (?:(\d+) minutes, )?(\d+)\.(\d+) seconds', output)
+    assert(m)
+    ms = int(m.group(1) or 0) * 60000 + int(m.group(2)) * 1000 + \
+        int(m.group(3))
+    cons.log.info('%d command dispatches took %d ms'
+                  % (LOOPS * (CMDS_PER_LOOP + 1), ms))
+    assert(cons.run_command('echo $x') == '1')
+
+    cons.run_command('setenv bench')
+    cons.run_command('setenv bench_body')
+    cons.run_command('setenv x')
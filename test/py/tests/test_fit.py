@@ -57,6 +57,12 @@ base_its = '''
                         os = "linux";
                         %(ramdisk_load)s
                         compression = "none";
+                        hash-1 {
+                                algo = "sha1";
+                        };
+                        hash-2 {
+                                algo = "crc32";
+                        };
                 };
                 ramdisk@2 {
                         description = "snow";
@@ -290,7 +296,7 @@ def test_fit(u_boot_console):
         """Basic sanity check of FIT loading in U-Boot
 
         TODO: Almost everything:
-          - hash algorithms - invalid hash/contents should be detected
+          - hash algorithms - only ramdisk sha1/crc32 are checked so far
           - signature algorithms - invalid sig/contents should be detected
           - compression
           - checking that errors are detected like:
@@ -402,6 +408,21 @@ def test_fit(u_boot_console):
             output = cons.run_command_list(cmd.splitlines())
             check_equal(ramdisk, ramdisk_out, 'Ramdisk not loaded')
 
+            # The hashes are checked while the ramdisk is copied
+            find_matching(output, 'Verifying Hash Integrity ... sha1+ crc32+ OK')
+
+        # Corrupt the ramdisk and check that this is spotted
+        with cons.log.section('Kernel + FDT + Bad ramdisk load'):
+            data = bytearray(read_file(fit))
+            pos = data.find(bytearray(read_file(ramdisk)))
+            assert pos != -1, 'Ramdisk not found in FIT'
+            data[pos + filesize(ramdisk) // 2] ^= 0xff
+            with open(fit, 'wb') as fd:
+                fd.write(data)
+            cons.restart_uboot()
+            output = cons.run_command_list(cmd.splitlines())
+            find_matching(output, 'Bad Data Hash')
+
         # Configuration with some Loadables
         with cons.log.section('Kernel + FDT + Ramdisk load + Loadables'):
             params['loadables_config'] = 'loadables = "kernel@2", "ramdisk@2";'
@@ -13,6 +13,8 @@ supported_fs_basic = ['fat16', 'fat32', 'ext4']
 supported_fs_ext = ['fat16', 'fat32']
 supported_fs_mkdir = ['fat16', 'fat32']
 supported_fs_unlink = ['fat16', 'fat32']
+supported_fs_blkcache = ['fat32', 'ext4']
+supported_fs_fragment = ['fat16', 'fat32', 'ext4']
 
 #
 # Filesystem test specific setup
@@ -48,6 +50,8 @@ def pytest_configure(config):
     global supported_fs_ext
     global supported_fs_mkdir
     global supported_fs_unlink
+    global supported_fs_blkcache
+    global supported_fs_fragment
 
     def intersect(listA, listB):
         return  [x for x in listA if x in listB]
@@ -59,6 +63,8 @@ def pytest_configure(config):
         supported_fs_ext =  intersect(supported_fs, supported_fs_ext)
         supported_fs_mkdir =  intersect(supported_fs, supported_fs_mkdir)
         supported_fs_unlink =  intersect(supported_fs, supported_fs_unlink)
+        supported_fs_blkcache =  intersect(supported_fs, supported_fs_blkcache)
+        supported_fs_fragment =  intersect(supported_fs, supported_fs_fragment)
 
 def pytest_generate_tests(metafunc):
     """Parametrize fixtures, fs_obj_xxx
@@ -84,6 +90,12 @@ def pytest_generate_tests(metafunc):
     if 'fs_obj_unlink' in metafunc.fixturenames:
         metafunc.parametrize('fs_obj_unlink', supported_fs_unlink,
             indirect=True, scope='module')
+    if 'fs_obj_blkcache' in metafunc.fixturenames:
+        metafunc.parametrize('fs_obj_blkcache', supported_fs_blkcache,
+            indirect=True, scope='module')
+    if 'fs_obj_fragment' in metafunc.fixturenames:
+        metafunc.parametrize('fs_obj_fragment', supported_fs_fragment,
+            indirect=True, scope='module')
 
 #
 # Helper functions
@@ -523,3 +535,128 @@ def fs_obj_unlink(request, u_boot_config):
         call('rmdir %s' % mount_dir, shell=True)
         if fs_img:
             call('rm -f %s' % fs_img, shell=True)
+
+#
+# Fixture for block cache test
+#
+# NOTE: yield_fixture was deprecated since pytest-3.0
+@pytest.yield_fixture()
+def fs_obj_blkcache(request, u_boot_config):
+    """Set up a file system to be used in block cache test.
+
+    Args:
+        request: Pytest request object.
+	u_boot_config: U-boot configuration.
+
+    Return:
+        A fixture for block cache test, i.e. a triplet of file system type,
+        volume file name and the MD5 hash of the big file.
+    """
+    fs_type = request.param
+    fs_img = ''
+
+    fs_ubtype = fstype_to_ubname(fs_type)
+    check_ubconfig(u_boot_config, fs_ubtype)
+
+    mount_dir = u_boot_config.persistent_data_dir + '/mnt'
+
+    try:
+
+        # 1GiB volume, so that the FAT and the ext4 group tables are big
+        fs_img = mk_fs(u_boot_config, fs_type, 0x40000000, '1GB')
+
+        # Mount the image so we can populate it.
+        check_call('mkdir -p %s' % mount_dir, shell=True)
+        mount_fs(fs_type, fs_img, mount_dir)
+
+        # A directory with many small files for the metadata walk
+        check_call('mkdir %s/dir1' % mount_dir, shell=True)
+        for i in range(0, 500):
+            check_call('echo %d > %s/dir1/file%03d' % (i, mount_dir, i),
+                shell=True)
+
+        # A file big enough to have several extents / cluster runs
+        check_call('dd if=/dev/urandom of=%s/%s bs=1M count=16'
+            % (mount_dir, BLKCACHE_FILE), shell=True)
+        out = check_output('dd if=%s/%s bs=1M 2> /dev/null | md5sum'
+            % (mount_dir, BLKCACHE_FILE), shell=True)
+        md5val = out.split()[0]
+
+        umount_fs(mount_dir)
+    except CalledProcessError:
+        pytest.skip('Setup failed for filesystem: ' + fs_type)
+        return
+    else:
+        yield [fs_ubtype, fs_img, md5val]
+    finally:
+        umount_fs(mount_dir)
+        call('rmdir %s' % mount_dir, shell=True)
+        if fs_img:
+            call('rm -f %s' % fs_img, shell=True)
+
+#
+# Fixture for fragmented file test
+#
+# NOTE: yield_fixture was deprecated since pytest-3.0
+@pytest.yield_fixture()
+def fs_obj_fragment(request, u_boot_config):
+    """Set up a file system with a fragmented file.
+
+    The volume is filled up with small files, every other one of which is
+    then removed, so that the big file written last is spread over the
+    holes.
+
+    Args:
+        request: Pytest request object.
+	u_boot_config: U-boot configuration.
+
+    Return:
+        A fixture for fragmented file test, i.e. a triplet of file system
+        type, volume file name and a list of MD5 hashes of the big file:
+        whole, and FRAG_LENGTH bytes from FRAG_OFFSET.
+    """
+    fs_type = request.param
+    fs_img = ''
+
+    fs_ubtype = fstype_to_ubname(fs_type)
+    check_ubconfig(u_boot_config, fs_ubtype)
+
+    mount_dir = u_boot_config.persistent_data_dir + '/mnt'
+
+    try:
+
+        # 64MiB volume
+        fs_img = mk_fs(u_boot_config, fs_type, 0x4000000, '64MB')
+
+        # Mount the image so we can populate it.
+        check_call('mkdir -p %s' % mount_dir, shell=True)
+        mount_fs(fs_type, fs_img, mount_dir)
+
+        check_call('mkdir %s/fill' % mount_dir, shell=True)
+        check_call('i=0; while dd if=/dev/zero of=%s/fill/$i bs=16K count=1 '
+                   '2> /dev/null; do i=$((i+1)); done; true'
+                   % mount_dir, shell=True)
+        check_call('cd %s/fill && for f in *; do [ $((f %% 2)) = 1 ] && '
+                   'rm $f; done; sync; true' % mount_dir, shell=True)
+        check_call('dd if=/dev/urandom of=%s/%s bs=1M count=16'
+            % (mount_dir, FRAG_FILE), shell=True)
+        md5val = []
+        out = check_output('dd if=%s/%s bs=1M 2> /dev/null | md5sum'
+            % (mount_dir, FRAG_FILE), shell=True)
+        md5val.append(out.split()[0])
+        out = check_output(
+            'dd if=%s/%s bs=1 skip=%d count=%d 2> /dev/null | md5sum'
+            % (mount_dir, FRAG_FILE, FRAG_OFFSET, FRAG_LENGTH), shell=True)
+        md5val.append(out.split()[0])
+
+        umount_fs(mount_dir)
+    except CalledProcessError:
+        pytest.skip('Setup failed for filesystem: ' + fs_type)
+        return
+    else:
+        yield [fs_ubtype, fs_img, md5val]
+    finally:
+        umount_fs(mount_dir)
+        call('rmdir %s' % mount_dir, shell=True)
+        if fs_img:
+            call('rm -f %s' % fs_img, shell=True)
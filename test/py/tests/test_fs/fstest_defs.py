@@ -9,5 +9,13 @@ SMALL_FILE='1MB.file'
 # $BIG_FILE is the name of the 2.5GB file in the file system image
 BIG_FILE='2.5GB.file'
 
+# $BLKCACHE_FILE is the name of the 16MB file in the block cache test image
+BLKCACHE_FILE='16MB.file'
+
 ADDR=0x01000008
 LENGTH=0x00100000
+
+# $FRAG_FILE is the name of the 16MB fragmented file in the file system image
+FRAG_FILE='frag.file'
+FRAG_OFFSET=1000000
+FRAG_LENGTH=300000
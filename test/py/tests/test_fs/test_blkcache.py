@@ -0,0 +1,60 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System: block cache benchmark
+
+"""
+This test reads a big directory and a file from a large file system with
+the block cache disabled, then enabled, and compares the number of reads
+issued to the device.
+"""
+
+import pytest
+import re
+from fstest_defs import *
+
+def run_workload(u_boot_console, fs_type, fs_img, cache_cfg):
+    """Run ls/load on a file system and return the device read count.
+
+    Args:
+        u_boot_console: U-Boot console.
+        fs_type: File system type.
+        fs_img: Volume's file name.
+        cache_cfg: Arguments to 'blkcache configure'.
+
+    Return:
+        A pair of the number of device reads and the 'md5sum' output.
+    """
+    output = u_boot_console.run_command_list([
+        'host bind 0 %s' % fs_img,
+        'blkcache configure %s' % cache_cfg,
+        '%sls host 0:0 /dir1' % fs_type,
+        '%sload host 0:0 %x /%s' % (fs_type, ADDR, BLKCACHE_FILE),
+        'md5sum %x $filesize' % ADDR,
+        '%sls host 0:0 /dir1' % fs_type,
+        'blkcache show'])
+    output = ''.join(output)
+    m = re.search('host 0: hits: (\d+), misses: (\d+)', output)
+    assert(m)
+    return int(m.group(2)), output
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_block_cache')
+class TestBlkcache(object):
+    def test_blkcache_reads(self, u_boot_console, fs_obj_blkcache):
+        """
+        Compare device reads with the cache off, as it was (2-block
+        entries, no read-ahead) and with the default configuration
+        """
+        fs_type,fs_img,md5val = fs_obj_blkcache
+        with u_boot_console.log.section('Block cache - device reads'):
+            reads = []
+            for cfg in ['0 0 0', '2 16384 0', '32 262144 8']:
+                count, output = run_workload(u_boot_console, fs_type,
+                                             fs_img, cfg)
+                assert(md5val in output)
+                u_boot_console.log.info('%s: blkcache %s: %d device reads'
+                                        % (fs_type, cfg, count))
+                reads.append(count)
+
+            assert(reads[1] < reads[0])
+            assert(reads[2] < reads[1])
@@ -0,0 +1,69 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System: fragmented file read test
+
+"""
+This test reads a file scattered over many extents, in whole and in part,
+and checks that reading it again does not walk the cluster chain or the
+extent tree again.
+"""
+
+import pytest
+import re
+from fstest_defs import *
+
+def device_reads(u_boot_console, cmd):
+    """Run a command and return the number of block reads it issued.
+
+    The block cache is disabled, so that every read is a miss.
+
+    Args:
+        u_boot_console: U-Boot console.
+        cmd: Command to run.
+
+    Return:
+        A pair of the number of block reads and the output of 'md5sum'.
+    """
+    output = u_boot_console.run_command_list([
+        'blkcache configure 0 0 0',
+        cmd,
+        'md5sum %x $filesize' % ADDR,
+        'blkcache show'])
+    output = ''.join(output)
+    m = re.search('host 0: hits: (\d+), misses: (\d+)', output)
+    assert(m)
+    return int(m.group(2)), output
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_block_cache')
+class TestFragment(object):
+    def test_fragment1(self, u_boot_console, fs_obj_fragment):
+        """
+        Test Case 1 - read a fragmented file twice
+        """
+        fs_type,fs_img,md5val = fs_obj_fragment
+        with u_boot_console.log.section('Test Case 1 - read whole file'):
+            u_boot_console.run_command('host bind 0 %s' % fs_img)
+            cmd = '%sload host 0:0 %x /%s' % (fs_type, ADDR, FRAG_FILE)
+            first, output = device_reads(u_boot_console, cmd)
+            assert(md5val[0] in output)
+            again, output = device_reads(u_boot_console, cmd)
+            assert(md5val[0] in output)
+            u_boot_console.log.info('%s: %d block reads, then %d'
+                                    % (fs_type, first, again))
+
+            # The cluster or extent map is kept, only the data is read again
+            assert(again < first)
+
+    def test_fragment2(self, u_boot_console, fs_obj_fragment):
+        """
+        Test Case 2 - read a part of a fragmented file
+        """
+        fs_type,fs_img,md5val = fs_obj_fragment
+        with u_boot_console.log.section('Test Case 2 - read at offset'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                '%sload host 0:0 %x /%s %x %x' % (fs_type, ADDR, FRAG_FILE,
+                    FRAG_LENGTH, FRAG_OFFSET),
+                'md5sum %x $filesize' % ADDR])
+            assert(md5val[1] in ''.join(output))
@@ -0,0 +1,59 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# UBI attach benchmark
+
+"""
+This test attaches UBI to the simulated NAND devices on sandbox and reports
+how long it took. The first attach scans the blank device and formats it.
+After a volume has been written, the device is detached and attached again,
+using the fastmap if UBI writes one.
+"""
+
+import pytest
+import re
+
+# Simulated NAND devices in test.dts: name and size in MiB
+DEVICES = [('nand0', 64), ('nand1', 256), ('nand2', 1024)]
+
+# Size of the volume written to each device, and where its data comes from
+VOL_SIZE = 0x800000
+DATA_ADDR = 0x0
+READ_ADDR = 0x1000000
+
+def time_ms(cons, cmd):
+    """Run a command under 'time' and return the output and elapsed ms."""
+    output = cons.run_command('time ' + cmd)
+    m = re.search('time: (?:(\d+) minutes, )?(\d+)\.(\d+) seconds', output)
+    assert(m)
+    ms = int(m.group(1) or 0) * 60000 + int(m.group(2)) * 1000 + \
+        int(m.group(3))
+    return output, ms
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_ubi')
+@pytest.mark.buildconfigspec('sandbox_nand')
+@pytest.mark.buildconfigspec('cmd_time')
+@pytest.mark.parametrize('dev,size_mb', DEVICES)
+def test_ubi_attach(u_boot_console, dev, size_mb):
+    """Time attaching UBI to a blank and to a populated device."""
+    cons = u_boot_console
+    output, scan_ms = time_ms(cons, 'ubi part %s' % dev)
+    assert('attached mtd' in output)
+
+    cons.run_command('ubi create bench %x' % VOL_SIZE)
+    output = cons.run_command('ubi write %x bench %x' % (DATA_ADDR, VOL_SIZE))
+    assert('%d bytes written' % VOL_SIZE in output)
+    cons.run_command('ubi detach')
+
+    output, attach_ms = time_ms(cons, 'ubi part %s' % dev)
+    assert('attached mtd' in output)
+    method = 'fastmap' if 'attached by fastmap' in output else 'scanning'
+    cons.log.info('%s (%d MiB): blank attach %d ms, attach by %s %d ms'
+                  % (dev, size_mb, scan_ms, method, attach_ms))
+
+    cons.run_command('ubi read %x bench %x' % (READ_ADDR, VOL_SIZE))
+    output = cons.run_command('cmp.b %x %x %x' % (DATA_ADDR, READ_ADDR,
+                                                  VOL_SIZE))
+    assert('were the same' in output)
+    cons.run_command('ubi remove bench')
+    cons.run_command('ubi detach')
@@ -32,3 +32,17 @@ void ut_failf(struct unit_test_state *uts, const char *fname, int line,
 	putc('\n');
 	uts->fail_count++;
 }
+
+u8 ut_pattern(ulong offset)
+{
+	return offset * 7 + (offset >> 9);
+}
+
+void ut_fill_pattern(void *buf, ulong size)
+{
+	u8 *p = buf;
+	ulong i;
+
+	for (i = 0; i < size; i++)
+		p[i] = ut_pattern(i);
+}